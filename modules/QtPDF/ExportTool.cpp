@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+// `qtpdf-export` renders (some of) the pages of a PDF to image files using
+// QtPDF::PDFPageExporter, e.g., for batch processing on build servers:
+//
+//   qtpdf-export -r 300 -p 1-3,7 -o 'out/page-%1.tiff' document.pdf
+
+#include "PDFBackend.h"
+#include "PDFPageExporter.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+
+#include <cstdio>
+
+using QtPDF::PDFPageExporter;
+
+int main(int argc, char ** argv)
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName(QStringLiteral("qtpdf-export"));
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Renders pages of a PDF file to image files."));
+  parser.addHelpOption();
+  parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("PDF file to export"));
+  const QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")}, QStringLiteral("Output file name; %1 is replaced by the page number (default: <file>-%1.png)."), QStringLiteral("pattern"));
+  const QCommandLineOption formatOption({QStringLiteral("f"), QStringLiteral("format")}, QStringLiteral("Image format, e.g., png or tiff (default: derived from the output file name)."), QStringLiteral("format"));
+  const QCommandLineOption resolutionOption({QStringLiteral("r"), QStringLiteral("resolution")}, QStringLiteral("Resolution in dpi (default: 150)."), QStringLiteral("dpi"), QStringLiteral("150"));
+  const QCommandLineOption pagesOption({QStringLiteral("p"), QStringLiteral("pages")}, QStringLiteral("Pages to export, e.g., 1-3,5,8- (default: all)."), QStringLiteral("range"));
+  const QCommandLineOption jobsOption({QStringLiteral("j"), QStringLiteral("jobs")}, QStringLiteral("Number of pages to render in parallel (default: number of cores)."), QStringLiteral("n"));
+  const QCommandLineOption backendOption(QStringLiteral("backend"), QStringLiteral("PDF backend to use (available: %1).").arg(QtPDF::Backend::Document::backends().join(QStringLiteral(", "))), QStringLiteral("name"));
+  const QCommandLineOption passwordOption(QStringLiteral("password"), QStringLiteral("Password for encrypted files."), QStringLiteral("password"));
+  const QCommandLineOption quietOption({QStringLiteral("q"), QStringLiteral("quiet")}, QStringLiteral("Don't report progress."));
+  parser.addOptions({outputOption, formatOption, resolutionOption, pagesOption, jobsOption, backendOption, passwordOption, quietOption});
+  parser.process(app);
+
+  if (parser.positionalArguments().size() != 1)
+    parser.showHelp(2);
+  const QString fileName = parser.positionalArguments().first();
+
+  PDFPageExporter exporter;
+  exporter.setFileName(fileName);
+  exporter.setBackend(parser.value(backendOption));
+  exporter.setPassword(parser.value(passwordOption));
+
+  bool ok{false};
+  exporter.setResolution(parser.value(resolutionOption).toDouble(&ok));
+  if (!ok) {
+    std::fprintf(stderr, "Invalid resolution '%s'\n", qPrintable(parser.value(resolutionOption)));
+    return 2;
+  }
+  if (parser.isSet(jobsOption)) {
+    const int jobs = parser.value(jobsOption).toInt(&ok);
+    if (!ok || jobs < 1) {
+      std::fprintf(stderr, "Invalid number of jobs '%s'\n", qPrintable(parser.value(jobsOption)));
+      return 2;
+    }
+    exporter.setThreadCount(jobs);
+  }
+
+  if (parser.isSet(pagesOption)) {
+    // We need the page count to resolve open ranges
+    QSharedPointer<QtPDF::Backend::Document> doc = QtPDF::Backend::Document::newDocument(fileName, parser.value(backendOption));
+    if (doc && doc->isLocked())
+      doc->unlock(parser.value(passwordOption));
+    const int numPages = (doc && doc->isValid() ? static_cast<int>(doc->numPages()) : 0);
+    doc.reset();
+    const QVector<int> pages = PDFPageExporter::parsePageRange(parser.value(pagesOption), numPages, &ok);
+    if (!ok || pages.isEmpty()) {
+      std::fprintf(stderr, "Invalid page range '%s'\n", qPrintable(parser.value(pagesOption)));
+      return 2;
+    }
+    exporter.setPages(pages);
+  }
+
+  const QFileInfo fi(fileName);
+  const QString output = (parser.isSet(outputOption) ? parser.value(outputOption) : fi.dir().filePath(fi.completeBaseName() + QStringLiteral("-%1.png")));
+  exporter.setOutputFiles(output, parser.value(formatOption).toLatin1());
+
+  const bool quiet = parser.isSet(quietOption);
+  QObject::connect(&exporter, &PDFPageExporter::progress, [quiet](int done, int total) {
+    if (!quiet)
+      std::fprintf(stderr, "\r%d/%d", done, total);
+  });
+  QObject::connect(&exporter, &PDFPageExporter::finished, &app, [&exporter, quiet](bool success) {
+    if (!quiet)
+      std::fprintf(stderr, "\n");
+    if (!success && !exporter.errorString().isEmpty())
+      std::fprintf(stderr, "%s\n", qPrintable(exporter.errorString()));
+    QCoreApplication::exit(success ? 0 : 1);
+  });
+
+  if (!exporter.start()) {
+    std::fprintf(stderr, "%s\n", qPrintable(exporter.errorString()));
+    return 1;
+  }
+  return QCoreApplication::exec();
+}
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+// `qtpdf-render-helper` renders pages and searches text on behalf of
+// QtPDF::Backend::RenderProcessPool. It reads requests from stdin and writes
+// replies to stdout (see QtPDF::Backend::RenderProtocol) until stdin is
+// closed. If anything goes wrong while processing a (possibly malicious) PDF,
+// only this process dies.
+
+#include "PDFBackend.h"
+#include "PDFRenderProcess.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QSharedMemory>
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+using namespace QtPDF::Backend;
+
+namespace {
+
+QSharedPointer<Document> doc;
+QString docBackend;
+QString docFileName;
+
+QSharedPointer<Page> loadPage(const QString & backend, const QString & fileName, const quint64 contentKey, const int pageNum)
+{
+  if (!doc || backend != docBackend || fileName != docFileName || doc->loadedContentKey() != contentKey) {
+    doc = Document::newDocument(fileName, backend);
+    docBackend = backend;
+    docFileName = fileName;
+  }
+  // If the file changed since the application loaded it, we can't produce
+  // results for the version it shows
+  if (!doc || !doc->isValid() || doc->isLocked() || doc->loadedContentKey() != contentKey)
+    return {};
+  return doc->page(pageNum).toStrongRef();
+}
+
+void render(QDataStream & request, QDataStream & reply, QSharedMemory & buffer, const QSharedPointer<Page> & page)
+{
+  double xres{0}, yres{0};
+  QRect renderBox;
+  QColor paperColor;
+  QString bufferKey;
+  qint64 bufferSize{0};
+  request >> xres >> yres >> renderBox >> paperColor >> bufferKey >> bufferSize;
+  if (request.status() != QDataStream::Ok || !page) {
+    reply << static_cast<quint8>(RenderProtocol::Status_Failed);
+    return;
+  }
+
+  if (doc->paperColor() != paperColor)
+    doc->setPaperColor(paperColor);
+  const QImage image = page->renderToImage(xres, yres, renderBox);
+
+  const qint64 requiredSize = static_cast<qint64>(image.bytesPerLine()) * image.height();
+  if (requiredSize > bufferSize) {
+    reply << static_cast<quint8>(RenderProtocol::Status_BufferTooSmall) << requiredSize;
+    return;
+  }
+
+  // The application creates a new segment (with a new key) whenever it needs
+  // a larger one
+  if (buffer.key() != bufferKey) {
+    if (buffer.isAttached())
+      buffer.detach();
+    buffer.setKey(bufferKey);
+  }
+  if (!buffer.isAttached() && !buffer.attach()) {
+    qWarning("Could not attach to shared memory: %s", qPrintable(buffer.errorString()));
+    reply << static_cast<quint8>(RenderProtocol::Status_Failed);
+    return;
+  }
+  if (requiredSize > static_cast<qint64>(buffer.size())) {
+    reply << static_cast<quint8>(RenderProtocol::Status_BufferTooSmall) << requiredSize;
+    return;
+  }
+
+  buffer.lock();
+  if (requiredSize > 0)
+    std::memcpy(buffer.data(), image.constBits(), static_cast<size_t>(requiredSize));
+  buffer.unlock();
+
+  reply << static_cast<quint8>(RenderProtocol::Status_Ok)
+        << static_cast<qint32>(image.width()) << static_cast<qint32>(image.height())
+        << static_cast<qint32>(image.bytesPerLine()) << static_cast<qint32>(image.format());
+}
+
+void search(QDataStream & request, QDataStream & reply, const QSharedPointer<Page> & page)
+{
+  QString searchText;
+  qint32 flags{0};
+  request >> searchText >> flags;
+  if (request.status() != QDataStream::Ok || !page) {
+    reply << static_cast<quint8>(RenderProtocol::Status_Failed);
+    return;
+  }
+
+  QList<QRectF> boxes;
+  for (const SearchResult & result : page->search(searchText, SearchFlags(QFlag(flags))))
+    boxes << result.bbox;
+  reply << static_cast<quint8>(RenderProtocol::Status_Ok) << boxes;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+  QCoreApplication app(argc, argv);
+
+  // stdout is reserved for the protocol; divert everything else that might
+  // get printed (e.g., by the backend library) to stderr
+#if defined(Q_OS_WIN)
+  const int protocolFd = _dup(_fileno(stdout));
+  _dup2(_fileno(stderr), _fileno(stdout));
+#else
+  const int protocolFd = dup(STDOUT_FILENO);
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+#endif
+
+  QFile in, out;
+  if (!in.open(fileno(stdin), QIODevice::ReadOnly | QIODevice::Unbuffered) ||
+      !out.open(protocolFd, QIODevice::WriteOnly | QIODevice::Unbuffered))
+    return 1;
+
+  QSharedMemory buffer;
+  QByteArray message;
+  while (RenderProtocol::readMessage(in, message)) {
+    QDataStream request(message);
+    request.setVersion(QDataStream::Qt_5_0);
+    QByteArray replyMessage;
+    QDataStream reply(&replyMessage, QIODevice::WriteOnly);
+    reply.setVersion(QDataStream::Qt_5_0);
+
+    quint8 command{0};
+    QString backend, fileName;
+    quint64 contentKey{0};
+    qint32 pageNum{-1};
+    request >> command >> backend >> fileName >> contentKey >> pageNum;
+    const QSharedPointer<Page> page = (request.status() == QDataStream::Ok ? loadPage(backend, fileName, contentKey, pageNum) : QSharedPointer<Page>());
+
+    switch (command) {
+      case RenderProtocol::Command_Render:
+        render(request, reply, buffer, page);
+        break;
+      case RenderProtocol::Command_Search:
+        search(request, reply, page);
+        break;
+      default:
+        reply << static_cast<quint8>(RenderProtocol::Status_Failed);
+        break;
+    }
+
+    if (!RenderProtocol::writeMessage(out, replyMessage))
+      return 1;
+  }
+  doc.reset();
+  return 0;
+}
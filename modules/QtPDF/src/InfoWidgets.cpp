@@ -13,18 +13,28 @@
  */
 #include "InfoWidgets.h"
 
+#include <QCheckBox>
 #include <QEvent>
+#include <QFileDialog>
 #include <QGroupBox>
+#include <QHeaderView>
 #include <QLabel>
 #include <QListView>
+#include <QListWidget>
+#include <QMessageBox>
+#include <QPixmap>
+#include <QPushButton>
+#include <QScrollBar>
 #include <QTableWidget>
+#include <QTreeView>
 #include <QTreeWidget>
-#include <QTreeWidgetItem>
 #include <QtConcurrent>
 
 #include "PaperSizes.h"
 #include "PDFBackend.h"
 #include "PDFDocumentView.h"
+#include "PDFToCModel.h"
+#include "PDFTrace.h"
 
 namespace QtPDF {
 
@@ -56,11 +66,18 @@ PDFToCInfoWidget::PDFToCInfoWidget(QWidget * parent) :
   QVBoxLayout * layout = new QVBoxLayout(this);
   layout->setContentsMargins(0, 0, 0, 0);
 
-  _tree = new QTreeWidget(this);
+  _model = new PDFToCModel(this);
+  _tree = new QTreeView(this);
   _tree->setAlternatingRowColors(true);
   _tree->setHeaderHidden(true);
   _tree->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
-  connect(_tree, &QTreeWidget::itemSelectionChanged, this, &PDFToCInfoWidget::itemSelectionChanged);
+  _tree->setUniformRowHeights(true);
+  _tree->setModel(_model);
+  _tree->setSelectionMode(QAbstractItemView::SingleSelection);
+  connect(_tree->selectionModel(), &QItemSelectionModel::selectionChanged, this, &PDFToCInfoWidget::itemSelectionChanged);
+  // Items are only fetched from the backend when their parent is expanded, so
+  // we can only honor the "open" state of items once they have been fetched
+  connect(_model, &QAbstractItemModel::rowsInserted, this, &PDFToCInfoWidget::expandOpenItems);
 
   layout->addWidget(_tree);
   setLayout(layout);
@@ -71,88 +88,60 @@ void PDFToCInfoWidget::retranslateUi()
   setWindowTitle(PDFDocumentView::tr("Table of Contents"));
 }
 
-PDFToCInfoWidget::~PDFToCInfoWidget()
-{
-  clear();
-}
+PDFToCInfoWidget::~PDFToCInfoWidget() = default;
 
 void PDFToCInfoWidget::initFromDocument(const QWeakPointer<Backend::Document> newDoc)
 {
   Q_ASSERT(_tree != nullptr);
+  Q_ASSERT(_model != nullptr);
 
   PDFDocumentInfoWidget::initFromDocument(newDoc);
 
-  clear();
-  QSharedPointer<Backend::Document> doc(newDoc.toStrongRef());
-  if (doc) {
-    const Backend::PDFToC tocData = doc->toc();
-    recursiveAddTreeItems(tocData, _tree->invisibleRootItem());
-  }
+  // make sure that no item is (and can be) selected while the model is reset
+  _tree->setSelectionMode(QAbstractItemView::NoSelection);
+  _model->setDocument(newDoc);
+  _tree->setSelectionMode(QAbstractItemView::SingleSelection);
+  // Fetch the top-level items right away (expanding open ones as needed)
+  if (_model->canFetchMore(QModelIndex()))
+    _model->fetchMore(QModelIndex());
 }
 
 void PDFToCInfoWidget::clear()
 {
   Q_ASSERT(_tree != nullptr);
+  Q_ASSERT(_model != nullptr);
   // make sure that no item is (and can be) selected while we clear the tree
-  // (otherwise clearing it could trigger (numerous) itemSelectionChanged signals)
+  // (otherwise clearing it could trigger selectionChanged signals)
   _tree->setSelectionMode(QAbstractItemView::NoSelection);
-  recursiveClearTreeItems(_tree->invisibleRootItem());
+  _model->setDocument({});
   _tree->setSelectionMode(QAbstractItemView::SingleSelection);
 }
 
 void PDFToCInfoWidget::itemSelectionChanged()
 {
   Q_ASSERT(_tree != nullptr);
-  // Since the ToC QTreeWidget is in single selection mode, we can only get zero
+  Q_ASSERT(_model != nullptr);
+  // Since the ToC tree is in single selection mode, we can only get zero
   // or one selected item(s)
 
-  QList<QTreeWidgetItem *> selectedItems = _tree->selectedItems();
-  if (selectedItems.count() == 0)
+  const QModelIndexList selectedIndexes = _tree->selectionModel()->selectedIndexes();
+  if (selectedIndexes.isEmpty())
     return;
-  QTreeWidgetItem * item = selectedItems.first();
-  Q_ASSERT(item != nullptr);
-  // TODO: It might be better to register PDFAction with the QMetaType framework
-  // instead of doing casts with (void*).
-  PDFAction * action = reinterpret_cast<PDFAction*>(item->data(0, Qt::UserRole).value<void*>());
-  if (action)
-    emit actionTriggered(action);
+  // Destinations are only resolved now that the item was actually activated.
+  // Keep the action around as receivers may hold on to the pointer.
+  _currentAction = _model->action(selectedIndexes.first());
+  if (_currentAction)
+    emit actionTriggered(_currentAction.get());
 }
 
-//static
-void PDFToCInfoWidget::recursiveAddTreeItems(const QList<Backend::PDFToCItem> & tocItems, QTreeWidgetItem * parentTreeItem)
-{
-  foreach (const Backend::PDFToCItem & tocItem, tocItems) {
-    QTreeWidgetItem * treeItem = new QTreeWidgetItem(parentTreeItem, QStringList(tocItem.label()));
-    treeItem->setForeground(0, tocItem.color());
-    if (tocItem.flags()) {
-      QFont font = treeItem->font(0);
-      font.setBold(tocItem.flags().testFlag(Backend::PDFToCItem::Flag_Bold));
-      font.setItalic(tocItem.flags().testFlag(Backend::PDFToCItem::Flag_Bold));
-      treeItem->setFont(0, font);
-    }
-    treeItem->setExpanded(tocItem.isOpen());
-    // TODO: It might be better to register PDFAction via QMetaType to avoid
-    // having to use (void*).
-    if (tocItem.action())
-      treeItem->setData(0, Qt::UserRole, QVariant::fromValue(reinterpret_cast<void*>(tocItem.action()->clone())));
-    // TODO: maybe display page numbers in col 2?
-
-    if (!tocItem.children().isEmpty())
-      recursiveAddTreeItems(tocItem.children(), treeItem);
-  }
-}
-
-//static
-void PDFToCInfoWidget::recursiveClearTreeItems(QTreeWidgetItem * parent)
-{
-  Q_ASSERT(parent != nullptr);
-  while (parent->childCount() > 0) {
-    QTreeWidgetItem * item = parent->child(0);
-    recursiveClearTreeItems(item);
-    PDFAction * action = static_cast<PDFAction*>(item->data(0, Qt::UserRole).value<void*>());
-    delete action;
-    parent->removeChild(item);
-    delete item;
+void PDFToCInfoWidget::expandOpenItems(const QModelIndex & parent, int first, int last)
+{
+  Q_ASSERT(_tree != nullptr);
+  Q_ASSERT(_model != nullptr);
+  for (int row = first; row <= last; ++row) {
+    const QModelIndex index = _model->index(row, 0, parent);
+    if (index.data(PDFToCModel::IsOpenRole).toBool())
+      _tree->expand(index);
   }
 }
 
@@ -288,10 +277,12 @@ void PDFMetaDataInfoWidget::reload()
     clear();
     return;
   }
-  _title->setText(doc->title());
-  _author->setText(doc->author());
-  _subject->setText(doc->subject());
-  _keywords->setText(doc->keywords());
+
+  // Large documents load their meta data in the background (see
+  // PDFDocumentScene); PDFDocumentView::documentMetaDataLoaded() tells us when
+  // it is available. Don't block the GUI by loading it here in the meantime.
+  if (!doc->isDeferredDataLoaded())
+    clear();
 
   // Convert the file size to human-readable form
   double fileSize = static_cast<double>(doc->fileSize());
@@ -303,6 +294,15 @@ void PDFMetaDataInfoWidget::reload()
   else
     _fileSize->setText(QString::fromLatin1("%1 %2").arg(fileSize, 0, 'f', 1).arg(sizeUnits[iUnit]));
 
+  if (!doc->isDeferredDataLoaded()) {
+    _otherGroup->setVisible(false);
+    return;
+  }
+
+  _title->setText(doc->title());
+  _author->setText(doc->author());
+  _subject->setText(doc->subject());
+  _keywords->setText(doc->keywords());
   _pageSize->setText(doc->pageSize().isValid() ? PaperSize::findForPDFSize(doc->pageSize()).label() : QString());
 
   _creator->setText(doc->creator());
@@ -349,6 +349,7 @@ void PDFMetaDataInfoWidget::clear()
   _author->setText(QString());
   _subject->setText(QString());
   _keywords->setText(QString());
+  _pageSize->setText(QString());
   _fileSize->setText(QString());
   _creator->setText(QString());
   _producer->setText(QString());
@@ -416,6 +417,9 @@ PDFFontsInfoWidget::PDFFontsInfoWidget(QWidget * parent) :
 
   layout->addWidget(_table);
   setLayout(layout);
+
+  connect(&_scanner, &PDFFontScanner::fontsFound, this, &PDFFontsInfoWidget::fontsFound, Qt::QueuedConnection);
+  connect(&_scanner, &PDFFontScanner::finished, this, &PDFFontsInfoWidget::scanFinished);
   retranslateUi();
 }
 
@@ -426,20 +430,37 @@ void PDFFontsInfoWidget::initFromDocument(const QWeakPointer<Backend::Document>
     reload();
 }
 
+PDFFontsInfoWidget::~PDFFontsInfoWidget()
+{
+  _scanner.ensureStopped();
+}
+
 void PDFFontsInfoWidget::reload()
 {
   Q_ASSERT(_table != nullptr);
 
+  _scanner.ensureStopped();
   clear();
-  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
-  if (!doc)
+  _scanner.setDocument(_doc);
+  if (!_doc.isNull())
+    _scanner.start(QThread::LowPriority);
+}
+
+void PDFFontsInfoWidget::fontsFound()
+{
+  Q_ASSERT(_table != nullptr);
+
+  // NB: Rows are only ever added for fonts reported by the scanner, so the row
+  // count tells us how many fonts we have already shown. Signals queued from a
+  // previous (aborted) scan are harmless as the scanner is queried directly.
+  const QList<Backend::PDFFontInfo> fonts = _scanner.fonts(_table->rowCount());
+  if (fonts.isEmpty())
     return;
 
-  QList<Backend::PDFFontInfo> fonts = doc->fonts();
-  _table->setRowCount(static_cast<decltype(_table->rowCount())>(fonts.count()));
+  int i = _table->rowCount();
+  _table->setRowCount(i + static_cast<decltype(_table->rowCount())>(fonts.count()));
 
-  int i = 0;
-  foreach (Backend::PDFFontInfo font, fonts) {
+  for (const Backend::PDFFontInfo & font : fonts) {
     _table->setItem(i, 0, new QTableWidgetItem(font.descriptor().pureName()));
     switch (font.fontType()) {
     case Backend::PDFFontInfo::FontType_Type0:
@@ -472,9 +493,17 @@ void PDFFontsInfoWidget::reload()
     }
     ++i;
   }
+  _table->sortItems(0);
+}
+
+void PDFFontsInfoWidget::scanFinished()
+{
+  Q_ASSERT(_table != nullptr);
+  // Pick up anything that was reported after the last fontsFound() was handled
+  fontsFound();
+  // Resizing is comparatively expensive, so only do it once all fonts are in
   _table->resizeColumnsToContents();
   _table->resizeRowsToContents();
-  _table->sortItems(0);
 }
 
 void PDFFontsInfoWidget::clear()
@@ -701,4 +730,327 @@ void PDFAnnotationsInfoWidget::retranslateUi()
   _table->setHorizontalHeaderLabels(QStringList() << PDFDocumentView::tr("Page") << PDFDocumentView::tr("Subject") << PDFDocumentView::tr("Author") << PDFDocumentView::tr("Contents"));
 }
 
+
+// PDFThumbnailsInfoWidget
+// ============
+PDFThumbnailsInfoWidget::PDFThumbnailsInfoWidget(QWidget * parent) :
+    PDFDocumentInfoWidget(parent, PDFDocumentView::tr("Thumbnails"), QString::fromLatin1("QtPDF.ThumbnailsInfoWidget"))
+{
+  QVBoxLayout * layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  _list = new QListWidget(this);
+  // A single column of thumbnails with the page number below each one
+  _list->setViewMode(QListView::IconMode);
+  _list->setFlow(QListView::TopToBottom);
+  _list->setWrapping(false);
+  _list->setMovement(QListView::Static);
+  _list->setResizeMode(QListView::Adjust);
+  _list->setUniformItemSizes(true);
+  _list->setSpacing(4);
+  _list->setSelectionMode(QAbstractItemView::SingleSelection);
+  _list->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+  _list->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  connect(_list, &QListWidget::itemClicked, this, &PDFThumbnailsInfoWidget::itemActivated);
+  connect(_list, &QListWidget::itemActivated, this, &PDFThumbnailsInfoWidget::itemActivated);
+
+  _requestTimer.setSingleShot(true);
+  _requestTimer.setInterval(50);
+  connect(&_requestTimer, &QTimer::timeout, this, &PDFThumbnailsInfoWidget::requestVisibleThumbnails);
+  connect(_list->verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() { _requestTimer.start(); });
+
+  layout->addWidget(_list);
+  setLayout(layout);
+  retranslateUi();
+}
+
+void PDFThumbnailsInfoWidget::initFromDocument(const QWeakPointer<Backend::Document> newDoc)
+{
+  Q_ASSERT(_list != nullptr);
+
+  // When the document is reloaded, keep the user's place in the list
+  const int scrollPos = _list->verticalScrollBar()->value();
+  const int currentRow = _list->currentRow();
+
+  PDFDocumentInfoWidget::initFromDocument(newDoc);
+  clear();
+
+  QSharedPointer<Backend::Document> doc(newDoc.toStrongRef());
+  if (!doc || !doc->isValid())
+    return;
+  const int numPages = static_cast<int>(doc->numPages());
+  if (numPages <= 0)
+    return;
+
+  // Size all items after the first page; pages of other sizes are scaled to
+  // fit once their thumbnail arrives
+  QSize iconSize{99, 140};
+  QSharedPointer<Backend::Page> firstPage(doc->page(0).toStrongRef());
+  if (firstPage) {
+    const QSize size = (firstPage->pageSizeF() * Backend::PDFThumbnailCache::resolution() / 72.).toSize();
+    if (!size.isEmpty())
+      iconSize = size;
+  }
+  _list->setIconSize(iconSize);
+  QPixmap placeholder(iconSize);
+  placeholder.fill(Qt::white);
+  const QIcon placeholderIcon(placeholder);
+
+  _list->setUpdatesEnabled(false);
+  for (int i = 0; i < numPages; ++i) {
+    QListWidgetItem * item = new QListWidgetItem(placeholderIcon, QString::number(i + 1), _list);
+    item->setTextAlignment(Qt::AlignHCenter);
+  }
+  _list->setUpdatesEnabled(true);
+  _requested.fill(false, numPages);
+
+  if (currentRow >= 0 && currentRow < numPages)
+    _list->setCurrentRow(currentRow);
+  _list->verticalScrollBar()->setValue(scrollPos);
+  _requestTimer.start();
+}
+
+void PDFThumbnailsInfoWidget::clear()
+{
+  Q_ASSERT(_list != nullptr);
+  _requestTimer.stop();
+  _list->clear();
+  _requested.clear();
+}
+
+void PDFThumbnailsInfoWidget::retranslateUi()
+{
+  setWindowTitle(PDFDocumentView::tr("Thumbnails"));
+}
+
+void PDFThumbnailsInfoWidget::setCurrentPage(const int pageNum)
+{
+  Q_ASSERT(_list != nullptr);
+  if (pageNum < 0 || pageNum >= _list->count() || pageNum == _list->currentRow())
+    return;
+  // Note: this doesn't emit itemClicked() or itemActivated(), so it doesn't
+  // trigger pageActivated()
+  _list->setCurrentRow(pageNum);
+  _list->scrollToItem(_list->item(pageNum));
+}
+
+void PDFThumbnailsInfoWidget::requestVisibleThumbnails()
+{
+  Q_ASSERT(_list != nullptr);
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (!doc || !isVisible() || _list->count() == 0)
+    return;
+
+  // Items are laid out top to bottom, so we can bisect for the first visible
+  // one instead of looking at all of them
+  const QRect viewport = _list->viewport()->rect();
+  int first{0}, last{_list->count()};
+  while (first < last) {
+    const int mid = first + (last - first) / 2;
+    if (_list->visualItemRect(_list->item(mid)).bottom() < viewport.top())
+      first = mid + 1;
+    else
+      last = mid;
+  }
+
+  for (int row = first; row < _list->count() && row < _requested.size(); ++row) {
+    if (_list->visualItemRect(_list->item(row)).top() > viewport.bottom())
+      break;
+    if (_requested[row])
+      continue;
+    QSharedPointer<Backend::Page> page(doc->page(row).toStrongRef());
+    if (!page)
+      continue;
+    _requested[row] = true;
+    page->asyncRenderThumbnail(this);
+  }
+}
+
+void PDFThumbnailsInfoWidget::itemActivated(QListWidgetItem * item)
+{
+  Q_ASSERT(_list != nullptr);
+  if (item)
+    emit pageActivated(_list->row(item));
+}
+
+bool PDFThumbnailsInfoWidget::event(QEvent * event)
+{
+  if (event && event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    const Backend::PDFPageRenderedEvent * renderEvent = static_cast<const Backend::PDFPageRenderedEvent *>(event);
+    if (renderEvent->page_num >= 0 && renderEvent->page_num < _list->count() && !renderEvent->rendered_page.isNull())
+      _list->item(static_cast<int>(renderEvent->page_num))->setIcon(QIcon(QPixmap::fromImage(renderEvent->rendered_page)));
+    return true;
+  }
+  return PDFDocumentInfoWidget::event(event);
+}
+
+void PDFThumbnailsInfoWidget::showEvent(QShowEvent * event)
+{
+  PDFDocumentInfoWidget::showEvent(event);
+  _requestTimer.start();
+}
+
+void PDFThumbnailsInfoWidget::resizeEvent(QResizeEvent * event)
+{
+  PDFDocumentInfoWidget::resizeEvent(event);
+  _requestTimer.start();
+}
+
+
+
+// PDFRenderStatisticsInfoWidget
+// ============
+PDFRenderStatisticsInfoWidget::PDFRenderStatisticsInfoWidget(QWidget * parent) :
+    PDFDocumentInfoWidget(parent, PDFDocumentView::tr("Render Statistics"), QString::fromLatin1("QtPDF.RenderStatisticsInfoWidget"))
+{
+  QVBoxLayout * layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+
+  _tree = new QTreeWidget(this);
+  _tree->setColumnCount(2);
+  _tree->setRootIsDecorated(true);
+  _tree->setSelectionMode(QAbstractItemView::NoSelection);
+  _tree->setAlternatingRowColors(true);
+  _tree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+  // Page cache, this document's processing thread, all processing threads
+  for (int i = 0; i < 3; ++i)
+    _tree->addTopLevelItem(new QTreeWidgetItem(_tree));
+  _tree->expandAll();
+  layout->addWidget(_tree);
+
+  QHBoxLayout * buttonLayout = new QHBoxLayout();
+  _resetButton = new QPushButton(this);
+  connect(_resetButton, &QPushButton::clicked, this, &PDFRenderStatisticsInfoWidget::resetStatistics);
+  buttonLayout->addWidget(_resetButton);
+  buttonLayout->addStretch();
+  _traceCheckBox = new QCheckBox(this);
+  connect(_traceCheckBox, &QCheckBox::toggled, this, [](const bool checked) { Trace::setEnabled(checked); });
+  buttonLayout->addWidget(_traceCheckBox);
+  _saveTraceButton = new QPushButton(this);
+  connect(_saveTraceButton, &QPushButton::clicked, this, &PDFRenderStatisticsInfoWidget::saveTrace);
+  buttonLayout->addWidget(_saveTraceButton);
+  layout->addLayout(buttonLayout);
+
+  setLayout(layout);
+
+  // Only poll the statistics while they are visible
+  _refreshTimer.setInterval(1000);
+  connect(&_refreshTimer, &QTimer::timeout, this, &PDFRenderStatisticsInfoWidget::refresh);
+
+  retranslateUi();
+}
+
+void PDFRenderStatisticsInfoWidget::initFromDocument(const QWeakPointer<Backend::Document> newDoc)
+{
+  PDFDocumentInfoWidget::initFromDocument(newDoc);
+  refresh();
+}
+
+void PDFRenderStatisticsInfoWidget::clear()
+{
+  for (int i = 0; i < _tree->topLevelItemCount(); ++i)
+    qDeleteAll(_tree->topLevelItem(i)->takeChildren());
+}
+
+void PDFRenderStatisticsInfoWidget::retranslateUi()
+{
+  setWindowTitle(PDFDocumentView::tr("Render Statistics"));
+  _tree->setHeaderLabels(QStringList() << PDFDocumentView::tr("Property") << PDFDocumentView::tr("Value"));
+  _tree->topLevelItem(0)->setText(0, PDFDocumentView::tr("Page cache"));
+  _tree->topLevelItem(1)->setText(0, PDFDocumentView::tr("Rendering (this document)"));
+  _tree->topLevelItem(2)->setText(0, PDFDocumentView::tr("Rendering (all documents)"));
+  _resetButton->setText(PDFDocumentView::tr("Reset"));
+  _traceCheckBox->setText(PDFDocumentView::tr("Record trace"));
+  _traceCheckBox->setToolTip(PDFDocumentView::tr("Record the timing of all rendering requests, e.g., to diagnose stalls"));
+  _saveTraceButton->setText(PDFDocumentView::tr("Save Trace..."));
+  // Labels are set when filling in the values
+  clear();
+  refresh();
+}
+
+void PDFRenderStatisticsInfoWidget::refresh()
+{
+  // Reuse existing rows so the view doesn't flicker (or lose its scroll
+  // position) on every update
+  auto setRow = [](QTreeWidgetItem * parent, const int row, const QString & label, const QString & value) {
+    QTreeWidgetItem * item = parent->child(row);
+    if (!item)
+      item = new QTreeWidgetItem(parent);
+    item->setText(0, label);
+    item->setText(1, value);
+  };
+  auto msecs = [](const double usecs) { return PDFDocumentView::tr("%1 ms").arg(usecs / 1000., 0, 'f', 1); };
+  auto mebibytes = [](const qint64 bytes) { return PDFDocumentView::tr("%1 MiB").arg(static_cast<double>(bytes) / 1024. / 1024., 0, 'f', 1); };
+
+  const Backend::PDFPageCache::Statistics cacheStats = Backend::Document::pageCache().statistics();
+  QTreeWidgetItem * cacheItem = _tree->topLevelItem(0);
+  int row = 0;
+  setRow(cacheItem, row++, PDFDocumentView::tr("Tiles"), PDFDocumentView::tr("%1 (%2 placeholders, %3 outdated)").arg(cacheStats.count).arg(cacheStats.placeholders).arg(cacheStats.outdated));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Memory"), PDFDocumentView::tr("%1 of %2").arg(mebibytes(cacheStats.cost), mebibytes(cacheStats.maxCost)));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Hit rate"), PDFDocumentView::tr("%1%").arg(100. * cacheStats.hitRate(), 0, 'f', 1));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Hits"), QString::number(cacheStats.hits));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Placeholder hits"), QString::number(cacheStats.placeholderHits));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Outdated hits"), QString::number(cacheStats.outdatedHits));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Misses"), QString::number(cacheStats.misses));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Insertions"), QString::number(cacheStats.insertions));
+  setRow(cacheItem, row++, PDFDocumentView::tr("Evictions"), QString::number(cacheStats.evictions));
+
+  auto fillProcessingStats = [&](QTreeWidgetItem * parent, const Backend::PDFPageProcessingThread::Statistics & stats) {
+    int r = 0;
+    setRow(parent, r++, PDFDocumentView::tr("Waiting requests"), PDFDocumentView::tr("%1 (max. %2)").arg(stats.queueDepth).arg(stats.maxQueueDepth));
+    setRow(parent, r++, PDFDocumentView::tr("Queued requests"), QString::number(stats.enqueued));
+    setRow(parent, r++, PDFDocumentView::tr("Coalesced requests"), QString::number(stats.coalesced));
+    setRow(parent, r++, PDFDocumentView::tr("Processed requests"), QString::number(stats.processed));
+    setRow(parent, r++, PDFDocumentView::tr("Cancelled requests"), QString::number(stats.cancelled));
+    setRow(parent, r++, PDFDocumentView::tr("Rendered tiles"), QString::number(stats.renderCount));
+    setRow(parent, r++, PDFDocumentView::tr("Average render time"), (stats.renderCount > 0 ? msecs(static_cast<double>(stats.renderTimeTotal) / static_cast<double>(stats.renderCount)) : QString()));
+    setRow(parent, r++, PDFDocumentView::tr("Longest render time"), msecs(static_cast<double>(stats.renderTimeMax)));
+    for (int i = 0; i < stats.renderTimeHistogram.size(); ++i) {
+      const qint64 limit = Backend::PDFPageProcessingThread::Statistics::renderTimeBucketLimit(i);
+      const QString label = (limit >= 0 ? PDFDocumentView::tr("Rendered in < %1 ms").arg(limit) : PDFDocumentView::tr("Rendered in >= %1 ms").arg(Backend::PDFPageProcessingThread::Statistics::renderTimeBucketLimit(i - 1)));
+      setRow(parent, r++, label, QString::number(stats.renderTimeHistogram[i]));
+    }
+  };
+
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (doc)
+    fillProcessingStats(_tree->topLevelItem(1), doc->processingThread().statistics());
+  else
+    qDeleteAll(_tree->topLevelItem(1)->takeChildren());
+  fillProcessingStats(_tree->topLevelItem(2), Backend::PDFPageProcessingThread::totalStatistics());
+
+  // Tracing can also be enabled elsewhere (e.g., in the settings)
+  const QSignalBlocker blocker(_traceCheckBox);
+  _traceCheckBox->setChecked(Trace::isEnabled());
+  _saveTraceButton->setEnabled(Trace::eventCount() > 0);
+}
+
+void PDFRenderStatisticsInfoWidget::resetStatistics()
+{
+  Backend::Document::pageCache().resetStatistics();
+  Backend::PDFPageProcessingThread::resetTotalStatistics();
+  refresh();
+}
+
+void PDFRenderStatisticsInfoWidget::saveTrace()
+{
+  const QString fileName = QFileDialog::getSaveFileName(this, PDFDocumentView::tr("Save Trace"), QString(), PDFDocumentView::tr("Trace files (*.json)"));
+  if (fileName.isEmpty())
+    return;
+  if (!Trace::writeJson(fileName))
+    QMessageBox::warning(this, PDFDocumentView::tr("Save Trace"), PDFDocumentView::tr("The trace could not be saved to %1.").arg(fileName));
+}
+
+void PDFRenderStatisticsInfoWidget::showEvent(QShowEvent * event)
+{
+  PDFDocumentInfoWidget::showEvent(event);
+  refresh();
+  _refreshTimer.start();
+}
+
+void PDFRenderStatisticsInfoWidget::hideEvent(QHideEvent * event)
+{
+  PDFDocumentInfoWidget::hideEvent(event);
+  _refreshTimer.stop();
+}
+
 } // namespace QtPDF
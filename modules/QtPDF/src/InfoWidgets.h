@@ -14,15 +14,25 @@
 #ifndef InfoWidgets_H
 #define InfoWidgets_H
 
+#include "PDFFontScanner.h"
+
 #include <QFutureWatcher>
+#include <QTimer>
+#include <QVector>
 #include <QWidget>
 
+#include <memory>
+
+class QCheckBox;
 class QGroupBox;
 class QLabel;
 class QListView;
+class QListWidget;
+class QListWidgetItem;
+class QPushButton;
 class QTableWidget;
+class QTreeView;
 class QTreeWidget;
-class QTreeWidgetItem;
 
 namespace QtPDF {
 
@@ -33,10 +43,10 @@ class AbstractAnnotation;
 namespace Backend {
 class Document;
 class Page;
-class PDFToCItem;
 }
 
 class PDFAction;
+class PDFToCModel;
 
 class PDFDocumentInfoWidget : public QWidget
 {
@@ -79,10 +89,11 @@ signals:
   void actionTriggered(const QtPDF::PDFAction*);
 private slots:
   void itemSelectionChanged();
+  void expandOpenItems(const QModelIndex & parent, int first, int last);
 private:
-  static void recursiveAddTreeItems(const QList<Backend::PDFToCItem> & tocItems, QTreeWidgetItem * parentTreeItem);
-  static void recursiveClearTreeItems(QTreeWidgetItem * parent);
-  QTreeWidget * _tree;
+  QTreeView * _tree;
+  PDFToCModel * _model;
+  std::unique_ptr<PDFAction> _currentAction;
 };
 
 class PDFMetaDataInfoWidget : public PDFDocumentInfoWidget
@@ -92,11 +103,13 @@ public:
   PDFMetaDataInfoWidget(QWidget * parent);
   ~PDFMetaDataInfoWidget() override = default;
 
+public slots:
+  void reload();
+
 protected slots:
   void initFromDocument(const QWeakPointer<QtPDF::Backend::Document> doc) override;
   void clear() override;
   void retranslateUi() final;
-  void reload();
 private:
   QGroupBox * _documentGroup;
   QLabel * _title, * _titleLabel;
@@ -119,13 +132,16 @@ class PDFFontsInfoWidget : public PDFDocumentInfoWidget
   Q_OBJECT
 public:
   PDFFontsInfoWidget(QWidget * parent);
-  ~PDFFontsInfoWidget() override = default;
+  ~PDFFontsInfoWidget() override;
 
 protected slots:
   void initFromDocument(const QWeakPointer<QtPDF::Backend::Document> doc) override;
   void clear() final;
   void retranslateUi() final;
   void reload();
+private slots:
+  void fontsFound();
+  void scanFinished();
 protected:
   void showEvent(QShowEvent * event) override {
     Q_UNUSED(event)
@@ -133,6 +149,7 @@ protected:
   }
 private:
   QTableWidget * _table;
+  PDFFontScanner _scanner;
 };
 
 class PDFPermissionsInfoWidget : public PDFDocumentInfoWidget
@@ -189,6 +206,68 @@ protected slots:
   void retranslateUi() final;
 };
 
+// Shows a list of page thumbnails. Thumbnails come from
+// Backend::Document::thumbnailCache() and are only requested (as low-priority
+// jobs) once they are scrolled into view.
+class PDFThumbnailsInfoWidget : public PDFDocumentInfoWidget
+{
+  Q_OBJECT
+public:
+  PDFThumbnailsInfoWidget(QWidget * parent);
+  ~PDFThumbnailsInfoWidget() override = default;
+
+public slots:
+  void setCurrentPage(const int pageNum);
+signals:
+  void pageActivated(int pageNum);
+
+protected slots:
+  void initFromDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc) override;
+  void clear() override;
+  void retranslateUi() final;
+private slots:
+  void requestVisibleThumbnails();
+  void itemActivated(QListWidgetItem * item);
+protected:
+  bool event(QEvent * event) override;
+  void showEvent(QShowEvent * event) override;
+  void resizeEvent(QResizeEvent * event) override;
+private:
+  QListWidget * _list{nullptr};
+  // Collects scroll and resize events so we don't request thumbnails for
+  // pages that are only scrolled past
+  QTimer _requestTimer;
+  QVector<bool> _requested;
+};
+
+// Debug panel showing live statistics of Backend::Document::pageCache() and of
+// the processing threads; it also allows recording a trace (see PDFTrace.h)
+class PDFRenderStatisticsInfoWidget : public PDFDocumentInfoWidget
+{
+  Q_OBJECT
+public:
+  PDFRenderStatisticsInfoWidget(QWidget * parent);
+  ~PDFRenderStatisticsInfoWidget() override = default;
+
+protected slots:
+  void initFromDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc) override;
+  void clear() override;
+  void retranslateUi() final;
+private slots:
+  void refresh();
+  void resetStatistics();
+  void saveTrace();
+protected:
+  void showEvent(QShowEvent * event) override;
+  void hideEvent(QHideEvent * event) override;
+private:
+  QTreeWidget * _tree{nullptr};
+  QPushButton * _resetButton{nullptr};
+  QCheckBox * _traceCheckBox{nullptr};
+  QPushButton * _saveTraceButton{nullptr};
+  QTimer _refreshTimer;
+};
+
 } // namespace QtPDF
 
 #endif // !defined(InfoWidgets_H)
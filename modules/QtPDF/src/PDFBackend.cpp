@@ -13,8 +13,12 @@
  */
 
 #include "PDFBackend.h"
+#include "PDFTrace.h"
 
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
 #include <QPainter>
 #include <QPainterPath>
 #include <QTimeZone>
@@ -169,6 +173,7 @@ QDateTime fromPDFDate(QString pdfDate)
 // _docLock.
 
 PDFPageCache Document::_pageCache;
+PDFThumbnailCache Document::_thumbnailCache;
 
 Document::Document(QString fileName):
   _fileName(fileName)
@@ -209,7 +214,138 @@ Document::~Document()
 //  qDebug() << "Document::~Document()";
 #endif
   clearPages();
-  _pageCache.removeDocumentTiles(this);
+  // Drops our tiles unless another document still uses them
+  _pageCache.changeKey(cacheKey(), 0);
+}
+
+//static
+quint64 Document::contentKey(const QString & fileName, const QByteArray & data /* = QByteArray() */)
+{
+  // Hashing all the data would take too long for large files (and this runs
+  // in the GUI thread). Instead, size and modification time identify the
+  // version of the file, and the trailer at its end (which holds the file
+  // identifier and the offset of the cross-reference table) tells apart
+  // versions written within the resolution of the time stamp.
+  const int tailSize = 1024;
+  qint64 size{0};
+  QByteArray tail;
+  if (!data.isEmpty()) {
+    size = data.size();
+    tail = data.right(tailSize);
+  }
+  else {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+      return 0;
+    size = file.size();
+    if (!file.seek(qMax(Q_INT64_C(0), size - tailSize)))
+      return 0;
+    tail = file.read(tailSize);
+  }
+  if (size <= 0)
+    return 0;
+
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  hash.addData(QByteArray::number(size));
+  hash.addData(QByteArray::number(QFileInfo(fileName).lastModified().toMSecsSinceEpoch()).prepend(','));
+  hash.addData(tail);
+  const QByteArray result = hash.result();
+  quint64 retVal{0};
+  for (int i = 0; i < 8; ++i)
+    retVal = (retVal << 8) | static_cast<quint8>(result[i]);
+  return (retVal != 0 ? retVal : 1);
+}
+
+void Document::setContentKey(const quint64 key)
+{
+  QWriteLocker docLocker(_docLock.data());
+  _contentKey = key;
+  _renderState = 0;
+  updateCacheKey();
+}
+
+void Document::setPaperColorKey(const QRgb color)
+{
+  QWriteLocker docLocker(_docLock.data());
+  _paperColorKey = color;
+  updateCacheKey();
+}
+
+void Document::renderStateChanged()
+{
+  // Render states are unique across all documents so they never share tiles
+  static QAtomicInteger<quint64> lastRenderState{0};
+  QWriteLocker docLocker(_docLock.data());
+  _renderState = lastRenderState.fetchAndAddOrdered(1) + 1;
+  updateCacheKey();
+}
+
+void Document::updateCacheKey()
+{
+  quint64 key = _contentKey;
+  if (key != 0 && (_paperColorKey != 0xffffffff || _renderState != 0)) {
+    // Mix in the render settings (the constants are the usual 64 bit golden
+    // ratio and MurmurHash multipliers)
+    key ^= (static_cast<quint64>(_paperColorKey) + 1) * Q_UINT64_C(0x9e3779b97f4a7c15);
+    key ^= _renderState * Q_UINT64_C(0xc2b2ae3d27d4eb4f);
+    key = (key ^ (key >> 31)) * Q_UINT64_C(0xff51afd7ed558ccd);
+    if (key == 0)
+      key = 1;
+  }
+  const quint64 oldKey = _cacheKey.loadAcquire();
+  if (key == oldKey)
+    return;
+  _cacheKey.storeRelease(key);
+  _pageCache.changeKey(oldKey, key);
+}
+
+void Document::loadLinksAndAnnotations(const QVector<size_type> & pages)
+{
+  for (const size_type n : pages) {
+    QSharedPointer<Page> p(page(n).toStrongRef());
+    if (!p)
+      continue;
+    p->loadLinks();
+    p->loadAnnotations();
+  }
+}
+
+void Document::preloadLinksAndAnnotations(const size_type page)
+{
+  // Only preload the pages the user is likely to scroll to next (nearest
+  // first) so pages far away are not created needlessly
+  const int radius = 16;
+  const size_type nPages = numPages();
+  QSharedPointer< QVector<size_type> > pages(new QVector<size_type>());
+  for (int i = 0; i <= radius; ++i) {
+    if (page + i < nPages)
+      pages->append(page + i);
+    if (i > 0 && page - i >= 0)
+      pages->append(page - i);
+  }
+  if (page < 0 || pages->isEmpty()) {
+    stopPreloadingLinksAndAnnotations();
+    return;
+  }
+
+  // The processing thread copies the task for each step, so the position must
+  // be shared between the copies
+  QSharedPointer<QAtomicInt> next(new QAtomicInt(0));
+  _processingThread.setIdleTask([this, pages, next]() {
+    // Small enough to not delay render requests noticeably
+    const int pagesPerStep = 8;
+    const int first = next->fetchAndAddOrdered(pagesPerStep);
+    const int count = static_cast<int>(pages->size());
+    const int last = qMin(first + pagesPerStep, count);
+    if (first < last)
+      loadLinksAndAnnotations(pages->mid(first, last - first));
+    return (last < count);
+  });
+}
+
+void Document::stopPreloadingLinksAndAnnotations()
+{
+  _processingThread.setIdleTask({});
 }
 
 Document::size_type Document::numPages() const { QReadLocker docLocker(_docLock.data()); return _numPages; }
@@ -224,6 +360,159 @@ QWeakPointer<Page> Document::page(size_type at)
   return _pages[at];
 }
 
+QSharedPointer<const PDFToC> Document::cachedToC() const
+{
+  // The caller must hold a doc-read-lock, so the document can't be reloaded
+  // (which clears the cache) while we are converting the ToC
+  {
+    QMutexLocker cacheLocker(&_tocCacheLock);
+    if (_tocCache)
+      return _tocCache;
+  }
+  QSharedPointer<const PDFToC> retVal(new PDFToC(toc()));
+  QMutexLocker cacheLocker(&_tocCacheLock);
+  if (!_tocCache)
+    _tocCache = retVal;
+  return _tocCache;
+}
+
+PDFToC Document::tocChildren(const QVector<int> & path) const
+{
+  QReadLocker docLocker(_docLock.data());
+  const QSharedPointer<const PDFToC> tocData = cachedToC();
+  const PDFToC * items = tocData.data();
+  for (const int i : path) {
+    if (i < 0 || i >= items->size())
+      return {};
+    items = &(*items)[i].children();
+  }
+  // Don't copy the (possibly large) subtrees
+  PDFToC retVal;
+  retVal.reserve(items->size());
+  for (const PDFToCItem & item : *items) {
+    PDFToCItem child(item.label());
+    child.setOpen(item.isOpen());
+    child.setColor(item.color());
+    child.flags() = item.flags();
+    child.setHasChildren(item.hasChildren());
+    retVal.append(child);
+  }
+  return retVal;
+}
+
+std::unique_ptr<PDFAction> Document::tocAction(const QVector<int> & path) const
+{
+  QReadLocker docLocker(_docLock.data());
+  const QSharedPointer<const PDFToC> tocData = cachedToC();
+  const PDFToCItem * item = nullptr;
+  for (const int i : path) {
+    const PDFToC & items = (item ? item->children() : *tocData);
+    if (i < 0 || i >= items.size())
+      return {};
+    item = &items[i];
+  }
+  if (!item || !item->action())
+    return {};
+  return std::unique_ptr<PDFAction>(item->action()->clone());
+}
+
+QList<PDFFontInfo> Document::fonts() const
+{
+  QList<PDFFontInfo> retVal;
+  fonts([&retVal](const QList<PDFFontInfo> & batch) {
+    retVal.append(batch);
+    return true;
+  });
+  return retVal;
+}
+
+bool Document::fonts(const FontCallback & callback) const
+{
+  QReadLocker docLocker(_docLock.data());
+
+  {
+    QMutexLocker cacheLocker(&_fontCacheLock);
+    if (_fontCacheValid) {
+      if (callback)
+        callback(_fontCache);
+      return true;
+    }
+  }
+
+  // If the document gets reloaded while we are scanning, the generation
+  // changes and we abort (see abortBackgroundScans())
+  const int generation = _scanGeneration.loadAcquire();
+  QList<PDFFontInfo> found;
+  const bool finished = scanFonts([&](const QList<PDFFontInfo> & batch) {
+    if (isScanAborted(generation))
+      return false;
+    found.append(batch);
+    return (!callback || callback(batch));
+  });
+
+  // Only cache complete results
+  if (finished) {
+    QMutexLocker cacheLocker(&_fontCacheLock);
+    _fontCache = found;
+    _fontCacheValid = true;
+  }
+  return finished;
+}
+
+bool Document::loadDeferredData()
+{
+  QMutexLocker loadLocker(&_deferredDataLock);
+  if (isDeferredDataLoaded())
+    return true;
+
+  Trace::Scope trace("document", "loadDeferredData");
+  // If the document gets reloaded while we are parsing, the generation changes
+  // and we abort (see abortBackgroundScans())
+  const int generation = _scanGeneration.loadAcquire();
+  DeferredData data;
+  // NB: parseDeferredData() only takes the doc-read-lock for short stretches;
+  // holding it throughout would block the creation of pages (e.g., when they
+  // are first painted) until all page sizes have been determined
+  if (!parseDeferredData(data, generation))
+    return false;
+
+  // Find the most common page size
+  QVector< QPair<QSizeF, size_type> > pageSizeCounts;
+  for (const QSizeF & size : data.pageSizes) {
+    auto it = std::find_if(pageSizeCounts.begin(), pageSizeCounts.end(), [&size](const QPair<QSizeF, size_type> & p) { return p.first == size; });
+    if (it != pageSizeCounts.end())
+      ++it->second;
+    else
+      pageSizeCounts.append(qMakePair(size, size_type(1)));
+  }
+  QSizeF pageSize;
+  size_type occurrences{0};
+  for (const auto & p : pageSizeCounts) {
+    if (p.second > occurrences) {
+      pageSize = p.first;
+      occurrences = p.second;
+    }
+  }
+
+  QWriteLocker docLocker(_docLock.data());
+  if (isScanAborted(generation))
+    return false;
+  _meta_title = data.title;
+  _meta_author = data.author;
+  _meta_subject = data.subject;
+  _meta_keywords = data.keywords;
+  _meta_creator = data.creator;
+  _meta_producer = data.producer;
+  _meta_creationDate = data.creationDate;
+  _meta_modDate = data.modDate;
+  _meta_trapped = data.trapped;
+  _meta_other = data.other;
+  _meta_pageSize = pageSize;
+  _pageSizes = data.pageSizes;
+  _deferredDataLoaded.storeRelease(1);
+  return true;
+}
+
 QList<SearchResult> Document::search(const QString & searchText, const SearchFlags & flags, const size_type startPage)
 {
   QReadLocker docLocker(_docLock.data());
@@ -289,6 +578,17 @@ void Document::clearMetaData()
   _meta_modDate = QDateTime();
   _meta_trapped = Trapped_Unknown;
   _meta_other.clear();
+  _meta_pageSize = QSizeF();
+  _pageSizes.clear();
+  _deferredDataLoaded.storeRelease(0);
+
+  {
+    QMutexLocker cacheLocker(&_fontCacheLock);
+    _fontCache.clear();
+    _fontCacheValid = false;
+  }
+  QMutexLocker cacheLocker(&_tocCacheLock);
+  _tocCache.reset();
 }
 
 // Page Class
@@ -418,6 +718,77 @@ bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
   return t1.xres > t2.xres;
 }
 
+QImage Page::approximateImage(const double xres, const double yres, const QRect & render_box)
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+
+  QImage retVal(render_box.width(), render_box.height(), QImage::Format_ARGB32);
+  QPainter p(&retVal);
+  p.fillRect(retVal.rect(), *pageDummyBrush);
+
+  // Look through the cache to find tiles we can reuse (by scaling)
+  if (_parent) {
+    const PDFPageTile key(xres, yres, render_box, _parent, _n);
+    QPainterPath clipPath;
+    clipPath.addRect(0, 0, render_box.width(), render_box.height());
+
+    // Crops, scales and paints each tile until the whole area is filled or no
+    // tiles are left; returns `true` in the former case
+    auto paintTiles = [&](QList<PDFPageTile> tiles) {
+      for (auto it = tiles.begin(); it != tiles.end(); ) {
+        if (it->doc_key != key.doc_key || it->page_num != pageNum() || it->xres <= 0 || it->yres <= 0) {
+          it = tiles.erase(it);
+          continue;
+        }
+        // See if it->render_box intersects with render_box (after proper scaling)
+        QRect scaledRect = QTransform::fromScale(xres / it->xres, yres / it->yres).mapRect(it->render_box);
+        if (!scaledRect.intersects(render_box)) {
+          it = tiles.erase(it);
+          continue;
+        }
+        ++it;
+      }
+      // Sort the remaining tiles by size, high-res first
+      std::sort(tiles.begin(), tiles.end(), higherResolutionThan);
+      for (const PDFPageTile & tile : tiles) {
+        QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
+        if (!tileImg)
+          continue;
+
+        // cropRect is the part of `tile` that overlaps the tile-to-paint (after
+        // proper scaling).
+        // paintRect is the part `tile` fills of the area we paint to (after
+        // proper scaling).
+        QRect cropRect = QTransform::fromScale(tile.xres / xres, tile.yres / yres).mapRect(render_box).intersected(tile.render_box).translated(-tile.render_box.left(), -tile.render_box.top());
+        QRect paintRect = QTransform::fromScale(xres / tile.xres, yres / tile.yres).mapRect(tile.render_box).intersected(render_box).translated(-render_box.left(), -render_box.top());
+
+        // Get the actual image and paint it onto the dummy tile
+        QImage tmp(tileImg->copy(cropRect).scaled(paintRect.size()));
+        p.setClipPath(clipPath);
+        p.drawImage(paintRect.topLeft(), tmp);
+
+        // Confine the clipping path to the part we have not painted to yet.
+        QPainterPath pp;
+        pp.addRect(paintRect);
+        clipPath = clipPath.subtracted(pp);
+        if (clipPath.isEmpty())
+          return true;
+      }
+      return false;
+    };
+
+    // Tiles rendered at (almost) the same resolution (e.g., after zooming by a
+    // few percent) are the best approximation and can be found without
+    // scanning the whole cache. Only if they don't cover everything, fall back
+    // to all tiles of the page.
+    if (!paintTiles(_parent->pageCache().similarTiles(key)))
+      paintTiles(_parent->pageCache().tiles());
+  }
+  p.end();
+  return retVal;
+}
+
 QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */)
 {
   QReadLocker docLocker(_docLock.data());
@@ -433,6 +804,28 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
   // background and we don't need to do anything)
   PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
   QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &status);
+  Document::pageCache().recordLookup(retVal ? status : PDFPageCache::UNKNOWN);
+  if (Trace::isEnabled()) {
+    const char * lookup = "miss";
+    switch (retVal ? status : PDFPageCache::UNKNOWN) {
+      case PDFPageCache::CURRENT:
+        lookup = "hit";
+        break;
+      case PDFPageCache::PLACEHOLDER:
+        lookup = "placeholder";
+        break;
+      case PDFPageCache::OUTDATED:
+        lookup = "outdated";
+        break;
+      case PDFPageCache::UNKNOWN:
+        break;
+    }
+    Trace::instant("cache", lookup, {
+      {"page", _n},
+      {"dpi", xres},
+      {"tile", QStringLiteral("%1,%2 %3x%4").arg(render_box.x()).arg(render_box.y()).arg(render_box.width()).arg(render_box.height())}
+    });
+  }
   if (retVal && (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER))
     return retVal;
 
@@ -449,63 +842,8 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
       _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _parent, _n), retVal, PDFPageCache::PLACEHOLDER, false);
     }
     else {
-      // otherwise construct a dummy image
-      QSharedPointer<QImage> tmpImg{new QImage(render_box.width(), render_box.height(), QImage::Format_ARGB32)};
-      QPainter p(tmpImg.data());
-      p.fillRect(tmpImg->rect(), *pageDummyBrush);
-
-      // Look through the cache to find tiles we can reuse (by scaling) for our
-      // dummy tile
-      // TODO: Benchmark this. If it is actualy too slow (i.e., just keeping the
-      // rendered image from popping up due to the write lock we hold) disable it
-      if (_parent) {
-        QList<PDFPageTile> tiles = _parent->pageCache().tiles();
-        for (QList<PDFPageTile>::iterator it = tiles.begin(); it != tiles.end(); ) {
-          if (it->doc != _parent || it->page_num != pageNum()) {
-            it = tiles.erase(it);
-            continue;
-          }
-          // See if it->render_box intersects with render_box (after proper scaling)
-          QRect scaledRect = QTransform::fromScale(xres / it->xres, yres / it->yres).mapRect(it->render_box);
-          if (!scaledRect.intersects(render_box)) {
-            it = tiles.erase(it);
-            continue;
-          }
-          ++it;
-        }
-        // Sort the remaining tiles by size, high-res first
-        std::sort(tiles.begin(), tiles.end(), higherResolutionThan);
-        // Finally, crop, scale and paint each image until the whole area is
-        // filled or no images are left in the list
-        QPainterPath clipPath;
-        clipPath.addRect(0, 0, render_box.width(), render_box.height());
-        foreach (PDFPageTile tile, tiles) {
-          QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
-          if (!tileImg)
-            continue;
-
-          // cropRect is the part of `tile` that overlaps the tile-to-paint (after
-          // proper scaling).
-          // paintRect is the part `tile` fills of the area we paint to (after
-          // proper scaling).
-          QRect cropRect = QTransform::fromScale(tile.xres / xres, tile.yres / yres).mapRect(render_box).intersected(tile.render_box).translated(-tile.render_box.left(), -tile.render_box.top());
-          QRect paintRect = QTransform::fromScale(xres / tile.xres, yres / tile.yres).mapRect(tile.render_box).intersected(render_box).translated(-render_box.left(), -render_box.top());
-
-          // Get the actual image and paint it onto the dummy tile
-          QImage tmp(tileImg->copy(cropRect).scaled(paintRect.size()));
-          p.setClipPath(clipPath);
-          p.drawImage(paintRect.topLeft(), tmp);
-
-          // Confine the clipping path to the part we have not painted to yet.
-          QPainterPath pp;
-          pp.addRect(paintRect);
-          clipPath = clipPath.subtracted(pp);
-          if (clipPath.isEmpty())
-            break;
-        }
-      }
-      // stop painting or else we couldn't (possibly) delete tmpImg below
-      p.end();
+      // otherwise construct a dummy image from what we have in the cache
+      QSharedPointer<QImage> tmpImg{new QImage(approximateImage(xres, yres, render_box))};
 
       // Add the dummy tile to the cache
       // Note: In the meantime the asynchronous rendering could have finished and
@@ -528,6 +866,17 @@ void Page::asyncLoadLinks(QObject *listener)
   _parent->processingThread().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
 }
 
+void Page::asyncRenderThumbnail(QObject *listener)
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+  if (!_parent)
+    return;
+  // Thumbnails are a convenience; whatever the user is looking at in the main
+  // view must not wait for them
+  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderThumbnailRequest(this, listener), PDFPageProcessingThread::LowPriority);
+}
+
 //static
 QList<SearchResult> Page::executeSearch(SearchRequest request)
 {
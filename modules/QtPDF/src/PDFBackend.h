@@ -18,14 +18,19 @@
 #include "PDFFontInfo.h"
 #include "PDFPageCache.h"
 #include "PDFPageProcessingThread.h"
+#include "PDFThumbnailCache.h"
 #include "PDFToC.h"
 #include "PDFTransitions.h"
 
 #include <QAbstractItemModel>
+#include <QAtomicInt>
 #include <QImage>
+#include <QMutex>
 #include <QReadLocker>
 #include <QWeakPointer>
 
+#include <functional>
+
 namespace QtPDF {
 
 namespace Backend {
@@ -63,6 +68,9 @@ class Document
 
 public:
   using size_type = QVector<QSharedPointer<Page>>::size_type;
+  // Receives a batch of fonts during incremental font scans; returning `false`
+  // aborts the scan
+  using FontCallback = std::function<bool(const QList<PDFFontInfo> &)>;
 
   enum TrappedState { Trapped_Unknown, Trapped_True, Trapped_False };
   enum Permission { Permission_Print = 0x0004,
@@ -87,14 +95,51 @@ public:
   size_type numPages() const;
   // Uses doc-read-lock
   QString fileName() const { QReadLocker docLocker(_docLock.data()); return _fileName; }
+  // The password the document was unlocked with (if any), e.g., for opening
+  // further instances of the same file
+  QString password() const { QReadLocker docLocker(_docLock.data()); return _password; }
   // Uses doc-read-lock
   PDFPageProcessingThread& processingThread();
   static PDFPageCache& pageCache() { return _pageCache; }
+  static PDFThumbnailCache& thumbnailCache() { return _thumbnailCache; }
+  // Identifies the rendered appearance of the document in pageCache().
+  // Documents showing the same file content with the same render settings
+  // (e.g., several windows showing the same file) share their tiles. 0 if no
+  // file has been loaded (yet).
+  // Lock-free
+  quint64 cacheKey() const { return _cacheKey.loadAcquire(); }
+  // Call this when something that affects rendering but is not part of the
+  // file changes (e.g., the visibility of optional content). The document
+  // stops sharing tiles with other documents; its current tiles are kept as
+  // outdated placeholders until they are re-rendered.
+  // Uses doc-write-lock
+  void renderStateChanged();
+  // Returns a key for the current version of the file that is suitable for
+  // setContentKey(), or 0 if the file is empty or can't be read. `data` is the
+  // file's content if the caller has it in memory anyway; otherwise, the
+  // relevant parts are read from the file. Cheap even for large files.
+  static quint64 contentKey(const QString & fileName, const QByteArray & data = QByteArray());
+  // The contentKey() of the file as it was loaded; 0 if no file has been
+  // loaded (yet)
+  quint64 loadedContentKey() const { QReadLocker docLocker(_docLock.data()); return _contentKey; }
 
   // Uses doc-read-lock and may use doc-write-lock
   // NB: no const variant exists as we may need to create a new Page (if it was
   // not cached in _pages), which requires a non-const `this` pointer as parent
   virtual QWeakPointer<Page> page(size_type at);
+  // Loads the links and annotations of `pages` (in that order) so subsequent
+  // calls to Page::loadLinks() and Page::loadAnnotations() return right away.
+  // Backends can override this to share work between pages. Used by the
+  // processing thread to batch link requests.
+  // Must not be called while holding a doc-lock.
+  virtual void loadLinksAndAnnotations(const QVector<size_type> & pages);
+  // Loads the links and annotations of the pages around `page` (nearest first)
+  // in the processing thread, a few pages at a time whenever it has nothing
+  // else to do. Replaces any previous preload. Backends must stop this (see
+  // PDFPageProcessingThread::setIdleTask()) in their destructor.
+  void preloadLinksAndAnnotations(const size_type page);
+  // Stops preloading; waits for a step that is currently running to finish
+  void stopPreloadingLinksAndAnnotations();
   virtual PDFDestination resolveDestination(const PDFDestination & namedDestination) const {
     return (namedDestination.isExplicit() ? namedDestination : PDFDestination());
   }
@@ -119,24 +164,69 @@ public:
   // Override in derived class if it provides access to the document outline
   // strutures of the pdf file.
   virtual PDFToC toc() const { return PDFToC(); }
-  virtual QList<PDFFontInfo> fonts() const { return QList<PDFFontInfo>(); }
+  // Lazy access to the document outline for large ToCs. `path` identifies an
+  // outline item by the indices of it and its ancestors, starting at the top
+  // level (an empty path denotes the (invisible) root).
+  // tocChildren() returns the items directly below `path` without their
+  // children (see PDFToCItem::hasChildren()) and without actions, as resolving
+  // destinations can be expensive. Use tocAction() to obtain the action of a
+  // particular item when it is needed.
+  // The default implementations convert the whole outline with toc() once and
+  // cache it until the document is reloaded; override them in derived classes
+  // if the backend can access the outline incrementally.
+  // Use doc-read-lock
+  virtual PDFToC tocChildren(const QVector<int> & path) const;
+  virtual std::unique_ptr<PDFAction> tocAction(const QVector<int> & path) const;
+  // Enumerating fonts can be slow (it may require scanning all pages or all
+  // objects in the file), so the result is cached until the document is
+  // reloaded.
+  // Uses doc-read-lock
+  QList<PDFFontInfo> fonts() const;
+  // Incremental variant of fonts() intended to be run in a background thread.
+  // `callback` is invoked with batches of fonts (e.g., the new fonts found on
+  // each page) as they become available. The scan is aborted if `callback`
+  // returns `false` or if the document is reloaded in the meantime. Returns
+  // `true` if the scan ran to completion.
+  // Uses doc-read-lock
+  bool fonts(const FontCallback & callback) const;
   virtual QAbstractItemModel * optionalContentModel() const { return nullptr; }
 
   // <metadata>
-  QString title() const { QReadLocker docLocker(_docLock.data()); return _meta_title; }
-  QString author() const { QReadLocker docLocker(_docLock.data()); return _meta_author; }
-  QString subject() const { QReadLocker docLocker(_docLock.data()); return _meta_subject; }
-  QString keywords() const { QReadLocker docLocker(_docLock.data()); return _meta_keywords; }
-  QString creator() const { QReadLocker docLocker(_docLock.data()); return _meta_creator; }
-  QString producer() const { QReadLocker docLocker(_docLock.data()); return _meta_producer; }
-  QDateTime creationDate() const { QReadLocker docLocker(_docLock.data()); return _meta_creationDate; }
-  QDateTime modDate() const { QReadLocker docLocker(_docLock.data()); return _meta_modDate; }
-  QSizeF pageSize() const { QReadLocker docLocker(_docLock.data()); return _meta_pageSize; }
+  // Parsing the metadata and determining the size of every page can take a
+  // while for large documents, so this is deferred until loadDeferredData() is
+  // called (e.g., from a background thread; see PDFDocumentScene). The
+  // accessors below load the data on demand if that has not happened yet. They
+  // must therefore not be called while holding a doc-read-lock.
+  QString title() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_title; }
+  QString author() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_author; }
+  QString subject() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_subject; }
+  QString keywords() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_keywords; }
+  QString creator() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_creator; }
+  QString producer() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_producer; }
+  QDateTime creationDate() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_creationDate; }
+  QDateTime modDate() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_modDate; }
+  // The most common page size (in pt)
+  QSizeF pageSize() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_pageSize; }
   qint64 fileSize() const { QReadLocker docLocker(_docLock.data()); return _meta_fileSize; }
-  TrappedState trapped() const { QReadLocker docLocker(_docLock.data()); return _meta_trapped; }
-  QMap<QString, QString> metaDataOther() const { QReadLocker docLocker(_docLock.data()); return _meta_other; }
+  TrappedState trapped() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_trapped; }
+  QMap<QString, QString> metaDataOther() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _meta_other; }
+  // The sizes (in pt) of all pages; may be empty if the backend can't
+  // determine them without fully loading every page
+  QVector<QSizeF> pageSizes() const { ensureDeferredData(); QReadLocker docLocker(_docLock.data()); return _pageSizes; }
   // </metadata>
 
+  // Loads the metadata and page sizes if that has not happened yet. Returns
+  // `false` if loading was aborted because the document was reloaded in the
+  // meantime.
+  // Uses doc-read-lock and doc-write-lock
+  bool loadDeferredData();
+  bool isDeferredDataLoaded() const { return _deferredDataLoaded.loadAcquire() != 0; }
+  // Makes running font scans and deferred data loads bail out as soon as
+  // possible. Call this in reload() (and similar) _before_ acquiring the
+  // doc-write-lock to avoid waiting for a long-running scan to finish, and
+  // before waiting for a scan that is no longer needed.
+  void abortBackgroundScans() { _scanGeneration.fetchAndAddOrdered(1); }
+
   virtual QColor paperColor() const { return Qt::white; }
   virtual void setPaperColor(const QColor & color) { Q_UNUSED(color); }
 
@@ -154,16 +244,60 @@ public:
 protected:
   Document(const QString fileName);
 
+  // Data gathered by loadDeferredData()
+  struct DeferredData {
+    QString title;
+    QString author;
+    QString subject;
+    QString keywords;
+    QString creator;
+    QString producer;
+    QDateTime creationDate;
+    QDateTime modDate;
+    TrappedState trapped{Trapped_Unknown};
+    QMap<QString, QString> other;
+    QVector<QSizeF> pageSizes;
+  };
+
   void clearPages();
+  // Derived classes call this after (re)loading the file with the result of
+  // contentKey(). If the key changes, the tiles rendered so far are kept as
+  // outdated placeholders. Also resets the render state (see
+  // renderStateChanged()).
+  // Uses doc-write-lock
+  void setContentKey(const quint64 key);
+  // Derived classes that support setPaperColor() call this to make the color
+  // part of the cache key
+  // Uses doc-write-lock
+  void setPaperColorKey(const QRgb color);
+  // Also marks the deferred data as not loaded
   virtual void clearMetaData();
 
+  // Override in derived class if it provides access to the fonts used in the
+  // pdf file. Implementations should report each font only once and should
+  // return `false` as soon as `callback` does. The caller holds a
+  // doc-read-lock.
+  virtual bool scanFonts(const FontCallback & callback) const { Q_UNUSED(callback) return true; }
+  // Override in derived class to fill in the metadata and page sizes. This is
+  // called in the thread that requested the data (possibly a background
+  // thread) _without_ holding a doc-lock. Implementations must only take the
+  // doc-read-lock for short stretches (e.g., per chunk of pages) so that
+  // pages can be created (which needs the doc-write-lock) in between, and
+  // must check isScanAborted(generation) after each acquisition and return
+  // `false` if it is set.
+  virtual bool parseDeferredData(DeferredData & data, const int generation) const { Q_UNUSED(data) Q_UNUSED(generation) return true; }
+  bool isScanAborted(const int generation) const { return _scanGeneration.loadAcquire() != generation; }
+
   size_type _numPages{-1};
   PDFPageProcessingThread _processingThread;
   static PDFPageCache _pageCache;
+  static PDFThumbnailCache _thumbnailCache;
   QVector< QSharedPointer<Page> > _pages;
   Permissions _permissions;
 
   QString _fileName;
+  // Set by derived classes when unlock() succeeds
+  QString _password;
 
   QString _meta_title;
   QString _meta_author;
@@ -177,7 +311,39 @@ protected:
   qint64 _meta_fileSize{0};
   TrappedState _meta_trapped{Trapped_Unknown};
   QMap<QString, QString> _meta_other;
+  QVector<QSizeF> _pageSizes;
   QSharedPointer<QReadWriteLock> _docLock{new QReadWriteLock(QReadWriteLock::Recursive)};
+
+private:
+  // The metadata accessors are const, but loading the data on demand modifies
+  // the document
+  void ensureDeferredData() const {
+    if (!isDeferredDataLoaded())
+      const_cast<Document *>(this)->loadDeferredData();
+  }
+
+  // Font scans may run concurrently (holding only doc-read-locks), so the cache
+  // needs its own lock
+  mutable QMutex _fontCacheLock;
+  mutable QList<PDFFontInfo> _fontCache;
+  mutable bool _fontCacheValid{false};
+  // The result of toc() for the default tocChildren() and tocAction(); null
+  // until it is needed
+  mutable QMutex _tocCacheLock;
+  mutable QSharedPointer<const PDFToC> _tocCache;
+  // Returns _tocCache, filling it if necessary; the caller must hold a
+  // doc-read-lock
+  QSharedPointer<const PDFToC> cachedToC() const;
+  QAtomicInt _scanGeneration{0};
+  // Recomputes _cacheKey; the caller must hold a doc-write-lock
+  void updateCacheKey();
+  quint64 _contentKey{0};
+  QRgb _paperColorKey{0xffffffff};
+  quint64 _renderState{0};
+  QAtomicInteger<quint64> _cacheKey{0};
+  // Serializes loadDeferredData() calls
+  QMutex _deferredDataLock;
+  QAtomicInt _deferredDataLoaded{0};
 };
 
 // This class is thread-safe. See implementation for internals.
@@ -204,9 +370,6 @@ protected:
   // Uses doc-read-lock and page-read-lock.
   QSharedPointer<QImage> getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr);
 
-  // Uses doc-read-lock and page-read-lock.
-  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
-
 public:
   // Class to encapsulate boxes, e.g., for selecting
   class Box {
@@ -264,6 +427,21 @@ public:
   // the result.
   // Uses page-read-lock and doc-read-lock.
   QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect());
+  // Queues a render request in the document's processing thread. The result is
+  // posted to `listener` as PDFPageRenderedEvent (and additionally stored in
+  // the global page cache if `cache == true`).
+  // Uses doc-read-lock and page-read-lock.
+  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
+  // Queues a low-priority request for the page's thumbnail (rendered at
+  // PDFThumbnailCache::resolution() and stored in Document::thumbnailCache()).
+  // The result is posted to `listener` as PDFPageRenderedEvent.
+  // Uses doc-read-lock and page-read-lock.
+  void asyncRenderThumbnail(QObject *listener);
+  // Composes an approximation of the given tile from (scaled) cached tiles of
+  // this page; parts not covered by any cached tile are filled with the
+  // "rendering page" dummy pattern. Does not trigger any rendering.
+  // Uses doc-read-lock and page-read-lock.
+  QImage approximateImage(const double xres, const double yres, const QRect & render_box);
 
   virtual QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() { return QList< QSharedPointer<Annotation::AbstractAnnotation> >(); }
 
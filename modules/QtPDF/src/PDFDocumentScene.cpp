@@ -102,11 +102,23 @@ PDFDocumentScene::PDFDocumentScene(QSharedPointer<Backend::Document> a_doc, QObj
   connect(&_fileWatcher, &QFileSystemWatcher::fileChanged, &_reloadTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
   setWatchForDocumentChangesOnDisk(true);
 
+  connect(&_deferredDataWatcher, &QFutureWatcher<bool>::finished, this, &PDFDocumentScene::deferredDataLoaded);
+
+  // Pages that correct their estimated size typically do so in bunches (e.g.,
+  // all pages that become visible), so only relayout once for all of them
+  _relayoutTimer.setSingleShot(true);
+  _relayoutTimer.setInterval(0);
+  connect(&_relayoutTimer, &QTimer::timeout, &_pageLayout, &PDFPageLayout::relayout);
+
   reinitializeScene();
 }
 
 PDFDocumentScene::~PDFDocumentScene()
 {
+  // The background task uses _doc; make it give up instead of waiting for it
+  // to determine the sizes of all pages
+  _doc->abortBackgroundScans();
+  _deferredDataWatcher.waitForFinished();
   // Destroy the _unlockProxy if it is not currently attached to the scene (in
   // which case it is destroyed automatically)
   if (!_unlockProxy->scene()) {
@@ -316,9 +328,25 @@ void PDFDocumentScene::reinitializeScene()
     if (_shownPageIdx >= _lastPage)
       _shownPageIdx = _lastPage - 1;
 
+    // Loading every page (to find out its size) takes a long time for large
+    // documents. Until the page sizes have been determined in the background
+    // (see loadDeferredData()), all pages are assumed to have the size of the
+    // first one. The pages themselves are only loaded when they are needed.
+    // Backends that can't determine the page sizes without loading the pages
+    // keep the estimate until the respective page is loaded (see
+    // PDFPageGraphicsItem::pageSizeChanged()).
+    const QVector<QSizeF> pageSizes = (_doc->isDeferredDataLoaded() ? _doc->pageSizes() : QVector<QSizeF>());
+    QSizeF estimatedPageSize;
+    if (pageSizes.size() < _lastPage) {
+      QSharedPointer<Backend::Page> firstPage(_doc->page(0).toStrongRef());
+      if (firstPage)
+        estimatedPageSize = firstPage->pageSizeF();
+    }
+
     for (size_type i = 0; i < _lastPage; ++i)
     {
-      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(_doc->page(i), _dpiX, _dpiY);
+      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(_doc.toWeakRef(), i, (i < pageSizes.size() ? pageSizes[i] : estimatedPageSize), _dpiX, _dpiY);
+      connect(pagePtr, &PDFPageGraphicsItem::pageSizeChanged, &_relayoutTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
       pagePtr->setVisible(i == _shownPageIdx || _shownPageIdx == -2);
       _pages.append(pagePtr);
       addItem(pagePtr);
@@ -326,6 +354,40 @@ void PDFDocumentScene::reinitializeScene()
     }
     _pageLayout.relayout();
   }
+
+  if (!_doc->isDeferredDataLoaded())
+    loadDeferredData();
+}
+
+void PDFDocumentScene::loadDeferredData()
+{
+  // If a load is still running (e.g., because the document was reloaded in
+  // the meantime), deferredDataLoaded() starts a new one once it finishes
+  if (_deferredDataWatcher.isRunning())
+    return;
+  Backend::Document * doc = _doc.data();
+  _deferredDataWatcher.setFuture(QtConcurrent::run([doc]() { return doc->loadDeferredData(); }));
+}
+
+void PDFDocumentScene::deferredDataLoaded()
+{
+  if (!_doc->isDeferredDataLoaded()) {
+    // The document was reloaded while the data was loaded
+    loadDeferredData();
+    return;
+  }
+
+  // Replace the estimated page sizes by the real ones (if the backend could
+  // determine them; otherwise, each page corrects its size once it is loaded)
+  const QVector<QSizeF> pageSizes = _doc->pageSizes();
+  if (!pageSizes.isEmpty()) {
+    for (size_type i = 0; i < _pages.size() && i < pageSizes.size(); ++i) {
+      if (isPageItem(_pages[i]))
+        static_cast<PDFPageGraphicsItem *>(_pages[i])->updatePageSize(pageSizes[i]);
+    }
+    _pageLayout.relayout();
+  }
+  emit documentMetaDataLoaded();
 }
 
 void PDFDocumentScene::finishUnlock()
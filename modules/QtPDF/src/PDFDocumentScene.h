@@ -17,6 +17,7 @@
 #include "PDFPageLayout.h"
 
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QGraphicsScene>
 #include <QSharedPointer>
 #include <QTimer>
@@ -74,6 +75,9 @@ signals:
   void pageLayoutChanged();
   void pdfActionTriggered(const QtPDF::PDFAction * action);
   void documentChanged(const QWeakPointer<QtPDF::Backend::Document> doc);
+  // Emitted once the meta data and the sizes of all pages have been loaded in
+  // the background (see reinitializeScene())
+  void documentMetaDataLoaded();
 
 public slots:
   void doUnlockDialog();
@@ -84,6 +88,7 @@ protected slots:
   void pageLayoutChanged(const QRectF& sceneRect);
   void reinitializeScene();
   void finishUnlock();
+  void deferredDataLoaded();
 
 protected:
   // Used in non-continuous mode to keep track of currently shown page across
@@ -105,9 +110,12 @@ private:
   PDFPageLayout _pageLayout;
   QFileSystemWatcher _fileWatcher;
   QTimer _reloadTimer;
+  QTimer _relayoutTimer;
   double _dpiX, _dpiY;
+  QFutureWatcher<bool> _deferredDataWatcher;
 
   void handleActionEvent(const PDFActionEvent * action_event);
+  void loadDeferredData();
 
   // Parent has no copy constructor, so this class shouldn't either. Also, we
   // hold some information in an `auto_ptr` which does interesting things on
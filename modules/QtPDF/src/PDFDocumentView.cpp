@@ -18,6 +18,9 @@
 #include "InfoWidgets.h"
 #include "PDFDocumentScene.h"
 #include "PDFGuideline.h"
+#include "PDFTrace.h"
+
+#include <algorithm>
 
 // This has to be outside the namespace (according to Qt docs)
 static void initResources()
@@ -99,6 +102,7 @@ PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
 
   connect(&_searcher, &PDFSearcher::resultReady, this, &PDFDocumentView::searchResultReady);
   connect(&_searcher, &PDFSearcher::progressValueChanged, this, &PDFDocumentView::searchProgressValueChanged);
+  connect(this, &PDFDocumentView::changedPage, this, &PDFDocumentView::preloadLinks);
 
   showRuler(false);
   connect(&_ruler, &PDFRuler::dragStart, this, [this](QPoint pos, Qt::Edge origin) {
@@ -135,6 +139,9 @@ void PDFDocumentView::setScene(QSharedPointer<PDFDocumentScene> a_scene)
 
   // disconnect us from the old scene (if any)
   if (_pdf_scene) {
+    QSharedPointer<Backend::Document> oldDoc{_pdf_scene->document().toStrongRef()};
+    if (oldDoc)
+      oldDoc->stopPreloadingLinksAndAnnotations();
     disconnect(_pdf_scene.data(), nullptr, this, nullptr);
     _pdf_scene.clear();
   }
@@ -155,6 +162,7 @@ void PDFDocumentView::setScene(QSharedPointer<PDFDocumentScene> a_scene)
     connect(_pdf_scene.data(), &PDFDocumentScene::pageChangeRequested, this, [this](int pageNum){ this->goToPage(pageNum); });
     connect(_pdf_scene.data(), &PDFDocumentScene::pdfActionTriggered, this, &PDFDocumentView::pdfActionTriggered);
     connect(_pdf_scene.data(), &PDFDocumentScene::documentChanged, this, &PDFDocumentView::reinitializeFromScene);
+    connect(_pdf_scene.data(), &PDFDocumentScene::documentMetaDataLoaded, this, &PDFDocumentView::documentMetaDataLoaded);
     // The connection PDFDocumentScene::documentChanged > PDFDocumentView::changedDocument
     // must be last in this list to ensure all internal states are updated (e.g.
     // in _lastPage in reinitializeFromScene()) before the signal is
@@ -273,8 +281,12 @@ QDockWidget * PDFDocumentView::dockWidget(const Dock type, QWidget * parent /* =
       break;
     }
     case Dock_MetaData:
-      infoWidget = new PDFMetaDataInfoWidget(dock);
+    {
+      PDFMetaDataInfoWidget * metaDataWidget = new PDFMetaDataInfoWidget(dock);
+      connect(this, &PDFDocumentView::documentMetaDataLoaded, metaDataWidget, &PDFMetaDataInfoWidget::reload);
+      infoWidget = metaDataWidget;
       break;
+    }
     case Dock_Fonts:
       infoWidget = new PDFFontsInfoWidget(dock);
       break;
@@ -288,6 +300,17 @@ QDockWidget * PDFDocumentView::dockWidget(const Dock type, QWidget * parent /* =
     case Dock_OptionalContent:
       infoWidget = new PDFOptionalContentInfoWidget(dock);
       break;
+    case Dock_Thumbnails:
+    {
+      PDFThumbnailsInfoWidget * thumbnailsWidget = new PDFThumbnailsInfoWidget(dock);
+      connect(thumbnailsWidget, &PDFThumbnailsInfoWidget::pageActivated, this, [this](const int pageNum) { goToPage(pageNum); });
+      connect(this, &PDFDocumentView::changedPage, thumbnailsWidget, [thumbnailsWidget](const size_type pageNum) { thumbnailsWidget->setCurrentPage(static_cast<int>(pageNum)); });
+      infoWidget = thumbnailsWidget;
+      break;
+    }
+    case Dock_RenderStatistics:
+      infoWidget = new PDFRenderStatisticsInfoWidget(dock);
+      break;
   }
   if (!infoWidget) {
     dock->deleteLater();
@@ -831,103 +854,86 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
 
 void PDFDocumentView::nextSearchResult()
 {
-  if (!_pdf_scene || _searchResults.empty())
+  if (!_pdf_scene || _searchResultCount == 0)
     return;
 
   // Note: _currentSearchResult is initially -1 if no result is selected
-  if (_currentSearchResult >= 0 && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(_searchResultHighlightBrush);
-
-  if ( (_currentSearchResult + 1) >= _searchResults.size() )
+  if ( (_currentSearchResult + 1) >= _searchResultCount )
     _currentSearchResult = 0;
   else
     ++_currentSearchResult;
 
-  // FIXME: The rest of the code in this method is the same as in previousSearchResult()
-  // We should move this into its own private method
-
-  QGraphicsPathItem* highlightPath = dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult]);
-
-  if (!highlightPath)
-    return;
-
-  highlightPath->setBrush(_currentSearchResultHighlightBrush);
-
-  PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem *>(highlightPath->parentItem());
-  if (pageItem) {
-    const QRectF bb = pageItem->mapRectFromItem(highlightPath, highlightPath->boundingRect());
-    const QRectF pdfRect = QRectF(pageItem->mapToPage(bb.topLeft()), pageItem->mapToPage(bb.bottomRight()));
-    goToPage(pageItem, pdfRect, false);
-
-    QSharedPointer<Backend::Page> page = pageItem->page().toStrongRef();
-    // FIXME: shape subpath coordinates seem to be in upside down pdf coordinates. We should find a better place to construct the proper transform (e.g., in PDFPageGraphicsItem)
-    if (page)
-      emit searchResultHighlighted(pageItem->pageNum(), highlightPath->shape().toSubpathPolygons(QTransform::fromTranslate(0, page->pageSizeF().height()).scale(1, -1)));
-  }
+  showCurrentSearchResult();
 }
 
 void PDFDocumentView::previousSearchResult()
 {
-  if (!_pdf_scene || _searchResults.empty())
+  if (!_pdf_scene || _searchResultCount == 0)
     return;
 
-  if (_currentSearchResult >= 0 && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(_searchResultHighlightBrush);
-
   if ( (_currentSearchResult - 1) < 0 )
-    _currentSearchResult = _searchResults.size() - 1;
+    _currentSearchResult = _searchResultCount - 1;
   else
     --_currentSearchResult;
 
-  // FIXME: The rest of the code in this method is the same as in previousSearchResult()
-  // We should move this into its own private method
-
-  QGraphicsPathItem* highlightPath = dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult]);
+  showCurrentSearchResult();
+}
 
-  if (!highlightPath)
+void PDFDocumentView::showCurrentSearchResult()
+{
+  // Find the page overlay containing the current result; overlays are sorted
+  // by firstResult
+  auto it = std::upper_bound(_searchResultPages.cbegin(), _searchResultPages.cend(), _currentSearchResult, [](const size_type idx, const SearchResultPage & p) { return idx < p.firstResult; });
+  if (it == _searchResultPages.cbegin())
     return;
+  --it;
 
-  highlightPath->setBrush(_currentSearchResultHighlightBrush);
+  for (const SearchResultPage & p : _searchResultPages) {
+    if (p.item != it->item)
+      p.item->setCurrent(-1);
+  }
+
+  PDFSearchResultsGraphicsItem * overlay = it->item;
+  const int idx = static_cast<int>(_currentSearchResult - it->firstResult);
+  overlay->setCurrent(idx);
 
-  PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem *>(highlightPath->parentItem());
+  PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem *>(overlay->parentItem());
   if (pageItem) {
-    const QRectF bb = pageItem->mapRectFromItem(highlightPath, highlightPath->boundingRect());
+    const QRectF bb = pageItem->mapRectFromItem(overlay, overlay->rect(idx));
     const QRectF pdfRect = QRectF(pageItem->mapToPage(bb.topLeft()), pageItem->mapToPage(bb.bottomRight()));
     goToPage(pageItem, pdfRect, false);
 
     QSharedPointer<Backend::Page> page = pageItem->page().toStrongRef();
-    // FIXME: shape subpath coordinates seem to be in upside down pdf coordinates. We should find a better place to construct the proper transform (e.g., in PDFPageGraphicsItem)
+    // FIXME: result rects are in upside down pdf coordinates. We should find a better place to construct the proper transform (e.g., in PDFPageGraphicsItem)
     if (page)
-      emit searchResultHighlighted(pageItem->pageNum(), highlightPath->shape().toSubpathPolygons(QTransform::fromTranslate(0, page->pageSizeF().height()).scale(1, -1)));
+      emit searchResultHighlighted(pageItem->pageNum(), QList<QPolygonF>() << QTransform::fromTranslate(0, page->pageSizeF().height()).scale(1, -1).map(QPolygonF(overlay->rect(idx))));
   }
 }
 
 void PDFDocumentView::clearSearchResults()
 {
-  if (!_pdf_scene || _searchResults.empty())
+  if (!_pdf_scene || _searchResultPages.empty())
     return;
 
-  foreach( QGraphicsItem *item, _searchResults )
-    _pdf_scene->removeItem(item);
+  for (const SearchResultPage & p : _searchResultPages)
+    delete p.item;
 
-  _searchResults.clear();
+  _searchResultPages.clear();
+  _searchResultCount = 0;
 }
 
 void PDFDocumentView::setSearchResultHighlightBrush(const QBrush & brush)
 {
   _searchResultHighlightBrush = brush;
-  for (int i = 0; i < _searchResults.size(); ++i) {
-    if (i == _currentSearchResult || !_searchResults[i])
-      continue;
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[i])->setBrush(brush);
-  }
+  for (const SearchResultPage & p : _searchResultPages)
+    p.item->setBrush(brush);
 }
 
 void PDFDocumentView::setCurrentSearchResultHighlightBrush(const QBrush & brush)
 {
   _currentSearchResultHighlightBrush = brush;
-  if (_currentSearchResult >= 0 && _currentSearchResult < _searchResults.size() && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(brush);
+  for (const SearchResultPage & p : _searchResultPages)
+    p.item->setCurrentBrush(brush);
 }
 
 
@@ -936,9 +942,24 @@ void PDFDocumentView::setCurrentSearchResultHighlightBrush(const QBrush & brush)
 void PDFDocumentView::searchResultReady(PDFSearcher::size_type pageIndex)
 {
   const auto & results = _searcher.resultAt(pageIndex);
-  // Convert the search result to highlight boxes
-  for(const Backend::SearchResult & result : results) {
-    _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
+
+  // All results passed at once belong to the same page, so they can share one
+  // overlay
+  PDFPageGraphicsItem * pageItem = (_pdf_scene && !results.empty() ? dynamic_cast<PDFPageGraphicsItem*>(_pdf_scene->pageAt(static_cast<int>(results.first().pageNum))) : nullptr);
+  if (pageItem && PDFDocumentScene::isPageItem(pageItem)) {
+    QVector<QRectF> rects;
+    rects.reserve(results.size());
+    for(const Backend::SearchResult & result : results)
+      rects << result.bbox;
+
+    PDFSearchResultsGraphicsItem * overlay = new PDFSearchResultsGraphicsItem(pageItem);
+    overlay->setBrush(_searchResultHighlightBrush);
+    overlay->setCurrentBrush(_currentSearchResultHighlightBrush);
+    overlay->setTransform(pageItem->pointScale());
+    overlay->addResults(rects);
+
+    _searchResultPages.append({overlay, _searchResultCount});
+    _searchResultCount += overlay->count();
   }
 
   // If this is the first result that becomes available in a new search, center
@@ -948,7 +969,7 @@ void PDFDocumentView::searchResultReady(PDFSearcher::size_type pageIndex)
 
   // Inform the rest of the world of our progress (in %, and how many
   // occurrences were found so far).
-  emit searchProgressChanged(static_cast<int>(100 * (_searcher.progressValue() - _searcher.progressMinimum()) / (_searcher.progressMaximum() - _searcher.progressMinimum())), _searchResults.count());
+  emit searchProgressChanged(static_cast<int>(100 * (_searcher.progressValue() - _searcher.progressMinimum()) / (_searcher.progressMaximum() - _searcher.progressMinimum())), _searchResultCount);
 }
 
 void PDFDocumentView::searchProgressValueChanged(PDFSearcher::size_type progressValue)
@@ -965,9 +986,9 @@ void PDFDocumentView::searchProgressValueChanged(PDFSearcher::size_type progress
   // primarily intended for informing the user of the progress when matches are
   // found.
   if (_searcher.progressMaximum() == _searcher.progressMinimum())
-    emit searchProgressChanged(100, _searchResults.count());
+    emit searchProgressChanged(100, _searchResultCount);
   else
-    emit searchProgressChanged(static_cast<int>(100 * (progressValue - _searcher.progressMinimum()) / (_searcher.progressMaximum() - _searcher.progressMinimum())), _searchResults.count());
+    emit searchProgressChanged(static_cast<int>(100 * (progressValue - _searcher.progressMinimum()) / (_searcher.progressMaximum() - _searcher.progressMinimum())), _searchResultCount);
 }
 
 void PDFDocumentView::maybeUpdateSceneRect() {
@@ -1308,9 +1329,11 @@ void PDFDocumentView::reinitializeFromScene()
   _searcher.ensureStopped();
   // Also reset _searchString. Otherwise the next search for the same string
   // will assume the search has already been run (without results as
-  // _searchResults is empty) and won't run it again on the new scene data.
+  // there are no results) and won't run it again on the new scene data.
   _searcher.setSearchString(QString());
-  _searchResults.clear();
+  // Note: the overlays were destroyed along with their page items
+  _searchResultPages.clear();
+  _searchResultCount = 0;
   _currentSearchResult = -1;
 
   QSharedPointer<Backend::Document> doc{document().toStrongRef()};
@@ -1327,12 +1350,13 @@ void PDFDocumentView::reinitializeFromScene()
         }
         QSharedPointer<Backend::Document> doc{document().toStrongRef()};
         if (doc) {
-          // Invalidate all document tiles
-          QtPDF::Backend::Document::pageCache().removeDocumentTiles(doc.data());
+          // The document no longer looks like other documents of the same
+          // file; the current tiles are kept as outdated placeholders
+          doc->renderStateChanged();
           // Update the view after returning to the event loop (in case other
           // views also display this same document --- and consequently call
-          // pageCache().removeDocumentTiles() --- we don't want to recreate and
-          // re-remove tiles multiple times)
+          // renderStateChanged() --- we don't want to re-render tiles multiple
+          // times)
 #if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
           QTimer::singleShot(1, viewport(), SLOT(update()));
 #else
@@ -1342,6 +1366,21 @@ void PDFDocumentView::reinitializeFromScene()
       });
     }
   }
+  preloadLinks();
+}
+
+void PDFDocumentView::preloadLinks()
+{
+  QSharedPointer<Backend::Document> doc{document().toStrongRef()};
+  if (!doc)
+    return;
+  // Links of the visible pages are requested when the pages are painted; load
+  // those of the surrounding pages whenever there is nothing else to do so
+  // they are available right away when scrolling
+  if (isVisible() && _currentPage >= 0)
+    doc->preloadLinksAndAnnotations(_currentPage);
+  else
+    doc->stopPreloadingLinksAndAnnotations();
 }
 
 void PDFDocumentView::notifyTextSelectionChanged()
@@ -1490,6 +1529,14 @@ void PDFDocumentView::keyReleaseEvent(QKeyEvent *event)
 
 void PDFDocumentView::mousePressEvent(QMouseEvent * event)
 {
+  // Link items are only created when hovered; make sure that has happened for
+  // the position clicked (e.g., if no mouse move preceded the click)
+  if (_pdf_scene) {
+    PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pdf_scene->pageAt(mapToScene(event->pos())));
+    if (pageItem)
+      pageItem->updateHoverItems(pageItem->mapFromScene(mapToScene(event->pos())));
+  }
+
   Super::mousePressEvent(event);
 
   // Don't do anything if the event was handled elsewhere (e.g., by a
@@ -1607,6 +1654,18 @@ void PDFDocumentView::resizeEvent(QResizeEvent * event)
   Super::resizeEvent(event);
 }
 
+void PDFDocumentView::showEvent(QShowEvent * event)
+{
+  Super::showEvent(event);
+  preloadLinks();
+}
+
+void PDFDocumentView::hideEvent(QHideEvent * event)
+{
+  preloadLinks();
+  Super::hideEvent(event);
+}
+
 void PDFDocumentView::armTool(const DocumentTool::AbstractTool::Type toolType)
 {
   armTool(getToolByType(toolType));
@@ -1676,12 +1735,22 @@ void PDFDocumentMagnifierView::prepareToShow()
     return;
 
   // Ensure we have the same scene
-  if (_parent_view->scene() != scene())
+  if (_parent_view->scene() != scene()) {
+    if (scene())
+      disconnect(scene(), nullptr, this, nullptr);
     setScene(_parent_view->scene());
+    clearTileCache();
+    PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+    if (pdfScene)
+      connect(pdfScene, &PDFDocumentScene::documentChanged, this, &PDFDocumentMagnifierView::clearTileCache);
+  }
   // Fix the zoom
   qreal zoomLevel = _parent_view->zoomLevel() * _zoomFactor;
-  if (zoomLevel != _zoomLevel)
+  if (zoomLevel != _zoomLevel) {
     scale(zoomLevel / _zoomLevel, zoomLevel / _zoomLevel);
+    // Tiles rendered at the old magnification are useless now
+    clearTileCache();
+  }
   _zoomLevel = zoomLevel;
   // Ensure we have enough padding at the border that we can display the
   // magnifier even beyond the edge
@@ -1780,6 +1849,63 @@ void PDFDocumentMagnifierView::paintEvent(QPaintEvent * event)
   // PDFDocumentMagnifierView::dropShadow().
 }
 
+QImage PDFDocumentMagnifierView::magnifiedTile(const QSharedPointer<Backend::Page> & page, const double xres, const double yres, const QRect & render_box)
+{
+  if (!page)
+    return {};
+
+  const Backend::PDFPageTile key(xres, yres, render_box, nullptr, page->pageNum());
+  const QImage * cached = _tileCache.object(key);
+  if (cached)
+    return *cached;
+
+  const auto pending = _pendingTiles.constFind(key);
+  if (pending != _pendingTiles.cend())
+    return *pending;
+
+  // The processing thread works off its stack in LIFO order, so this request
+  // (issued last) takes precedence over pending requests of the main view.
+  // Don't put it in the global page cache, though; we keep our own below.
+  page->asyncRenderToImage(this, xres, yres, render_box, false);
+  const QImage placeholder = page->approximateImage(xres, yres, render_box);
+  _pendingTiles.insert(key, placeholder);
+  return placeholder;
+}
+
+void PDFDocumentMagnifierView::clearTileCache()
+{
+  _tileCache.clear();
+  // Results of requests still in the queue will be discarded when they arrive
+  _pendingTiles.clear();
+}
+
+bool PDFDocumentMagnifierView::event(QEvent * event)
+{
+  if (event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    event->accept();
+
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    Q_ASSERT(renderedEvent != nullptr);
+    const Backend::PDFPageTile key(renderedEvent->xres, renderedEvent->yres, renderedEvent->render_rect, nullptr, renderedEvent->page_num);
+    // Ignore results we are no longer waiting for (e.g., from before the
+    // document was reloaded)
+    if (_pendingTiles.remove(key) && !renderedEvent->rendered_page.isNull()) {
+      const QImage & img = renderedEvent->rendered_page;
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+      const int cost = img.byteCount();
+#elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+      const int cost = static_cast<int>(img.sizeInBytes());
+#else
+      const qsizetype cost = img.sizeInBytes();
+#endif
+      _tileCache.insert(key, new QImage(img), cost);
+      viewport()->update();
+    }
+    return true;
+  }
+  return Super::event(event);
+}
+
 // Modelled after http://labs.qt.nokia.com/2009/10/07/magnifying-glass
 QPixmap& PDFDocumentMagnifierView::dropShadow()
 {
@@ -1887,6 +2013,8 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
   //
   // NOTE: This flag needs Qt 4.6 or newer.
   setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+  // Hover events are needed to create link and annotation items on demand
+  setAcceptHoverEvents(true);
 
   QSharedPointer<Backend::Page> page(_page.toStrongRef());
   if (page) {
@@ -1894,17 +2022,67 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
     // Create an empty pixmap that is the same size as the PDF page. This
     // allows us to delay the rendering of pages until they actually come into
     // view yet still know what the page size is.
-    _pageSize = page->pageSizeF();
-    _pageSize.setWidth(_pageSize.width() * _dpiX / 72.0);
-    _pageSize.setHeight(_pageSize.height() * _dpiY / 72.0);
+    setPageSizeInPt(page->pageSizeF());
+  }
+}
 
-    // `_pageScale` holds a transformation matrix that can map between normalized
-    // page coordinates (in the range 0...1) and the coordinate system for this
-    // graphics item. `_pointScale` is similar, except it maps from coordinates
-    // expressed in pixels at a resolution of 72 dpi.
-    _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
-    _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
+PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Document> a_doc, const size_type pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent /* = nullptr */):
+  Super(parent),
+  _doc(a_doc),
+  _dpiX(dpiX),
+  _dpiY(dpiY),
+  _pageNum(pageNum),
+  _linksLoaded(false),
+  _annotationsLoaded(false),
+  _zoomLevel(0.0)
+{
+  setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+  setAcceptHoverEvents(true);
+  setPageSizeInPt(pageSize);
+  _pageSizeEstimated = true;
+}
+
+void PDFPageGraphicsItem::setPageSizeInPt(const QSizeF & pageSize)
+{
+  _pageSize = QSizeF(pageSize.width() * _dpiX / 72.0, pageSize.height() * _dpiY / 72.0);
+
+  // `_pageScale` holds a transformation matrix that can map between normalized
+  // page coordinates (in the range 0...1) and the coordinate system for this
+  // graphics item. `_pointScale` is similar, except it maps from coordinates
+  // expressed in pixels at a resolution of 72 dpi.
+  _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
+  _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
+}
+
+QWeakPointer<Backend::Page> PDFPageGraphicsItem::page() const
+{
+  if (_page.isNull()) {
+    QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+    if (doc)
+      _page = doc->page(_pageNum);
   }
+  return _page;
+}
+
+void PDFPageGraphicsItem::updatePageSize(const QSizeF & pageSize)
+{
+  _pageSizeEstimated = false;
+  const QSizeF newSize(pageSize.width() * _dpiX / 72.0, pageSize.height() * _dpiY / 72.0);
+  if (newSize == _pageSize)
+    return;
+  prepareGeometryChange();
+  setPageSizeInPt(pageSize);
+}
+
+void PDFPageGraphicsItem::applyLoadedPageSize()
+{
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
+  if (!page)
+    return;
+  const QSizeF oldSize = _pageSize;
+  updatePageSize(page->pageSizeF());
+  if (_pageSize != oldSize)
+    emit pageSizeChanged();
 }
 
 QRectF PDFPageGraphicsItem::boundingRect() const { return QRectF(QPointF(0.0, 0.0), _pageSize); }
@@ -1912,7 +2090,7 @@ int PDFPageGraphicsItem::type() const { return Type; }
 
 QPointF PDFPageGraphicsItem::mapFromPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
   if (!page)
     return QPointF();
   // item coordinates are in pixels
@@ -1922,7 +2100,7 @@ QPointF PDFPageGraphicsItem::mapFromPage(const QPointF & point) const
 
 QPointF PDFPageGraphicsItem::mapToPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
   if (!page)
     return QPointF();
   // item coordinates are in pixels
@@ -1939,26 +2117,28 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   qreal scaleFactor = painter->transform().m11();
   QTransform scaleT = QTransform::fromScale(scaleFactor, scaleFactor);
   QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
   QSharedPointer<QImage> renderedPage;
 
   if (!page)
     return;
 
+  // The page is loaded now anyway, so correct the size if it was only
+  // estimated. NB: The geometry must not change while painting.
+  if (_pageSizeEstimated) {
+    _pageSizeEstimated = false;
+    QMetaObject::invokeMethod(this, "applyLoadedPageSize", Qt::QueuedConnection);
+  }
+
   // If this is the first time this `PDFPageGraphicsItem` has come into view,
-  // `_linksLoaded` will be `false`. We then load all of the links on the page.
+  // `_linksLoaded` will be `false`. We then load all of the links and
+  // annotations on the page (they arrive in a PDFLinksLoadedEvent).
   if (!_linksLoaded)
   {
     page->asyncLoadLinks(this);
     _linksLoaded = true;
   }
 
-  if (!_annotationsLoaded) {
-    // FIXME: Load annotations asynchronously?
-    addAnnotations(page->loadAnnotations());
-    _annotationsLoaded = true;
-  }
-
   if ( _zoomLevel != scaleFactor )
     _zoomLevel = scaleFactor;
 
@@ -2034,9 +2214,17 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 
     const QRect visibleRect = scaleT.mapRect(exposedRect).toAlignedRect();
 
-    // Each tile is rendered at TILE_SIZE pixels, which may be scaled (e.g. on
+    // The magnifier has its own render path with smaller tiles and a private
+    // cache (see PDFDocumentMagnifierView::magnifiedTile())
+    PDFDocumentMagnifierView * magnifier = (widget ? qobject_cast<PDFDocumentMagnifierView*>(widget->parent()) : nullptr);
+    const int tileSize = (magnifier ? MAGNIFIER_TILE_SIZE : TILE_SIZE);
+    // The page in render coordinates (i.e., taking the devicePixelRatio into
+    // account); magnifier tiles are cropped to it
+    const QRect renderPageRect = QTransform::fromScale(painter->device()->devicePixelRatio(), painter->device()->devicePixelRatio()).mapRect(QRectF(pageRect)).toAlignedRect();
+
+    // Each tile is rendered at tileSize pixels, which may be scaled (e.g. on
     // high-dpi screens) and displayed at an effective size
-    int effectiveTileSize = static_cast<int>(TILE_SIZE / painter->device()->devicePixelRatio());
+    int effectiveTileSize = static_cast<int>(tileSize / painter->device()->devicePixelRatio());
 
     int imin = (visibleRect.left() - pageRect.left()) / effectiveTileSize;
     int imax = (visibleRect.right() - pageRect.left());
@@ -2056,7 +2244,7 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
       for (int i = imin; i < imax; ++i) {
         // renderTile is the rect used for rendering/retrieving tiles. It is
         // agnostic of the painter (e.g., its devicePixelRatio)
-        QRect renderTile(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+        QRect renderTile(i * tileSize, j * tileSize, tileSize, tileSize);
         // displayTile is the rect used for displaying. It takes the painter's
         // settings into account (e.g. its devicePixelRatio)
         QRect displayTile(i * effectiveTileSize, j * effectiveTileSize, effectiveTileSize, effectiveTileSize);
@@ -2074,7 +2262,14 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
             useGrayScale = true;
         }
 
-        renderedPage = page->getTileImage(this, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile);
+        if (magnifier) {
+          renderTile = renderTile.intersected(renderPageRect);
+          if (renderTile.isEmpty())
+            continue;
+          renderedPage = QSharedPointer<QImage>(new QImage(magnifier->magnifiedTile(page, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile)));
+        }
+        else
+          renderedPage = page->getTileImage(this, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile);
         // renderedPage as returned from getTileImage _should_ always be valid
         if ( renderedPage ) {
           if (useGrayScale) {
@@ -2098,6 +2293,11 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
     }
   }
   painter->restore();
+
+  // Time from requesting a tile until it is actually on screen
+  for (const qint64 requested : _tracePendingDisplay)
+    Trace::complete("display", "tile", requested, {{"page", _pageNum}});
+  _tracePendingDisplay.clear();
 }
 
 //static
@@ -2129,6 +2329,10 @@ bool PDFPageGraphicsItem::event(QEvent *event)
     // Cast to a `PDFLinksLoaded` event so we can access the links.
     const Backend::PDFLinksLoadedEvent *links_loaded_event = dynamic_cast<const Backend::PDFLinksLoadedEvent*>(event);
     addLinks(links_loaded_event->links);
+    if (!_annotationsLoaded) {
+      addAnnotations(links_loaded_event->annotations);
+      _annotationsLoaded = true;
+    }
 
     return true;
 
@@ -2142,6 +2346,13 @@ bool PDFPageGraphicsItem::event(QEvent *event)
     // fetches stuff from the cache.
     //
     // Perhaps there should be a separate event for when the cache is updated.
+    const Backend::PDFPageRenderedEvent * renderedEvent = static_cast<const Backend::PDFPageRenderedEvent*>(event);
+    // Failed renders leave the cache untouched; repainting right away would
+    // only request the same tile again (and likely fail again)
+    if (renderedEvent->rendered_page.isNull())
+      return true;
+    if (renderedEvent->requested >= 0 && Trace::isEnabled())
+      _tracePendingDisplay.append(renderedEvent->requested);
     update();
 
     return true;
@@ -2151,29 +2362,81 @@ bool PDFPageGraphicsItem::event(QEvent *event)
   return Super::event(event);
 }
 
-// This method causes the `PDFPageGraphicsItem` to create `PDFLinkGraphicsItem`
-// objects for a list of asynchronously generated `PDFLinkAnnotation` objects.
-// The page item also takes ownership the objects created.  Calling
-// `setParentItem` causes the link objects to be added to the scene that owns
-// the page object. `update` is then called to ensure all links are drawn at
-// once.
+void PDFPageGraphicsItem::hoverEnterEvent(QGraphicsSceneHoverEvent * event)
+{
+  updateHoverItems(event->pos());
+  Super::hoverEnterEvent(event);
+}
+
+void PDFPageGraphicsItem::hoverMoveEvent(QGraphicsSceneHoverEvent * event)
+{
+  updateHoverItems(event->pos());
+  Super::hoverMoveEvent(event);
+}
+
+void PDFPageGraphicsItem::hoverLeaveEvent(QGraphicsSceneHoverEvent * event)
+{
+  // Note: We don't get a hover leave event when the cursor moves onto a child
+  // item, so this really means the cursor left the page
+  delete _hoverLinkItem;
+  _hoverLinkItem = nullptr;
+  _hoverLink = -1;
+  Super::hoverLeaveEvent(event);
+}
+
+void PDFPageGraphicsItem::updateHoverItems(const QPointF & pos)
+{
+  // Map to pdf coordinates (see the transform set on link items below)
+  const QPointF pdfPos(pos.x() * 72. / _dpiX, (_pageSize.height() - pos.y()) * 72. / _dpiY);
+  const QTransform pdfToItem = QTransform::fromTranslate(0, _pageSize.height()).scale(_dpiX / 72., -_dpiY / 72.);
+
+  const QVector<int> links = _linkIndex.itemsAt(pdfPos);
+  const int link = (links.isEmpty() ? -1 : links.first());
+  if (link != _hoverLink) {
+    // Note: Hover events are not delivered while an item grabs the mouse, so
+    // it's safe to delete the previous link item here
+    delete _hoverLinkItem;
+    _hoverLinkItem = nullptr;
+    _hoverLink = link;
+    if (link >= 0) {
+      _hoverLinkItem = new PDFLinkGraphicsItem(_links[link]);
+      _hoverLinkItem->setTransform(pdfToItem);
+      _hoverLinkItem->setParentItem(this);
+    }
+  }
+  // Links take precedence over annotations
+  if (link >= 0)
+    return;
+
+  const QVector<int> annots = _markupAnnotationIndex.itemsAt(pdfPos);
+  if (annots.isEmpty() || _markupAnnotationItems[annots.first()])
+    return;
+  PDFMarkupAnnotationGraphicsItem * markupAnnotItem = new PDFMarkupAnnotationGraphicsItem(_markupAnnotations[annots.first()]);
+  markupAnnotItem->setTransform(pdfToItem);
+  // Keep annotation items below (transient) link items
+  markupAnnotItem->setZValue(-1);
+  markupAnnotItem->setParentItem(this);
+  _markupAnnotationItems[annots.first()] = markupAnnotItem;
+}
+
+// This method stores the asynchronously loaded links of the page in a spatial
+// index. Graphics items for them are created on demand in updateHoverItems().
 void PDFPageGraphicsItem::addLinks(QList< QSharedPointer<Annotation::Link> > links)
 {
 #ifdef DEBUG
   QElapsedTimer stopwatch;
   stopwatch.start();
 #endif
-  foreach( QSharedPointer<Annotation::Link> link, links ){
-    PDFLinkGraphicsItem * linkItem = new PDFLinkGraphicsItem(link);
-    // Map the link from pdf coordinates to scene coordinates
-    linkItem->setTransform(QTransform::fromTranslate(0, _pageSize.height()).scale(_dpiX / 72., -_dpiY / 72.));
-    linkItem->setParentItem(this);
-  }
+  _links.append(links);
+
+  QVector<QRectF> rects;
+  rects.reserve(_links.size());
+  foreach (const QSharedPointer<Annotation::Link> & link, _links)
+    rects.append(link->rect());
+  _linkIndex.build(QRectF(0, 0, _pageSize.width() * 72. / _dpiX, _pageSize.height() * 72. / _dpiY), rects);
 #ifdef DEBUG
   qDebug() << "Added links in: " << stopwatch.elapsed() << " milliseconds";
 #endif
-
-  update();
 }
 
 void PDFPageGraphicsItem::addAnnotations(QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations)
@@ -2186,17 +2449,18 @@ void PDFPageGraphicsItem::addAnnotations(QList< QSharedPointer<Annotation::Abstr
     // We currently only handle popups
     if (!annot->isMarkup())
       continue;
-    QSharedPointer<Annotation::Markup> markupAnnot = annot.staticCast<Annotation::Markup>();
-    PDFMarkupAnnotationGraphicsItem * markupAnnotItem = new PDFMarkupAnnotationGraphicsItem(markupAnnot);
-    // Map the link from pdf coordinates to scene coordinates
-    markupAnnotItem->setTransform(QTransform::fromTranslate(0, _pageSize.height()).scale(_dpiX / 72., -_dpiY / 72.));
-    markupAnnotItem->setParentItem(this);
+    _markupAnnotations.append(annot.staticCast<Annotation::Markup>());
+    _markupAnnotationItems.append(nullptr);
   }
+
+  QVector<QRectF> rects;
+  rects.reserve(_markupAnnotations.size());
+  foreach (const QSharedPointer<Annotation::Markup> & annot, _markupAnnotations)
+    rects.append(annot->rect());
+  _markupAnnotationIndex.build(QRectF(0, 0, _pageSize.width() * 72. / _dpiX, _pageSize.height() * 72. / _dpiY), rects);
 #ifdef DEBUG
   qDebug() << "Added annotations in: " << stopwatch.elapsed() << " milliseconds";
 #endif
-
-  update();
 }
 
 
@@ -2498,6 +2762,79 @@ void PDFMarkupAnnotationGraphicsItem::mouseReleaseEvent(QGraphicsSceneMouseEvent
 }
 
 
+// PDFSearchResultsGraphicsItem
+// ============================
+
+PDFSearchResultsGraphicsItem::PDFSearchResultsGraphicsItem(QGraphicsItem *parent /* = nullptr */):
+  Super(parent)
+{
+  // Search results are purely visual; they must not intercept the mouse
+  setAcceptedMouseButtons(Qt::NoButton);
+  setAcceptHoverEvents(false);
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+int PDFSearchResultsGraphicsItem::type() const { return Type; }
+
+void PDFSearchResultsGraphicsItem::paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget)
+{
+  Q_UNUSED(widget)
+
+  const QRectF exposed = option->exposedRect;
+  // Draw the current result separately so it is not tinted by _brush as well
+  auto drawRange = [&](const int from, const int to) {
+    for (int i = from; i < to; ++i) {
+      if (_rects[i].normalized().intersects(exposed))
+        painter->drawRect(_rects[i]);
+    }
+  };
+
+  painter->setPen(Qt::NoPen);
+  painter->setBrush(_brush);
+  if (_current >= 0 && _current < _rects.size()) {
+    drawRange(0, _current);
+    drawRange(_current + 1, count());
+    painter->setBrush(_currentBrush);
+    painter->drawRect(_rects[_current]);
+  }
+  else
+    drawRange(0, count());
+}
+
+void PDFSearchResultsGraphicsItem::addResults(const QVector<QRectF> & rects)
+{
+  prepareGeometryChange();
+  for (const QRectF & r : rects) {
+    _rects << r;
+    _boundingRect |= r.normalized();
+  }
+  update();
+}
+
+void PDFSearchResultsGraphicsItem::setCurrent(const int idx)
+{
+  if (idx == _current)
+    return;
+  if (_current >= 0 && _current < _rects.size())
+    update(_rects[_current].normalized());
+  _current = idx;
+  if (_current >= 0 && _current < _rects.size())
+    update(_rects[_current].normalized());
+}
+
+void PDFSearchResultsGraphicsItem::setBrush(const QBrush & brush)
+{
+  _brush = brush;
+  update();
+}
+
+void PDFSearchResultsGraphicsItem::setCurrentBrush(const QBrush & brush)
+{
+  _currentBrush = brush;
+  update();
+}
+
+
 // PDFActionEvent
 // ============
 
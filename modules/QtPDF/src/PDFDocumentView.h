@@ -18,6 +18,7 @@
 #include "PDFDocumentTools.h"
 #include "PDFRuler.h"
 #include "PDFSearcher.h"
+#include "PDFSpatialIndex.h"
 
 #include <QtWidgets>
 #include <memory>
@@ -29,12 +30,17 @@ class PDFDocumentScene;
 // Forward declare classes defined in this header.
 class PDFPageGraphicsItem;
 class PDFLinkGraphicsItem;
+class PDFMarkupAnnotationGraphicsItem;
+class PDFSearchResultsGraphicsItem;
 class PDFDocumentMagnifierView;
 class PDFActionEvent;
 class PDFDocumentView;
 
 
 const int TILE_SIZE=1024;
+// The magnifier only shows a small region around the cursor, so it uses much
+// smaller tiles to avoid rendering (and caching) lots of invisible pixels
+const int MAGNIFIER_TILE_SIZE=256;
 
 class PDFDocumentView : public QGraphicsView {
   Q_OBJECT
@@ -46,7 +52,7 @@ class PDFDocumentView : public QGraphicsView {
 public:
   enum PageMode { PageMode_SinglePage, PageMode_OneColumnContinuous, PageMode_TwoColumnContinuous, PageMode_Presentation };
   enum MouseMode { MouseMode_MagnifyingGlass, MouseMode_Move, MouseMode_MarqueeZoom, MouseMode_Measure, MouseMode_Select };
-  enum Dock { Dock_TableOfContents, Dock_MetaData, Dock_Fonts, Dock_Permissions, Dock_Annotations, Dock_OptionalContent };
+  enum Dock { Dock_TableOfContents, Dock_MetaData, Dock_Fonts, Dock_Permissions, Dock_Annotations, Dock_OptionalContent, Dock_Thumbnails, Dock_RenderStatistics };
   using size_type = QList<QGraphicsItem*>::size_type;
 
   PDFDocumentView(QWidget *parent = nullptr);
@@ -149,6 +155,9 @@ signals:
   // emitted, e.g., if a new document was loaded, or if the existing document
   // has changed (e.g., if it was unlocked)
   void changedDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc);
+  // emitted once the meta data and page sizes of the document have been loaded
+  // (see PDFDocumentScene::documentMetaDataLoaded())
+  void documentMetaDataLoaded();
 
   void updated();
 
@@ -172,6 +181,8 @@ protected:
   void wheelEvent(QWheelEvent * event) override;
   void changeEvent(QEvent * event) override;
   void resizeEvent(QResizeEvent * event) override;
+  void showEvent(QShowEvent * event) override;
+  void hideEvent(QHideEvent * event) override;
 
   // Maybe this will become public later on
   // Ownership of tool is transferred to PDFDocumentView
@@ -194,6 +205,8 @@ protected slots:
   void searchProgressValueChanged(PDFSearcher::size_type progressValue);
   void reinitializeFromScene();
   void notifyTextSelectionChanged();
+  // Preloads the links around the current page while the view is visible
+  void preloadLinks();
 
 private:
   PageMode _pageMode{PageMode_OneColumnContinuous};
@@ -213,7 +226,14 @@ private:
   size_type _currentPage{-1}, _lastPage{-1};
 
   PDFSearcher _searcher;
-  QList<QGraphicsItem *> _searchResults;
+  // One overlay per page with results, in the order in which they were found;
+  // `firstResult` is the (global) index of the overlay's first result
+  struct SearchResultPage {
+    PDFSearchResultsGraphicsItem * item;
+    size_type firstResult;
+  };
+  QVector<SearchResultPage> _searchResultPages;
+  size_type _searchResultCount{0};
   size_type _currentSearchResult{-1};
   QBrush _searchResultHighlightBrush;
   QBrush _currentSearchResultHighlightBrush;
@@ -222,6 +242,9 @@ private:
 
   // Never try to set a vanilla QGraphicsScene, always use a PDFGraphicsScene.
   void setScene(QGraphicsScene *scene);
+  // Highlights the result with (global) index `_currentSearchResult` and
+  // scrolls it into view
+  void showCurrentSearchResult();
   // Parent class has no copy constructor.
   Q_DISABLE_COPY(PDFDocumentView)
 };
@@ -236,6 +259,16 @@ class PDFDocumentMagnifierView : public QGraphicsView {
   DocumentTool::MagnifyingGlass::MagnifierShape _shape{DocumentTool::MagnifyingGlass::Magnifier_Circle};
   int _size{300};
 
+  // Magnified tiles are kept in a small private cache (rather than the global
+  // page cache) as they are typically only needed while the magnifier is shown.
+  // Keys don't include the document since the cache is cleared whenever the
+  // document changes.
+  QCache<Backend::PDFPageTile, QImage> _tileCache{32 * 1024 * 1024};
+  // Tiles being rendered in the background, along with the approximation
+  // shown until they arrive (computing it requires scanning the page cache,
+  // so we don't want to do that on every repaint)
+  QHash<Backend::PDFPageTile, QImage> _pendingTiles;
+
 public:
   PDFDocumentMagnifierView(PDFDocumentView *parent = nullptr);
   // the zoom factor multiplies the parent view's _zoomLevel
@@ -253,7 +286,16 @@ public:
 
   QPixmap& dropShadow();
 
+  // Returns the magnified image of `render_box` of `page`. If it is not cached,
+  // it is rendered in the background and an approximation made from (scaled)
+  // cached tiles is returned in the meantime.
+  QImage magnifiedTile(const QSharedPointer<Backend::Page> & page, const double xres, const double yres, const QRect & render_box);
+
+public slots:
+  void clearTileCache();
+
 protected:
+  bool event(QEvent * event) override;
   void wheelEvent(QWheelEvent * event) override { event->ignore(); }
   void paintEvent(QPaintEvent * event) override;
 
@@ -270,12 +312,17 @@ class PDFPageGraphicsItem : public QGraphicsObject
   typedef QGraphicsObject Super;
   using size_type = PDFDocumentView::size_type;
 
-  QWeakPointer<Backend::Page> _page;
+  // Items created for a page number (rather than a page) only load the page
+  // when it is first needed (see page())
+  QWeakPointer<Backend::Document> _doc;
+  mutable QWeakPointer<Backend::Page> _page;
 
   double _dpiX;
   double _dpiY;
   // the nominal (i.e., unmagnified) page size in pixel
   QSizeF _pageSize;
+  // Whether _pageSize may only be an estimate (see updatePageSize())
+  bool _pageSizeEstimated{false};
   size_type _pageNum;
 
   bool _linksLoaded;
@@ -284,14 +331,34 @@ class PDFPageGraphicsItem : public QGraphicsObject
   QTransform _pageScale, _pointScale;
   qreal _zoomLevel;
 
+  // Links and (markup) annotations are kept in spatial indices (in pdf
+  // coordinates) and graphics items for them are only created on demand, i.e.,
+  // when they are hovered (see updateHoverItems())
+  QList< QSharedPointer<Annotation::Link> > _links;
+  PDFSpatialIndex _linkIndex;
+  int _hoverLink{-1};
+  PDFLinkGraphicsItem * _hoverLinkItem{nullptr};
+  QList< QSharedPointer<Annotation::Markup> > _markupAnnotations;
+  PDFSpatialIndex _markupAnnotationIndex;
+  // Markup annotation items are kept once created as they manage the state of
+  // their popup
+  QVector<PDFMarkupAnnotationGraphicsItem *> _markupAnnotationItems;
+  // Trace::now() of requests whose results arrived but were not painted yet
+  QVector<qint64> _tracePendingDisplay;
+
   friend class PageProcessingRenderPageRequest;
   friend class PageProcessingLoadLinksRequest;
 //  friend class PDFPageLayout;
 
   static void imageToGrayScale(QImage & img);
+  void setPageSizeInPt(const QSizeF & pageSize);
 
 public:
   PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
+  // Creates an item for page `pageNum` of `a_doc` without loading the page.
+  // `pageSize` (in pt) may be an estimate; use updatePageSize() once the
+  // actual size is known.
+  PDFPageGraphicsItem(QWeakPointer<Backend::Document> a_doc, const size_type pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
 
   // This seems fragile as it assumes no other code declaring a custom graphics
   // item will choose the same ID for it's object types. Unfortunately, there
@@ -304,7 +371,13 @@ public:
 
   QRectF boundingRect() const override;
 
-  QWeakPointer<Backend::Page> page() const { return _page; }
+  // Uses doc-read-lock and may use doc-write-lock (if the page still needs to
+  // be loaded)
+  QWeakPointer<Backend::Page> page() const;
+  // Sets the page size (in pt), e.g., if it was only estimated before. If this
+  // doesn't happen before the page is painted for the first time, the item
+  // corrects the size itself and emits pageSizeChanged().
+  void updatePageSize(const QSizeF & pageSize);
 
   // Maps the point _point_ from the page's coordinate system (in pt) to this
   // item's coordinate system - chain with mapToScene and related methods to get
@@ -322,16 +395,29 @@ public:
   QSizeF pageSizeF() const { return _pageSize; }
   size_type pageNum() const { return _pageNum; }
 
+  // Ensures graphics items exist for the link and/or annotation at `pos` (in
+  // item coordinates) so they can handle hover and mouse events
+  void updateHoverItems(const QPointF & pos);
+
 protected:
   bool event(QEvent * event) override;
+  void hoverEnterEvent(QGraphicsSceneHoverEvent * event) override;
+  void hoverMoveEvent(QGraphicsSceneHoverEvent * event) override;
+  void hoverLeaveEvent(QGraphicsSceneHoverEvent * event) override;
 
 private:
   // Parent has no copy constructor.
   Q_DISABLE_COPY(PDFPageGraphicsItem)
 
+signals:
+  // Emitted when the item corrected its estimated page size by itself; the
+  // page layout needs to be updated then
+  void pageSizeChanged();
+
 private slots:
   void addLinks(QList< QSharedPointer<Annotation::Link> > links);
   void addAnnotations(QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations);
+  void applyLoadedPageSize();
 };
 
 // TODO: Should be turned into a QGraphicsPolygonItem
@@ -387,6 +473,44 @@ private:
   Q_DISABLE_COPY(PDFMarkupAnnotationGraphicsItem)
 };
 
+// Paints all search results on one page in a single pass. Results are stored
+// as plain rects (in pdf coordinates; the item uses the page's pointScale())
+// so that even thousands of hits don't require any additional graphics items.
+class PDFSearchResultsGraphicsItem : public QGraphicsItem {
+  typedef QGraphicsItem Super;
+
+  QVector<QRectF> _rects;
+  QRectF _boundingRect;
+  int _current{-1};
+  QBrush _brush;
+  QBrush _currentBrush;
+
+public:
+  PDFSearchResultsGraphicsItem(QGraphicsItem *parent = nullptr);
+  // See concerns in `PDFPageGraphicsItem` for why this feels fragile.
+  enum { Type = UserType + 4 };
+  int type() const override;
+
+  QRectF boundingRect() const override { return _boundingRect; }
+  void paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget = nullptr) override;
+
+  void addResults(const QVector<QRectF> & rects);
+  int count() const { return static_cast<int>(_rects.size()); }
+  QRectF rect(const int idx) const { return _rects[idx]; }
+
+  // Index of the result to highlight with currentBrush(), or -1 for none
+  int current() const { return _current; }
+  void setCurrent(const int idx);
+
+  QBrush brush() const { return _brush; }
+  void setBrush(const QBrush & brush);
+  QBrush currentBrush() const { return _currentBrush; }
+  void setCurrentBrush(const QBrush & brush);
+
+private:
+  Q_DISABLE_COPY(PDFSearchResultsGraphicsItem)
+};
+
 class PDFActionEvent : public QEvent {
   typedef QEvent Super;
 
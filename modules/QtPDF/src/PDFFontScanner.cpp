@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "PDFFontScanner.h"
+
+namespace QtPDF {
+
+void PDFFontScanner::ensureStopped()
+{
+  if (!isRunning()) {
+    return;
+  }
+  requestInterruption();
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+  wait(ULONG_MAX);
+#else
+  wait();
+#endif
+}
+
+void PDFFontScanner::clear()
+{
+  const QMutexLocker mutexLocker{&m_mutex};
+  m_fonts.clear();
+}
+
+QWeakPointer<Backend::Document> PDFFontScanner::document() const
+{
+  const QMutexLocker mutexLocker{&m_mutex};
+  return m_doc;
+}
+
+void PDFFontScanner::setDocument(const QWeakPointer<Backend::Document> & doc)
+{
+  ensureStopped();
+  clear();
+  const QMutexLocker mutexLocker{&m_mutex};
+  m_doc = doc;
+}
+
+int PDFFontScanner::count() const
+{
+  const QMutexLocker mutexLocker{&m_mutex};
+  return static_cast<int>(m_fonts.size());
+}
+
+QList<Backend::PDFFontInfo> PDFFontScanner::fonts(const int from) const
+{
+  const QMutexLocker mutexLocker{&m_mutex};
+  if (from <= 0) {
+    return m_fonts;
+  }
+  return m_fonts.mid(from);
+}
+
+void PDFFontScanner::run()
+{
+  clear();
+
+  const QSharedPointer<Backend::Document> doc = [this] () {
+    const QMutexLocker mutexLocker{&m_mutex};
+    return m_doc.toStrongRef();
+  }();
+  if (!doc) {
+    return;
+  }
+
+  doc->fonts([this](const QList<Backend::PDFFontInfo> & batch) {
+    if (isInterruptionRequested()) {
+      return false;
+    }
+    if (batch.isEmpty()) {
+      return true;
+    }
+    {
+      const QMutexLocker mutexLocker{&m_mutex};
+      m_fonts.append(batch);
+    }
+    emit fontsFound();
+    return true;
+  });
+}
+
+} // namespace QtPDF
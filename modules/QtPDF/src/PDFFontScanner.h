@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFFontScanner_H
+#define PDFFontScanner_H
+
+#include "PDFBackend.h"
+
+#include <QMutex>
+#include <QThread>
+
+namespace QtPDF {
+
+// Enumerates the fonts of a document in a background thread. Results are
+// collected incrementally (as the backend reports them) and fontsFound() is
+// emitted whenever new fonts are available. The backend caches the full list
+// until the document is reloaded, so rescanning the same document is cheap.
+class PDFFontScanner : public QThread
+{
+  Q_OBJECT
+
+public:
+  void ensureStopped();
+  void clear();
+
+  QWeakPointer<QtPDF::Backend::Document> document() const;
+  void setDocument(const QWeakPointer<QtPDF::Backend::Document> & doc);
+
+  int count() const;
+  // Returns all fonts found so far, starting with the one at index `from`
+  QList<Backend::PDFFontInfo> fonts(int from = 0) const;
+
+signals:
+  void fontsFound();
+
+protected:
+  void run() final;
+
+private:
+  QWeakPointer<Backend::Document> m_doc;
+  QList<Backend::PDFFontInfo> m_fonts;
+  mutable QMutex m_mutex;
+};
+
+} // namespace QtPDF
+
+#endif // !defined(PDFFontScanner_H)
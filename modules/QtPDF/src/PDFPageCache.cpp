@@ -35,28 +35,59 @@ PDFPageCache::TileStatus PDFPageCache::getStatus(const PDFPageTile & tile) const
   QReadLocker locker(&_lock);
   CachedTileData * data = m_cache.object(tile);
   if (data) {
-    return data->status;
+    return data->status();
   }
   return UNKNOWN;
 }
 
-QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const bool overwrite /* = true */)
+PDFPageCache::CachedTileData::CachedTileData(PDFPageCache * cache, const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status)
+  : image(image)
+  , _cache(cache)
+  , _tile(tile)
+  , _status(status)
 {
-  QWriteLocker locker(&_lock);
+  ++_cache->_statusCounts[_status];
+  _cache->_buckets[_tile.bucket()].append(_tile);
+}
+
+PDFPageCache::CachedTileData::~CachedTileData()
+{
+  --_cache->_statusCounts[_status];
+  // NB: When a tile is replaced, the new data is constructed before the old
+  // one is destroyed, so only remove one entry
+  const PDFPageTile bucket = _tile.bucket();
+  auto it = _cache->_buckets.find(bucket);
+  if (it != _cache->_buckets.end()) {
+    it->removeOne(_tile);
+    if (it->isEmpty())
+      _cache->_buckets.erase(it);
+  }
+}
 
-  auto insert = [this](const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status) {
-    CachedTileData * data = new CachedTileData{image, status};
+void PDFPageCache::insert(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status)
+{
+  // QCache silently deletes the least recently used tiles to make room for
+  // the new one; infer how many from the change in size
+  const auto countBefore = m_cache.count() + (m_cache.contains(tile) ? 0 : 1);
+  CachedTileData * data = new CachedTileData(this, tile, image, status);
 #if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-    m_cache.insert(tile, data, (image ? image->byteCount() : 0));
+  m_cache.insert(tile, data, (image ? image->byteCount() : 0));
 #elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    // No image (1024x124x4 bytes by default) should ever come even close to the
-    // 2 GB mark corresponding to INT_MAX; note that Document::Document() sets
-    // the cache's max-size to 1 GB total
-    m_cache.insert(tile, data, (image ? static_cast<int>(image->sizeInBytes()) : 0));
+  // No image (1024x124x4 bytes by default) should ever come even close to the
+  // 2 GB mark corresponding to INT_MAX; note that Document::Document() sets
+  // the cache's max-size to 1 GB total
+  m_cache.insert(tile, data, (image ? static_cast<int>(image->sizeInBytes()) : 0));
 #else
-    m_cache.insert(tile, data, (image ? image->sizeInBytes() : 0));
+  m_cache.insert(tile, data, (image ? image->sizeInBytes() : 0));
 #endif
-  };
+  ++_insertions;
+  if (m_cache.count() < countBefore)
+    _evictions += static_cast<quint64>(countBefore - m_cache.count());
+}
+
+QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const bool overwrite /* = true */)
+{
+  QWriteLocker locker(&_lock);
 
   CachedTileData * data = m_cache.object(tile);
   if (!data) {
@@ -65,7 +96,7 @@ QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QSharedP
   }
   if (data->image == image) {
     // Trying to overwrite an image with itself - just update the status
-    data->status = status;
+    data->setStatus(status);
     return data->image;
   }
   if (overwrite) {
@@ -75,28 +106,129 @@ QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QSharedP
   return data->image;
 }
 
-void PDFPageCache::removeDocumentTiles(const Document *doc)
+void PDFPageCache::removePlaceholder(const PDFPageTile & tile)
 {
   QWriteLocker l(&_lock);
+  CachedTileData * data = m_cache.object(tile);
+  if (data && data->status() == PLACEHOLDER)
+    m_cache.remove(tile);
+}
 
-  const auto keys = m_cache.keys();
-  for (const PDFPageTile & tile : keys) {
-    if (tile.doc == doc) {
-      m_cache.remove(tile);
-    }
-  }
+void PDFPageCache::markPlaceholderOutdated(const PDFPageTile & tile)
+{
+  QWriteLocker l(&_lock);
+  CachedTileData * data = m_cache.object(tile);
+  if (data && data->status() == PLACEHOLDER)
+    data->setStatus(OUTDATED);
 }
 
-void PDFPageCache::markOutdated(const Document * doc)
+void PDFPageCache::changeKey(const quint64 oldKey, const quint64 newKey)
 {
+  if (oldKey == newKey)
+    return;
   QWriteLocker l(&_lock);
 
+  if (newKey != 0)
+    ++_keyUsers[newKey];
+  if (oldKey == 0)
+    return;
+  const bool oldKeyUnused = (--_keyUsers[oldKey] <= 0);
+  if (oldKeyUnused)
+    _keyUsers.remove(oldKey);
+
   const auto keys = m_cache.keys();
   for (const PDFPageTile & tile : keys) {
-    if (tile.doc == doc) {
-      m_cache[tile]->status = OUTDATED;
-    }
+    if (tile.doc_key != oldKey)
+      continue;
+    // The tile may have been evicted by an insertion below in the meantime
+    CachedTileData * data = m_cache.object(tile);
+    if (!data)
+      continue;
+    const QSharedPointer<QImage> image = data->image;
+    // Remove the old tile before inserting the new one so the (shared) image
+    // is never accounted for twice; otherwise, a full cache would evict other
+    // tiles (including the placeholders we are about to create) to make room
+    if (oldKeyUnused)
+      m_cache.remove(tile);
+    if (newKey == 0)
+      continue;
+    PDFPageTile newTile(tile);
+    newTile.doc_key = newKey;
+    // NB: The image is shared, so this doesn't copy any pixel data. If other
+    // documents still use `oldKey`, it is accounted for twice, though.
+    if (!m_cache.contains(newTile))
+      insert(newTile, image, OUTDATED);
+  }
+}
+
+QList<PDFPageTile> PDFPageCache::similarTiles(const PDFPageTile & tile) const
+{
+  QReadLocker locker(&_lock);
+  QList<PDFPageTile> retVal;
+  const auto it = _buckets.constFind(tile.bucket());
+  if (it == _buckets.cend())
+    return retVal;
+  for (const PDFPageTile & t : *it) {
+    if (!(t == tile))
+      retVal.append(t);
   }
+  return retVal;
+}
+
+void PDFPageCache::recordLookup(const TileStatus status) const
+{
+  _lookups[status].fetchAndAddRelaxed(1);
+}
+
+PDFPageCache::Statistics PDFPageCache::statistics() const
+{
+  QReadLocker locker(&_lock);
+  Statistics stats;
+  stats.hits = _lookups[CURRENT].loadAcquire();
+  stats.placeholderHits = _lookups[PLACEHOLDER].loadAcquire();
+  stats.outdatedHits = _lookups[OUTDATED].loadAcquire();
+  stats.misses = _lookups[UNKNOWN].loadAcquire();
+  stats.insertions = _insertions;
+  stats.evictions = _evictions;
+  stats.cost = m_cache.totalCost();
+  stats.maxCost = m_cache.maxCost();
+  stats.count = static_cast<int>(m_cache.count());
+  stats.placeholders = _statusCounts[PLACEHOLDER];
+  stats.outdated = _statusCounts[OUTDATED];
+  return stats;
+}
+
+void PDFPageCache::resetStatistics()
+{
+  QWriteLocker locker(&_lock);
+  for (auto & lookups : _lookups)
+    lookups.storeRelease(0);
+  _insertions = 0;
+  _evictions = 0;
+}
+
+double PDFPageCache::Statistics::hitRate() const
+{
+  const quint64 lookups = hits + placeholderHits + outdatedHits + misses;
+  return (lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.);
+}
+
+QVariantMap PDFPageCache::Statistics::toVariantMap() const
+{
+  return {
+    {QStringLiteral("hits"), hits},
+    {QStringLiteral("placeholderHits"), placeholderHits},
+    {QStringLiteral("outdatedHits"), outdatedHits},
+    {QStringLiteral("misses"), misses},
+    {QStringLiteral("hitRate"), hitRate()},
+    {QStringLiteral("insertions"), insertions},
+    {QStringLiteral("evictions"), evictions},
+    {QStringLiteral("cost"), cost},
+    {QStringLiteral("maxCost"), maxCost},
+    {QStringLiteral("count"), count},
+    {QStringLiteral("placeholders"), placeholders},
+    {QStringLiteral("outdated"), outdated}
+  };
 }
 
 } // namespace Backend
@@ -17,9 +17,11 @@
 
 #include "PDFPageTile.h"
 
+#include <QAtomicInteger>
 #include <QCache>
 #include <QReadWriteLock>
 #include <QSharedPointer>
+#include <QVariantMap>
 #include <QWriteLocker>
 
 class QImage;
@@ -39,6 +41,27 @@ class PDFPageCache
 public:
   enum TileStatus { UNKNOWN, PLACEHOLDER, CURRENT, OUTDATED };
 
+  struct Statistics {
+    // Outcomes of the lookups recorded with recordLookup() (see
+    // Page::getTileImage())
+    quint64 hits{0};
+    quint64 placeholderHits{0};
+    quint64 outdatedHits{0};
+    quint64 misses{0};
+    quint64 insertions{0};
+    // Tiles that were dropped to stay within maxCost()
+    quint64 evictions{0};
+    qint64 cost{0};
+    qint64 maxCost{0};
+    int count{0};
+    int placeholders{0};
+    int outdated{0};
+
+    // Fraction of lookups that returned a current tile
+    double hitRate() const;
+    QVariantMap toVariantMap() const;
+  };
+
   size_type maxCost() const { QReadLocker locker(&_lock); return m_cache.maxCost(); }
   void setMaxCost(const size_type cost) { QWriteLocker locker(&_lock); m_cache.setMaxCost(cost); }
 
@@ -51,19 +74,69 @@ public:
   QSharedPointer<QImage> setImage(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const bool overwrite = true);
 
   void clear() { QWriteLocker l(&_lock); m_cache.clear(); }
-  void removeDocumentTiles(const Document *doc);
-  // Mark all tiles outdated
-  void markOutdated(const Document *doc);
+  // Removes the tile only if it is (still) a placeholder, e.g., because the
+  // request that was supposed to replace it was cancelled
+  void removePlaceholder(const PDFPageTile & tile);
+  // Marks the tile outdated if it is (still) a placeholder, e.g., because the
+  // request that was supposed to replace it failed; unlike removePlaceholder(),
+  // this keeps the approximation on screen until the tile is requested again
+  void markPlaceholderOutdated(const PDFPageTile & tile);
+
+  // Documents report which cache key they use (see Document::cacheKey()) so
+  // tiles can be dropped once no document uses them anymore. The tiles of
+  // `oldKey` are kept as outdated placeholders for `newKey` (unless the latter
+  // has tiles of its own already). Passing 0 as `oldKey` or `newKey` denotes
+  // that a document starts or stops using the cache, respectively.
+  void changeKey(const quint64 oldKey, const quint64 newKey);
 
   QList<PDFPageTile> tiles() const { QReadLocker locker(&_lock); return m_cache.keys(); }
+  // Returns the tiles of the same page in the same resolution bucket as `tile`
+  // (see PDFPageTile::bucket()), except `tile` itself
+  QList<PDFPageTile> similarTiles(const PDFPageTile & tile) const;
+
+  void recordLookup(const TileStatus status) const;
+  Statistics statistics() const;
+  // Resets the counters (but not the current state, e.g., cost() or count())
+  void resetStatistics();
+
 protected:
-  struct CachedTileData {
+  // Keeps track of how many tiles are in which state and of the resolution
+  // buckets (including tiles that QCache deletes on its own to make room for
+  // new ones)
+  class CachedTileData {
+  public:
+    CachedTileData(PDFPageCache * cache, const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status);
+    ~CachedTileData();
+    CachedTileData(const CachedTileData &) = delete;
+    CachedTileData & operator=(const CachedTileData &) = delete;
+
+    TileStatus status() const { return _status; }
+    void setStatus(const TileStatus status) { --_cache->_statusCounts[_status]; _status = status; ++_cache->_statusCounts[_status]; }
+
     QSharedPointer<QImage> image;
-    TileStatus status;
+  private:
+    PDFPageCache * _cache;
+    const PDFPageTile _tile;
+    TileStatus _status;
   };
 
+  // Inserts a new CachedTileData for `tile`; the caller must hold a write lock
+  void insert(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status);
+
   mutable QReadWriteLock _lock;
 
+  // Protected by _lock; must be declared before m_cache so they outlive all
+  // CachedTileData objects
+  int _statusCounts[OUTDATED + 1]{};
+  // Maps PDFPageTile::bucket() to the tiles in that bucket
+  QHash<PDFPageTile, QVector<PDFPageTile>> _buckets;
+  // Number of documents using each cache key
+  QHash<quint64, int> _keyUsers;
+  // Lookups happen under a read lock, so these must be atomic
+  mutable QAtomicInteger<quint64> _lookups[OUTDATED + 1]{};
+  quint64 _insertions{0};
+  quint64 _evictions{0};
+
   // Set cache for rendered pages to be 1GB. This is enough for 256 RGBA tiles
   // (1024 x 1024 pixels x 4 bytes per pixel).
   QCache<PDFPageTile, CachedTileData> m_cache{1024 * 1024 * 1024};
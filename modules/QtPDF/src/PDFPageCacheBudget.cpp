@@ -0,0 +1,291 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFPageCacheBudget.h"
+
+#include "PDFPageCache.h"
+
+#include <QFile>
+#include <QList>
+
+#include <limits>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace QtPDF {
+
+namespace Backend {
+
+namespace {
+
+// Evicting tiles in steps of this size keeps each step well below a frame
+const qint64 kTrimStep = 32 * 1024 * 1024;
+// Used if the kernel doesn't report pressure stall information
+const double kLowMemoryFraction = 0.05;
+// "some avg10" value (in percent) above which we consider memory to be tight
+const double kPressureThreshold = 10;
+
+#if defined(Q_OS_LINUX)
+QByteArray readFile(const QString & path)
+{
+  QFile f(path);
+  if (!f.open(QIODevice::ReadOnly))
+    return {};
+  // Files in /proc and /sys report a size of 0, so we can't use f.size()
+  return f.readAll();
+}
+
+qint64 readNumber(const QString & path)
+{
+  bool ok{false};
+  const qint64 value = readFile(path).trimmed().toLongLong(&ok);
+  return (ok ? value : -1);
+}
+
+// Returns the memory limit and usage of the control group the process runs in
+// (or -1 if there is none)
+void cgroupMemory(qint64 & limit, qint64 & usage)
+{
+  limit = usage = -1;
+  const QList<QByteArray> lines = readFile(QStringLiteral("/proc/self/cgroup")).split('\n');
+  for (const QByteArray & line : lines) {
+    // cgroup v2: "0::/path"
+    if (line.startsWith("0::")) {
+      const QString dir = QStringLiteral("/sys/fs/cgroup") + QString::fromUtf8(line.mid(3));
+      limit = readNumber(dir + QStringLiteral("/memory.max"));
+      usage = readNumber(dir + QStringLiteral("/memory.current"));
+      if (limit >= 0)
+        return;
+    }
+  }
+  for (const QByteArray & line : lines) {
+    // cgroup v1: "N:memory:/path"
+    const QList<QByteArray> parts = line.split(':');
+    if (parts.size() == 3 && parts[1].split(',').contains("memory")) {
+      const QString dir = QStringLiteral("/sys/fs/cgroup/memory") + QString::fromUtf8(parts[2]);
+      limit = readNumber(dir + QStringLiteral("/memory.limit_in_bytes"));
+      usage = readNumber(dir + QStringLiteral("/memory.usage_in_bytes"));
+      return;
+    }
+  }
+}
+#endif // defined(Q_OS_LINUX)
+
+} // anonymous namespace
+
+PDFPageCacheBudget::PDFPageCacheBudget(PDFPageCache & cache, QObject * parent /* = nullptr */)
+  : QObject(parent)
+  , _cache(cache)
+{
+  _pollTimer.setInterval(5000);
+  connect(&_pollTimer, &QTimer::timeout, this, &PDFPageCacheBudget::update);
+  _trimTimer.setInterval(50);
+  connect(&_trimTimer, &QTimer::timeout, this, &PDFPageCacheBudget::trimStep);
+  setAdaptive(true);
+}
+
+void PDFPageCacheBudget::setLimits(const qint64 minCost, const qint64 maxCost)
+{
+  _minCost = qMax(qint64(0), minCost);
+  _maxCost = qMax(_minCost, maxCost);
+  update();
+}
+
+void PDFPageCacheBudget::setBaseCost(const qint64 cost)
+{
+  _baseCost = qMax(qint64(0), cost);
+  update();
+}
+
+void PDFPageCacheBudget::setAdaptive(const bool adaptive)
+{
+  _adaptive = adaptive;
+  if (_adaptive)
+    _pollTimer.start();
+  else
+    _pollTimer.stop();
+  update();
+}
+
+//static
+PDFPageCacheBudget::MemoryInfo PDFPageCacheBudget::systemMemory()
+{
+  MemoryInfo retVal;
+#if defined(Q_OS_LINUX)
+  retVal = parseMemInfo(readFile(QStringLiteral("/proc/meminfo")));
+
+  // In containers (and some desktop session managers), the control group limit
+  // can be much lower than the physical memory
+  qint64 limit{-1}, usage{-1};
+  cgroupMemory(limit, usage);
+  // cgroup v1 reports "no limit" as a huge number
+  if (limit > 0 && (retVal.total < 0 || limit < retVal.total)) {
+    retVal.total = limit;
+    if (usage >= 0) {
+      const qint64 cgroupAvailable = qMax(qint64(0), limit - usage);
+      retVal.available = (retVal.available < 0 ? cgroupAvailable : qMin(retVal.available, cgroupAvailable));
+    }
+  }
+
+  // Pressure stall information is available since Linux 4.20
+  const double pressure = parsePressure(readFile(QStringLiteral("/proc/pressure/memory")));
+  if (pressure >= 0)
+    retVal.underPressure = (pressure > kPressureThreshold);
+#elif defined(Q_OS_WIN)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status)) {
+    retVal.total = static_cast<qint64>(status.ullTotalPhys);
+    retVal.available = static_cast<qint64>(status.ullAvailPhys);
+    retVal.underPressure = (status.dwMemoryLoad >= 90);
+  }
+#endif
+  if (retVal.total > 0 && retVal.available >= 0 && static_cast<double>(retVal.available) < kLowMemoryFraction * static_cast<double>(retVal.total))
+    retVal.underPressure = true;
+  return retVal;
+}
+
+//static
+qint64 PDFPageCacheBudget::computeBudget(const MemoryInfo & memory, const qint64 currentCost, const qint64 minCost, const qint64 maxCost, const double availableFraction, const qint64 baseCost /* = 0 */)
+{
+  const qint64 upper = qMax(minCost, maxCost);
+  const qint64 base = (baseCost > 0 ? qBound(minCost, baseCost, upper) : upper);
+  if (memory.available < 0)
+    return base;
+  if (memory.underPressure)
+    // Give back half of what we have; if the pressure persists, we'll shrink
+    // further on the next update
+    return qBound(minCost, currentCost / 2, upper);
+  // The memory the cache uses already is not included in `available`
+  const qint64 budget = currentCost + static_cast<qint64>(availableFraction * static_cast<double>(memory.available));
+  return qBound((baseCost > 0 ? base : minCost), budget, upper);
+}
+
+//static
+PDFPageCacheBudget::MemoryInfo PDFPageCacheBudget::parseMemInfo(const QByteArray & meminfo)
+{
+  MemoryInfo retVal;
+  qint64 freeMem{-1}, buffers{0}, cached{0};
+  for (const QByteArray & line : meminfo.split('\n')) {
+    // e.g. "MemAvailable:   12345678 kB"
+    const auto colon = line.indexOf(':');
+    if (colon < 0)
+      continue;
+    const QByteArray key = line.left(colon);
+    QByteArray value = line.mid(colon + 1).trimmed();
+    qint64 factor = 1;
+    if (value.endsWith(" kB")) {
+      factor = 1024;
+      value.chop(3);
+    }
+    bool ok{false};
+    const qint64 number = value.trimmed().toLongLong(&ok) * factor;
+    if (!ok)
+      continue;
+    if (key == "MemTotal")
+      retVal.total = number;
+    else if (key == "MemAvailable")
+      retVal.available = number;
+    else if (key == "MemFree")
+      freeMem = number;
+    else if (key == "Buffers")
+      buffers = number;
+    else if (key == "Cached")
+      cached = number;
+  }
+  // MemAvailable only exists since Linux 3.14
+  if (retVal.available < 0 && freeMem >= 0)
+    retVal.available = freeMem + buffers + cached;
+  return retVal;
+}
+
+//static
+double PDFPageCacheBudget::parsePressure(const QByteArray & pressure)
+{
+  // e.g. "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+  for (const QByteArray & line : pressure.split('\n')) {
+    if (!line.startsWith("some "))
+      continue;
+    for (const QByteArray & field : line.split(' ')) {
+      if (field.startsWith("avg10=")) {
+        bool ok{false};
+        const double value = field.mid(6).toDouble(&ok);
+        return (ok ? value : -1);
+      }
+    }
+  }
+  return -1;
+}
+
+void PDFPageCacheBudget::update()
+{
+  if (!_adaptive) {
+    setTargetCost(_baseCost > 0 ? qBound(_minCost, _baseCost, _maxCost) : _maxCost);
+    return;
+  }
+  setTargetCost(computeBudget(systemMemory(), _cache.statistics().cost, _minCost, _maxCost, _availableFraction, _baseCost));
+}
+
+void PDFPageCacheBudget::releaseMemory()
+{
+  setTargetCost(_minCost);
+}
+
+void PDFPageCacheBudget::setTargetCost(const qint64 cost)
+{
+  if (cost != _targetCost) {
+    _targetCost = cost;
+    emit targetCostChanged(cost);
+  }
+  if (cost >= static_cast<qint64>(_cache.maxCost())) {
+    // Growing never evicts anything, so do it right away
+    _trimTimer.stop();
+    applyCost(cost);
+  }
+  else if (!_trimTimer.isActive()) {
+    trimStep();
+    _trimTimer.start();
+  }
+}
+
+void PDFPageCacheBudget::trimStep()
+{
+  const qint64 current = static_cast<qint64>(_cache.maxCost());
+  const qint64 used = _cache.statistics().cost;
+  if (current <= _targetCost || used <= _targetCost) {
+    // Nothing (more) to evict
+    applyCost(_targetCost);
+    _trimTimer.stop();
+    return;
+  }
+  applyCost(qMax(_targetCost, qMin(current, used) - kTrimStep));
+}
+
+void PDFPageCacheBudget::applyCost(const qint64 cost)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  // QCache uses int for costs in Qt 5 (the parentheses guard against the max()
+  // macro from windows.h)
+  const int maxCost = static_cast<int>(qMin(cost, static_cast<qint64>((std::numeric_limits<int>::max)())));
+#else
+  const qsizetype maxCost = static_cast<qsizetype>(cost);
+#endif
+  _cache.setMaxCost(maxCost);
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
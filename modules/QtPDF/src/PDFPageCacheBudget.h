@@ -0,0 +1,110 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFPageCacheBudget_H
+#define PDFPageCacheBudget_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QTimer>
+
+namespace QtPDF {
+
+namespace Backend {
+
+class PDFPageCache;
+
+// Adjusts the maximum cost of a PDFPageCache to the memory that is available
+// on the system (or in the control group the process runs in). The cache has
+// baseCost() normally and may grow into a fraction of the free memory, but
+// always stays between minCost() and maxCost(). Under memory pressure, the
+// cache is shrunk (down to minCost()).
+//
+// Shrinking happens in small steps spread over time so evicting (possibly
+// hundreds of) tiles doesn't block the GUI.
+class PDFPageCacheBudget : public QObject
+{
+  Q_OBJECT
+public:
+  struct MemoryInfo {
+    // All values are in bytes; -1 if unknown
+    qint64 total{-1};
+    qint64 available{-1};
+    bool underPressure{false};
+  };
+
+  explicit PDFPageCacheBudget(PDFPageCache & cache, QObject * parent = nullptr);
+  ~PDFPageCacheBudget() override = default;
+
+  qint64 minCost() const { return _minCost; }
+  qint64 maxCost() const { return _maxCost; }
+  void setLimits(const qint64 minCost, const qint64 maxCost);
+  // Size of the cache if adaptive is false, or if the available memory is
+  // unknown; with adaptation, the cache doesn't shrink below it unless there
+  // is memory pressure. 0 (the default) stands for maxCost().
+  qint64 baseCost() const { return _baseCost; }
+  void setBaseCost(const qint64 cost);
+  bool isAdaptive() const { return _adaptive; }
+  void setAdaptive(const bool adaptive);
+  // Fraction of the available memory the cache may grow into (default: 0.25)
+  double availableFraction() const { return _availableFraction; }
+  void setAvailableFraction(const double fraction) { _availableFraction = fraction; }
+
+  // The cost the cache is (being) adjusted to
+  qint64 targetCost() const { return _targetCost; }
+
+  static MemoryInfo systemMemory();
+  // Computes the target cost for a cache that currently uses `currentCost`
+  static qint64 computeBudget(const MemoryInfo & memory, const qint64 currentCost, const qint64 minCost, const qint64 maxCost, const double availableFraction, const qint64 baseCost = 0);
+
+  // Parsers for the Linux kernel interfaces used by systemMemory(); exposed
+  // for testing
+  static MemoryInfo parseMemInfo(const QByteArray & meminfo);
+  // Returns the "some avg10" value of /proc/pressure/memory (in percent), or
+  // -1 if it can't be parsed
+  static double parsePressure(const QByteArray & pressure);
+
+public slots:
+  // Re-reads the memory information and adjusts the cache (called
+  // periodically)
+  void update();
+  // Shrinks the cache to minCost() right away; the next update() lets it grow
+  // again if enough memory is available
+  void releaseMemory();
+
+signals:
+  void targetCostChanged(qint64 cost);
+
+private slots:
+  void trimStep();
+
+private:
+  void setTargetCost(const qint64 cost);
+  void applyCost(const qint64 cost);
+
+  PDFPageCache & _cache;
+  qint64 _minCost{64 * 1024 * 1024};
+  qint64 _maxCost{1024 * 1024 * 1024};
+  qint64 _baseCost{0};
+  bool _adaptive{true};
+  double _availableFraction{0.25};
+  qint64 _targetCost{-1};
+  QTimer _pollTimer;
+  QTimer _trimTimer;
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFPageCacheBudget_H)
@@ -0,0 +1,289 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFPageExporter.h"
+
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageWriter>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace QtPDF {
+
+PDFPageExporter::PDFPageExporter(QObject * parent /* = nullptr */) :
+  QObject(parent)
+{
+}
+
+PDFPageExporter::~PDFPageExporter()
+{
+  cancel();
+  _pool.waitForDone();
+}
+
+void PDFPageExporter::setOutputFiles(const QString & pattern, const QByteArray & format /* = QByteArray() */)
+{
+  _outputPattern = pattern;
+  _outputFormat = (format.isEmpty() ? QFileInfo(pattern).suffix().toLower().toLatin1() : format.toLower());
+}
+
+//static
+QVector<int> PDFPageExporter::parsePageRange(const QString & range, const int numPages, bool * ok /* = nullptr */)
+{
+  QVector<int> retVal;
+  if (ok)
+    *ok = false;
+
+  if (range.trimmed().isEmpty()) {
+    for (int i = 0; i < numPages; ++i)
+      retVal << i;
+    if (ok)
+      *ok = true;
+    return retVal;
+  }
+
+  auto parseNumber = [numPages](const QString & str, const int defaultValue, bool * numberOk) {
+    const QString s = str.trimmed();
+    if (s.isEmpty()) {
+      *numberOk = true;
+      return defaultValue;
+    }
+    const int n = s.toInt(numberOk);
+    *numberOk = *numberOk && n >= 1 && n <= numPages;
+    return n;
+  };
+
+  for (const QString & part : range.split(QLatin1Char(','))) {
+    const int dash = part.indexOf(QLatin1Char('-'));
+    bool fromOk{false}, toOk{false};
+    int from{0}, to{0};
+    if (dash < 0) {
+      from = parseNumber(part, 0, &fromOk);
+      to = from;
+      toOk = (from > 0);
+    }
+    else {
+      from = parseNumber(part.left(dash), 1, &fromOk);
+      to = parseNumber(part.mid(dash + 1), numPages, &toOk);
+    }
+    if (!fromOk || !toOk || from > to)
+      return {};
+    for (int i = from; i <= to; ++i)
+      retVal << i - 1;
+  }
+  if (ok)
+    *ok = true;
+  return retVal;
+}
+
+bool PDFPageExporter::start()
+{
+  if (_running)
+    return false;
+
+  _errorString.clear();
+  _cancelled.storeRelease(0);
+  _nextToSchedule = 0;
+  _nextToDeliver = 0;
+  _inFlight = 0;
+  _done = 0;
+  _pending.clear();
+
+  if (_outputPattern.isEmpty() == !_sink) {
+    _errorString = tr("Exactly one kind of output (files or page sink) must be set");
+    return false;
+  }
+  if (!_outputPattern.isEmpty()) {
+    if (!_outputPattern.contains(QStringLiteral("%1"))) {
+      _errorString = tr("The output file name must contain %1 for the page number");
+      return false;
+    }
+    if (!QImageWriter::supportedImageFormats().contains(_outputFormat)) {
+      _errorString = tr("Unsupported image format '%1'").arg(QString::fromLatin1(_outputFormat));
+      return false;
+    }
+  }
+  if (_resolution <= 0) {
+    _errorString = tr("Invalid resolution");
+    return false;
+  }
+
+  // Open the first instance right away to catch errors early and to validate
+  // the page numbers
+  QSharedPointer<Backend::Document> doc = acquireDocument(&_errorString);
+  if (!doc)
+    return false;
+  const int numPages = static_cast<int>(doc->numPages());
+  releaseDocument(doc);
+
+  if (_pages.isEmpty())
+    _pages = parsePageRange(QString(), numPages);
+  for (const int pageNum : _pages) {
+    if (pageNum < 0 || pageNum >= numPages) {
+      _errorString = tr("Page %1 does not exist").arg(pageNum + 1);
+      return false;
+    }
+  }
+  _pageNumberWidth = static_cast<int>(QString::number(numPages).size());
+
+  _running = true;
+  emit progress(0, static_cast<int>(_pages.size()));
+  if (_pages.isEmpty()) {
+#if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
+    QTimer::singleShot(0, this, SLOT(finish()));
+#else
+    QTimer::singleShot(0, this, &PDFPageExporter::finish);
+#endif
+  }
+  else
+    scheduleMore();
+  return true;
+}
+
+void PDFPageExporter::cancel()
+{
+  // Pages that are being rendered right now are finished (and ignored);
+  // finished() is emitted once they are done
+  _cancelled.storeRelease(1);
+  _pending.clear();
+}
+
+void PDFPageExporter::scheduleMore()
+{
+  while (!_cancelled.loadAcquire() && _nextToSchedule < _pages.size() &&
+         _inFlight + static_cast<int>(_pending.size()) < maxPagesInFlight()) {
+    const int index = _nextToSchedule++;
+    const int pageNum = _pages[index];
+    ++_inFlight;
+
+    QFutureWatcher<PageResult> * watcher = new QFutureWatcher<PageResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, index]() {
+      const PageResult result = watcher->result();
+      watcher->deleteLater();
+      pageDone(index, result);
+    });
+    watcher->setFuture(QtConcurrent::run(&_pool, [this, pageNum]() { return renderPage(pageNum); }));
+  }
+}
+
+void PDFPageExporter::pageDone(const int index, const PageResult & result)
+{
+  --_inFlight;
+
+  if (!_cancelled.loadAcquire()) {
+    if (!result.error.isEmpty())
+      fail(result.error);
+    else if (_sink) {
+      // Pages must be handed on in order; keep those that were rendered early
+      _pending.insert(index, result.image);
+      while (!_cancelled.loadAcquire() && _pending.contains(_nextToDeliver)) {
+        const QImage image = _pending.take(_nextToDeliver);
+        if (!_sink(_pages[_nextToDeliver], image))
+          cancel();
+        ++_nextToDeliver;
+        emit progress(++_done, static_cast<int>(_pages.size()));
+      }
+    }
+    else
+      emit progress(++_done, static_cast<int>(_pages.size()));
+  }
+
+  scheduleMore();
+  if (_inFlight == 0 && (_cancelled.loadAcquire() || _nextToSchedule >= _pages.size()))
+    finish();
+}
+
+void PDFPageExporter::fail(const QString & error)
+{
+  if (_errorString.isEmpty())
+    _errorString = error;
+  cancel();
+}
+
+void PDFPageExporter::finish()
+{
+  _running = false;
+  _pending.clear();
+  {
+    QMutexLocker locker(&_docsMutex);
+    _idleDocs.clear();
+  }
+  emit finished(!_cancelled.loadAcquire());
+}
+
+QSharedPointer<Backend::Document> PDFPageExporter::acquireDocument(QString * error)
+{
+  {
+    QMutexLocker locker(&_docsMutex);
+    if (!_idleDocs.isEmpty())
+      return _idleDocs.takeLast();
+  }
+
+  QSharedPointer<Backend::Document> doc = Backend::Document::newDocument(_fileName, _backend);
+  if (!doc || !doc->isValid()) {
+    if (error)
+      *error = tr("Could not open '%1'").arg(_fileName);
+    return {};
+  }
+  if (doc->isLocked() && !doc->unlock(_password)) {
+    if (error)
+      *error = tr("Could not unlock '%1'").arg(_fileName);
+    return {};
+  }
+  return doc;
+}
+
+void PDFPageExporter::releaseDocument(const QSharedPointer<Backend::Document> & doc)
+{
+  QMutexLocker locker(&_docsMutex);
+  _idleDocs.append(doc);
+}
+
+PDFPageExporter::PageResult PDFPageExporter::renderPage(const int pageNum)
+{
+  // Runs in one of the threads of _pool
+  PageResult result;
+  if (_cancelled.loadAcquire())
+    return result;
+
+  QSharedPointer<Backend::Document> doc = acquireDocument(&result.error);
+  if (!doc)
+    return result;
+  QSharedPointer<Backend::Page> page = doc->page(pageNum).toStrongRef();
+  if (page)
+    result.image = page->renderToImage(_resolution, _resolution);
+  releaseDocument(doc);
+
+  if (result.image.isNull()) {
+    result.error = tr("Could not render page %1").arg(pageNum + 1);
+    return result;
+  }
+  // Record the resolution so the image keeps the page's physical size
+  const int dotsPerMeter = qRound(_resolution / 0.0254);
+  result.image.setDotsPerMeterX(dotsPerMeter);
+  result.image.setDotsPerMeterY(dotsPerMeter);
+
+  if (!_outputPattern.isEmpty()) {
+    const QString path = _outputPattern.arg(pageNum + 1, _pageNumberWidth, 10, QLatin1Char('0'));
+    QImageWriter writer(path, _outputFormat);
+    if (!writer.write(result.image))
+      result.error = tr("Could not write '%1': %2").arg(path, writer.errorString());
+    // The page is on disk now, so there is no need to keep it in memory
+    result.image = QImage();
+  }
+  return result;
+}
+
+} // namespace QtPDF
@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFPageExporter_H
+#define PDFPageExporter_H
+
+#include "PDFBackend.h"
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+
+#include <functional>
+
+namespace QtPDF {
+
+// Renders a range of pages at a fixed resolution (e.g., for printing or for
+// exporting pages as images) on several threads. Backends generally serialize
+// rendering per document, so each thread renders from its own instance of the
+// document (opened from fileName()).
+//
+// At most maxPagesInFlight() rendered pages are kept in memory at any time.
+// The results are either written to image files directly by the rendering
+// threads (setOutputFiles()) or handed to a PageSink in page order in the
+// thread the exporter lives in (setPageSink()).
+//
+// The exporter must be configured before calling start(); progress is reported
+// through signals, which requires a running event loop.
+class PDFPageExporter : public QObject
+{
+  Q_OBJECT
+public:
+  // Called for each page (in the order given to setPages()); returning false
+  // cancels the export
+  using PageSink = std::function<bool(const int pageNum, const QImage & image)>;
+
+  explicit PDFPageExporter(QObject * parent = nullptr);
+  // Cancels a running export and waits for the rendering threads to finish
+  ~PDFPageExporter() override;
+
+  QString fileName() const { return _fileName; }
+  void setFileName(const QString & fileName) { _fileName = fileName; }
+  // Backend to use; empty (the default) selects the default backend
+  QString backend() const { return _backend; }
+  void setBackend(const QString & backend) { _backend = backend; }
+  void setPassword(const QString & password) { _password = password; }
+
+  // 0-based page numbers; if empty, all pages are exported
+  QVector<int> pages() const { return _pages; }
+  void setPages(const QVector<int> & pages) { _pages = pages; }
+  double resolution() const { return _resolution; }
+  void setResolution(const double dpi) { _resolution = dpi; }
+
+  // Defaults to QThread::idealThreadCount()
+  int threadCount() const { return _pool.maxThreadCount(); }
+  void setThreadCount(const int count) { _pool.setMaxThreadCount(qMax(1, count)); }
+  // Defaults to 2 * threadCount()
+  int maxPagesInFlight() const { return (_maxPagesInFlight > 0 ? _maxPagesInFlight : 2 * threadCount()); }
+  void setMaxPagesInFlight(const int count) { _maxPagesInFlight = count; }
+
+  // `pattern` must contain `%1`, which is replaced by the (1-based, zero-padded)
+  // page number. `format` must be supported by QImageWriter (e.g., "png" or
+  // "tiff"); if it is empty, the format is derived from the file suffix.
+  void setOutputFiles(const QString & pattern, const QByteArray & format = QByteArray());
+  void setPageSink(const PageSink & sink) { _sink = sink; }
+
+  // Parses a page range such as "1-3,5,8-" (1-based, inclusive; open ranges
+  // extend to the first/last page) into 0-based page numbers. An empty range
+  // selects all pages. Returns an empty list and sets `ok` to false if the
+  // range is invalid.
+  static QVector<int> parsePageRange(const QString & range, const int numPages, bool * ok = nullptr);
+
+  bool isRunning() const { return _running; }
+  QString errorString() const { return _errorString; }
+
+public slots:
+  // Returns false if the export could not be started (see errorString())
+  bool start();
+  void cancel();
+
+signals:
+  void progress(int pagesDone, int pagesTotal);
+  // Emitted once all rendering threads have finished; `success` is false if
+  // the export was cancelled or failed
+  void finished(bool success);
+
+private:
+  struct PageResult {
+    QImage image;
+    QString error;
+  };
+
+  PageResult renderPage(const int pageNum);
+  QSharedPointer<Backend::Document> acquireDocument(QString * error);
+  void releaseDocument(const QSharedPointer<Backend::Document> & doc);
+  void scheduleMore();
+  void pageDone(const int index, const PageResult & result);
+  void fail(const QString & error);
+
+private slots:
+  void finish();
+
+private:
+  QString _fileName;
+  QString _backend;
+  QString _password;
+  QVector<int> _pages;
+  double _resolution{150};
+  int _maxPagesInFlight{0};
+  QString _outputPattern;
+  QByteArray _outputFormat;
+  int _pageNumberWidth{1};
+  PageSink _sink;
+
+  QThreadPool _pool;
+  // Document instances not currently used by any rendering thread
+  QMutex _docsMutex;
+  QList< QSharedPointer<Backend::Document> > _idleDocs;
+
+  bool _running{false};
+  QAtomicInt _cancelled{0};
+  QString _errorString;
+  // Index (into _pages) of the next page to schedule and of the next page to
+  // hand to the sink
+  int _nextToSchedule{0};
+  int _nextToDeliver{0};
+  int _inFlight{0};
+  int _done{0};
+  // Pages rendered ahead of _nextToDeliver
+  QMap<int, QImage> _pending;
+};
+
+} // namespace QtPDF
+
+#endif // !defined(PDFPageExporter_H)
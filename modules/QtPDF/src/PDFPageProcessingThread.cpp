@@ -14,8 +14,10 @@
 #include "PDFPageProcessingThread.h"
 
 #include "PDFBackend.h"
+#include "PDFTrace.h"
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 
 namespace QtPDF {
 namespace Backend {
@@ -36,9 +38,62 @@ void PDFPageProcessingThread::dumpWorkStack(const QStack<PageProcessingRequest*>
 }
 #endif
 
+namespace {
+
+const char * traceName(const PageProcessingRequest * request)
+{
+  switch (request->type()) {
+    case PageProcessingRequest::PageRendering:
+      return "render";
+    case PageProcessingRequest::LoadLinks:
+      return "loadLinks";
+    case PageProcessingRequest::ThumbnailRendering:
+      return "thumbnail";
+  }
+  return "unknown";
+}
+
+quint64 traceId(const PageProcessingRequest * request)
+{
+  return static_cast<quint64>(reinterpret_cast<quintptr>(request));
+}
+
+Trace::Args traceArgs(const PageProcessingRequest * request)
+{
+  const PDFPageTile & key = request->key;
+  return {
+    {"page", key.page_num},
+    {"dpi", key.xres},
+    {"tile", QStringLiteral("%1,%2 %3x%4").arg(key.render_box.x()).arg(key.render_box.y()).arg(key.render_box.width()).arg(key.render_box.height())}
+  };
+}
+
+// All processing threads, so totalStatistics() can collect their numbers
+struct ThreadRegistry {
+  QMutex mutex;
+  QList<PDFPageProcessingThread *> threads;
+  // Accumulated statistics of threads that no longer exist
+  PDFPageProcessingThread::Statistics finished;
+};
+
+ThreadRegistry & threadRegistry()
+{
+  static ThreadRegistry registry;
+  return registry;
+}
+
+} // anonymous namespace
+
 // Backend Rendering
 // =================
 
+PDFPageProcessingThread::PDFPageProcessingThread()
+{
+  ThreadRegistry & registry = threadRegistry();
+  QMutexLocker locker(&registry.mutex);
+  registry.threads.append(this);
+}
+
 PDFPageProcessingThread::~PDFPageProcessingThread()
 {
   _mutex.lock();
@@ -46,9 +101,115 @@ PDFPageProcessingThread::~PDFPageProcessingThread()
   _waitCondition.wakeAll();
   _mutex.unlock();
   wait();
+
+  ThreadRegistry & registry = threadRegistry();
+  QMutexLocker locker(&registry.mutex);
+  registry.threads.removeOne(this);
+  Statistics stats = statistics();
+  // Nothing is waiting anymore
+  stats.queueDepth = 0;
+  registry.finished += stats;
+}
+
+PDFPageProcessingThread::Statistics PDFPageProcessingThread::statistics() const
+{
+  QMutexLocker locker(&_mutex);
+  Statistics stats = _statistics;
+  stats.queueDepth = static_cast<int>(_workStack.size());
+  return stats;
 }
 
-void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request)
+void PDFPageProcessingThread::resetStatistics()
+{
+  QMutexLocker locker(&_mutex);
+  _statistics = Statistics();
+  _statistics.maxQueueDepth = static_cast<int>(_workStack.size());
+}
+
+//static
+PDFPageProcessingThread::Statistics PDFPageProcessingThread::totalStatistics()
+{
+  ThreadRegistry & registry = threadRegistry();
+  QMutexLocker locker(&registry.mutex);
+  Statistics stats = registry.finished;
+  // maxQueueDepth of the combined statistics is the largest depth of any
+  // single thread; the total number of waiting requests is in queueDepth
+  const QList<PDFPageProcessingThread *> & threads = registry.threads;
+  for (const PDFPageProcessingThread * thread : threads)
+    stats += thread->statistics();
+  return stats;
+}
+
+//static
+void PDFPageProcessingThread::resetTotalStatistics()
+{
+  ThreadRegistry & registry = threadRegistry();
+  QMutexLocker locker(&registry.mutex);
+  registry.finished = Statistics();
+  const QList<PDFPageProcessingThread *> & threads = registry.threads;
+  for (PDFPageProcessingThread * thread : threads)
+    thread->resetStatistics();
+}
+
+//static
+qint64 PDFPageProcessingThread::Statistics::renderTimeBucketLimit(const int bucket)
+{
+  if (bucket < 0 || bucket >= renderTimeBucketCount() - 1)
+    return -1;
+  return qint64(1) << bucket;
+}
+
+void PDFPageProcessingThread::Statistics::addRenderTime(const qint64 usecs)
+{
+  ++renderCount;
+  renderTimeTotal += usecs;
+  renderTimeMax = qMax(renderTimeMax, usecs);
+  int bucket = 0;
+  while (bucket < renderTimeBucketCount() - 1 && usecs >= renderTimeBucketLimit(bucket) * 1000)
+    ++bucket;
+  ++renderTimeHistogram[bucket];
+}
+
+PDFPageProcessingThread::Statistics & PDFPageProcessingThread::Statistics::operator+=(const Statistics & other)
+{
+  enqueued += other.enqueued;
+  coalesced += other.coalesced;
+  processed += other.processed;
+  cancelled += other.cancelled;
+  queueDepth += other.queueDepth;
+  maxQueueDepth = qMax(maxQueueDepth, other.maxQueueDepth);
+  renderCount += other.renderCount;
+  renderTimeTotal += other.renderTimeTotal;
+  renderTimeMax = qMax(renderTimeMax, other.renderTimeMax);
+  for (int i = 0; i < renderTimeHistogram.size() && i < other.renderTimeHistogram.size(); ++i)
+    renderTimeHistogram[i] += other.renderTimeHistogram[i];
+  return *this;
+}
+
+QVariantMap PDFPageProcessingThread::Statistics::toVariantMap() const
+{
+  QVariantList histogram;
+  for (int i = 0; i < renderTimeHistogram.size(); ++i) {
+    histogram.append(QVariantMap{
+      {QStringLiteral("lessThanMsecs"), renderTimeBucketLimit(i)},
+      {QStringLiteral("count"), renderTimeHistogram[i]}
+    });
+  }
+  return {
+    {QStringLiteral("enqueued"), enqueued},
+    {QStringLiteral("coalesced"), coalesced},
+    {QStringLiteral("processed"), processed},
+    {QStringLiteral("cancelled"), cancelled},
+    {QStringLiteral("queueDepth"), queueDepth},
+    {QStringLiteral("maxQueueDepth"), maxQueueDepth},
+    {QStringLiteral("renderCount"), renderCount},
+    {QStringLiteral("renderTimeTotalMsecs"), static_cast<double>(renderTimeTotal) / 1000.},
+    {QStringLiteral("renderTimeMaxMsecs"), static_cast<double>(renderTimeMax) / 1000.},
+    {QStringLiteral("renderTimeHistogram"), histogram}
+  };
+}
+
+void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request, const Priority priority /* = NormalPriority */)
 {
 
   if (!request)
@@ -59,28 +220,52 @@ void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * r
   Q_ASSERT(request->thread() == QCoreApplication::instance()->thread());
 
   QMutexLocker locker(&(this->_mutex));
-  // Note: Commenting the "remove identical requests in the stack" code for now.
-  // This should be handled by the caching routine elsewhere automatically. If
-  // in doubt, it's better to render a tile twice than to not render it at all
-  // (thereby leaving the dummy image in the cache indefinitely)
-/*
-  // remove any instances of the given request type before adding the new one to
-  // avoid processing it several times
-  // **TODO:** Could it be that we require several concurrent versions of the
-  //           same page?
-  int i;
-  for (i = _workStack.size() - 1; i >= 0; --i) {
-    if (*(_workStack[i]) == *request) {
-      // Using deleteLater() doesn't work because we have no event queue in this
-      // thread. However, since the object is still on the stack, it is still
-      // sleeping and directly deleting it should therefore be safe.
-      delete _workStack[i];
-      _workStack.remove(i);
+
+  // Repeated paint events (e.g., while zooming or scrolling) tend to request
+  // the same tiles over and over. Instead of processing them several times,
+  // attach the listener to the request already in flight.
+  PageProcessingRequest * existing = _inFlight.value(request->key, nullptr);
+  if (existing && existing->type() == request->type()) {
+    PageProcessingRenderPageRequest * existingRender = dynamic_cast<PageProcessingRenderPageRequest*>(existing);
+    const PageProcessingRenderPageRequest * newRender = dynamic_cast<const PageProcessingRenderPageRequest*>(request);
+    const bool running = _currentRequests.contains(existing);
+    // A request that is already running without caching can't serve a
+    // caching one (that would leave the placeholder in the cache forever)
+    if (!running || !newRender || existingRender->cache || !newRender->cache) {
+      if (newRender && newRender->cache && !existingRender->cache)
+        existingRender->cache = true;
+      if (request->listener != existing->listener && !existing->additionalListeners.contains(request->listener))
+        existing->additionalListeners.append(request->listener);
+      if (!running && priority == NormalPriority) {
+        // The tile is wanted now, so give it top priority again
+        _workStack.removeOne(existing);
+        _workStack.push(existing);
+      }
+      ++_statistics.coalesced;
+      if (Trace::isEnabled())
+        Trace::instant("request", "coalesce", traceArgs(request) << Trace::Arg("type", QString::fromLatin1(traceName(request))));
+#ifdef DEBUG
+      qDebug() << "coalesced request:" << *request;
+#endif
+      // Nobody else has seen `request` yet, so it's safe to delete it directly
+      delete request;
+      return;
     }
   }
-*/
 
-  _workStack.push(request);
+  // The stack is processed from the top, so low-priority requests go to the
+  // bottom
+  if (priority == LowPriority)
+    _workStack.prepend(request);
+  else
+    _workStack.push(request);
+  _inFlight.insert(request->key, request);
+  ++_statistics.enqueued;
+  _statistics.maxQueueDepth = qMax(_statistics.maxQueueDepth, static_cast<int>(_workStack.size()));
+  if (Trace::isEnabled()) {
+    request->enqueued = Trace::now();
+    Trace::asyncBegin("request", traceName(request), traceId(request), traceArgs(request) << Trace::Arg("priority", (priority == LowPriority ? QStringLiteral("low") : QStringLiteral("normal"))));
+  }
 #ifdef DEBUG
   qDebug() << "new request:" << *request;
 #endif
@@ -94,20 +279,49 @@ void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * r
 
 void PDFPageProcessingThread::run()
 {
+  // Loading links for a page is fast compared to the overhead of looking at
+  // each page separately, so waiting link requests are processed together
+  const int maxLinkBatchSize = 32;
+
   _mutex.lock();
   _idle = false;
   while (!_quit) {
     // mutex must be locked at start of loop
     if (!_workStack.empty()) {
       PageProcessingRequest * workItem = _workStack.pop();
+      QList<PageProcessingRequest*> batch{workItem};
+      if (workItem->type() == PageProcessingRequest::LoadLinks) {
+        // Take further link requests in the order they would be processed
+        // anyway (i.e., from the top of the stack)
+        for (auto i = _workStack.size() - 1; i >= 0 && batch.size() < maxLinkBatchSize; --i) {
+          if (_workStack[i]->type() == PageProcessingRequest::LoadLinks) {
+            batch.append(_workStack[i]);
+            _workStack.remove(i);
+          }
+        }
+      }
+      _currentRequests = batch;
       _mutex.unlock();
 
 #ifdef DEBUG
       qDebug() << "processing work item" << *workItem << "; remaining items:" << _workStack.size();
+#endif
       QElapsedTimer timer;
       timer.start();
-#endif
-      workItem->execute();
+      if (batch.size() > 1) {
+        Trace::Scope traceScope("execute", "loadLinksBatch", (Trace::isEnabled() ? Trace::Args{{"pages", batch.size()}} : Trace::Args()));
+        QVector<Document::size_type> pages;
+        for (const PageProcessingRequest * request : batch)
+          pages.append(request->key.page_num);
+        Document * doc = workItem->page->document();
+        if (doc)
+          doc->loadLinksAndAnnotations(pages);
+      }
+      for (PageProcessingRequest * request : batch) {
+        Trace::Scope traceScope("execute", traceName(request), (Trace::isEnabled() ? traceArgs(request) : Trace::Args()));
+        request->execute();
+      }
+      const qint64 elapsed = timer.nsecsElapsed() / 1000;
 #ifdef DEBUG
       QString jobDesc;
       switch (workItem->type()) {
@@ -117,19 +331,68 @@ void PDFPageProcessingThread::run()
         case PageProcessingRequest::PageRendering:
           jobDesc = QString::fromUtf8("rendering page");
           break;
+        case PageProcessingRequest::ThumbnailRendering:
+          jobDesc = QString::fromUtf8("rendering thumbnail");
+          break;
       }
       qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << timer.elapsed() << " ms.";
 #endif
 
-      // Delete the work item as it has fulfilled its purpose
-      // Note that we can't delete it here or we might risk that some emitted
-      // signals are invalidated; to ensure they reach their destination, we
-      // need to call deleteLater().
-      // Note: workItem *must* live in the main (GUI) thread for this!
-      Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
-      workItem->deleteLater();
+      for (PageProcessingRequest * request : batch) {
+        // Once the request is no longer in flight, no more listeners can be
+        // attached to it
+        _mutex.lock();
+        if (_inFlight.value(request->key, nullptr) == request)
+          _inFlight.remove(request->key);
+        _currentRequests.removeOne(request);
+        ++_statistics.processed;
+        if (request->type() == PageProcessingRequest::PageRendering)
+          _statistics.addRenderTime(elapsed);
+        Trace::asyncEnd("request", traceName(request), traceId(request));
+        const QList<QObject *> listeners = QList<QObject *>() << request->listener << request->additionalListeners;
+        _mutex.unlock();
+        for (QObject * listener : listeners) {
+          // Requests that only fill caches (e.g., to preload data) have no
+          // listener
+          if (listener)
+            request->postResult(listener);
+        }
+
+        // Delete the work item as it has fulfilled its purpose
+        // Note that we can't delete it here or we might risk that some emitted
+        // signals are invalidated; to ensure they reach their destination, we
+        // need to call deleteLater().
+        // Note: request *must* live in the main (GUI) thread for this!
+        Q_ASSERT(request->thread() == QCoreApplication::instance()->thread());
+        request->deleteLater();
+      }
+
+      _mutex.lock();
+    }
+    else if (_idleTask) {
+      // Nothing else to do, so run (one step of) the idle task; requests that
+      // are added in the meantime are processed before the next step
+      const std::function<bool()> task = _idleTask;
+      const quint64 generation = _idleTaskGeneration;
+      // We are not working on any request, so clearWorkStack() doesn't need to
+      // wait for us
+      _idle = true;
+      _idleCondition.wakeAll();
+      _idleTaskRunning = true;
+      _mutex.unlock();
+
+      bool moreWork{false};
+      {
+        Trace::Scope traceScope("execute", "idleTask");
+        moreWork = task();
+      }
 
       _mutex.lock();
+      _idleTaskRunning = false;
+      _idle = false;
+      _idleTaskCondition.wakeAll();
+      if (!moreWork && generation == _idleTaskGeneration)
+        _idleTask = nullptr;
     }
     else {
 #ifdef DEBUG
@@ -147,6 +410,23 @@ void PDFPageProcessingThread::run()
   _mutex.unlock();
 }
 
+void PDFPageProcessingThread::setIdleTask(const std::function<bool()> & task)
+{
+  QMutexLocker locker(&_mutex);
+  _idleTask = task;
+  ++_idleTaskGeneration;
+  if (!task) {
+    while (_idleTaskRunning)
+      _idleTaskCondition.wait(&_mutex);
+    return;
+  }
+  locker.unlock();
+  if (!isRunning())
+    start();
+  else
+    _waitCondition.wakeOne();
+}
+
 void PDFPageProcessingThread::clearWorkStack()
 {
   _mutex.lock();
@@ -155,6 +435,18 @@ void PDFPageProcessingThread::clearWorkStack()
     if (!workItem)
       continue;
     Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
+    _inFlight.remove(workItem->key);
+    ++_statistics.cancelled;
+    if (Trace::isEnabled()) {
+      Trace::instant("request", "cancel", traceArgs(workItem) << Trace::Arg("type", QString::fromLatin1(traceName(workItem))));
+      Trace::asyncEnd("request", traceName(workItem), traceId(workItem), {{"cancelled", true}});
+    }
+    // getTileImage() put a placeholder into the cache that this request was
+    // supposed to replace; remove it so the tile gets requested again if it is
+    // needed later on
+    const PageProcessingRenderPageRequest * renderRequest = dynamic_cast<const PageProcessingRenderPageRequest*>(workItem);
+    if (renderRequest && renderRequest->cache)
+      Document::pageCache().removePlaceholder(workItem->key);
     workItem->deleteLater();
   }
   _workStack.clear();
@@ -177,6 +469,26 @@ void PDFPageProcessingThread::clearWorkStack()
 // `listener` will need a custom `event` function that is capable of picking up
 // on these events.
 
+PageProcessingRenderPageRequest::PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box /* = QRect() */, bool cache /* = false */) :
+  PageProcessingRequest(page, listener, PDFPageTile(xres, yres, render_box, page->document(), page->pageNum())),
+  xres(xres), yres(yres),
+  render_box(render_box),
+  cache(cache)
+{
+}
+
+PageProcessingLoadLinksRequest::PageProcessingLoadLinksRequest(Page *page, QObject *listener) :
+  // Use an impossible resolution so the key can't clash with any tile
+  PageProcessingRequest(page, listener, PDFPageTile(-1, -1, QRect(), page->document(), page->pageNum()))
+{
+}
+
+PageProcessingRenderThumbnailRequest::PageProcessingRenderThumbnailRequest(Page *page, QObject *listener) :
+  // Use a negative resolution so the key can't clash with any tile
+  PageProcessingRequest(page, listener, PDFPageTile(-PDFThumbnailCache::resolution(), -PDFThumbnailCache::resolution(), QRect(), page->document(), page->pageNum()))
+{
+}
+
 bool PageProcessingRequest::operator==(const PageProcessingRequest & r) const
 {
   // TODO: Should we care about the listener here as well?
@@ -213,18 +525,61 @@ bool PageProcessingRenderPageRequest::execute()
   // that returns a `bool` value indicating if the request is still valid? Then
   // the `PDFPageGraphicsItem` could have a function that indicates if the item
   // is anywhere near a viewport.
-  QImage rendered_page = page->renderToImage(xres, yres, render_box, cache);
-  QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page));
-
+  rendered_page = page->renderToImage(xres, yres, render_box, cache);
   return true;
 }
 
+void PageProcessingRenderPageRequest::postResult(QObject * receiver) const
+{
+  QCoreApplication::postEvent(receiver, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page, page->pageNum(), enqueued));
+}
+
+bool PageProcessingRenderThumbnailRequest::execute()
+{
+  Document * doc = page->document();
+  if (!doc)
+    return false;
+  PDFThumbnailCache & cache = Document::thumbnailCache();
+  // The key is known without touching the backend, so cache hits are cheap
+  // and don't block rendering
+  const quint64 contentKey = doc->loadedContentKey();
+  const QByteArray key = PDFThumbnailCache::key(contentKey, static_cast<int>(page->pageNum()));
+  if (contentKey != 0)
+    thumbnail = cache.image(key);
+  if (thumbnail.isNull()) {
+    thumbnail = page->renderToImage(PDFThumbnailCache::resolution(), PDFThumbnailCache::resolution());
+    // Without a key (e.g., if the file could not be read) we can't tell
+    // whether the thumbnail will still be valid later on
+    if (contentKey != 0)
+      cache.insert(key, thumbnail);
+  }
+  return !thumbnail.isNull();
+}
+
+void PageProcessingRenderThumbnailRequest::postResult(QObject * receiver) const
+{
+  QCoreApplication::postEvent(receiver, new PDFPageRenderedEvent(PDFThumbnailCache::resolution(), PDFThumbnailCache::resolution(), QRect(), thumbnail, page->pageNum(), enqueued));
+}
+
+#ifdef DEBUG
+PageProcessingRenderThumbnailRequest::operator QString() const
+{
+  return QString::fromUtf8("RT:%1").arg(page->pageNum());
+}
+#endif
+
 bool PageProcessingLoadLinksRequest::execute()
 {
-  QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(page->loadLinks()));
+  links = page->loadLinks();
+  annotations = page->loadAnnotations();
   return true;
 }
 
+void PageProcessingLoadLinksRequest::postResult(QObject * receiver) const
+{
+  QCoreApplication::postEvent(receiver, new PDFLinksLoadedEvent(links, annotations));
+}
+
 #ifdef DEBUG
 PageProcessingLoadLinksRequest::operator QString() const
 {
@@ -14,18 +14,26 @@
 #ifndef PDFPageProcessingThread_H
 #define PDFPageProcessingThread_H
 
+#include "PDFPageTile.h"
+
 #include <QEvent>
+#include <QHash>
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QRect>
 #include <QStack>
 #include <QThread>
+#include <QVariantMap>
+#include <QVector>
 #include <QWaitCondition>
 
+#include <functional>
+
 namespace QtPDF {
 
 namespace Annotation {
+class AbstractAnnotation;
 class Link;
 } // namespace Annotation
 
@@ -41,19 +49,32 @@ class PageProcessingRequest : public QObject
   // Protect c'tor and execute() so we can't access them except in derived
   // classes and friends
 protected:
-  PageProcessingRequest(Page *page, QObject *listener) : page(page), listener(listener) { }
-  // Should perform whatever processing it is designed to do
+  PageProcessingRequest(Page *page, QObject *listener, const PDFPageTile & key) : page(page), listener(listener), key(key) { }
+  // Should perform whatever processing it is designed to do and keep the
+  // result for postResult()
   // Returns true if finished successfully, false otherwise
   virtual bool execute() = 0;
+  // Posts the result of execute() to `receiver`; called once for `listener`
+  // and once for each of `additionalListeners`
+  virtual void postResult(QObject * receiver) const = 0;
+
+  // Listeners of identical requests that were coalesced into this one
+  // Protected by PDFPageProcessingThread::_mutex
+  QList<QObject *> additionalListeners;
+  // Trace::now() when the request was queued (or -1 if tracing was disabled)
+  qint64 enqueued{-1};
 
 public:
-  enum Type { PageRendering, LoadLinks };
+  enum Type { PageRendering, LoadLinks, ThumbnailRendering };
 
   ~PageProcessingRequest() override = default;
   virtual Type type() const = 0;
 
   Page *page;
   QObject *listener;
+  // Identifies requests that produce the same result (see
+  // PDFPageProcessingThread::addPageProcessingRequest())
+  const PDFPageTile key;
 
   virtual bool operator==(const PageProcessingRequest & r) const;
 #ifdef DEBUG
@@ -67,12 +88,7 @@ class PageProcessingRenderPageRequest : public PageProcessingRequest
   friend class PDFPageProcessingThread;
 
 public:
-  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false) :
-    PageProcessingRequest(page, listener),
-    xres(xres), yres(yres),
-    render_box(render_box),
-    cache(cache)
-  {}
+  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
   Type type() const override { return PageRendering; }
 
   bool operator==(const PageProcessingRequest & r) const override;
@@ -82,10 +98,35 @@ public:
 
 protected:
   bool execute() override;
+  void postResult(QObject * receiver) const override;
 
   double xres, yres;
   QRect render_box;
   bool cache;
+  QImage rendered_page;
+};
+
+
+// Renders a page at PDFThumbnailCache::resolution(), unless an up-to-date
+// thumbnail is available in Document::thumbnailCache() already
+class PageProcessingRenderThumbnailRequest : public PageProcessingRequest
+{
+  Q_OBJECT
+  friend class PDFPageProcessingThread;
+
+public:
+  PageProcessingRenderThumbnailRequest(Page *page, QObject *listener);
+  Type type() const override { return ThumbnailRendering; }
+
+#ifdef DEBUG
+  operator QString() const override;
+#endif
+
+protected:
+  bool execute() override;
+  void postResult(QObject * receiver) const override;
+
+  QImage thumbnail;
 };
 
 
@@ -93,11 +134,15 @@ class PDFPageRenderedEvent : public QEvent
 {
 
 public:
-  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, QImage rendered_page):
+  using size_type = QVector<Page*>::size_type;
+
+  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, QImage rendered_page, size_type page_num = -1, qint64 requested = -1):
     QEvent(PageRenderedEvent),
     xres(xres), yres(yres),
     render_rect(render_rect),
-    rendered_page(rendered_page)
+    rendered_page(rendered_page),
+    page_num(page_num),
+    requested(requested)
   {}
 
   static const QEvent::Type PageRenderedEvent;
@@ -105,17 +150,23 @@ public:
   const double xres, yres;
   const QRect render_rect;
   const QImage rendered_page;
+  const size_type page_num;
+  // Trace::now() when the image was requested (or -1 if tracing was disabled)
+  const qint64 requested;
 
 };
 
 
+// Loads the links and the annotations of a page. Requests that are waiting at
+// the same time are processed in one batch (see
+// Document::loadLinksAndAnnotations()).
 class PageProcessingLoadLinksRequest : public PageProcessingRequest
 {
   Q_OBJECT
   friend class PDFPageProcessingThread;
 
 public:
-  PageProcessingLoadLinksRequest(Page *page, QObject *listener) : PageProcessingRequest(page, listener) { }
+  PageProcessingLoadLinksRequest(Page *page, QObject *listener);
   Type type() const override { return LoadLinks; }
 
 #ifdef DEBUG
@@ -124,6 +175,10 @@ public:
 
 protected:
   bool execute() override;
+  void postResult(QObject * receiver) const override;
+
+  QList< QSharedPointer<Annotation::Link> > links;
+  QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations;
 };
 
 
@@ -131,14 +186,16 @@ class PDFLinksLoadedEvent : public QEvent
 {
 
 public:
-  PDFLinksLoadedEvent(const QList< QSharedPointer<Annotation::Link> > links):
+  PDFLinksLoadedEvent(const QList< QSharedPointer<Annotation::Link> > links, const QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations = {}):
     QEvent(LinksLoadedEvent),
-    links(links)
+    links(links),
+    annotations(annotations)
   {}
 
   static const QEvent::Type LinksLoadedEvent;
 
   const QList< QSharedPointer<Annotation::Link> > links;
+  const QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations;
 
 };
 
@@ -155,13 +212,54 @@ class PDFPageProcessingThread : public QThread
   Q_OBJECT
 
 public:
-  PDFPageProcessingThread() = default;
+  enum Priority {
+    // Processed before all requests that are already waiting
+    NormalPriority,
+    // Processed after all requests that are already waiting (e.g., for work
+    // that is not immediately visible to the user)
+    LowPriority
+  };
+
+  struct Statistics {
+    // Requests that were put on the work stack (i.e., not counting coalesced
+    // ones)
+    quint64 enqueued{0};
+    quint64 coalesced{0};
+    quint64 processed{0};
+    // Requests dropped by clearWorkStack()
+    quint64 cancelled{0};
+    // Requests currently waiting on the work stack
+    int queueDepth{0};
+    int maxQueueDepth{0};
+    // Time spent on page rendering requests (in microseconds)
+    quint64 renderCount{0};
+    qint64 renderTimeTotal{0};
+    qint64 renderTimeMax{0};
+    // renderTimeHistogram[i] counts page renderings that took less than
+    // renderTimeBucketLimit(i) ms (but not less than the previous limit); the
+    // last bucket counts all slower ones
+    QVector<quint64> renderTimeHistogram{QVector<quint64>(renderTimeBucketCount(), 0)};
+
+    static int renderTimeBucketCount() { return 12; }
+    // 1, 2, 4, ..., 1024 ms; -1 for the last bucket
+    static qint64 renderTimeBucketLimit(const int bucket);
+    void addRenderTime(const qint64 usecs);
+
+    Statistics & operator+=(const Statistics & other);
+    QVariantMap toVariantMap() const;
+  };
+
+  PDFPageProcessingThread();
   ~PDFPageProcessingThread() override;
 
   // add a processing request to the work stack
   // Note: request must have been created on the heap and must be in the scope
   // of this thread; use requestRenderPage() and requestLoadLinks() for that
-  void addPageProcessingRequest(PageProcessingRequest * request);
+  // If an identical request (same key) is already queued or being processed,
+  // `request` is merged into it (i.e., its listener is added to the existing
+  // request, which is moved to the top of the stack if it is still waiting and
+  // `priority` is NormalPriority) and deleted.
+  void addPageProcessingRequest(PageProcessingRequest * request, const Priority priority = NormalPriority);
 
   // drop all remaining processing requests
   // WARNING: This function *must not* be called while the calling thread holds
@@ -172,12 +270,40 @@ public:
   // finish. However, that lock is held by the caller of clearWorkStack().
   void clearWorkStack();
 
+  // `task` is run (in this thread) whenever there are no requests to process,
+  // until it returns `false`. It should do only a small amount of work per
+  // call so new requests don't have to wait long. An empty `task` removes the
+  // current one; in that case, this waits for a running call to return.
+  void setIdleTask(const std::function<bool()> & task);
+
+  // Number of requests that were merged into identical pending ones
+  quint64 coalescedRequestCount() const { QMutexLocker l(&_mutex); return _statistics.coalesced; }
+
+  Statistics statistics() const;
+  void resetStatistics();
+  // Combined statistics of all processing threads (including those that were
+  // destroyed already)
+  static Statistics totalStatistics();
+  static void resetTotalStatistics();
+
 protected:
   void run() override;
 
 private:
   QStack<PageProcessingRequest*> _workStack;
-  QMutex _mutex;
+  // All requests that are on the work stack or currently being processed
+  QHash<PDFPageTile, PageProcessingRequest*> _inFlight;
+  // Requests currently being processed (several if they were batched)
+  QList<PageProcessingRequest*> _currentRequests;
+  std::function<bool()> _idleTask;
+  // Incremented by setIdleTask() so run() doesn't remove a task that replaced
+  // the one that just finished
+  quint64 _idleTaskGeneration{0};
+  bool _idleTaskRunning{false};
+  QWaitCondition _idleTaskCondition;
+  // Protected by _mutex (queueDepth is only filled in by statistics())
+  Statistics _statistics;
+  mutable QMutex _mutex;
   QWaitCondition _waitCondition;
   bool _idle{true};
   QWaitCondition _idleCondition;
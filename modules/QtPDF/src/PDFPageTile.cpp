@@ -14,11 +14,15 @@
 
 #include "PDFPageTile.h"
 
+#include "PDFBackend.h"
+
 #include <QPair>
 #include <QByteArray>
 #include <QDataStream>
 #include <QIODevice>
 
+#include <cmath>
+
 #if QT_VERSION < QT_VERSION_CHECK(5, 3, 0)
 
 // Taken from Qt 4.7.2 sources (<Qt>/src/corelib/tools/qhash.cpp)
@@ -68,11 +72,45 @@ namespace QtPDF {
 
 namespace Backend {
 
+namespace {
+
+// 16 buckets per doubling of the resolution, i.e., neighboring buckets differ
+// by a factor of 2^(1/16) (~4.4%)
+const double kBucketsPerOctave = 16.;
+
+} // anonymous namespace
+
+PDFPageTile::PDFPageTile(double xres, double yres, QRect render_box, const Document * doc, size_type page_num):
+  xres(xres), yres(yres),
+  render_box(render_box),
+  doc_key(doc ? doc->cacheKey() : 0),
+  page_num(page_num)
+{
+}
+
 bool PDFPageTile::operator <(const PDFPageTile &other) const
 {
   return qHash(*this) < qHash(other);
 }
 
+//static
+double PDFPageTile::bucketResolution(const double resolution)
+{
+  // Negative resolutions are used for special requests (e.g., thumbnails)
+  if (resolution <= 0)
+    return resolution;
+  return std::exp2(std::round(std::log2(resolution) * kBucketsPerOctave) / kBucketsPerOctave);
+}
+
+PDFPageTile PDFPageTile::bucket() const
+{
+  PDFPageTile retVal(*this);
+  retVal.xres = bucketResolution(xres);
+  retVal.yres = bucketResolution(yres);
+  retVal.render_box = QRect();
+  return retVal;
+}
+
 #ifdef DEBUG
 PDFPageTile::operator QString() const
 {
@@ -85,7 +123,7 @@ decltype(::qHash(0)) qHash(const PDFPageTile &tile) noexcept
 {
   QByteArray ba;
   QDataStream strm{&ba, QIODevice::WriteOnly};
-  strm << tile.xres << tile.yres << tile.render_box << reinterpret_cast<quint64>(tile.doc) << tile.page_num;
+  strm << tile.xres << tile.yres << tile.render_box << tile.doc_key << tile.page_num;
   return ::qHash(ba);
 }
 
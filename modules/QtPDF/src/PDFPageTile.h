@@ -30,29 +30,40 @@ namespace Backend {
 class Document;
 class Page;
 
+// Identifies a rendered tile of a page. Tiles are not tied to a Document
+// instance but to its Document::cacheKey(), so documents loaded from identical
+// files share tiles (e.g., if the same pdf is shown in several windows).
 class PDFPageTile
 {
   using size_type = QVector<Page*>::size_type;
 public:
-  PDFPageTile(double xres, double yres, QRect render_box, const Document * doc, size_type page_num):
-    xres(xres), yres(yres),
-    render_box(render_box),
-    doc(doc),
-    page_num(page_num)
-  {}
+  // `doc` may be nullptr (e.g., for tiles that are not stored in the global
+  // PDFPageCache)
+  PDFPageTile(double xres, double yres, QRect render_box, const Document * doc, size_type page_num);
 
   double xres, yres;
   QRect render_box;
-  const Document * doc;
+  // Document::cacheKey() of the document (0 if there is none)
+  quint64 doc_key;
   size_type page_num;
 
   bool operator==(const PDFPageTile &other) const
   {
-    return (xres == other.xres && yres == other.yres && render_box == other.render_box && doc == other.doc && page_num == other.page_num);
+    return (xres == other.xres && yres == other.yres && render_box == other.render_box && doc_key == other.doc_key && page_num == other.page_num);
   }
 
   bool operator <(const PDFPageTile &other) const;
 
+  // Resolutions are grouped into buckets of about 4% width. Tiles of the same
+  // page in the same bucket look almost identical when scaled to each other's
+  // resolution, so they make good placeholders while the exact tile is
+  // rendered (e.g., if two views show a document at slightly different zoom
+  // levels).
+  static double bucketResolution(const double resolution);
+  // Returns a key that is shared by all tiles of the same page in the same
+  // resolution bucket (with an empty render_box)
+  PDFPageTile bucket() const;
+
 #ifdef DEBUG
   operator QString() const;
 #endif
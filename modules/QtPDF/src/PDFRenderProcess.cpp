@@ -0,0 +1,514 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "PDFRenderProcess.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QThread>
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+namespace QtPDF {
+
+namespace Backend {
+
+namespace RenderProtocol {
+
+bool readMessage(QIODevice & device, QByteArray & message)
+{
+  // Reads exactly `size` bytes, retrying on short reads (which can happen on
+  // pipes even in blocking mode)
+  auto readFully = [&device](char * data, qint64 size) {
+    while (size > 0) {
+      const qint64 n = device.read(data, size);
+      if (n <= 0)
+        return false;
+      data += n;
+      size -= n;
+    }
+    return true;
+  };
+
+  uchar header[sizeof(quint32)];
+  if (!readFully(reinterpret_cast<char *>(header), sizeof(header)))
+    return false;
+  const quint32 size = qFromBigEndian<quint32>(header);
+  if (size > static_cast<quint32>(std::numeric_limits<int>::max()))
+    return false;
+  message.resize(static_cast<int>(size));
+  return readFully(message.data(), message.size());
+}
+
+bool writeMessage(QIODevice & device, const QByteArray & message)
+{
+  uchar header[sizeof(quint32)];
+  qToBigEndian<quint32>(static_cast<quint32>(message.size()), header);
+  if (device.write(reinterpret_cast<const char *>(header), sizeof(header)) != static_cast<qint64>(sizeof(header)))
+    return false;
+  return device.write(message) == message.size();
+}
+
+} // namespace RenderProtocol
+
+
+struct RenderProcessPool::Job
+{
+  RenderProtocol::Command command;
+  // Serialized arguments of the command (see RenderProtocol::Command); for
+  // Command_Render, the shared memory key and size are appended by the worker
+  QByteArray arguments;
+
+  Result result{Result_Failed};
+  // Serialized reply (starting with the RenderProtocol::Status)
+  QByteArray reply;
+  // Only used for Command_Render
+  QImage image;
+};
+
+
+// Thread that owns one helper process and the shared memory segment used to
+// transfer its tiles
+class RenderProcessPool::Worker : public QThread
+{
+public:
+  Worker(RenderProcessPool * pool, const int id) : _pool(pool), _id(id) { }
+  ~Worker() override;
+
+  // Hands `job` to the worker thread and blocks until it has been processed
+  void process(Job & job);
+
+protected:
+  void run() override;
+
+private:
+  void execute(Job & job);
+  bool ensureProcess(const int timeout);
+  bool ensureBuffer(const qint64 size);
+  bool transact(const QByteArray & request, QByteArray & reply, const int timeout);
+  void stopProcess();
+
+  // Segments are never shrunk; a single 2048x2048 ARGB32 tile fits in the
+  // initial allocation
+  static constexpr qint64 MinBufferSize = 16 * 1024 * 1024;
+
+  RenderProcessPool * _pool;
+  const int _id;
+  int _bufferGeneration{0};
+
+  // Only accessed from within run()
+  std::unique_ptr<QProcess> _process;
+  std::unique_ptr<QSharedMemory> _buffer;
+
+  QMutex _mutex;
+  QWaitCondition _jobAvailable;
+  QWaitCondition _jobDone;
+  Job * _job{nullptr};
+  bool _quit{false};
+};
+
+constexpr qint64 RenderProcessPool::Worker::MinBufferSize;
+
+RenderProcessPool::Worker::~Worker()
+{
+  {
+    QMutexLocker l(&_mutex);
+    _quit = true;
+    _jobAvailable.wakeAll();
+  }
+  wait();
+}
+
+void RenderProcessPool::Worker::process(Job & job)
+{
+  QMutexLocker l(&_mutex);
+  if (!isRunning())
+    start();
+  _job = &job;
+  _jobAvailable.wakeAll();
+  while (_job)
+    _jobDone.wait(&_mutex);
+}
+
+void RenderProcessPool::Worker::run()
+{
+  QMutexLocker l(&_mutex);
+  while (!_quit) {
+    if (!_job) {
+      _jobAvailable.wait(&_mutex);
+      continue;
+    }
+    Job * job = _job;
+    l.unlock();
+    execute(*job);
+    l.relock();
+    _job = nullptr;
+    _jobDone.wakeAll();
+  }
+  l.unlock();
+  stopProcess();
+  _buffer.reset();
+}
+
+void RenderProcessPool::Worker::execute(Job & job)
+{
+  const int timeout = _pool->timeout();
+
+  job.result = Result_Failed;
+  if (!ensureProcess(timeout)) {
+    job.result = Result_Unavailable;
+    return;
+  }
+
+  // Rendering may need a second round trip if the shared memory segment turns
+  // out to be too small for the requested tile
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    QByteArray request;
+    {
+      QDataStream stream(&request, QIODevice::WriteOnly);
+      stream.setVersion(QDataStream::Qt_5_0);
+      stream << static_cast<quint8>(job.command);
+      stream.writeRawData(job.arguments.constData(), job.arguments.size());
+      if (job.command == RenderProtocol::Command_Render) {
+        if (!ensureBuffer(MinBufferSize))
+          return;
+        stream << _buffer->key() << static_cast<qint64>(_buffer->size());
+      }
+    }
+
+    if (!transact(request, job.reply, timeout)) {
+      job.result = Result_Crashed;
+      return;
+    }
+
+    QDataStream stream(job.reply);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 status{RenderProtocol::Status_Failed};
+    stream >> status;
+
+    if (status == RenderProtocol::Status_BufferTooSmall) {
+      qint64 requiredSize{0};
+      stream >> requiredSize;
+      if (!ensureBuffer(requiredSize))
+        return;
+      continue;
+    }
+    if (status != RenderProtocol::Status_Ok)
+      return;
+
+    if (job.command == RenderProtocol::Command_Render) {
+      qint32 width{0}, height{0}, bytesPerLine{0}, format{0};
+      stream >> width >> height >> bytesPerLine >> format;
+      if (stream.status() != QDataStream::Ok || width < 0 || height < 0 || bytesPerLine < 0)
+        return;
+      if (format <= QImage::Format_Invalid || format >= QImage::NImageFormats)
+        return;
+      if (static_cast<qint64>(bytesPerLine) * height > static_cast<qint64>(_buffer->size()))
+        return;
+
+      QImage image(width, height, static_cast<QImage::Format>(format));
+      if (image.isNull() && width > 0 && height > 0)
+        return;
+      const int lineSize = qMin(bytesPerLine, static_cast<qint32>(image.bytesPerLine()));
+      _buffer->lock();
+      const char * src = static_cast<const char *>(_buffer->constData());
+      for (int y = 0; y < height; ++y)
+        std::memcpy(image.scanLine(y), src + static_cast<qint64>(y) * bytesPerLine, static_cast<size_t>(lineSize));
+      _buffer->unlock();
+      job.image = image;
+    }
+    job.result = Result_Success;
+    return;
+  }
+}
+
+bool RenderProcessPool::Worker::ensureProcess(const int timeout)
+{
+  if (_process && _process->state() == QProcess::Running)
+    return true;
+  stopProcess();
+
+  const QString program = _pool->helperProgram();
+  if (!QFileInfo(program).isExecutable())
+    return false;
+
+  _process.reset(new QProcess);
+  // Forward the helper's diagnostics (e.g., from the backend library) to our
+  // stderr so they are not lost
+  _process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+  _process->start(program, QStringList());
+  if (!_process->waitForStarted(timeout)) {
+    qWarning() << "Could not start render helper" << program << ":" << _process->errorString();
+    stopProcess();
+    return false;
+  }
+  return true;
+}
+
+bool RenderProcessPool::Worker::ensureBuffer(const qint64 size)
+{
+  if (_buffer && _buffer->size() >= size)
+    return true;
+  _buffer.reset();
+
+  if (size > std::numeric_limits<int>::max())
+    return false;
+
+  // Use a fresh key for every segment so a helper that is still attached to
+  // an old one never writes into memory we no longer read from
+  _buffer.reset(new QSharedMemory(QStringLiteral("QtPDF-render-%1-%2-%3").arg(QCoreApplication::applicationPid()).arg(_id).arg(++_bufferGeneration)));
+  if (!_buffer->create(static_cast<int>(qMax(size, MinBufferSize)))) {
+    qWarning() << "Could not create shared memory for render helper:" << _buffer->errorString();
+    _buffer.reset();
+    return false;
+  }
+  return true;
+}
+
+bool RenderProcessPool::Worker::transact(const QByteArray & request, QByteArray & reply, const int timeout)
+{
+  Q_ASSERT(_process);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!RenderProtocol::writeMessage(*_process, request)) {
+    stopProcess();
+    return false;
+  }
+
+  QByteArray buffer;
+  while (true) {
+    buffer += _process->readAll();
+    if (buffer.size() >= static_cast<int>(sizeof(quint32))) {
+      const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer.constData()));
+      if (static_cast<quint64>(buffer.size()) >= sizeof(quint32) + size) {
+        reply = buffer.mid(static_cast<int>(sizeof(quint32)), static_cast<int>(size));
+        return true;
+      }
+    }
+    const qint64 remaining = timeout - timer.elapsed();
+    // waitForReadyRead() also returns false if the helper died
+    if (remaining <= 0 || !_process->waitForReadyRead(static_cast<int>(remaining))) {
+      if (_process->state() == QProcess::Running)
+        qWarning() << "Render helper timed out after" << timer.elapsed() << "ms; restarting it";
+      else
+        qWarning() << "Render helper terminated unexpectedly; restarting it";
+      stopProcess();
+      return false;
+    }
+  }
+}
+
+void RenderProcessPool::Worker::stopProcess()
+{
+  if (!_process)
+    return;
+  if (_process->state() != QProcess::NotRunning) {
+    // Closing stdin makes a healthy helper exit on its own; a hung one is
+    // killed
+    _process->closeWriteChannel();
+    if (!_process->waitForFinished(1000)) {
+      _process->kill();
+      _process->waitForFinished(1000);
+    }
+  }
+  _process.reset();
+}
+
+
+RenderProcessPool & RenderProcessPool::instance()
+{
+  static RenderProcessPool pool;
+  return pool;
+}
+
+RenderProcessPool::RenderProcessPool()
+{
+  // The static instance is destroyed only after the application object, so
+  // stop the worker threads and helper processes before that
+  if (QCoreApplication::instance())
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, [this]() { shutdown(); });
+}
+
+RenderProcessPool::~RenderProcessPool()
+{
+  QMutexLocker l(&_mutex);
+  _idleWorkers.clear();
+  _workers.clear();
+}
+
+int RenderProcessPool::processCount() const
+{
+  QMutexLocker l(&_mutex);
+  return _processCount;
+}
+
+void RenderProcessPool::setProcessCount(const int count)
+{
+  std::vector< std::unique_ptr<Worker> > surplus;
+  {
+    QMutexLocker l(&_mutex);
+    _processCount = qMax(0, count);
+    // Busy workers are shut down in releaseWorker()
+    while (static_cast<int>(_workers.size()) > _processCount && !_idleWorkers.isEmpty()) {
+      Worker * worker = _idleWorkers.takeLast();
+      for (auto it = _workers.begin(); it != _workers.end(); ++it) {
+        if (it->get() == worker) {
+          surplus.push_back(std::move(*it));
+          _workers.erase(it);
+          break;
+        }
+      }
+    }
+    _workerAvailable.wakeAll();
+  }
+  // Stop the surplus helpers without holding the mutex
+  surplus.clear();
+}
+
+int RenderProcessPool::timeout() const
+{
+  QMutexLocker l(&_mutex);
+  return _timeout;
+}
+
+void RenderProcessPool::setTimeout(const int msecs)
+{
+  QMutexLocker l(&_mutex);
+  _timeout = msecs;
+}
+
+QString RenderProcessPool::helperProgram() const
+{
+  {
+    QMutexLocker l(&_mutex);
+    if (!_helperProgram.isEmpty())
+      return _helperProgram;
+  }
+#if defined(Q_OS_WIN)
+  return QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("qtpdf-render-helper.exe"));
+#else
+  return QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("qtpdf-render-helper"));
+#endif
+}
+
+void RenderProcessPool::setHelperProgram(const QString & program)
+{
+  QMutexLocker l(&_mutex);
+  _helperProgram = program;
+}
+
+QImage RenderProcessPool::renderToImage(const QString & backend, const QString & fileName, const quint64 contentKey, const int page, const double xres, const double yres, const QRect & render_box, const QColor & paperColor, Result * result)
+{
+  Job job;
+  job.command = RenderProtocol::Command_Render;
+  {
+    QDataStream stream(&job.arguments, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << backend << fileName << contentKey << static_cast<qint32>(page) << xres << yres << render_box << paperColor;
+  }
+  process(job);
+  if (result)
+    *result = job.result;
+  return job.image;
+}
+
+QList<SearchResult> RenderProcessPool::search(const QString & backend, const QString & fileName, const quint64 contentKey, const int page, const QString & searchText, const SearchFlags & flags, Result * result)
+{
+  QList<SearchResult> results;
+
+  Job job;
+  job.command = RenderProtocol::Command_Search;
+  {
+    QDataStream stream(&job.arguments, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << backend << fileName << contentKey << static_cast<qint32>(page) << searchText << static_cast<qint32>(flags);
+  }
+  process(job);
+
+  if (job.result == Result_Success) {
+    QDataStream stream(job.reply);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 status{RenderProtocol::Status_Failed};
+    QList<QRectF> boxes;
+    stream >> status >> boxes;
+    if (stream.status() != QDataStream::Ok)
+      job.result = Result_Failed;
+    else {
+      for (const QRectF & box : boxes)
+        results << SearchResult{page, box};
+    }
+  }
+  if (result)
+    *result = job.result;
+  return results;
+}
+
+void RenderProcessPool::process(Job & job)
+{
+  Worker * worker = acquireWorker();
+  if (!worker) {
+    job.result = Result_Unavailable;
+    return;
+  }
+  worker->process(job);
+  releaseWorker(worker);
+}
+
+RenderProcessPool::Worker * RenderProcessPool::acquireWorker()
+{
+  QMutexLocker l(&_mutex);
+  while (_idleWorkers.isEmpty()) {
+    if (_processCount <= 0)
+      return nullptr;
+    if (static_cast<int>(_workers.size()) < _processCount) {
+      _workers.push_back(std::unique_ptr<Worker>(new Worker(this, _nextWorkerId++)));
+      return _workers.back().get();
+    }
+    _workerAvailable.wait(&_mutex);
+  }
+  return _idleWorkers.takeLast();
+}
+
+void RenderProcessPool::releaseWorker(Worker * worker)
+{
+  std::unique_ptr<Worker> surplus;
+  {
+    QMutexLocker l(&_mutex);
+    if (static_cast<int>(_workers.size()) > _processCount) {
+      for (auto it = _workers.begin(); it != _workers.end(); ++it) {
+        if (it->get() == worker) {
+          surplus = std::move(*it);
+          _workers.erase(it);
+          break;
+        }
+      }
+    }
+    else
+      _idleWorkers.append(worker);
+    _workerAvailable.wakeOne();
+  }
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFRenderProcess_H
+#define PDFRenderProcess_H
+
+#include "PDFBackend.h"
+
+#include <QColor>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QRect>
+#include <QString>
+#include <QWaitCondition>
+
+#include <memory>
+#include <vector>
+
+class QIODevice;
+
+namespace QtPDF {
+
+namespace Backend {
+
+// Wire format shared by RenderProcessPool and the `qtpdf-render-helper`
+// program. Every message is a big-endian quint32 length followed by that many
+// bytes of QDataStream (version Qt_5_0) data. Requests start with a Command,
+// replies with a Status. `contentKey` is the Document::loadedContentKey() of
+// the requesting document; the helper fails requests if its own copy of the
+// file differs (e.g., because the file changed in the meantime). Rendered
+// pixels are not sent through the pipe but written to a shared memory segment
+// owned by the requesting process.
+namespace RenderProtocol {
+
+enum Command : quint8 {
+  // QString backend, QString fileName, quint64 contentKey, qint32 page,
+  // double xres, double yres, QRect renderBox, QColor paperColor,
+  // QString sharedMemoryKey, qint64 sharedMemorySize
+  // -> qint32 width, qint32 height, qint32 bytesPerLine, qint32 format
+  //    (Status_Ok) or qint64 requiredSize (Status_BufferTooSmall)
+  Command_Render = 1,
+  // QString backend, QString fileName, quint64 contentKey, qint32 page,
+  // QString searchText, qint32 searchFlags
+  // -> QList<QRectF> boundingBoxes
+  Command_Search = 2
+};
+
+enum Status : quint8 {
+  Status_Ok = 0,
+  Status_Failed = 1,
+  Status_BufferTooSmall = 2
+};
+
+// Blocking helpers for use on plain pipes (e.g., stdin/stdout of the helper)
+bool readMessage(QIODevice & device, QByteArray & message);
+bool writeMessage(QIODevice & device, const QByteArray & message);
+
+} // namespace RenderProtocol
+
+// Dispatches rendering and text search requests to a pool of helper processes
+// so that a malformed or malicious PDF can crash or hang one of them without
+// taking down the application. The pool is disabled (processCount() == 0) by
+// default, in which case backends render in-process as usual.
+//
+// Each helper process is driven by a dedicated thread (so the QProcess never
+// changes threads) and owns one shared memory segment for transferring tiles.
+// Helpers that crash or exceed timeout() are killed and transparently
+// respawned on the next request. All public methods are thread-safe; requests
+// from different threads are processed in parallel by different helpers.
+class RenderProcessPool
+{
+public:
+  enum Result {
+    // The request was carried out by a helper
+    Result_Success,
+    // No helper could be started (e.g., the program is missing); callers
+    // should fall back to in-process processing
+    Result_Unavailable,
+    // The helper could not process the request (e.g., because the file
+    // changed since the caller loaded it); callers should fall back to
+    // in-process processing
+    Result_Failed,
+    // The helper crashed or timed out; callers must not retry rendering
+    // in-process as that is what the helper protects against. As the request
+    // may just have been slow, the (empty) result must not be cached
+    Result_Crashed
+  };
+
+  static RenderProcessPool & instance();
+
+  ~RenderProcessPool();
+
+  int processCount() const;
+  // Sets the maximum number of helper processes; 0 disables out-of-process
+  // rendering. Surplus helpers are shut down once they become idle.
+  void setProcessCount(const int count);
+  bool isEnabled() const { return processCount() > 0; }
+
+  // Time (in milliseconds) a helper may take to answer a single request
+  int timeout() const;
+  void setTimeout(const int msecs);
+
+  // Defaults to `qtpdf-render-helper` next to the application executable
+  QString helperProgram() const;
+  void setHelperProgram(const QString & program);
+
+  // Stops all helpers and disables the pool; called automatically when the
+  // application is about to quit (as the threads and processes must not
+  // outlive it)
+  void shutdown() { setProcessCount(0); }
+
+  // Blocks the calling thread until the request has been processed
+  QImage renderToImage(const QString & backend, const QString & fileName, const quint64 contentKey, const int page, const double xres, const double yres, const QRect & render_box, const QColor & paperColor, Result * result = nullptr);
+  QList<SearchResult> search(const QString & backend, const QString & fileName, const quint64 contentKey, const int page, const QString & searchText, const SearchFlags & flags, Result * result = nullptr);
+
+private:
+  class Worker;
+  struct Job;
+
+  RenderProcessPool();
+
+  void process(Job & job);
+  Worker * acquireWorker();
+  void releaseWorker(Worker * worker);
+
+  mutable QMutex _mutex;
+  QWaitCondition _workerAvailable;
+  std::vector< std::unique_ptr<Worker> > _workers;
+  QList<Worker *> _idleWorkers;
+  int _processCount{0};
+  int _timeout{30000};
+  QString _helperProgram;
+  int _nextWorkerId{0};
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFRenderProcess_H)
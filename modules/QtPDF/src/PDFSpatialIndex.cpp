@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "PDFSpatialIndex.h"
+
+#include <cmath>
+#include <numeric>
+
+namespace QtPDF {
+
+void PDFSpatialIndex::clear()
+{
+  _bounds = QRectF();
+  _columns = 0;
+  _rows = 0;
+  _rects.clear();
+  _cellOffsets.clear();
+  _cellItems.clear();
+}
+
+void PDFSpatialIndex::build(const QRectF & bounds, const QVector<QRectF> & rects)
+{
+  clear();
+
+  _bounds = bounds.normalized();
+  _rects.reserve(rects.size());
+  for (const QRectF & r : rects) {
+    _rects.append(r.normalized());
+    // Make sure all rectangles are inside the grid
+    _bounds = _bounds.united(_rects.last());
+  }
+  if (_rects.isEmpty() || _bounds.isEmpty())
+    return;
+
+  // Aim for roughly one rectangle per cell (assuming an even distribution)
+  const int gridSize = qBound(1, static_cast<int>(std::sqrt(static_cast<double>(_rects.size()))), MaxGridSize);
+  _columns = gridSize;
+  _rows = gridSize;
+
+  // First pass: count the rectangles per cell
+  _cellOffsets.fill(0, _columns * _rows + 1);
+  for (const QRectF & r : _rects) {
+    for (int j = row(r.top()); j <= row(r.bottom()); ++j) {
+      for (int i = column(r.left()); i <= column(r.right()); ++i)
+        ++_cellOffsets[j * _columns + i + 1];
+    }
+  }
+  std::partial_sum(_cellOffsets.begin(), _cellOffsets.end(), _cellOffsets.begin());
+
+  // Second pass: fill in the indices
+  _cellItems.resize(_cellOffsets.last());
+  QVector<int> fill{_cellOffsets};
+  for (int idx = 0; idx < _rects.size(); ++idx) {
+    const QRectF & r = _rects[idx];
+    for (int j = row(r.top()); j <= row(r.bottom()); ++j) {
+      for (int i = column(r.left()); i <= column(r.right()); ++i)
+        _cellItems[fill[j * _columns + i]++] = idx;
+    }
+  }
+}
+
+int PDFSpatialIndex::column(const qreal x) const
+{
+  return qBound(0, static_cast<int>((x - _bounds.left()) * _columns / _bounds.width()), _columns - 1);
+}
+
+int PDFSpatialIndex::row(const qreal y) const
+{
+  return qBound(0, static_cast<int>((y - _bounds.top()) * _rows / _bounds.height()), _rows - 1);
+}
+
+QVector<int> PDFSpatialIndex::itemsAt(const QPointF & pt) const
+{
+  QVector<int> retVal;
+  if (_columns == 0 || _rows == 0 || !_bounds.contains(pt))
+    return retVal;
+
+  const int cell = row(pt.y()) * _columns + column(pt.x());
+  // Indices were added in increasing order, so walk backwards to get the
+  // topmost rectangle first
+  for (int k = _cellOffsets[cell + 1] - 1; k >= _cellOffsets[cell]; --k) {
+    const int idx = _cellItems[k];
+    if (_rects[idx].contains(pt))
+      retVal.append(idx);
+  }
+  return retVal;
+}
+
+} // namespace QtPDF
@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFSpatialIndex_H
+#define PDFSpatialIndex_H
+
+#include <QRectF>
+#include <QVector>
+
+namespace QtPDF {
+
+// Compact index for fast point lookups among many (typically small)
+// rectangles, e.g., the link areas on a page. The rectangles are distributed
+// over a uniform grid; each cell stores the indices of the rectangles
+// overlapping it (all cells share one flat array).
+class PDFSpatialIndex
+{
+public:
+  void build(const QRectF & bounds, const QVector<QRectF> & rects);
+  void clear();
+
+  bool isEmpty() const { return _rects.isEmpty(); }
+  int count() const { return static_cast<int>(_rects.size()); }
+  QRectF rect(const int idx) const { return _rects.value(idx); }
+
+  // Returns the indices of all rectangles containing `pt`, the most recently
+  // added one (i.e., the topmost one) first
+  QVector<int> itemsAt(const QPointF & pt) const;
+
+private:
+  static constexpr int MaxGridSize = 64;
+
+  int column(const qreal x) const;
+  int row(const qreal y) const;
+
+  QRectF _bounds;
+  int _columns{0};
+  int _rows{0};
+  QVector<QRectF> _rects;
+  // _cellItems[_cellOffsets[i]] ... _cellItems[_cellOffsets[i + 1] - 1] are the
+  // rectangles overlapping cell i
+  QVector<int> _cellOffsets;
+  QVector<int> _cellItems;
+};
+
+} // namespace QtPDF
+
+#endif // !defined(PDFSpatialIndex_H)
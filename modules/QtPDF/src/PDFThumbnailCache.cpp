@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFThumbnailCache.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace QtPDF {
+
+namespace Backend {
+
+//static
+QByteArray PDFThumbnailCache::key(const quint64 contentKey, const int page)
+{
+  // The key doubles as file name in the disk cache
+  return QByteArray::number(contentKey, 16) + '-' + QByteArray::number(page) + '-' + QByteArray::number(resolution());
+}
+
+QImage PDFThumbnailCache::image(const QByteArray & key)
+{
+  QMutexLocker locker(&_lock);
+  const QImage * img = _cache.object(key);
+  if (img)
+    return *img;
+
+  const QString path = diskFile(key);
+  if (path.isEmpty())
+    return {};
+  // Don't block other threads while reading from disk
+  locker.unlock();
+  QImage retVal;
+  if (!QFileInfo::exists(path) || !retVal.load(path, "PNG"))
+    return {};
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  // Mark the file as recently used (see pruneDirectory())
+  QFile file(path);
+  if (file.open(QIODevice::ReadWrite))
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+#endif
+  locker.relock();
+  insertInMemory(key, retVal);
+  return retVal;
+}
+
+void PDFThumbnailCache::insert(const QByteArray & key, const QImage & image)
+{
+  if (image.isNull())
+    return;
+  QMutexLocker locker(&_lock);
+  insertInMemory(key, image);
+  const QString path = diskFile(key);
+  locker.unlock();
+
+  if (path.isEmpty())
+    return;
+  // Write to a temporary file first so that concurrent readers (e.g., another
+  // instance of the application) never see partial files
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG"))
+    return;
+  const qint64 fileSize = file.size();
+  if (!file.commit())
+    return;
+
+  locker.relock();
+  _diskSize += fileSize;
+  maybePruneDisk();
+}
+
+void PDFThumbnailCache::clear()
+{
+  QMutexLocker locker(&_lock);
+  _cache.clear();
+}
+
+void PDFThumbnailCache::setCacheDirectory(const QString & dir)
+{
+  if (!dir.isEmpty())
+    QDir().mkpath(dir);
+  QMutexLocker locker(&_lock);
+  _cacheDirectory = dir;
+  // Get the current size of the cache (and trim it if necessary, e.g., if it
+  // was written by a version with a larger limit)
+  _diskSize = (dir.isEmpty() ? 0 : pruneDirectory(dir, _maxDiskSize));
+}
+
+void PDFThumbnailCache::setMaxDiskSize(const qint64 size)
+{
+  QMutexLocker locker(&_lock);
+  _maxDiskSize = size;
+  maybePruneDisk();
+}
+
+QString PDFThumbnailCache::diskFile(const QByteArray & key) const
+{
+  // The caller must hold _lock
+  if (_cacheDirectory.isEmpty())
+    return {};
+  return QDir(_cacheDirectory).filePath(QString::fromLatin1(key) + QStringLiteral(".png"));
+}
+
+void PDFThumbnailCache::maybePruneDisk()
+{
+  // The caller must hold _lock
+  if (_cacheDirectory.isEmpty() || _diskSize <= _maxDiskSize)
+    return;
+  _diskSize = pruneDirectory(_cacheDirectory, _maxDiskSize / 4 * 3);
+}
+
+//static
+qint64 PDFThumbnailCache::pruneDirectory(const QString & dir, const qint64 maxSize)
+{
+  // Most recently used files first
+  const QFileInfoList files = QDir(dir).entryInfoList(QStringList(QStringLiteral("*.png")), QDir::Files, QDir::Time);
+  qint64 size{0};
+  bool full{false};
+  for (const QFileInfo & fi : files) {
+    full = full || (size + fi.size() > maxSize);
+    if (full)
+      QFile::remove(fi.absoluteFilePath());
+    else
+      size += fi.size();
+  }
+  return size;
+}
+
+void PDFThumbnailCache::insertInMemory(const QByteArray & key, const QImage & image)
+{
+  // The caller must hold _lock
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+  _cache.insert(key, new QImage(image), image.byteCount());
+#elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  // Thumbnails are tiny, so the size always fits into an int
+  _cache.insert(key, new QImage(image), static_cast<int>(image.sizeInBytes()));
+#else
+  _cache.insert(key, new QImage(image), image.sizeInBytes());
+#endif
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
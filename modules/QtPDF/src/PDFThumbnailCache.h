@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFThumbnailCache_H
+#define PDFThumbnailCache_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+namespace QtPDF {
+
+namespace Backend {
+
+// Small, separate cache for page thumbnails. Unlike PDFPageCache, entries are
+// not tied to a Document instance but to the file's Document::contentKey() and
+// the page number. Thumbnails thus survive reloading (or reopening) a document
+// as long as the file did not change. Optionally, thumbnails are also
+// stored on disk (see setCacheDirectory()); the least recently used files are
+// removed when the disk cache grows beyond maxDiskSize().
+//
+// This class is thread-safe
+class PDFThumbnailCache
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  using size_type = int;
+#else
+  using size_type = qsizetype;
+#endif
+public:
+  // Resolution (in dpi) at which thumbnails are rendered; e.g., an A4 page
+  // results in a 99x140 pixel image
+  static double resolution() { return 12.; }
+
+  // Returns a key for the given page of the file with the given
+  // Document::contentKey(); any change to the file invalidates all its
+  // thumbnails
+  static QByteArray key(const quint64 contentKey, const int page);
+
+  // Returns a null image if there is no thumbnail for `key`
+  QImage image(const QByteArray & key);
+  void insert(const QByteArray & key, const QImage & image);
+  void clear();
+
+  size_type maxCost() const { QMutexLocker locker(&_lock); return _cache.maxCost(); }
+  void setMaxCost(const size_type cost) { QMutexLocker locker(&_lock); _cache.setMaxCost(cost); }
+
+  // Directory in which thumbnails are stored as PNG files; empty (the default)
+  // disables the disk cache
+  QString cacheDirectory() const { QMutexLocker locker(&_lock); return _cacheDirectory; }
+  void setCacheDirectory(const QString & dir);
+
+  // Maximum size (in bytes) of all thumbnails in the cache directory
+  qint64 maxDiskSize() const { QMutexLocker locker(&_lock); return _maxDiskSize; }
+  void setMaxDiskSize(const qint64 size);
+
+private:
+  QString diskFile(const QByteArray & key) const;
+  void insertInMemory(const QByteArray & key, const QImage & image);
+  // Removes the least recently used files from `dir` until their total size is
+  // at most `maxSize`; returns the remaining total size. Does not use _lock.
+  static qint64 pruneDirectory(const QString & dir, const qint64 maxSize);
+  // Prunes the disk cache (down to 3/4 of its maximum size, so this doesn't
+  // have to happen for every insertion) if it is too large
+  void maybePruneDisk();
+
+  mutable QMutex _lock;
+  // 32 MB hold ~600 thumbnails of A4 pages
+  QCache<QByteArray, QImage> _cache{32 * 1024 * 1024};
+  QString _cacheDirectory;
+  // Thumbnails are typically a few kB, so this holds >10000 of them
+  qint64 _maxDiskSize{64 * 1024 * 1024};
+  // Current (approximate) size of the disk cache
+  qint64 _diskSize{0};
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFThumbnailCache_H)
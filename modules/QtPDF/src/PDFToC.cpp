@@ -24,6 +24,7 @@ PDFToCItem::PDFToCItem(const PDFToCItem & o)
   , _action(std::unique_ptr<PDFAction>(o._action ? o._action->clone() : nullptr))
   , _color(o._color)
   , _children(o._children)
+  , _hasChildren(o._hasChildren)
   , _flags(o._flags)
 {
 }
@@ -37,6 +38,7 @@ PDFToCItem & PDFToCItem::operator=(const PDFToCItem & o)
   _isOpen = o._isOpen;
   _color = o._color;
   _children = o._children;
+  _hasChildren = o._hasChildren;
   _flags = o._flags;
   setAction(std::unique_ptr<PDFAction>(o._action != nullptr ? o._action->clone() : nullptr));
   return *this;
@@ -48,7 +50,7 @@ void PDFToCItem::setAction(std::unique_ptr<PDFAction> action)
 }
 
 bool PDFToCItem::operator==(const PDFToCItem & o) const {
-  if (_label != o._label || _isOpen != o._isOpen || _color != o._color || _flags != o._flags) {
+  if (_label != o._label || _isOpen != o._isOpen || _color != o._color || _flags != o._flags || hasChildren() != o.hasChildren()) {
     return false;
   }
   if (_action != nullptr && o._action != nullptr) {
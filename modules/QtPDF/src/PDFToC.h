@@ -41,6 +41,9 @@ public:
   QColor color() const { return _color; }
   const QList<PDFToCItem> & children() const { return _children; }
   QList<PDFToCItem> & children() { return _children; }
+  // Items obtained through Document::tocChildren() don't have their children
+  // populated, but still report whether there are any
+  bool hasChildren() const { return _hasChildren || !_children.isEmpty(); }
   PDFToCItemFlags flags() const { return _flags; }
   PDFToCItemFlags & flags() { return _flags; }
 
@@ -48,6 +51,7 @@ public:
   void setOpen(const bool isOpen = true) { _isOpen = isOpen; }
   void setAction(std::unique_ptr<PDFAction> action);
   void setColor(const QColor color) { _color = color; }
+  void setHasChildren(const bool hasChildren = true) { _hasChildren = hasChildren; }
 
   bool operator==(const PDFToCItem & o) const;
 
@@ -57,6 +61,7 @@ protected:
   std::unique_ptr<PDFAction> _action; // if the `Dest` member of the outline item dictionary is set, it must be converted to a PDFGotoAction
   QColor _color;
   QList<PDFToCItem> _children;
+  bool _hasChildren{false};
   PDFToCItemFlags _flags;
 };
 
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "PDFToCModel.h"
+
+#include "PDFBackend.h"
+
+#include <QFont>
+
+#include <vector>
+
+namespace QtPDF {
+
+struct PDFToCModel::Node
+{
+  Node * parent{nullptr};
+  int row{0};
+  Backend::PDFToCItem item;
+  bool fetched{false};
+  std::vector< std::unique_ptr<Node> > children;
+};
+
+PDFToCModel::PDFToCModel(QObject * parent /* = nullptr */)
+  : QAbstractItemModel(parent)
+  , _root(new Node)
+{
+}
+
+PDFToCModel::~PDFToCModel() = default;
+
+void PDFToCModel::setDocument(const QWeakPointer<Backend::Document> & doc)
+{
+  beginResetModel();
+  _doc = doc;
+  _root.reset(new Node);
+  _root->item.setHasChildren(!_doc.isNull());
+  endResetModel();
+}
+
+PDFToCModel::Node * PDFToCModel::nodeFromIndex(const QModelIndex & index) const
+{
+  if (!index.isValid())
+    return _root.get();
+  return static_cast<Node*>(index.internalPointer());
+}
+
+// static
+QVector<int> PDFToCModel::pathFromNode(const Node * node)
+{
+  QVector<int> retVal;
+  for (; node && node->parent; node = node->parent)
+    retVal.prepend(node->row);
+  return retVal;
+}
+
+std::unique_ptr<PDFAction> PDFToCModel::action(const QModelIndex & index) const
+{
+  const QSharedPointer<Backend::Document> doc{_doc.toStrongRef()};
+  if (!doc || !index.isValid())
+    return {};
+  return doc->tocAction(pathFromNode(nodeFromIndex(index)));
+}
+
+QModelIndex PDFToCModel::index(int row, int column, const QModelIndex & parent /* = {} */) const
+{
+  const Node * parentNode = nodeFromIndex(parent);
+  if (!parentNode || column != 0 || row < 0 || static_cast<std::size_t>(row) >= parentNode->children.size())
+    return {};
+  return createIndex(row, column, parentNode->children[static_cast<std::size_t>(row)].get());
+}
+
+QModelIndex PDFToCModel::parent(const QModelIndex & child) const
+{
+  const Node * node = nodeFromIndex(child);
+  if (!node || !node->parent || node->parent == _root.get())
+    return {};
+  return createIndex(node->parent->row, 0, node->parent);
+}
+
+int PDFToCModel::rowCount(const QModelIndex & parent /* = {} */) const
+{
+  if (parent.column() > 0)
+    return 0;
+  const Node * node = nodeFromIndex(parent);
+  return (node ? static_cast<int>(node->children.size()) : 0);
+}
+
+int PDFToCModel::columnCount(const QModelIndex & parent /* = {} */) const
+{
+  Q_UNUSED(parent)
+  return 1;
+}
+
+bool PDFToCModel::hasChildren(const QModelIndex & parent /* = {} */) const
+{
+  if (parent.column() > 0)
+    return false;
+  const Node * node = nodeFromIndex(parent);
+  if (!node)
+    return false;
+  if (node->fetched)
+    return !node->children.empty();
+  return node->item.hasChildren();
+}
+
+bool PDFToCModel::canFetchMore(const QModelIndex & parent) const
+{
+  const Node * node = nodeFromIndex(parent);
+  return (node && !node->fetched && node->item.hasChildren());
+}
+
+void PDFToCModel::fetchMore(const QModelIndex & parent)
+{
+  Node * node = nodeFromIndex(parent);
+  if (!node || node->fetched)
+    return;
+  node->fetched = true;
+
+  const QSharedPointer<Backend::Document> doc{_doc.toStrongRef()};
+  if (!doc)
+    return;
+
+  const Backend::PDFToC items = doc->tocChildren(pathFromNode(node));
+  if (items.isEmpty())
+    return;
+
+  beginInsertRows(parent, 0, static_cast<int>(items.size()) - 1);
+  node->children.reserve(static_cast<std::size_t>(items.size()));
+  for (const Backend::PDFToCItem & item : items) {
+    std::unique_ptr<Node> child{new Node};
+    child->parent = node;
+    child->row = static_cast<int>(node->children.size());
+    child->item = item;
+    node->children.push_back(std::move(child));
+  }
+  endInsertRows();
+}
+
+QVariant PDFToCModel::data(const QModelIndex & index, int role /* = Qt::DisplayRole */) const
+{
+  if (!index.isValid())
+    return {};
+  const Node * node = nodeFromIndex(index);
+  Q_ASSERT(node != nullptr);
+  const Backend::PDFToCItem & item = node->item;
+
+  switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+      return item.label();
+    case Qt::ForegroundRole:
+      if (item.color().isValid())
+        return item.color();
+      return {};
+    case Qt::FontRole:
+      if (item.flags()) {
+        QFont font;
+        font.setBold(item.flags().testFlag(Backend::PDFToCItem::Flag_Bold));
+        font.setItalic(item.flags().testFlag(Backend::PDFToCItem::Flag_Italic));
+        return font;
+      }
+      return {};
+    case IsOpenRole:
+      return item.isOpen();
+    default:
+      return {};
+  }
+}
+
+} // namespace QtPDF
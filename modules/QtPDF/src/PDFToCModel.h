@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFToCModel_H
+#define PDFToCModel_H
+
+#include "PDFToC.h"
+
+#include <QAbstractItemModel>
+#include <QWeakPointer>
+
+#include <memory>
+
+namespace QtPDF {
+
+namespace Backend {
+class Document;
+}
+
+// Item model exposing the outline of a document. Children are only retrieved
+// from the backend (via Backend::Document::tocChildren()) when a view asks for
+// them (see canFetchMore()/fetchMore()), i.e., typically when the parent item
+// is expanded. Actions (and thus destinations) are only resolved when
+// requested through action().
+class PDFToCModel : public QAbstractItemModel
+{
+  Q_OBJECT
+public:
+  enum Role { IsOpenRole = Qt::UserRole + 1 };
+
+  explicit PDFToCModel(QObject * parent = nullptr);
+  ~PDFToCModel() override;
+
+  QWeakPointer<Backend::Document> document() const { return _doc; }
+  void setDocument(const QWeakPointer<Backend::Document> & doc);
+
+  std::unique_ptr<PDFAction> action(const QModelIndex & index) const;
+
+  QModelIndex index(int row, int column, const QModelIndex & parent = {}) const override;
+  QModelIndex parent(const QModelIndex & child) const override;
+  int rowCount(const QModelIndex & parent = {}) const override;
+  int columnCount(const QModelIndex & parent = {}) const override;
+  bool hasChildren(const QModelIndex & parent = {}) const override;
+  bool canFetchMore(const QModelIndex & parent) const override;
+  void fetchMore(const QModelIndex & parent) override;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+
+private:
+  struct Node;
+
+  Node * nodeFromIndex(const QModelIndex & index) const;
+  static QVector<int> pathFromNode(const Node * node);
+
+  QWeakPointer<Backend::Document> _doc;
+  std::unique_ptr<Node> _root;
+};
+
+} // namespace QtPDF
+
+#endif // !defined(PDFToCModel_H)
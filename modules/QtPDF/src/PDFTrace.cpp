@@ -0,0 +1,266 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFTrace.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+
+namespace QtPDF {
+
+namespace Trace {
+
+namespace {
+
+struct Event {
+  const char * category;
+  const char * name;
+  char phase;
+  qint64 timestamp;
+  qint64 duration;
+  quint64 id;
+  quintptr thread;
+  Args args;
+};
+
+QAtomicInt enabled{0};
+
+struct Buffer {
+  QMutex mutex;
+  QVector<Event> events;
+  // Index of the oldest event once the buffer has wrapped around
+  int first{0};
+  int maxEvents{100000};
+  QHash<quintptr, QString> threadNames;
+};
+
+Buffer & buffer()
+{
+  static Buffer b;
+  return b;
+}
+
+const QElapsedTimer & clock()
+{
+  static const QElapsedTimer timer = []() {
+    QElapsedTimer t;
+    t.start();
+    return t;
+  }();
+  return timer;
+}
+
+void record(const char * category, const char * name, const char phase, const qint64 timestamp, const qint64 duration, const quint64 id, const Args & args)
+{
+  const quintptr thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+
+  if (!b.threadNames.contains(thread)) {
+    QThread * t = QThread::currentThread();
+    QString threadName = t->objectName();
+    if (threadName.isEmpty()) {
+      if (QCoreApplication::instance() && t == QCoreApplication::instance()->thread())
+        threadName = QStringLiteral("main");
+      else
+        threadName = QString::fromLatin1(t->metaObject()->className());
+    }
+    b.threadNames.insert(thread, threadName);
+  }
+
+  const Event e{category, name, phase, timestamp, duration, id, thread, args};
+  if (b.events.size() < b.maxEvents)
+    b.events.append(e);
+  else if (b.maxEvents > 0) {
+    b.events[b.first] = e;
+    b.first = (b.first + 1) % b.maxEvents;
+  }
+}
+
+} // anonymous namespace
+
+bool isEnabled()
+{
+  return enabled.loadAcquire() != 0;
+}
+
+void setEnabled(const bool enable)
+{
+  // Make sure the clock is running before the first event is recorded
+  clock();
+  enabled.storeRelease(enable ? 1 : 0);
+}
+
+void clear()
+{
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+  b.events.clear();
+  b.first = 0;
+}
+
+int maxEvents()
+{
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+  return b.maxEvents;
+}
+
+void setMaxEvents(const int count)
+{
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+  const int newMax = qMax(0, count);
+  // Bring the events into chronological order before resizing
+  QVector<Event> events;
+  events.reserve(b.events.size());
+  for (int i = 0; i < b.events.size(); ++i)
+    events.append(b.events[(b.first + i) % b.events.size()]);
+  if (events.size() > newMax)
+    events.erase(events.begin(), events.begin() + (events.size() - newMax));
+  b.events = events;
+  b.first = 0;
+  b.maxEvents = newMax;
+}
+
+int eventCount()
+{
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+  return static_cast<int>(b.events.size());
+}
+
+qint64 now()
+{
+  return clock().nsecsElapsed() / 1000;
+}
+
+void instant(const char * category, const char * name, const Args & args /* = {} */)
+{
+  if (isEnabled())
+    record(category, name, 'i', now(), 0, 0, args);
+}
+
+void complete(const char * category, const char * name, const qint64 start, const Args & args /* = {} */)
+{
+  if (isEnabled())
+    record(category, name, 'X', start, now() - start, 0, args);
+}
+
+void asyncBegin(const char * category, const char * name, const quint64 id, const Args & args /* = {} */)
+{
+  if (isEnabled())
+    record(category, name, 'b', now(), 0, id, args);
+}
+
+void asyncEnd(const char * category, const char * name, const quint64 id, const Args & args /* = {} */)
+{
+  if (isEnabled())
+    record(category, name, 'e', now(), 0, id, args);
+}
+
+QByteArray toJson()
+{
+  Buffer & b = buffer();
+  QMutexLocker locker(&b.mutex);
+
+  const qint64 pid = QCoreApplication::applicationPid();
+  QJsonArray events;
+  for (auto it = b.threadNames.cbegin(); it != b.threadNames.cend(); ++it) {
+    QJsonObject meta{
+      {QStringLiteral("ph"), QStringLiteral("M")},
+      {QStringLiteral("name"), QStringLiteral("thread_name")},
+      {QStringLiteral("pid"), pid},
+      {QStringLiteral("tid"), static_cast<qint64>(it.key())},
+      {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), it.value()}}}
+    };
+    events.append(meta);
+  }
+
+  for (int i = 0; i < b.events.size(); ++i) {
+    const Event & e = b.events[(b.first + i) % b.events.size()];
+    QJsonObject obj{
+      {QStringLiteral("cat"), QString::fromLatin1(e.category)},
+      {QStringLiteral("name"), QString::fromLatin1(e.name)},
+      {QStringLiteral("ph"), QString(QLatin1Char(e.phase))},
+      {QStringLiteral("ts"), e.timestamp},
+      {QStringLiteral("pid"), pid},
+      {QStringLiteral("tid"), static_cast<qint64>(e.thread)}
+    };
+    switch (e.phase) {
+      case 'X':
+        obj.insert(QStringLiteral("dur"), e.duration);
+        break;
+      case 'b':
+      case 'e':
+        obj.insert(QStringLiteral("id"), QString::number(e.id, 16).prepend(QStringLiteral("0x")));
+        break;
+      case 'i':
+        // Thread-scoped instant events
+        obj.insert(QStringLiteral("s"), QStringLiteral("t"));
+        break;
+      default:
+        break;
+    }
+    if (!e.args.isEmpty()) {
+      QJsonObject args;
+      for (const Arg & arg : e.args)
+        args.insert(QString::fromLatin1(arg.first), QJsonValue::fromVariant(arg.second));
+      obj.insert(QStringLiteral("args"), args);
+    }
+    events.append(obj);
+  }
+
+  return QJsonDocument(QJsonObject{
+    {QStringLiteral("traceEvents"), events},
+    {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}
+  }).toJson(QJsonDocument::Compact);
+}
+
+bool writeJson(const QString & fileName)
+{
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(toJson());
+  return file.commit();
+}
+
+Scope::Scope(const char * category, const char * name, const Args & args /* = {} */)
+  : _category(category)
+  , _name(name)
+{
+  if (isEnabled()) {
+    _args = args;
+    _start = now();
+  }
+}
+
+Scope::~Scope()
+{
+  if (_start >= 0)
+    complete(_category, _name, _start, _args);
+}
+
+} // namespace Trace
+
+} // namespace QtPDF
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2024  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFTrace_H
+#define PDFTrace_H
+
+#include <QByteArray>
+#include <QPair>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <initializer_list>
+
+namespace QtPDF {
+
+// Lightweight event tracing for the rendering pipeline. Tracing is always
+// compiled in but disabled by default; while disabled, each trace point costs
+// a single atomic load. Events are kept in a ring buffer (the oldest events
+// are dropped once maxEvents() is reached) and can be dumped in the Chrome
+// trace event format, which can be viewed in, e.g., https://ui.perfetto.dev or
+// chrome://tracing.
+//
+// Categories and names must be string literals (or otherwise outlive the
+// trace buffer). All functions are thread-safe.
+namespace Trace {
+
+using Arg = QPair<const char *, QVariant>;
+using Args = QVector<Arg>;
+
+bool isEnabled();
+void setEnabled(const bool enabled);
+// Discards all recorded events
+void clear();
+
+int maxEvents();
+void setMaxEvents(const int count);
+int eventCount();
+
+// Microseconds since an arbitrary (but fixed) point in time
+qint64 now();
+
+// A point in time
+void instant(const char * category, const char * name, const Args & args = {});
+// An operation that started at `start` (as returned by now()) and ends now
+void complete(const char * category, const char * name, const qint64 start, const Args & args = {});
+// An operation that may start and end in different threads; begin and end are
+// matched by `category`, `name` and `id`
+void asyncBegin(const char * category, const char * name, const quint64 id, const Args & args = {});
+void asyncEnd(const char * category, const char * name, const quint64 id, const Args & args = {});
+
+// Returns the recorded events as JSON object in the Chrome trace event format
+QByteArray toJson();
+bool writeJson(const QString & fileName);
+
+// Records a complete event covering the lifetime of the object (if tracing
+// was enabled when it was constructed)
+class Scope
+{
+public:
+  Scope(const char * category, const char * name, const Args & args = {});
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope & operator=(const Scope &) = delete;
+
+private:
+  const char * _category;
+  const char * _name;
+  Args _args;
+  qint64 _start{-1};
+};
+
+} // namespace Trace
+
+} // namespace QtPDF
+
+#endif // !defined(PDFTrace_H)
@@ -385,6 +385,8 @@ Document::~Document()
 #ifdef DEBUG
 //  qDebug() << "MuPDF::Document::~Document()";
 #endif
+  // Stop preloading links before the MuPDF data goes away
+  _processingThread.setIdleTask({});
 
   QWriteLocker docLocker(_docLock.data());
 
@@ -406,12 +408,17 @@ void Document::reload()
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
   _processingThread.clearWorkStack();
+  abortBackgroundScans();
 
   QWriteLocker docLocker(_docLock.data());
   MuPDFLocaleResetter lr;
 
   clearPages();
-  _pageCache.markOutdated();
+  clearMetaData();
+  _meta_fileSize = QFileInfo(_fileName).size();
+  // Tiles of the previous file content become outdated placeholders if the
+  // content changed
+  setContentKey(contentKey(_fileName));
 
   if (_mupdf_data) {
     pdf_free_xref(_mupdf_data);
@@ -494,7 +501,7 @@ void Document::reload()
   // NOTE: This can also fail.
   pdf_load_page_tree(_mupdf_data);
   _numPages = pdf_count_pages(_mupdf_data);
-  loadMetaData();
+  // The meta data is loaded on demand by parseDeferredData()
 }
 
 QWeakPointer<Backend::Page> Document::page(int at)
@@ -536,22 +543,27 @@ QWeakPointer<Backend::Page> Document::page(int at) const
   return _pages[at];
 }
 
-void Document::loadMetaData()
+bool Document::parseDeferredData(DeferredData & data, const int generation) const
 {
   char infoName[] = "Info"; // required because fz_dict_gets is not prototyped to take const char *
 
-  QWriteLocker docLocker(_docLock.data());
+  // NB: Reading the `Info` dictionary is quick, so we hold the doc-read-lock
+  // throughout
+  QReadLocker docLocker(_docLock.data());
+  if (isScanAborted(generation))
+    return false;
   MuPDFLocaleResetter lr;
 
-  if (_isLocked())
-    return;
+  if (!_isValid() || _isLocked())
+    return true;
 
   // TODO: Handle encrypted meta data
   // Note: fz_is_dict(NULL)===0, i.e., it doesn't crash
   if (!fz_is_dict(_mupdf_data->trailer))
-    return;
+    return true;
 
-  clearMetaData();
+  // NB: Page sizes are not determined here as pdf_load_page() (which we would
+  // need for that) fully parses the page
   fz_obj * info = fz_dict_gets(_mupdf_data->trailer, infoName);
   if (fz_is_dict(info)) { // the `Info` entry is optional
     for (int i = 0; i < fz_dict_len(info); ++i) {
@@ -567,11 +579,11 @@ void Document::loadMetaData()
         // can be codec dependent (see Qt docs)
         QString val = QString::fromAscii(fz_to_name(fz_dict_get_val(info, i)));
         if (val == QString::fromUtf8("True"))
-          _meta_trapped = Trapped_True;
+          data.trapped = Trapped_True;
         else if (val == QString::fromUtf8("False"))
-          _meta_trapped = Trapped_False;
+          data.trapped = Trapped_False;
         else
-          _meta_trapped = Trapped_Unknown;
+          data.trapped = Trapped_Unknown;
       }
       else {
         // TODO: Check if fromAscii always gives correct results (the pdf specs
@@ -579,29 +591,29 @@ void Document::loadMetaData()
         // can be codec dependent (see Qt docs)
         QString val = QString::fromAscii(fz_to_str_buf(fz_dict_get_val(info, i)));
         if (key == QString::fromUtf8("Title"))
-          _meta_title = val;
+          data.title = val;
         else if (key == QString::fromUtf8("Author"))
-          _meta_author = val;
+          data.author = val;
         else if (key == QString::fromUtf8("Subject"))
-          _meta_subject = val;
+          data.subject = val;
         else if (key == QString::fromUtf8("Keywords"))
-          _meta_keywords = val;
+          data.keywords = val;
         else if (key == QString::fromUtf8("Creator"))
-          _meta_creator = val;
+          data.creator = val;
         else if (key == QString::fromUtf8("Producer"))
-          _meta_producer = val;
+          data.producer = val;
         else if (key == QString::fromUtf8("CreationDate"))
-          _meta_creationDate = fromPDFDate(val);
+          data.creationDate = fromPDFDate(val);
         else if (key == QString::fromUtf8("ModDate"))
-          _meta_modDate = fromPDFDate(val);
+          data.modDate = fromPDFDate(val);
         else
-          _meta_other[key] = val;
+          data.other[key] = val;
       }
     }
   }
-  _meta_fileSize = QFileInfo(_fileName).size();
   // TODO: Implement metadata stream handling (which should probably override
   // the data in the `Info` dictionary
+  return true;
 }
 
 PDFDestination Document::resolveDestination(const PDFDestination & namedDestination) const
@@ -626,7 +638,7 @@ PDFDestination Document::resolveDestination(const PDFDestination & namedDestinat
   return toPDFDestination(_mupdf_data, dest);
 }
 
-QList<PDFFontInfo> Document::fonts() const
+bool Document::scanFonts(const FontCallback & callback) const
 {
   QReadLocker docLocker(_docLock.data());
   MuPDFLocaleResetter lr;
@@ -767,7 +779,9 @@ QList<PDFFontInfo> Document::fonts() const
   qDebug() << "loaded fonts in" << timer.elapsed() << "ms";
 #endif
 
-  return retVal;
+  // All fonts are collected from the xref table in one go, so report them in
+  // a single batch
+  return callback(retVal);
 }
 
 void Document::recursiveConvertToC(QList<PDFToCItem> & items, pdf_outline * node) const
@@ -937,7 +951,7 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   fz_drop_pixmap(mu_image);
 
   if( cache ) {
-    PDFPageTile key(xres, yres, render_box, _n);
+    PDFPageTile key(xres, yres, render_box, _parent, _n);
     QImage * img = new QImage(renderedPage.copy());
     if (img != _parent->pageCache().setImage(key, img, PDFPageCache::CURRENT))
       delete img;
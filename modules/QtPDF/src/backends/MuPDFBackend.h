@@ -51,7 +51,7 @@ protected:
   pdf_xref *_mupdf_data;
   fz_glyph_cache *_glyph_cache;
 
-  void loadMetaData();
+  bool parseDeferredData(DeferredData & data, const int generation) const override;
 
   // The following two methods are not thread-safe because they don't acquire a
   // read lock. This is to enable methods that have a write lock to use them.
@@ -73,11 +73,12 @@ public:
   PDFDestination resolveDestination(const PDFDestination & namedDestination) const override;
 
   PDFToC toc() const override;
-  QList<PDFFontInfo> fonts() const override;
+
+protected:
+  bool scanFonts(const FontCallback & callback) const override;
 
 private:
   enum PermissionLevel { PermissionLevel_Locked, PermissionLevel_User, PermissionLevel_Owner };
-  QString _password;
   // NOTE: the MuPDF function pdf_needs_password actually tries to authenticate
   // with an empty password under certain circumstances. This can effectively
   // relock _mupdf_data, so we have to cache to `locked` state.
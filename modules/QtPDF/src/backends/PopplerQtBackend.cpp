@@ -14,6 +14,7 @@
 
 // NOTE: `PopplerQtBackend.h` is included via `PDFBackend.h`
 #include "PDFBackend.h"
+#include "PDFRenderProcess.h"
 
 #include <QBitArray>
 
@@ -27,14 +28,6 @@
 #endif
 #include <memory>
 
-// Comparison operator for QSizeF needed to use QSizeF as keys in a QMap
-// NB: Must be in the global namespace
-inline bool operator<(const QSizeF & a, const QSizeF & b) {
-    qreal areaA = a.width() * a.height();
-    qreal areaB = b.width() * b.height();
-    return (areaA < areaB || (areaA == areaB && a.width() < b.width()));
-}
-
 namespace QtPDF {
 
 namespace Backend {
@@ -99,6 +92,77 @@ PDFDestination toPDFDestination(const ::Poppler::Document * doc, const ::Poppler
   return retVal;
 }
 
+bool toPDFFontInfo(const ::Poppler::FontInfo & popplerFontInfo, PDFFontInfo & fi)
+{
+  if (popplerFontInfo.isEmbedded())
+    fi.setSource(PDFFontInfo::Source_Embedded);
+  else
+    fi.setFileName(QFileInfo(popplerFontInfo.file()));
+  fi.setDescriptor(PDFFontDescriptor(popplerFontInfo.name()));
+
+  switch (popplerFontInfo.type()) {
+    case ::Poppler::FontInfo::Type1:
+      fi.setFontType(PDFFontInfo::FontType_Type1);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_Type1);
+      break;
+    case ::Poppler::FontInfo::Type1C:
+      fi.setFontType(PDFFontInfo::FontType_Type1);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_Type1CFF);
+      break;
+    case ::Poppler::FontInfo::Type1COT:
+      fi.setFontType(PDFFontInfo::FontType_Type1);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType); // speculation
+      break;
+    case ::Poppler::FontInfo::Type3:
+      fi.setFontType(PDFFontInfo::FontType_Type3);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_None); // probably wrong!
+      break;
+    case ::Poppler::FontInfo::TrueType:
+      fi.setFontType(PDFFontInfo::FontType_TrueType);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_TrueType);
+      break;
+    case ::Poppler::FontInfo::TrueTypeOT:
+      fi.setFontType(PDFFontInfo::FontType_TrueType);
+      fi.setCIDType(PDFFontInfo::CIDFont_None);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
+      break;
+    case ::Poppler::FontInfo::CIDType0:
+      fi.setFontType(PDFFontInfo::FontType_Type0);
+      fi.setCIDType(PDFFontInfo::CIDFont_Type0);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_None); // probably wrong!
+      break;
+    case ::Poppler::FontInfo::CIDType0C:
+      fi.setFontType(PDFFontInfo::FontType_Type0);
+      fi.setCIDType(PDFFontInfo::CIDFont_Type0);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_CIDCFF);
+      break;
+    case ::Poppler::FontInfo::CIDType0COT:
+      fi.setFontType(PDFFontInfo::FontType_Type0);
+      fi.setCIDType(PDFFontInfo::CIDFont_Type0);
+      fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
+      break;
+    case ::Poppler::FontInfo::CIDTrueType:
+      fi.setFontType(PDFFontInfo::FontType_Type0);
+      fi.setCIDType(PDFFontInfo::CIDFont_Type2); // speculation
+      fi.setFontProgramType(PDFFontInfo::ProgramType_TrueType);
+      break;
+    case ::Poppler::FontInfo::CIDTrueTypeOT:
+      fi.setFontType(PDFFontInfo::FontType_Type0);
+      fi.setCIDType(PDFFontInfo::CIDFont_Type2); // speculation
+      fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
+      break;
+    case ::Poppler::FontInfo::unknown:
+    default:
+      return false;
+  }
+  return true;
+}
+
 void convertAnnotation(Annotation::AbstractAnnotation * dest, const ::Poppler::Annotation * src, const QWeakPointer<Backend::Page> & thePage)
 {
   QSharedPointer<Backend::Page> page(thePage.toStrongRef());
@@ -157,6 +221,8 @@ Document::~Document()
 #ifdef DEBUG
 //  qDebug() << "PopplerQt::Document::~Document()";
 #endif
+  // Stop preloading links before the poppler document goes away
+  _processingThread.setIdleTask({});
   clearPages();
   delete _poppler_docLock;
 }
@@ -166,12 +232,19 @@ bool Document::load(const QString & filename)
   bool success{true};
   QFile pdf(filename);
   if (pdf.open(QIODevice::ReadOnly)) {
-    QMutexLocker l(_poppler_docLock);
     // Load the file into memory and then initialize _poppler_doc from memory to
     // ensure the data is available even while the pdf file gets modified (e.g.,
     // during typesetting)
-    _poppler_doc = std::unique_ptr<::Poppler::Document>(::Poppler::Document::loadFromData(pdf.readAll()));
+    const QByteArray data = pdf.readAll();
     pdf.close();
+    {
+      QMutexLocker l(_poppler_docLock);
+      _poppler_doc = std::unique_ptr<::Poppler::Document>(::Poppler::Document::loadFromData(data));
+    }
+    // NB: If loading fails (e.g., because the file is still being written), we
+    // keep the previous key so the old tiles remain available as placeholders
+    if (_poppler_doc)
+      setContentKey(contentKey(filename, data));
   }
   else {
     _poppler_doc.reset();
@@ -191,12 +264,15 @@ void Document::reload()
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
   _processingThread.clearWorkStack();
+  // Likewise, make any running font scans and metadata loads give up their
+  // doc-read-lock
+  abortBackgroundScans();
 
   QWriteLocker docLocker(_docLock.data());
 
   clearPages();
-  _pageCache.markOutdated(this);
-
+  // NB: load() updates the cache key if the file content changed; in that case
+  // the current tiles become outdated placeholders
   load(_fileName);
 
   // TODO: possibly unlock the new document again if it was previously unlocked
@@ -206,7 +282,6 @@ void Document::reload()
 void Document::parseDocument()
 {
   QWriteLocker docLocker(_docLock.data());
-  using poppler_size_type = decltype(_poppler_doc->numPages());
 
   clearMetaData();
   _meta_fileSize = QFileInfo(_fileName).size();
@@ -216,6 +291,7 @@ void Document::parseDocument()
     return;
 
   _numPages = _poppler_doc->numPages();
+  _outOfProcess = !_poppler_doc->hasOptionalContent();
 
   // Permissions
   // TODO: Check if this mapping from Poppler flags to our flags is correct
@@ -246,42 +322,65 @@ void Document::parseDocument()
   _poppler_doc->setRenderHint(::Poppler::Document::Antialiasing);
   _poppler_doc->setRenderHint(::Poppler::Document::TextAntialiasing);
 
-  // Load meta data
-  QStringList metaKeys = _poppler_doc->infoKeys();
-  if (metaKeys.contains(QString::fromUtf8("Title"))) {
-    _meta_title = _poppler_doc->info(QString::fromUtf8("Title"));
-    metaKeys.removeAll(QString::fromUtf8("Title"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("Author"))) {
-    _meta_author = _poppler_doc->info(QString::fromUtf8("Author"));
-    metaKeys.removeAll(QString::fromUtf8("Author"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("Subject"))) {
-    _meta_subject = _poppler_doc->info(QString::fromUtf8("Subject"));
-    metaKeys.removeAll(QString::fromUtf8("Subject"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("Keywords"))) {
-    _meta_keywords = _poppler_doc->info(QString::fromUtf8("Keywords"));
-    metaKeys.removeAll(QString::fromUtf8("Keywords"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("Creator"))) {
-    _meta_creator = _poppler_doc->info(QString::fromUtf8("Creator"));
-    metaKeys.removeAll(QString::fromUtf8("Creator"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("Producer"))) {
-    _meta_producer = _poppler_doc->info(QString::fromUtf8("Producer"));
-    metaKeys.removeAll(QString::fromUtf8("Producer"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("CreationDate"))) {
-    _meta_creationDate = fromPDFDate(_poppler_doc->info(QString::fromUtf8("CreationDate")));
-    metaKeys.removeAll(QString::fromUtf8("CreationDate"));
-  }
-  if (metaKeys.contains(QString::fromUtf8("ModDate"))) {
-    _meta_modDate = fromPDFDate(_poppler_doc->info(QString::fromUtf8("ModDate")));
-    metaKeys.removeAll(QString::fromUtf8("ModDate"));
+  // The remaining (meta) data is loaded on demand by parseDeferredData() as
+  // that can take a while for large documents
+}
+
+bool Document::parseDeferredData(DeferredData & data, const int generation) const
+{
+  using poppler_size_type = decltype(_poppler_doc->numPages());
+
+  // Poppler is not thread-safe, so we need to serialize access to it. The
+  // page sizes are determined in chunks below so rendering (which also needs
+  // the mutex) can proceed in between. Likewise, the doc-read-lock is only
+  // held for each chunk so pages can be created in between. If the document
+  // is reloaded in the meantime (which needs the doc-write-lock), the
+  // generation changes and we bail out.
+  poppler_size_type numPages{0};
+  QStringList metaKeys;
+  QString xmpMetadata;
+  {
+    QReadLocker docLocker(_docLock.data());
+    if (isScanAborted(generation))
+      return false;
+    if (!_poppler_doc || _isLocked())
+      return true;
+    numPages = static_cast<poppler_size_type>(_numPages);
+
+    QMutexLocker popplerLocker(_poppler_docLock);
+    metaKeys = _poppler_doc->infoKeys();
+    const auto takeInfo = [this, &metaKeys](const QString & key, QString & value) {
+      if (metaKeys.contains(key)) {
+        value = _poppler_doc->info(key);
+        metaKeys.removeAll(key);
+        return true;
+      }
+      return false;
+    };
+    takeInfo(QString::fromUtf8("Title"), data.title);
+    takeInfo(QString::fromUtf8("Author"), data.author);
+    takeInfo(QString::fromUtf8("Subject"), data.subject);
+    takeInfo(QString::fromUtf8("Keywords"), data.keywords);
+    takeInfo(QString::fromUtf8("Creator"), data.creator);
+    takeInfo(QString::fromUtf8("Producer"), data.producer);
+    QString date;
+    if (takeInfo(QString::fromUtf8("CreationDate"), date))
+      data.creationDate = fromPDFDate(date);
+    if (takeInfo(QString::fromUtf8("ModDate"), date))
+      data.modDate = fromPDFDate(date);
+
+    // Note: Poppler doesn't handle the meta data key "Trapped" correctly, as
+    // that has a value of type `name` (/True, /False, or /Unknown) which
+    // doesn't get converted to a string representation properly.
+    data.trapped = Trapped_Unknown;
+    metaKeys.removeAll(QString::fromUtf8("Trapped"));
+
+    foreach (QString key, metaKeys)
+      data.other[key] = _poppler_doc->info(key);
+
+    xmpMetadata = _poppler_doc->metadata();
   }
 
-  const QString xmpMetadata = _poppler_doc->metadata();
   if (!xmpMetadata.isEmpty()) {
     QDomDocument domDoc;
     const auto getMetadataEntry = [&domDoc](const QString & nsURI, const QString & tag) {
@@ -316,50 +415,42 @@ void Document::parseDocument()
 #if QT_VERSION < QT_VERSION_CHECK(6, 5, 0)
     QString errMsg;
     int errLine{0}, errCol{0};
-    if (domDoc.setContent(_poppler_doc->metadata(), true, &errMsg, &errLine, &errCol)) {
+    if (domDoc.setContent(xmpMetadata, true, &errMsg, &errLine, &errCol)) {
 #else
-    if (domDoc.setContent(_poppler_doc->metadata(), QDomDocument::ParseOption::UseNamespaceProcessing)) {
+    if (domDoc.setContent(xmpMetadata, QDomDocument::ParseOption::UseNamespaceProcessing)) {
 #endif
       const QString dcNS{QStringLiteral("http://purl.org/dc/")};
       const QString xmpNS{QStringLiteral("http://ns.adobe.com/xap/")};
       const QString pdfNS{QStringLiteral("http://ns.adobe.com/pdf/")};
 
-      setMetadataString(dcNS, QStringLiteral("title"), _meta_title);
-      setMetadataString(dcNS, QStringLiteral("creator"), _meta_author);
-      setMetadataString(dcNS, QStringLiteral("description"), _meta_subject);
-      setMetadataString(dcNS, QStringLiteral("subject"), _meta_keywords);
-      setMetadataString(xmpNS, QStringLiteral("CreatorTool"), _meta_creator);
-      setMetadataString(pdfNS, QStringLiteral("Producer"), _meta_producer);
-      setMetadataDatetime(xmpNS, QStringLiteral("CreateDate"), _meta_creationDate);
-      setMetadataDatetime(xmpNS, QStringLiteral("ModifyDate"), _meta_modDate);
+      setMetadataString(dcNS, QStringLiteral("title"), data.title);
+      setMetadataString(dcNS, QStringLiteral("creator"), data.author);
+      setMetadataString(dcNS, QStringLiteral("description"), data.subject);
+      setMetadataString(dcNS, QStringLiteral("subject"), data.keywords);
+      setMetadataString(xmpNS, QStringLiteral("CreatorTool"), data.creator);
+      setMetadataString(pdfNS, QStringLiteral("Producer"), data.producer);
+      setMetadataDatetime(xmpNS, QStringLiteral("CreateDate"), data.creationDate);
+      setMetadataDatetime(xmpNS, QStringLiteral("ModifyDate"), data.modDate);
     }
   }
 
-  // Get the most often used page size
-  QMap<QSizeF, size_type> pageSizes;
-  for (poppler_size_type i = 0; i < _numPages; ++i) {
-    const std::unique_ptr<::Poppler::Page> page{_poppler_doc->page(i)};
-    QSizeF ps = page->pageSizeF();
-    if (pageSizes.contains(ps)) ++pageSizes[ps];
-    else pageSizes[ps] = 1;
-  }
-  size_type occurrences = -1;
-  _meta_pageSize = QSizeF();
-  Q_FOREACH(QSizeF ps, pageSizes.keys()) {
-      if (occurrences < pageSizes[ps]) {
-          _meta_pageSize = ps;
-          occurrences = pageSizes[ps];
-      }
+  // Determining the page sizes requires loading every page
+  const poppler_size_type chunkSize = 16;
+  data.pageSizes.reserve(numPages);
+  for (poppler_size_type i = 0; i < numPages; i += chunkSize) {
+    if (isScanAborted(generation))
+      return false;
+    QReadLocker docLocker(_docLock.data());
+    // Recheck now that we hold the lock; _poppler_doc may have been replaced
+    if (isScanAborted(generation))
+      return false;
+    QMutexLocker popplerLocker(_poppler_docLock);
+    for (poppler_size_type j = i; j < qMin(i + chunkSize, numPages); ++j) {
+      const std::unique_ptr<::Poppler::Page> page{_poppler_doc->page(j)};
+      data.pageSizes.append(page ? page->pageSizeF() : QSizeF());
+    }
   }
-
-  // Note: Poppler doesn't handle the meta data key "Trapped" correctly, as that
-  // has a value of type `name` (/True, /False, or /Unknown) which doesn't get
-  // converted to a string representation properly.
-  _meta_trapped = Trapped_Unknown;
-    metaKeys.removeAll(QString::fromUtf8("Trapped"));
-
-  foreach (QString key, metaKeys)
-    _meta_other[key] = _poppler_doc->info(key);
+  return true;
 }
 
 QWeakPointer<Backend::Page> Document::page(size_type at)
@@ -397,6 +488,42 @@ QWeakPointer<Backend::Page> Document::page(size_type at)
   return _pages[at].toWeakRef();
 }
 
+void Document::loadLinksAndAnnotations(const QVector<size_type> & pages)
+{
+  // NB: Getting the pages may need a doc-write-lock, so do that first
+  QVector< QSharedPointer<Page> > todo;
+  todo.reserve(pages.size());
+  for (const size_type n : pages) {
+    QSharedPointer<Page> p = page(n).toStrongRef().dynamicCast<Page>();
+    if (p && !p->linksAndAnnotationsLoaded())
+      todo.append(p);
+  }
+  if (todo.isEmpty())
+    return;
+
+  QReadLocker docLocker(_docLock.data());
+
+  // Acquire the poppler lock only once for all pages (and not once for the
+  // links and once for the annotations of each page) so we don't compete with
+  // rendering more than necessary
+  std::vector<Page::PopplerAnnotationData> data;
+  data.reserve(static_cast<std::vector<Page::PopplerAnnotationData>::size_type>(todo.size()));
+  {
+    QMutexLocker popplerDocLock(_poppler_docLock);
+    if (!_poppler_doc)
+      return;
+    for (const QSharedPointer<Page> & page : todo)
+      data.push_back(page->fetchLinksAndAnnotations());
+  }
+
+  for (decltype(todo.size()) i = 0; i < todo.size(); ++i) {
+    const QSharedPointer<Page> & page = todo[i];
+    const Page::PopplerAnnotationData & pageData = data[static_cast<std::vector<Page::PopplerAnnotationData>::size_type>(i)];
+    page->convertLinks(pageData);
+    page->convertAnnotations(pageData);
+  }
+}
+
 PDFDestination Document::resolveDestination(const PDFDestination & namedDestination) const
 {
   QReadLocker docLocker(_docLock.data());
@@ -421,24 +548,42 @@ void Document::recursiveConvertToC(QList<PDFToCItem> & items, const QVector<Popp
     PDFToCItem newItem(popplerItem.name());
     newItem.setOpen(popplerItem.isOpen());
     // Note: color and flags are not supported by poppler
-
-    PDFGotoAction * action = nullptr;
-    if (popplerItem.destination())
-      action = new PDFGotoAction(toPDFDestination(_poppler_doc.get(), *(popplerItem.destination())));
-
-    if (action && !popplerItem.externalFileName().isEmpty()) {
-      // Open external links in new window by default (since poppler doesn't
-      // tell us what to do)
-      action->setOpenInNewWindow(true);
-      action->setRemote();
-      action->setFilename(popplerItem.externalFileName());
-    }
-    newItem.setAction(std::unique_ptr<PDFAction>(action));
+    newItem.setAction(convertToCAction(popplerItem));
 
     recursiveConvertToC(newItem.children(), popplerItem.children());
     items << newItem;
   }
 }
+
+std::unique_ptr<PDFAction> Document::convertToCAction(const Poppler::OutlineItem & popplerItem) const
+{
+  if (!popplerItem.destination())
+    return {};
+
+  std::unique_ptr<PDFGotoAction> action{new PDFGotoAction(toPDFDestination(_poppler_doc.get(), *(popplerItem.destination())))};
+  if (!popplerItem.externalFileName().isEmpty()) {
+    // Open external links in new window by default (since poppler doesn't
+    // tell us what to do)
+    action->setOpenInNewWindow(true);
+    action->setRemote();
+    action->setFilename(popplerItem.externalFileName());
+  }
+  return std::unique_ptr<PDFAction>(action.release());
+}
+
+bool Document::findOutlineItems(const QVector<int> & path, QVector<Poppler::OutlineItem> & siblings, Poppler::OutlineItem & item) const
+{
+  // NB: Poppler reads outline items from the file on demand, so only the
+  // items along `path` (and their siblings) are actually loaded
+  siblings = _poppler_doc->outline();
+  for (const int i : path) {
+    if (i < 0 || i >= siblings.size())
+      return false;
+    item = siblings[i];
+    siblings = item.children();
+  }
+  return true;
+}
 #else // POPPLER_HAS_OUTLINE
 void Document::recursiveConvertToC(QList<PDFToCItem> & items, QDomNode node) const
 {
@@ -498,89 +643,80 @@ PDFToC Document::toc() const
   return retVal;
 }
 
-QList<PDFFontInfo> Document::fonts() const
+#if POPPLER_HAS_OUTLINE
+PDFToC Document::tocChildren(const QVector<int> & path) const
 {
   QReadLocker docLocker(_docLock.data());
 
-  if (_fontsLoaded)
-    return _fonts;
+  PDFToC retVal;
+  if (!_poppler_doc || _isLocked())
+    return retVal;
+
+  QMutexLocker popplerLocker(_poppler_docLock);
+  QVector<Poppler::OutlineItem> popplerItems;
+  Poppler::OutlineItem popplerItem;
+  if (!findOutlineItems(path, popplerItems, popplerItem))
+    return retVal;
+
+  for (const Poppler::OutlineItem & child : popplerItems) {
+    PDFToCItem newItem(child.name());
+    newItem.setOpen(child.isOpen());
+    newItem.setHasChildren(child.hasChildren());
+    retVal << newItem;
+  }
+  return retVal;
+}
 
+std::unique_ptr<PDFAction> Document::tocAction(const QVector<int> & path) const
+{
+  QReadLocker docLocker(_docLock.data());
+
+  if (!_poppler_doc || _isLocked() || path.isEmpty())
+    return {};
+
+  QMutexLocker popplerLocker(_poppler_docLock);
+  QVector<Poppler::OutlineItem> popplerItems;
+  Poppler::OutlineItem popplerItem;
+  if (!findOutlineItems(path, popplerItems, popplerItem))
+    return {};
+  return convertToCAction(popplerItem);
+}
+#endif // POPPLER_HAS_OUTLINE
+
+bool Document::scanFonts(const FontCallback & callback) const
+{
+  // NB: The caller holds a doc-read-lock
   if (!_poppler_doc || _isLocked())
-    return QList<PDFFontInfo>();
-
-  _fontsLoaded = true;
-
-  foreach(::Poppler::FontInfo popplerFontInfo, _poppler_doc->fonts()) {
-    PDFFontInfo fi;
-    if (popplerFontInfo.isEmbedded())
-      fi.setSource(PDFFontInfo::Source_Embedded);
-    else
-      fi.setFileName(QFileInfo(popplerFontInfo.file()));
-    fi.setDescriptor(PDFFontDescriptor(popplerFontInfo.name()));
-
-    switch (popplerFontInfo.type()) {
-      case ::Poppler::FontInfo::Type1:
-        fi.setFontType(PDFFontInfo::FontType_Type1);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_Type1);
-        break;
-      case ::Poppler::FontInfo::Type1C:
-        fi.setFontType(PDFFontInfo::FontType_Type1);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_Type1CFF);
-        break;
-      case ::Poppler::FontInfo::Type1COT:
-        fi.setFontType(PDFFontInfo::FontType_Type1);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType); // speculation
-        break;
-      case ::Poppler::FontInfo::Type3:
-        fi.setFontType(PDFFontInfo::FontType_Type3);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_None); // probably wrong!
-        break;
-      case ::Poppler::FontInfo::TrueType:
-        fi.setFontType(PDFFontInfo::FontType_TrueType);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_TrueType);
-        break;
-      case ::Poppler::FontInfo::TrueTypeOT:
-        fi.setFontType(PDFFontInfo::FontType_TrueType);
-        fi.setCIDType(PDFFontInfo::CIDFont_None);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
-        break;
-      case ::Poppler::FontInfo::CIDType0:
-        fi.setFontType(PDFFontInfo::FontType_Type0);
-        fi.setCIDType(PDFFontInfo::CIDFont_Type0);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_None); // probably wrong!
-        break;
-      case ::Poppler::FontInfo::CIDType0C:
-        fi.setFontType(PDFFontInfo::FontType_Type0);
-        fi.setCIDType(PDFFontInfo::CIDFont_Type0);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_CIDCFF);
-        break;
-      case ::Poppler::FontInfo::CIDType0COT:
-        fi.setFontType(PDFFontInfo::FontType_Type0);
-        fi.setCIDType(PDFFontInfo::CIDFont_Type0);
-        fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
-        break;
-      case ::Poppler::FontInfo::CIDTrueType:
-        fi.setFontType(PDFFontInfo::FontType_Type0);
-        fi.setCIDType(PDFFontInfo::CIDFont_Type2); // speculation
-        fi.setFontProgramType(PDFFontInfo::ProgramType_TrueType);
-        break;
-      case ::Poppler::FontInfo::CIDTrueTypeOT:
-        fi.setFontType(PDFFontInfo::FontType_Type0);
-        fi.setCIDType(PDFFontInfo::CIDFont_Type2); // speculation
-        fi.setFontProgramType(PDFFontInfo::ProgramType_OpenType);
+    return true;
+
+  std::unique_ptr<::Poppler::FontIterator> it = [this]() {
+    QMutexLocker popplerLocker(_poppler_docLock);
+    return std::unique_ptr<::Poppler::FontIterator>(_poppler_doc->newFontIterator());
+  }();
+
+  // Note: The iterator scans the document page by page and only reports fonts
+  // that it has not encountered on previous pages
+  while (true) {
+    QList<::Poppler::FontInfo> popplerFonts;
+    {
+      // Poppler is not thread-safe. Only hold the mutex for one page at a time,
+      // though, so page rendering can proceed in between
+      QMutexLocker popplerLocker(_poppler_docLock);
+      if (!it->hasNext())
         break;
-      case ::Poppler::FontInfo::unknown:
-      default:
-        continue;
+      popplerFonts = it->next();
+    }
+
+    QList<PDFFontInfo> batch;
+    for (const ::Poppler::FontInfo & popplerFontInfo : popplerFonts) {
+      PDFFontInfo fi;
+      if (toPDFFontInfo(popplerFontInfo, fi))
+        batch << fi;
     }
-    _fonts << fi;
+    if (!callback(batch))
+      return false;
   }
-  return _fonts;
+  return true;
 }
 
 QAbstractItemModel *Document::optionalContentModel() const
@@ -609,12 +745,18 @@ void Document::setPaperColor(const QColor &color)
   if (!_poppler_doc) {
     return;
   }
-  QMutexLocker l(_poppler_docLock);
-  _poppler_doc->setPaperColor(color);
+  {
+    QMutexLocker l(_poppler_docLock);
+    if (_poppler_doc->paperColor() == color)
+      return;
+    _poppler_doc->setPaperColor(color);
+  }
+  setPaperColorKey(color.rgba());
 }
 
 bool Document::unlock(const QString password)
 {
+  abortBackgroundScans();
   QWriteLocker docLocker(_docLock.data());
 
   if (!_poppler_doc)
@@ -624,11 +766,14 @@ bool Document::unlock(const QString password)
   // access is already granted.
   bool success = !_poppler_doc->unlock(password.toLatin1(), password.toLatin1());
 
-  if (success)
+  if (success) {
+    _password = password;
     parseDocument();
+    _outOfProcess = false;
+  }
 
-  // FIXME: Store password for this session in case we need to reload the
-  // document later on (e.g., if it has changed on the disk)
+  // FIXME: Use the password in case we need to reload the document later on
+  // (e.g., if it has changed on the disk)
 
   return success;
 }
@@ -669,8 +814,28 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
     return QImage();
 
   QImage renderedPage;
+  bool rendered{false};
+
+  Document * doc = dynamic_cast<Document *>(_parent);
+  RenderProcessPool & pool = RenderProcessPool::instance();
+  if (doc->_outOfProcess && pool.isEnabled()) {
+    // Helpers have their own copy of the document, so there is no need to
+    // serialize with _poppler_docLock
+    RenderProcessPool::Result result{RenderProcessPool::Result_Unavailable};
+    renderedPage = pool.renderToImage(QStringLiteral("poppler-qt"), doc->fileName(), doc->loadedContentKey(), static_cast<int>(_n), xres, yres, render_box, doc->paperColor(), &result);
+    if (result == RenderProcessPool::Result_Crashed) {
+      // Don't retry in-process (we would likely crash, too), but don't cache
+      // the (null) result either: the helper may merely have timed out on a
+      // slow page, so the tile must be requested again when it is needed
+      if (cache)
+        _parent->pageCache().markPlaceholderOutdated(PDFPageTile(xres, yres, render_box, _parent, _n));
+      return QImage();
+    }
+    // Fall back to rendering in-process unless the helper succeeded
+    rendered = (result == RenderProcessPool::Result_Success);
+  }
 
-  {
+  if (!rendered) {
     // Rendering pages is not thread safe.
     QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
     if( render_box.isNull() ) {
@@ -691,6 +856,37 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   return renderedPage;
 }
 
+Page::PopplerAnnotationData Page::fetchLinksAndAnnotations() const
+{
+  // NB: The caller holds the _poppler_docLock
+  QReadLocker pageLocker(&_pageLock);
+  PopplerAnnotationData data;
+  if (!_poppler_page)
+    return data;
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  const QList<::Poppler::Link *> poppler_links = _poppler_page->links();
+  data.links.reserve(static_cast<decltype(data.links)::size_type>(poppler_links.size()));
+  for (::Poppler::Link * link : poppler_links) {
+    data.links.emplace_back(link);
+  }
+  const QList<::Poppler::Annotation *> poppler_annots = _poppler_page->annotations();
+  data.annotations.reserve(static_cast<decltype(data.annotations)::size_type>(poppler_annots.size()));
+  for (::Poppler::Annotation * annot : poppler_annots) {
+    data.annotations.emplace_back(annot);
+  }
+#else
+  data.links = _poppler_page->links();
+  data.annotations = _poppler_page->annotations();
+#endif
+  return data;
+}
+
+bool Page::linksAndAnnotationsLoaded() const
+{
+  QReadLocker pageLocker(&_pageLock);
+  return (_linksLoaded && _annotationsLoaded) || !_parent;
+}
+
 QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
 {
   {
@@ -701,45 +897,34 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
   }
 
   QReadLocker docLocker(_docLock.data());
+  PopplerAnnotationData data;
+  {
+    QReadLocker pageLocker(&_pageLock);
+    if (_linksLoaded || !_parent)
+      return _links;
+    // Loading links is not thread safe.
+    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+    data = fetchLinksAndAnnotations();
+  }
+  convertLinks(data);
+
+  QReadLocker pageLocker(&_pageLock);
+  return _links;
+}
+
+void Page::convertLinks(const PopplerAnnotationData & data)
+{
+  // NB: The caller holds a doc-read-lock
   QWriteLocker pageLocker(&_pageLock);
 
   // Check if the links were loaded in another thread in the meantime
   if (_linksLoaded || !_parent)
-    return _links;
-
+    return;
 
   Q_ASSERT(_poppler_page != nullptr);
   _linksLoaded = true;
-  const std::vector< std::unique_ptr<::Poppler::Link> > popplerLinks = [&]() {
-    // Loading links is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    const QList<::Poppler::Link *> poppler_links = _poppler_page->links();
-    std::vector< std::unique_ptr<::Poppler::Link> > rv;
-    rv.reserve(static_cast<decltype(rv)::size_type>(poppler_links.size()));
-    for (::Poppler::Link * link : poppler_links) {
-      rv.emplace_back(link);
-    }
-    return rv;
-#else
-    return _poppler_page->links();
-#endif
-  }();
-  const std::vector< std::unique_ptr<::Poppler::Annotation> > popplerAnnots = [&]() {
-    // Loading annotations is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    const QList<::Poppler::Annotation *> poppler_annots = _poppler_page->annotations();
-    std::vector< std::unique_ptr<::Poppler::Annotation> > rv;
-    rv.reserve(static_cast<decltype(rv)::size_type>(poppler_annots.size()));
-    for (::Poppler::Annotation * annot : poppler_annots) {
-      rv.emplace_back(annot);
-    }
-    return rv;
-#else
-    return _poppler_page->annotations();
-#endif
-  }();
+  const std::vector< std::unique_ptr<::Poppler::Link> > & popplerLinks = data.links;
+  const std::vector< std::unique_ptr<::Poppler::Annotation> > & popplerAnnots = data.annotations;
 
   // Note: Poppler gives the linkArea in normalized coordinates, i.e., in the
   // range of 0..1, with y=0 at the top. We use pdf coordinates internally, so
@@ -877,7 +1062,6 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
 
     _links << link;
   }
-  return _links;
 }
 
 QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
@@ -890,31 +1074,32 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   }
 
   QReadLocker docLocker(_docLock.data());
+  PopplerAnnotationData data;
+  {
+    QReadLocker pageLocker(&_pageLock);
+    if (_annotationsLoaded || !_poppler_page || !_parent)
+      return _annotations;
+    // Loading annotations is not thread safe.
+    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+    data = fetchLinksAndAnnotations();
+  }
+  convertAnnotations(data);
+
+  QReadLocker pageLocker(&_pageLock);
+  return _annotations;
+}
+
+void Page::convertAnnotations(const PopplerAnnotationData & data)
+{
+  // NB: The caller holds a doc-read-lock
   QWriteLocker pageLocker(&_pageLock);
   // Check if the annotations were loaded in another thread in the meantime
   if (_annotationsLoaded || !_poppler_page || !_parent)
-    return _annotations;
+    return;
 
   _annotationsLoaded = true;
+  const std::vector< std::unique_ptr<::Poppler::Annotation> > & popplerAnnots = data.annotations;
 
-  const std::vector< std::unique_ptr<::Poppler::Annotation> > popplerAnnots = [&]() {
-    // Loading annotations is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    const QList<::Poppler::Annotation *> poppler_annots = _poppler_page->annotations();
-    std::vector< std::unique_ptr<::Poppler::Annotation> > rv;
-    rv.reserve(static_cast<decltype(rv)::size_type>(poppler_annots.size()));
-    for (::Poppler::Annotation * annot : poppler_annots) {
-      rv.emplace_back(annot);
-    }
-    return rv;
-#else
-    return _poppler_page->annotations();
-#endif
-  }();
-
-  // we don't need the docLock anymore
-  docLocker.unlock();
   // we don't need the pageLock anymore (until we actually modify _annotations).
   // in fact, convertAnnotation tries to acquire a read lock at some point,
   // which fails while we hold a write lock here
@@ -989,8 +1174,6 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
         break;
     }
   }
-  pageLocker.relock();
-  return _annotations;
 }
 
 QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags) const
@@ -1012,7 +1195,21 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
 
   result.pageNum = _n;
 
-  QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
+  Document * doc = dynamic_cast<Document *>(_parent);
+  RenderProcessPool & pool = RenderProcessPool::instance();
+  if (doc->_outOfProcess && pool.isEnabled()) {
+    RenderProcessPool::Result poolResult{RenderProcessPool::Result_Unavailable};
+    results = pool.search(QStringLiteral("poppler-qt"), doc->fileName(), doc->loadedContentKey(), static_cast<int>(_n), searchText, flags, &poolResult);
+    if (poolResult == RenderProcessPool::Result_Success)
+      return results;
+    // Otherwise, search in-process. Unlike for rendering, we do so even if the
+    // helper crashed or timed out: searching doesn't render anything (which is
+    // what typically crashes), and an empty result would be indistinguishable
+    // from "no matches" for the caller (and is never retried)
+    results.clear();
+  }
+
+  QMutexLocker popplerDocLock(doc->_poppler_docLock);
 
   if (flags & Search_Backwards) {
     left = right = pageSizeF().width();
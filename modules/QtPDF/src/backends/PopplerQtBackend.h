@@ -47,6 +47,10 @@ class Document: public Backend::Document
 
 #if POPPLER_HAS_OUTLINE
   void recursiveConvertToC(QList<PDFToCItem> & items, const QVector<Poppler::OutlineItem> & popplerItems) const;
+  std::unique_ptr<PDFAction> convertToCAction(const Poppler::OutlineItem & popplerItem) const;
+  // Walks the outline along `path` (see Backend::Document::tocChildren());
+  // returns `false` if the path is invalid. Caller must hold _poppler_docLock.
+  bool findOutlineItems(const QVector<int> & path, QVector<Poppler::OutlineItem> & siblings, Poppler::OutlineItem & item) const;
 #else
   void recursiveConvertToC(QList<PDFToCItem> & items, QDomNode node) const;
 #endif
@@ -55,12 +59,15 @@ protected:
   // Poppler is not threadsafe, so some operations need to be serialized with a
   // mutex.
   QMutex * _poppler_docLock{new QMutex};
-  // Since ::Poppler::Document::fonts() is extremely slow, we need to cache the
-  // result.
-  mutable QList<PDFFontInfo> _fonts;
-  mutable bool _fontsLoaded{false};
+  // Whether rendering and searching may be delegated to the
+  // RenderProcessPool; the helper processes open the file themselves, so this
+  // is not possible if the document's appearance depends on state that only
+  // exists in this process (password, optional content visibility)
+  bool _outOfProcess{false};
 
   bool load(const QString & filename);
+  bool scanFonts(const FontCallback & callback) const override;
+  bool parseDeferredData(DeferredData & data, const int generation) const override;
 
   // The following two methods are not thread-safe because they don't acquire a
   // read lock. This is to enable methods that have a write lock to use them.
@@ -78,10 +85,14 @@ public:
   bool unlock(const QString password) override;
 
   QWeakPointer<Backend::Page> page(size_type at) override;
+  void loadLinksAndAnnotations(const QVector<size_type> & pages) override;
   PDFDestination resolveDestination(const PDFDestination & namedDestination) const override;
 
   PDFToC toc() const override;
-  QList<PDFFontInfo> fonts() const override;
+#if POPPLER_HAS_OUTLINE
+  PDFToC tocChildren(const QVector<int> & path) const override;
+  std::unique_ptr<PDFAction> tocAction(const QVector<int> & path) const override;
+#endif
   QAbstractItemModel * optionalContentModel() const override;
 
   QColor paperColor() const override;
@@ -102,7 +113,20 @@ class Page: public Backend::Page
   bool _annotationsLoaded{false};
   bool _linksLoaded{false};
 
+  // The raw poppler objects that loadLinks() and loadAnnotations() convert
+  struct PopplerAnnotationData {
+    std::vector< std::unique_ptr<::Poppler::Link> > links;
+    std::vector< std::unique_ptr<::Poppler::Annotation> > annotations;
+  };
+
   void loadTransitionData();
+  // The caller must hold the document's _poppler_docLock. Uses page-read-lock.
+  PopplerAnnotationData fetchLinksAndAnnotations() const;
+  // The caller must hold a doc-read-lock. Uses page-write-lock.
+  void convertLinks(const PopplerAnnotationData & data);
+  void convertAnnotations(const PopplerAnnotationData & data);
+  // Uses page-read-lock.
+  bool linksAndAnnotationsLoaded() const;
 
 protected:
   Page(Document *parent, size_type at, QSharedPointer<QReadWriteLock> docLock);
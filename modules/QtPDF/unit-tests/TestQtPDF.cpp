@@ -20,9 +20,19 @@
 */
 #include "TestQtPDF.h"
 #include "PaperSizes.h"
+#include "PDFPageCacheBudget.h"
+#include "PDFPageExporter.h"
+#include "PDFRenderProcess.h"
+#include "PDFSpatialIndex.h"
+#include "PDFToCModel.h"
+#include "PDFTrace.h"
 #include "PhysicalUnits.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTimeZone>
+#include <QtConcurrent>
 
 #ifdef USE_MUPDF
   typedef QtPDF::MuPDFBackend Backend;
@@ -1229,6 +1239,43 @@ void TestQtPDF::fonts()
   QCOMPARE(actualFontNames, fontNames);
 }
 
+void TestQtPDF::fontsIncremental_data()
+{
+  fonts_data();
+}
+
+void TestQtPDF::fontsIncremental()
+{
+  QFETCH(pDoc, doc);
+  QFETCH(QStringList, fontNames);
+
+  // Use a fresh document so the font list is not cached yet
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> freshDoc{backend.newDocument(doc->fileName())};
+
+  // Aborting the scan must not leave a partial list behind in the cache
+  bool called{false};
+  const bool finished = freshDoc->fonts([&called](const QList<QtPDF::Backend::PDFFontInfo> &) {
+    called = true;
+    return false;
+  });
+  QCOMPARE(finished, !called);
+
+  QStringList actualFontNames;
+  QVERIFY(freshDoc->fonts([&actualFontNames](const QList<QtPDF::Backend::PDFFontInfo> & batch) {
+    for (const QtPDF::Backend::PDFFontInfo & font : batch)
+      actualFontNames.append(font.descriptor().pureName());
+    return true;
+  }));
+  QCOMPARE(actualFontNames, fontNames);
+
+  // Subsequent calls are served from the cache
+  QStringList cachedFontNames;
+  for (const QtPDF::Backend::PDFFontInfo & font : freshDoc->fonts())
+    cachedFontNames.append(font.descriptor().pureName());
+  QCOMPARE(cachedFontNames, fontNames);
+}
+
 void TestQtPDF::ToCItem()
 {
   QtPDF::Backend::PDFToCItem ti, def, act;
@@ -1340,6 +1387,90 @@ void TestQtPDF::toc()
   }
 }
 
+// static
+void TestQtPDF::compareLazyToC(const QtPDF::Backend::Document & doc, const QVector<int> & path, const QtPDF::Backend::PDFToC & expected)
+{
+  const QtPDF::Backend::PDFToC actual = doc.tocChildren(path);
+  QCOMPARE(actual.size(), expected.size());
+  if (QTest::currentTestFailed()) return;
+
+  for (int i = 0; i < actual.size(); ++i) {
+    const QVector<int> childPath = QVector<int>(path) << i;
+    QCOMPARE(actual[i].label(), expected[i].label());
+    QCOMPARE(actual[i].isOpen(), expected[i].isOpen());
+    QCOMPARE(actual[i].hasChildren(), !expected[i].children().isEmpty());
+    QVERIFY(actual[i].children().isEmpty());
+    QVERIFY(actual[i].action() == nullptr);
+
+    const std::unique_ptr<QtPDF::PDFAction> action = doc.tocAction(childPath);
+    QCOMPARE(action != nullptr, expected[i].action() != nullptr);
+    if (action && expected[i].action())
+      QVERIFY(*action == *expected[i].action());
+
+    compareLazyToC(doc, childPath, expected[i].children());
+    if (QTest::currentTestFailed()) return;
+  }
+}
+
+void TestQtPDF::tocLazy_data()
+{
+  QTest::addColumn<pDoc>("doc");
+
+  newDocTest("invalid");
+  newDocTest("annotations");
+  newDocTest("pgfmanual");
+}
+
+void TestQtPDF::tocLazy()
+{
+  QFETCH(pDoc, doc);
+
+  compareLazyToC(*doc, {}, doc->toc());
+
+  // Invalid paths
+  QCOMPARE(doc->tocChildren(QVector<int>() << -1), QtPDF::Backend::PDFToC());
+  QCOMPARE(doc->tocChildren(QVector<int>() << static_cast<int>(doc->toc().size())), QtPDF::Backend::PDFToC());
+  QVERIFY(doc->tocAction({}) == nullptr);
+}
+
+void TestQtPDF::tocModel()
+{
+  QtPDF::PDFToCModel model;
+  QCOMPARE(model.rowCount(), 0);
+  QVERIFY(!model.canFetchMore(QModelIndex()));
+
+  model.setDocument(_docs[QString::fromLatin1("annotations")]);
+  // Nothing is loaded until it is requested
+  QCOMPARE(model.rowCount(), 0);
+  QVERIFY(model.hasChildren());
+  QVERIFY(model.canFetchMore(QModelIndex()));
+
+  model.fetchMore(QModelIndex());
+  QVERIFY(!model.canFetchMore(QModelIndex()));
+  QCOMPARE(model.rowCount(), 2);
+
+  const QModelIndex a = model.index(0, 0);
+  QCOMPARE(a.data().toString(), QString::fromLatin1("A"));
+  QVERIFY(model.hasChildren(a));
+  QCOMPARE(model.rowCount(a), 0);
+  QVERIFY(model.canFetchMore(a));
+  model.fetchMore(a);
+  QCOMPARE(model.rowCount(a), 1);
+
+  const QModelIndex child = model.index(0, 0, a);
+  QCOMPARE(child.data().toString(), QString::fromUtf8("aä®€"));
+  QCOMPARE(model.parent(child), a);
+  QCOMPARE(model.parent(a), QModelIndex());
+  QVERIFY(!model.hasChildren(child));
+
+  const QModelIndex latex = model.index(1, 0);
+  QCOMPARE(latex.data().toString(), QString::fromLatin1("LaTeX"));
+  QVERIFY(!model.hasChildren(latex));
+
+  model.setDocument({});
+  QCOMPARE(model.rowCount(), 0);
+}
+
 void TestQtPDF::annotationComparison()
 {
   using SAP = QSharedPointer<QtPDF::Annotation::AbstractAnnotation>;
@@ -1454,6 +1585,666 @@ void TestQtPDF::page_renderToImage()
   }
 }
 
+void TestQtPDF::page_approximateImage()
+{
+  // Use a fresh document so no tiles of it are in the cache yet
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc{backend.newDocument(QStringLiteral("base14-fonts.pdf"))};
+  QVERIFY(doc);
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+
+  const QRect box(100, 100, 200, 100);
+
+  // Without cached tiles, we only get the placeholder pattern
+  QCOMPARE(page->approximateImage(72, 72, box).size(), box.size());
+
+  // Synchronous rendering puts the tile into the cache
+  QSharedPointer<QImage> tile = page->getTileImage(nullptr, 72, 72, box);
+  QVERIFY(tile);
+  QVERIFY(ComparableImage(page->approximateImage(72, 72, box)) == ComparableImage(*tile));
+
+  // Magnified (i.e., upscaled) approximation
+  const QImage magnified = page->approximateImage(144, 144, QRect(2 * box.topLeft(), 2 * box.size()));
+  QCOMPARE(magnified.size(), 2 * box.size());
+  QVERIFY(ComparableImage(magnified.scaled(box.size()), 15) == ComparableImage(*tile, 15));
+}
+
+void TestQtPDF::spatialIndex()
+{
+  QtPDF::PDFSpatialIndex index;
+  QVERIFY(index.isEmpty());
+  QCOMPARE(index.itemsAt(QPointF(1, 1)), QVector<int>());
+
+  QVector<QRectF> rects;
+  // A 30x30 grid of small boxes (e.g., index entries)...
+  for (int j = 0; j < 30; ++j) {
+    for (int i = 0; i < 30; ++i)
+      rects << QRectF(20 * i + 1, 20 * j + 1, 10, 10);
+  }
+  // ... a big box overlapping some of them (given with negative height as may
+  // happen for pdf rects) ...
+  rects << QRectF(0, 100, 100, -100);
+  // ... and a box partially outside the bounds
+  rects << QRectF(590, 590, 50, 50);
+  index.build(QRectF(0, 0, 600, 600), rects);
+
+  QCOMPARE(index.count(), static_cast<int>(rects.size()));
+  QCOMPARE(index.rect(900), QRectF(0, 0, 100, 100));
+
+  QCOMPARE(index.itemsAt(QPointF(15, 15)), QVector<int>() << 900);
+  QCOMPARE(index.itemsAt(QPointF(5, 5)), QVector<int>() << 900 << 0);
+  QCOMPARE(index.itemsAt(QPointF(125, 125)), QVector<int>() << 6 * 30 + 6);
+  QCOMPARE(index.itemsAt(QPointF(135, 135)), QVector<int>());
+  QCOMPARE(index.itemsAt(QPointF(595, 595)), QVector<int>() << 901);
+  QCOMPARE(index.itemsAt(QPointF(620, 620)), QVector<int>() << 901);
+  QCOMPARE(index.itemsAt(QPointF(-1, -1)), QVector<int>());
+
+  // Compare against brute force
+  for (int y = 0; y < 650; y += 7) {
+    for (int x = 0; x < 650; x += 7) {
+      const QPointF pt(x, y);
+      QVector<int> expected;
+      for (int k = static_cast<int>(rects.size()) - 1; k >= 0; --k) {
+        if (rects[k].normalized().contains(pt))
+          expected << k;
+      }
+      QCOMPARE(index.itemsAt(pt), expected);
+    }
+  }
+
+  index.clear();
+  QVERIFY(index.isEmpty());
+  QCOMPARE(index.itemsAt(QPointF(5, 5)), QVector<int>());
+}
+
+void TestQtPDF::renderProcess()
+{
+  using QtPDF::Backend::RenderProcessPool;
+  namespace RenderProtocol = QtPDF::Backend::RenderProtocol;
+
+  {
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    QVERIFY(RenderProtocol::writeMessage(buffer, QByteArray("abc")));
+    QVERIFY(RenderProtocol::writeMessage(buffer, QByteArray()));
+    buffer.seek(0);
+
+    QByteArray message;
+    QVERIFY(RenderProtocol::readMessage(buffer, message));
+    QCOMPARE(message, QByteArray("abc"));
+    QVERIFY(RenderProtocol::readMessage(buffer, message));
+    QCOMPARE(message, QByteArray());
+    QVERIFY(!RenderProtocol::readMessage(buffer, message));
+  }
+
+  RenderProcessPool & pool = RenderProcessPool::instance();
+  const QString fileName = QStringLiteral("base14-fonts.pdf");
+#ifdef QTPDF_RENDER_HELPER_PATH
+  // Built along with the tests (see CMakeLists.txt)
+  const QString helper = QStringLiteral(QTPDF_RENDER_HELPER_PATH);
+#else
+  const QString helper = pool.helperProgram();
+#endif
+  const quint64 key = QtPDF::Backend::Document::contentKey(fileName);
+  const QRect box(100, 100, 200, 100);
+  RenderProcessPool::Result result{RenderProcessPool::Result_Success};
+
+  // Disabled by default
+  QVERIFY(!pool.isEnabled());
+  pool.renderToImage(QStringLiteral("poppler-qt"), fileName, key, 0, 72, 72, box, Qt::white, &result);
+  QCOMPARE(result, RenderProcessPool::Result_Unavailable);
+
+  pool.setProcessCount(2);
+  pool.setHelperProgram(QStringLiteral("does-not-exist"));
+  pool.renderToImage(QStringLiteral("poppler-qt"), fileName, key, 0, 72, 72, box, Qt::white, &result);
+  QCOMPARE(result, RenderProcessPool::Result_Unavailable);
+  pool.setHelperProgram(helper);
+  pool.setProcessCount(0);
+
+#ifdef USE_POPPLERQT
+  if (!QFileInfo(helper).isExecutable())
+    QSKIP("qtpdf-render-helper is not available");
+
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc{backend.newDocument(fileName)};
+  QVERIFY(doc);
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+
+  const QImage reference = page->renderToImage(72, 72, box);
+  const QList<QtPDF::Backend::SearchResult> referenceHits = page->search(QStringLiteral("Times"), QtPDF::Backend::SearchFlags());
+  QVERIFY(!referenceHits.isEmpty());
+
+  pool.setProcessCount(2);
+  QCOMPARE(doc->loadedContentKey(), key);
+  const QImage tile = pool.renderToImage(QStringLiteral("poppler-qt"), fileName, key, 0, 72, 72, box, Qt::white, &result);
+  QCOMPARE(result, RenderProcessPool::Result_Success);
+  QVERIFY(ComparableImage(tile) == ComparableImage(reference));
+
+  // Requests for a different version of the file are refused
+  QVERIFY(pool.renderToImage(QStringLiteral("poppler-qt"), fileName, key + 1, 0, 72, 72, box, Qt::white, &result).isNull());
+  QCOMPARE(result, RenderProcessPool::Result_Failed);
+  pool.search(QStringLiteral("poppler-qt"), fileName, key + 1, 0, QStringLiteral("Times"), QtPDF::Backend::SearchFlags(), &result);
+  QCOMPARE(result, RenderProcessPool::Result_Failed);
+
+  // Delegation through the backend
+  QVERIFY(ComparableImage(page->renderToImage(72, 72, box)) == ComparableImage(reference));
+  compareSearchResults(page->search(QStringLiteral("Times"), QtPDF::Backend::SearchFlags()), referenceHits);
+
+  // Full pages at high resolution exceed the initial shared memory segment
+  const QImage fullPage = page->renderToImage(300, 300);
+  QCOMPARE(fullPage.size(), (page->pageSizeF() * 300. / 72.).toSize());
+
+  pool.shutdown();
+  QVERIFY(!pool.isEnabled());
+  pool.renderToImage(QStringLiteral("poppler-qt"), fileName, key, 0, 72, 72, box, Qt::white, &result);
+  QCOMPARE(result, RenderProcessPool::Result_Unavailable);
+#endif
+  pool.setHelperProgram(QString());
+}
+
+void TestQtPDF::thumbnailCache()
+{
+  using QtPDF::Backend::PDFThumbnailCache;
+
+  // The key depends on the file's content key and the page
+  QCOMPARE(PDFThumbnailCache::key(42, 0), PDFThumbnailCache::key(42, 0));
+  QVERIFY(PDFThumbnailCache::key(42, 0) != PDFThumbnailCache::key(42, 1));
+  QVERIFY(PDFThumbnailCache::key(42, 0) != PDFThumbnailCache::key(43, 0));
+
+  QImage img(10, 20, QImage::Format_ARGB32);
+  img.fill(Qt::red);
+  {
+    PDFThumbnailCache cache;
+    QVERIFY(cache.image("foo").isNull());
+    cache.insert("foo", img);
+    QCOMPARE(cache.image("foo"), img);
+    cache.clear();
+    QVERIFY(cache.image("foo").isNull());
+  }
+  {
+    // Thumbnails in the disk cache are available to other cache objects
+    PDFThumbnailCache cache;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    cache.setCacheDirectory(dir.path());
+    QVERIFY(cache.image("foo").isNull());
+    cache.insert("foo", img);
+    PDFThumbnailCache other;
+    other.setCacheDirectory(dir.path());
+    QCOMPARE(other.image("foo").convertToFormat(img.format()), img);
+  }
+  {
+    // The disk cache is trimmed once it grows too large
+    PDFThumbnailCache cache;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    cache.setCacheDirectory(dir.path());
+    cache.insert("foo", img);
+    const QStringList filter{QStringLiteral("*.png")};
+    const QFileInfoList files = QDir(dir.path()).entryInfoList(filter, QDir::Files);
+    QCOMPARE(files.size(), 1);
+    cache.setMaxDiskSize(2 * files.first().size() - 1);
+    cache.insert("bar", img);
+    QCOMPARE(QDir(dir.path()).entryInfoList(filter, QDir::Files).size(), 1);
+    cache.setMaxDiskSize(0);
+    QCOMPARE(QDir(dir.path()).entryInfoList(filter, QDir::Files).size(), 0);
+  }
+
+  // Documents of the same (unchanged) file share their thumbnails
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc1{backend.newDocument(QStringLiteral("annotations.pdf"))};
+  QSharedPointer<QtPDF::Backend::Document> doc2{backend.newDocument(QStringLiteral("annotations.pdf"))};
+  QVERIFY(doc1);
+  QVERIFY(doc2);
+  QVERIFY(doc1->loadedContentKey() != 0);
+  QCOMPARE(PDFThumbnailCache::key(doc2->loadedContentKey(), 0), PDFThumbnailCache::key(doc1->loadedContentKey(), 0));
+}
+
+void TestQtPDF::pageExporter()
+{
+  using QtPDF::PDFPageExporter;
+  bool ok{false};
+
+  QCOMPARE(PDFPageExporter::parsePageRange(QString(), 3, &ok), QVector<int>({0, 1, 2}));
+  QVERIFY(ok);
+  QCOMPARE(PDFPageExporter::parsePageRange(QStringLiteral("1-2, 5,7-"), 8, &ok), QVector<int>({0, 1, 4, 6, 7}));
+  QVERIFY(ok);
+  QCOMPARE(PDFPageExporter::parsePageRange(QStringLiteral("-2"), 8, &ok), QVector<int>({0, 1}));
+  QVERIFY(ok);
+  QCOMPARE(PDFPageExporter::parsePageRange(QStringLiteral("3-2"), 8, &ok), QVector<int>());
+  QVERIFY(!ok);
+  QCOMPARE(PDFPageExporter::parsePageRange(QStringLiteral("9"), 8, &ok), QVector<int>());
+  QVERIFY(!ok);
+  QCOMPARE(PDFPageExporter::parsePageRange(QStringLiteral("a"), 8, &ok), QVector<int>());
+  QVERIFY(!ok);
+
+  {
+    PDFPageExporter exporter;
+    exporter.setFileName(QStringLiteral("does-not-exist.pdf"));
+    exporter.setOutputFiles(QStringLiteral("page-%1.png"));
+    QVERIFY(!exporter.start());
+    QVERIFY(!exporter.errorString().isEmpty());
+  }
+
+#ifdef USE_POPPLERQT
+  const QString fileName = QStringLiteral("annotations.pdf");
+  QSharedPointer<QtPDF::Backend::Document> doc = _docs[QStringLiteral("annotations")];
+  QVERIFY(doc);
+  const int numPages = static_cast<int>(doc->numPages());
+  QVERIFY(numPages > 1);
+
+  // Export to files
+  {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PDFPageExporter exporter;
+    exporter.setFileName(fileName);
+    exporter.setResolution(36);
+    exporter.setOutputFiles(QDir(dir.path()).filePath(QStringLiteral("page-%1.png")));
+    QSignalSpy spy(&exporter, &PDFPageExporter::finished);
+    QVERIFY(exporter.start());
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.first().first().toBool(), true);
+    for (int i = 0; i < numPages; ++i) {
+      const QImage image(QDir(dir.path()).filePath(QStringLiteral("page-%1.png").arg(i + 1)));
+      QVERIFY(ComparableImage(image.convertToFormat(QImage::Format_ARGB32)) == ComparableImage(doc->page(i).toStrongRef()->renderToImage(36, 36).convertToFormat(QImage::Format_ARGB32)));
+    }
+  }
+
+  // Pages are handed to the sink in order, even if they are rendered out of
+  // order
+  {
+    PDFPageExporter exporter;
+    exporter.setFileName(fileName);
+    exporter.setResolution(36);
+    exporter.setThreadCount(2);
+    exporter.setMaxPagesInFlight(2);
+    const QVector<int> pages{1, 0, 1};
+    exporter.setPages(pages);
+    QVector<int> received;
+    exporter.setPageSink([&received](const int pageNum, const QImage & image) {
+      received << pageNum;
+      return !image.isNull();
+    });
+    QSignalSpy spy(&exporter, &PDFPageExporter::finished);
+    QVERIFY(exporter.start());
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.first().first().toBool(), true);
+    QCOMPARE(received, pages);
+
+    // Returning false from the sink cancels the export
+    received.clear();
+    exporter.setPageSink([&received](const int pageNum, const QImage &) {
+      received << pageNum;
+      return false;
+    });
+    spy.clear();
+    QVERIFY(exporter.start());
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.first().first().toBool(), false);
+    QCOMPARE(received, QVector<int>({1}));
+  }
+#endif
+}
+
+void TestQtPDF::trace()
+{
+  namespace Trace = QtPDF::Trace;
+
+  Trace::clear();
+  Trace::setEnabled(false);
+  Trace::instant("test", "ignored");
+  QCOMPARE(Trace::eventCount(), 0);
+  {
+    Trace::Scope scope("test", "ignored");
+  }
+  QCOMPARE(Trace::eventCount(), 0);
+
+  Trace::setEnabled(true);
+  Trace::instant("test", "instant", {{"page", 1}});
+  const qint64 start = Trace::now();
+  Trace::complete("test", "complete", start);
+  Trace::asyncBegin("test", "async", 42);
+  Trace::asyncEnd("test", "async", 42);
+  {
+    Trace::Scope scope("test", "scope");
+  }
+  QCOMPARE(Trace::eventCount(), 5);
+
+  const QJsonDocument json = QJsonDocument::fromJson(Trace::toJson());
+  QVERIFY(json.isObject());
+  QStringList phases;
+  for (const QJsonValue & v : json.object().value(QStringLiteral("traceEvents")).toArray()) {
+    const QJsonObject event = v.toObject();
+    if (event.value(QStringLiteral("ph")).toString() == QStringLiteral("M"))
+      continue;
+    QCOMPARE(event.value(QStringLiteral("cat")).toString(), QStringLiteral("test"));
+    phases << event.value(QStringLiteral("ph")).toString();
+    if (event.value(QStringLiteral("name")).toString() == QStringLiteral("instant"))
+      QCOMPARE(event.value(QStringLiteral("args")).toObject().value(QStringLiteral("page")).toInt(), 1);
+  }
+  QCOMPARE(phases, QStringList({QStringLiteral("i"), QStringLiteral("X"), QStringLiteral("b"), QStringLiteral("e"), QStringLiteral("X")}));
+
+  // Only the most recent events are kept
+  const int oldMaxEvents = Trace::maxEvents();
+  Trace::setMaxEvents(3);
+  QCOMPARE(Trace::eventCount(), 3);
+  Trace::instant("test", "last");
+  QCOMPARE(Trace::eventCount(), 3);
+  const QJsonArray events = QJsonDocument::fromJson(Trace::toJson()).object().value(QStringLiteral("traceEvents")).toArray();
+  QCOMPARE(events.last().toObject().value(QStringLiteral("name")).toString(), QStringLiteral("last"));
+
+  // Negative limits are treated as 0
+  Trace::setMaxEvents(-1);
+  QCOMPARE(Trace::maxEvents(), 0);
+  QCOMPARE(Trace::eventCount(), 0);
+
+  Trace::setEnabled(false);
+  Trace::setMaxEvents(oldMaxEvents);
+  Trace::clear();
+  QCOMPARE(Trace::eventCount(), 0);
+}
+
+void TestQtPDF::renderStatistics()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageProcessingThread;
+  using QtPDF::Backend::PDFPageTile;
+
+  QSharedPointer<QImage> img(new QImage(16, 16, QImage::Format_ARGB32));
+  // 4 bytes per pixel
+  const int imgCost = 16 * 16 * 4;
+
+  PDFPageCache cache;
+  cache.setMaxCost(2 * imgCost);
+  const PDFPageTile t0(72, 72, QRect(0, 0, 16, 16), nullptr, 0);
+  const PDFPageTile t1(72, 72, QRect(0, 0, 16, 16), nullptr, 1);
+  const PDFPageTile t2(72, 72, QRect(0, 0, 16, 16), nullptr, 2);
+
+  cache.setImage(t0, img, PDFPageCache::CURRENT);
+  cache.setImage(t1, img, PDFPageCache::PLACEHOLDER);
+  {
+    const PDFPageCache::Statistics stats = cache.statistics();
+    QCOMPARE(stats.count, 2);
+    QCOMPARE(stats.insertions, quint64(2));
+    QCOMPARE(stats.evictions, quint64(0));
+    QCOMPARE(stats.placeholders, 1);
+    QCOMPARE(stats.cost, static_cast<qint64>(2 * imgCost));
+  }
+
+  // Only placeholders are marked outdated (e.g., after a failed render)
+  cache.markPlaceholderOutdated(t0);
+  cache.markPlaceholderOutdated(t1);
+  QCOMPARE(cache.getStatus(t0), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::OUTDATED);
+
+  // Inserting a third tile evicts the least recently used one
+  cache.setImage(t2, img, PDFPageCache::CURRENT);
+  {
+    const PDFPageCache::Statistics stats = cache.statistics();
+    QCOMPARE(stats.count, 2);
+    QCOMPARE(stats.insertions, quint64(3));
+    QCOMPARE(stats.evictions, quint64(1));
+    QCOMPARE(stats.placeholders, 0);
+    QCOMPARE(stats.outdated, 1);
+  }
+
+  // Moving tiles to a new cache key (e.g., after a reload) keeps them as
+  // outdated placeholders without evicting anything, even if the cache is full
+  {
+    PDFPageCache keyCache;
+    keyCache.setMaxCost(2 * imgCost);
+    PDFPageTile k0(t0), k1(t1);
+    k0.doc_key = k1.doc_key = 1;
+    keyCache.changeKey(0, 1);
+    keyCache.setImage(k0, img, PDFPageCache::CURRENT);
+    keyCache.setImage(k1, img, PDFPageCache::CURRENT);
+    keyCache.changeKey(1, 2);
+    k0.doc_key = k1.doc_key = 2;
+    QCOMPARE(keyCache.getStatus(k0), PDFPageCache::OUTDATED);
+    QCOMPARE(keyCache.getStatus(k1), PDFPageCache::OUTDATED);
+    const PDFPageCache::Statistics stats = keyCache.statistics();
+    QCOMPARE(stats.count, 2);
+    QCOMPARE(stats.evictions, quint64(0));
+  }
+
+  cache.recordLookup(PDFPageCache::CURRENT);
+  cache.recordLookup(PDFPageCache::CURRENT);
+  cache.recordLookup(PDFPageCache::PLACEHOLDER);
+  cache.recordLookup(PDFPageCache::UNKNOWN);
+  {
+    const PDFPageCache::Statistics stats = cache.statistics();
+    QCOMPARE(stats.hits, quint64(2));
+    QCOMPARE(stats.placeholderHits, quint64(1));
+    QCOMPARE(stats.outdatedHits, quint64(0));
+    QCOMPARE(stats.misses, quint64(1));
+    QCOMPARE(stats.hitRate(), 0.5);
+    QCOMPARE(stats.toVariantMap().value(QStringLiteral("hits")).toULongLong(), quint64(2));
+  }
+
+  // Resetting keeps the state of the cache
+  cache.resetStatistics();
+  {
+    const PDFPageCache::Statistics stats = cache.statistics();
+    QCOMPARE(stats.hits, quint64(0));
+    QCOMPARE(stats.insertions, quint64(0));
+    QCOMPARE(stats.count, 2);
+  }
+  cache.clear();
+  QCOMPARE(cache.statistics().outdated, 0);
+
+  // Render times are sorted into power-of-two buckets (in ms)
+  PDFPageProcessingThread::Statistics stats;
+  stats.addRenderTime(500);
+  stats.addRenderTime(1500);
+  stats.addRenderTime(3000);
+  stats.addRenderTime(5000000);
+  QCOMPARE(stats.renderCount, quint64(4));
+  QCOMPARE(stats.renderTimeMax, qint64(5000000));
+  QCOMPARE(stats.renderTimeHistogram[0], quint64(1));
+  QCOMPARE(stats.renderTimeHistogram[1], quint64(1));
+  QCOMPARE(stats.renderTimeHistogram[2], quint64(1));
+  QCOMPARE(stats.renderTimeHistogram.last(), quint64(1));
+  QCOMPARE(PDFPageProcessingThread::Statistics::renderTimeBucketLimit(PDFPageProcessingThread::Statistics::renderTimeBucketCount() - 1), qint64(-1));
+
+  PDFPageProcessingThread::Statistics sum;
+  sum += stats;
+  sum += stats;
+  QCOMPARE(sum.renderCount, quint64(8));
+  QCOMPARE(sum.renderTimeHistogram[0], quint64(2));
+  QCOMPARE(sum.renderTimeMax, qint64(5000000));
+}
+
+void TestQtPDF::pageCacheBudget()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageCacheBudget;
+  using QtPDF::Backend::PDFPageTile;
+  const qint64 MiB = 1024 * 1024;
+
+  {
+    const PDFPageCacheBudget::MemoryInfo mem = PDFPageCacheBudget::parseMemInfo("MemTotal:       16000000 kB\nMemFree:         1000000 kB\nMemAvailable:    8000000 kB\nBuffers:          100000 kB\n");
+    QCOMPARE(mem.total, qint64(16000000) * 1024);
+    QCOMPARE(mem.available, qint64(8000000) * 1024);
+    QCOMPARE(mem.underPressure, false);
+  }
+  {
+    // Old kernels don't report MemAvailable
+    const PDFPageCacheBudget::MemoryInfo mem = PDFPageCacheBudget::parseMemInfo("MemTotal: 1000 kB\nMemFree: 100 kB\nBuffers: 10 kB\nCached: 200 kB\n");
+    QCOMPARE(mem.available, qint64(310) * 1024);
+  }
+  QCOMPARE(PDFPageCacheBudget::parseMemInfo(QByteArray()).total, qint64(-1));
+
+  QCOMPARE(PDFPageCacheBudget::parsePressure("some avg10=12.50 avg60=3.00 avg300=1.00 total=1234\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"), 12.5);
+  QCOMPARE(PDFPageCacheBudget::parsePressure(QByteArray()), -1.);
+
+  PDFPageCacheBudget::MemoryInfo mem;
+  // Unknown memory: use the maximum
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 0, 64 * MiB, 1024 * MiB, 0.25), 1024 * MiB);
+  mem.total = 8192 * MiB;
+  mem.available = 1024 * MiB;
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 100 * MiB, 64 * MiB, 1024 * MiB, 0.25), 356 * MiB);
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 100 * MiB, 64 * MiB, 200 * MiB, 0.25), 200 * MiB);
+  mem.underPressure = true;
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 300 * MiB, 64 * MiB, 1024 * MiB, 0.25), 150 * MiB);
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 100 * MiB, 64 * MiB, 1024 * MiB, 0.25), 64 * MiB);
+
+  // With a base size, the cache only grows beyond it if enough memory is free
+  // and only shrinks below it under pressure
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 300 * MiB, 64 * MiB, 1024 * MiB, 0.25, 256 * MiB), 150 * MiB);
+  mem.underPressure = false;
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 0, 64 * MiB, 1024 * MiB, 0.25, 512 * MiB), 512 * MiB);
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 400 * MiB, 64 * MiB, 1024 * MiB, 0.25, 256 * MiB), 656 * MiB);
+  mem.available = -1;
+  QCOMPARE(PDFPageCacheBudget::computeBudget(mem, 0, 64 * MiB, 1024 * MiB, 0.25, 256 * MiB), 256 * MiB);
+
+  // Without adaptation, the cache size is fixed to the maximum
+  PDFPageCache cache;
+  PDFPageCacheBudget budget(cache);
+  budget.setAdaptive(false);
+  budget.setLimits(1 * MiB, 8 * MiB);
+  QCOMPARE(static_cast<qint64>(cache.maxCost()), 8 * MiB);
+  QCOMPARE(budget.targetCost(), 8 * MiB);
+
+  // 512 x 512 pixels x 4 bytes = 1 MiB
+  QSharedPointer<QImage> img(new QImage(512, 512, QImage::Format_ARGB32));
+  for (int i = 0; i < 4; ++i)
+    cache.setImage(PDFPageTile(72, 72, QRect(), nullptr, i), img, PDFPageCache::CURRENT);
+  QCOMPARE(cache.statistics().count, 4);
+
+  budget.releaseMemory();
+  QCOMPARE(budget.targetCost(), 1 * MiB);
+  QTRY_COMPARE(static_cast<qint64>(cache.maxCost()), 1 * MiB);
+  QCOMPARE(cache.statistics().count, 1);
+
+  // Without adaptation, a base size takes precedence over the maximum
+  budget.setBaseCost(4 * MiB);
+  QCOMPARE(budget.targetCost(), 4 * MiB);
+  QCOMPARE(static_cast<qint64>(cache.maxCost()), 4 * MiB);
+}
+
+void TestQtPDF::deferredData()
+{
+  Backend backend;
+  pDoc doc = backend.newDocument(QStringLiteral("pgfmanual.pdf"));
+  QVERIFY(doc);
+  QVERIFY(doc->isValid());
+
+  // Opening a document must not parse the meta data or load all pages
+  QVERIFY(!doc->isDeferredDataLoaded());
+  QCOMPARE(doc->numPages(), 726);
+
+  // Loading in a background thread
+  QFuture<bool> future = QtConcurrent::run([doc]() { return doc->loadDeferredData(); });
+  future.waitForFinished();
+  QVERIFY(future.result());
+  QVERIFY(doc->isDeferredDataLoaded());
+  QCOMPARE(doc->pageSizes().size(), 726);
+  QCOMPARE(doc->pageSize(), QSizeF(595.276, 841.89));
+
+  // Reloading discards the data
+  doc->reload();
+  QVERIFY(!doc->isDeferredDataLoaded());
+
+  // The accessors load the data on demand
+  QCOMPARE(doc->pageSize(), QSizeF(595.276, 841.89));
+  QVERIFY(doc->isDeferredDataLoaded());
+  QVERIFY(doc->loadDeferredData());
+}
+
+void TestQtPDF::tileSharing()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+
+  // Nearby resolutions share a bucket, distant ones don't
+  QCOMPARE(PDFPageTile::bucketResolution(35), PDFPageTile::bucketResolution(35.3));
+  QVERIFY(PDFPageTile::bucketResolution(35) != PDFPageTile::bucketResolution(40));
+  QCOMPARE(PDFPageTile::bucketResolution(-1), -1.);
+
+  // Documents of the same file share a cache key, other files don't
+  Backend backend;
+  pDoc doc1 = backend.newDocument(QStringLiteral("base14-fonts.pdf"));
+  pDoc doc2 = backend.newDocument(QStringLiteral("base14-fonts.pdf"));
+  pDoc doc3 = backend.newDocument(QStringLiteral("page-rotation.pdf"));
+  QVERIFY(doc1);
+  QVERIFY(doc2);
+  QVERIFY(doc3);
+  QVERIFY(doc1->cacheKey() != 0);
+  QCOMPARE(doc1->cacheKey(), doc2->cacheKey());
+  QVERIFY(doc1->cacheKey() != doc3->cacheKey());
+  QCOMPARE(PDFPageTile(72, 72, QRect(), doc1.data(), 0), PDFPageTile(72, 72, QRect(), doc2.data(), 0));
+
+  PDFPageCache & cache = QtPDF::Backend::Document::pageCache();
+  QSharedPointer<QImage> img(new QImage(16, 16, QImage::Format_ARGB32));
+  const PDFPageTile tile(35, 35, QRect(0, 0, 16, 16), doc1.data(), 0);
+  cache.setImage(tile, img, PDFPageCache::CURRENT);
+
+  // Tiles at a slightly different zoom level are found as similar tiles
+  QCOMPARE(cache.similarTiles(PDFPageTile(35.3, 35.3, QRect(16, 0, 16, 16), doc2.data(), 0)), QList<PDFPageTile>{tile});
+  QVERIFY(cache.similarTiles(tile).isEmpty());
+  QVERIFY(cache.similarTiles(PDFPageTile(35.3, 35.3, QRect(), doc3.data(), 0)).isEmpty());
+  QVERIFY(cache.similarTiles(PDFPageTile(35.3, 35.3, QRect(), doc1.data(), 1)).isEmpty());
+
+  // Reloading an unchanged file keeps the tiles current
+  doc2->reload();
+  QCOMPARE(doc2->cacheKey(), doc1->cacheKey());
+  QCOMPARE(cache.getStatus(tile), PDFPageCache::CURRENT);
+
+  // Changing the render state stops sharing, but keeps the tiles as outdated
+  // placeholders
+  doc2->renderStateChanged();
+  QVERIFY(doc2->cacheKey() != doc1->cacheKey());
+  const PDFPageTile tile2(35, 35, QRect(0, 0, 16, 16), doc2.data(), 0);
+  QCOMPARE(cache.getStatus(tile2), PDFPageCache::OUTDATED);
+  QCOMPARE(cache.getImage(tile2), img);
+  QCOMPARE(cache.getStatus(tile), PDFPageCache::CURRENT);
+
+  // Tiles are dropped once no document uses them anymore
+  doc2.reset();
+  QCOMPARE(cache.getStatus(tile2), PDFPageCache::UNKNOWN);
+  QCOMPARE(cache.getStatus(tile), PDFPageCache::CURRENT);
+}
+
+void TestQtPDF::batchLoadLinks()
+{
+  Backend backend;
+  pDoc doc = backend.newDocument(QStringLiteral("annotations.pdf"));
+  pDoc reference = backend.newDocument(QStringLiteral("annotations.pdf"));
+  QVERIFY(doc);
+  QVERIFY(reference);
+
+  // Batch loading gives the same results as loading each page
+  doc->loadLinksAndAnnotations({0, 1});
+  for (int i = 0; i < 2; ++i) {
+    pPage page = doc->page(i).toStrongRef();
+    pPage referencePage = reference->page(i).toStrongRef();
+    QVERIFY(page);
+    QVERIFY(referencePage);
+    const auto links = page->loadLinks();
+    const auto referenceLinks = referencePage->loadLinks();
+    QCOMPARE(links.size(), referenceLinks.size());
+    for (int j = 0; j < links.size(); ++j)
+      QCOMPARE(*links[j], *referenceLinks[j]);
+    QCOMPARE(page->loadAnnotations().size(), referencePage->loadAnnotations().size());
+  }
+  // Invalid page numbers are ignored
+  doc->loadLinksAndAnnotations({-1, 99});
+
+#ifdef USE_POPPLERQT
+  // Reloading an unchanged file yields the same links
+  const auto linksBefore = doc->page(0).toStrongRef()->loadLinks();
+  QVERIFY(!linksBefore.isEmpty());
+  doc->reload();
+  pPage page = doc->page(0).toStrongRef();
+  doc->loadLinksAndAnnotations({0});
+  const auto linksAfter = page->loadLinks();
+  QCOMPARE(linksAfter, linksBefore);
+#endif
+}
+
 void TestQtPDF::page_loadLinks_data()
 {
   QTest::addColumn<pPage>("page");
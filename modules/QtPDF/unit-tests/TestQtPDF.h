@@ -43,6 +43,7 @@ class TestQtPDF : public QObject
   static void compareLinks(const QtPDF::Annotation::Link & actual, const QtPDF::Annotation::Link & expected);
   static void compareSearchResults(const QList<QtPDF::Backend::SearchResult> & actual, const QList<QtPDF::Backend::SearchResult> & expected);
   static void compareToC(const QtPDF::Backend::PDFToC & actual, const QtPDF::Backend::PDFToC & expected);
+  static void compareLazyToC(const QtPDF::Backend::Document & doc, const QVector<int> & path, const QtPDF::Backend::PDFToC & expected);
 
   static void printAction(const QtPDF::PDFAction & a);
   static void printAnnotation(const QtPDF::Annotation::AbstractAnnotation & a);
@@ -135,16 +136,32 @@ private slots:
 
   void fonts_data();
   void fonts();
+  void fontsIncremental_data();
+  void fontsIncremental();
 
   void ToCItem();
 
   void toc_data();
   void toc();
+  void tocLazy_data();
+  void tocLazy();
+  void tocModel();
 
   void annotationComparison();
 
   void page_renderToImage_data();
   void page_renderToImage();
+  void page_approximateImage();
+  void spatialIndex();
+  void renderProcess();
+  void thumbnailCache();
+  void pageExporter();
+  void trace();
+  void renderStatistics();
+  void pageCacheBudget();
+  void deferredData();
+  void tileSharing();
+  void batchLoadLinks();
 
   void page_loadLinks_data();
   void page_loadLinks();
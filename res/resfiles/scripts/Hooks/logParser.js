@@ -2,8 +2,8 @@
 // Title: Errors, warnings, badboxes
 // Description: Looks for errors, warnings or badboxes in the LaTeX terminal output
 // Author: Jonathan Kew, Stefan Löffler, Antonio Macrì, Henrik Skov Midtiby
-// Version: 0.9.0
-// Date: 2017-11-05
+// Version: 0.9.1
+// Date: 2026-10-19
 // Script-Type: hook
 // Hook: AfterTypeset
 
@@ -552,6 +552,19 @@ if (typeof (justLoad) == "undefined") {
   }
 
   parser.Parse(TW.target.consoleOutput, TW.target.rootFileName);
+
+  // Mark the lines with errors next to the line numbers in the editor
+  var errorLines = {};
+  for (var i = 0, len = parser.Results.length; i < len; i++) {
+    var result = parser.Results[i];
+    if (result.Severity != Severity.Error || typeof (result.File) == "undefined" || !(result.Row > 0))
+      continue;
+    if (!errorLines.hasOwnProperty(result.File))
+      errorLines[result.File] = [];
+    errorLines[result.File].push(parseInt(result.Row, 10));
+  }
+  TW.target.setErrorLines(errorLines);
+
   TW.result = parser.GenerateReport();
 }
 undefined;
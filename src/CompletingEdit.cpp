@@ -78,6 +78,7 @@ CompletingEdit::CompletingEdit(QWidget *parent /* = nullptr */)
 	connect(this, &CompletingEdit::selectionChanged, this, &CompletingEdit::cursorPositionChangedSlot);
 
 	lineNumberArea = new Tw::UI::LineNumberWidget(this);
+	lineNumberArea->setMarkersVisible(true);
 
 	// Invoke our setDocument() method to properly set up document-specific
 	// connections
@@ -571,7 +572,7 @@ void CompletingEdit::focusInEvent(QFocusEvent *e)
 void CompletingEdit::resetExtraSelections()
 {
 	QList<ExtraSelection> selections;
-	if (highlightCurrentLine && !textCursor().hasSelection()) {
+	if (highlightCurrentLine && currentLineHighlightAllowed && !textCursor().hasSelection()) {
 		ExtraSelection sel;
 		sel.format = *currentLineFormat;
 		sel.cursor = textCursor();
@@ -588,7 +589,7 @@ void CompletingEdit::resetExtraSelections()
 
 void CompletingEdit::keyPressEvent(QKeyEvent *e)
 {
-	if (autocompleteEnabled) {
+	if (autocompleteEnabled && autocompleteAllowed) {
 		QKeySequence seq(static_cast<int>(e->modifiers()) | e->key());
 		if (seq == actionNext_Completion->shortcut() || seq == actionPrevious_Completion->shortcut() || seq == actionNext_Completion_Placeholder->shortcut() || seq == actionPrevious_Completion_Placeholder->shortcut()) {
 			if (handleCompletionShortcut(e))
@@ -1387,6 +1388,8 @@ void CompletingEdit::setDocument(QTextDocument * document)
 	QTextEdit::setDocument(document);
 	setCursorWidth(oldCursorWidth);
 	connect(document, &QTextDocument::blockCountChanged, this, &CompletingEdit::updateLineNumberAreaWidth);
+	// Saving (or undoing all changes) clears the modified-line markers
+	lineNumberArea->setDocument(document);
 }
 
 bool CompletingEdit::event(QEvent *e)
@@ -1457,6 +1460,14 @@ void CompletingEdit::setAutocompleteEnabled(bool autocomplete)
 	}
 }
 
+void CompletingEdit::setCurrentLineHighlightAllowed(bool allowed)
+{
+	if (allowed != currentLineHighlightAllowed) {
+		currentLineHighlightAllowed = allowed;
+		resetExtraSelections();
+	}
+}
+
 void CompletingEdit::setFont(const QFont & font)
 {
 	QTextEdit::setFont(font);
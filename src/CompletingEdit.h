@@ -57,6 +57,7 @@ public:
 
 	void setLineNumberDisplay(bool displayNumbers);
 	bool getLineNumbersVisible() const;
+	Tw::UI::LineNumberWidget * lineNumberWidget() const { return lineNumberArea; }
 
 	QString getIndentMode() const {
 		return autoIndentMode >= 0 && autoIndentMode < autoIndentModes().size() ?
@@ -82,6 +83,13 @@ public:
 	static void setHighlightCurrentLine(bool highlight);
 	static void setAutocompleteEnabled(bool autocomplete);
 
+	// Per-editor overrides of the global settings above (e.g., to spare very
+	// large files the cost of these features)
+	bool isCurrentLineHighlightAllowed() const { return currentLineHighlightAllowed; }
+	void setCurrentLineHighlightAllowed(bool allowed);
+	bool isAutocompleteAllowed() const { return autocompleteAllowed; }
+	void setAutocompleteAllowed(bool allowed) { autocompleteAllowed = allowed; }
+
 	void prefixLines(const QString &prefix);
 	void unPrefixLines(const QString &prefix);
 
@@ -217,6 +225,8 @@ private:
 
 	static bool highlightCurrentLine;
 	static bool autocompleteEnabled;
+	bool currentLineHighlightAllowed{true};
+	bool autocompleteAllowed{true};
 };
 
 #endif // COMPLETING_EDIT_H
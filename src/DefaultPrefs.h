@@ -45,6 +45,21 @@ const bool kDefault_AllowScriptFileWriting = false;
 const bool kDefault_EnableScriptingPlugins = false;
 const bool kDefault_AllowSystemCommands = false;
 const bool kDefault_ScriptDebugger = false;
+// Size of the render cache; if kDefault_PDFPageCacheAdaptive is true, the cache
+// grows beyond that while enough memory is available and shrinks (down to
+// kDefault_PDFPageCacheMinSizeMiB) when memory gets tight
 const int kDefault_PDFPageCacheSizeMiB = 256;
+const int kDefault_PDFPageCacheMinSizeMiB = 64;
+const bool kDefault_PDFPageCacheAdaptive = true;
+// 0 renders PDFs in-process
+const int kDefault_PDFRenderProcesses = 0;
+const bool kDefault_PDFPersistentThumbnails = false;
+const bool kDefault_PreloadDictionaries = false;
+// Number of recently used spell checking languages remembered for preloading
+const int kDefault_RecentSpellcheckLanguages = 3;
+// Files larger than this (in bytes) or with more lines are opened in
+// large-file mode; 0 disables the respective check
+const qint64 kDefault_LargeFileSize = 4 * 1024 * 1024;
+const int kDefault_LargeFileLines = 100000;
 
 #endif // !defined(DefaultPrefs_H)
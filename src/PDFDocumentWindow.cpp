@@ -22,6 +22,7 @@
 #include "PDFDocumentWindow.h"
 
 #include "../modules/QtPDF/src/PDFDocumentScene.h"
+#include "../modules/QtPDF/src/PDFPageExporter.h"
 #include "FindDialog.h"
 #include "Settings.h"
 #include "TWApp.h"
@@ -42,6 +43,9 @@
 #include <QMessageBox>
 #include <QPaintEngine>
 #include <QPainter>
+#include <QPrintDialog>
+#include <QPrinter>
+#include <QProgressDialog>
 #include <QRegion>
 #include <QScrollArea>
 #include <QScrollBar>
@@ -54,6 +58,7 @@
 #include <QUrl>
 #include <QVector>
 #include <cmath>
+#include <memory>
 
 
 #define SYNCTEX_GZ_EXT	".synctex.gz"
@@ -304,6 +309,16 @@ void PDFDocumentWindow::init()
 	addDockWidget(Qt::LeftDockWidgetArea, dw);
 	menuShow->addAction(dw->toggleViewAction());
 
+	dw = pdfWidget->dockWidget(QtPDF::PDFDocumentView::Dock_Thumbnails, this);
+	dw->hide();
+	addDockWidget(Qt::LeftDockWidgetArea, dw);
+	menuShow->addAction(dw->toggleViewAction());
+
+	dw = pdfWidget->dockWidget(QtPDF::PDFDocumentView::Dock_RenderStatistics, this);
+	dw->hide();
+	addDockWidget(Qt::BottomDockWidgetArea, dw);
+	menuShow->addAction(dw->toggleViewAction());
+
 	Tw::Settings settings;
 	switch(settings.value(QString::fromLatin1("pdfPageMode"), kDefault_PDFPageMode).toInt()) {
 		case 0:
@@ -1151,18 +1166,114 @@ void PDFDocumentWindow::maybeOpenPdf(const QString & filename, const QtPDF::PDFD
 
 void PDFDocumentWindow::print()
 {
-	// Currently, printing is not supported in a reliable, cross-platform way
-	// Instead, offer to open the document in the system's default viewer
-
-	QString msg = tr("Unfortunately, this version of %1 is unable to print PDF documents due to various technical reasons.\n").arg(QCoreApplication::applicationName());
-	msg += tr("Do you want to open the file in the default viewer for printing instead?");
-	msg += tr(" (remember to close it again to avoid access problems)");
-
-	if(QMessageBox::information(this,
-		tr("Print PDF..."), msg,
-		QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes
-	) {
-		QDesktopServices::openUrl(QUrl::fromLocalFile(curFile));
+	// Printing PDFs as such is not supported in a reliable, cross-platform way.
+	// Instead, we rasterize the pages (in parallel) and send the bitmaps to the
+	// printer.
+	QSharedPointer<QtPDF::Backend::Document> doc = pdfWidget->document().toStrongRef();
+	if (!doc || !doc->isValid())
+		return;
+	const int numPages = static_cast<int>(doc->numPages());
+
+	// The printer and painter must outlive this function as the pages are
+	// printed asynchronously; the painter is declared last so it is destroyed
+	// (and thus ended) before the printer. Unless the job completed, the
+	// printer is aborted first so that a job that is torn down prematurely
+	// (e.g., because the window is closed) doesn't print a partial document.
+	struct PrintJob {
+		~PrintJob() {
+			if (!completed)
+				printer.abort();
+		}
+		QPrinter printer{QPrinter::HighResolution};
+		QPainter painter;
+		bool firstPage{true};
+		bool completed{false};
+	};
+	std::shared_ptr<PrintJob> job = std::make_shared<PrintJob>();
+	QPrinter & printer = job->printer;
+	printer.setDocName(QFileInfo(curFile).fileName());
+	// PDF pages include their margins already
+	printer.setFullPage(true);
+	QPrintDialog dialog(&printer, this);
+	dialog.setWindowTitle(tr("Print PDF..."));
+	dialog.setMinMax(1, numPages);
+	dialog.setOption(QAbstractPrintDialog::PrintCurrentPage);
+	if (dialog.exec() != QDialog::Accepted)
+		return;
+
+	QVector<int> pages;
+	switch (printer.printRange()) {
+		case QPrinter::PageRange:
+			for (int i = printer.fromPage(); i <= printer.toPage(); ++i)
+				pages << i - 1;
+			break;
+		case QPrinter::CurrentPage:
+			pages << static_cast<int>(pdfWidget->currentPage());
+			break;
+		default:
+			pages = QtPDF::PDFPageExporter::parsePageRange(QString(), numPages);
+			break;
+	}
+
+	// Owned by this window, so closing it cancels the export (without emitting
+	// finished()); the print job is then aborted when the last reference to it
+	// goes away
+	QtPDF::PDFPageExporter * exporter = new QtPDF::PDFPageExporter(this);
+	exporter->setFileName(doc->fileName());
+	exporter->setPassword(doc->password());
+	exporter->setPages(pages);
+	// Render at the printer's resolution, but don't let high-end devices make
+	// us produce gigantic bitmaps
+	const double resolution = qMin(printer.resolution(), 600);
+	exporter->setResolution(resolution);
+
+	if (!job->painter.begin(&printer)) {
+		delete exporter;
+		QMessageBox::warning(this, tr("Print PDF..."), tr("Printing could not be started."));
+		return;
+	}
+	exporter->setPageSink([job, resolution](const int pageNum, const QImage & image) {
+		Q_UNUSED(pageNum)
+		if (!job->firstPage && !job->printer.newPage())
+			return false;
+		job->firstPage = false;
+		// Print at the original size, unless the page doesn't fit on the paper
+		const QRect paper = job->painter.viewport();
+		QSizeF size = QSizeF(image.size()) * (job->printer.resolution() / resolution);
+		if (size.width() > paper.width() || size.height() > paper.height())
+			size.scale(paper.size(), Qt::KeepAspectRatio);
+		QRectF target(QPointF(0, 0), size);
+		target.moveCenter(QRectF(paper).center());
+		job->painter.drawImage(target, image);
+		return true;
+	});
+
+	QProgressDialog * progress = new QProgressDialog(tr("Printing %1...").arg(QFileInfo(curFile).fileName()), tr("Cancel"), 0, static_cast<int>(pages.size()), this);
+	progress->setWindowModality(Qt::WindowModal);
+	progress->setMinimumDuration(500);
+	connect(exporter, &QtPDF::PDFPageExporter::progress, progress, &QProgressDialog::setValue);
+	connect(progress, &QProgressDialog::canceled, exporter, &QtPDF::PDFPageExporter::cancel);
+
+	// Only one print job at a time
+	actionPrintPdf->setEnabled(false);
+	connect(exporter, &QtPDF::PDFPageExporter::finished, this, [this, job, exporter, progress](bool ok) {
+		job->completed = ok;
+		if (!ok)
+			job->printer.abort();
+		job->painter.end();
+		if (!ok && !exporter->errorString().isEmpty())
+			QMessageBox::warning(this, tr("Print PDF..."), tr("Printing failed: %1").arg(exporter->errorString()));
+		progress->deleteLater();
+		exporter->deleteLater();
+		actionPrintPdf->setEnabled(true);
+	});
+	if (!exporter->start()) {
+		job->printer.abort();
+		job->painter.end();
+		QMessageBox::warning(this, tr("Print PDF..."), tr("Printing failed: %1").arg(exporter->errorString()));
+		delete progress;
+		delete exporter;
+		actionPrintPdf->setEnabled(true);
 	}
 }
 
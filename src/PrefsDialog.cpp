@@ -68,6 +68,18 @@ void PrefsDialog::init()
 
 	connect(tabWidget, &QTabWidget::currentChanged, this, &PrefsDialog::changedTabPanel);
 
+	// The minimum only matters if the cache size adapts to the available memory
+	connect(pdfPageCacheAdaptive, &QCheckBox::toggled, pdfPageCacheMinSizeMiB, &QSpinBox::setEnabled);
+	// Keep the range valid
+	connect(pdfPageCacheMinSizeMiB, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this](const int value) {
+		if (pdfPageCacheSizeMiB->value() < value)
+			pdfPageCacheSizeMiB->setValue(value);
+	});
+	connect(pdfPageCacheSizeMiB, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this](const int value) {
+		if (pdfPageCacheMinSizeMiB->value() > value)
+			pdfPageCacheMinSizeMiB->setValue(value);
+	});
+
 	pathsChanged = toolsChanged = false;
 }
 
@@ -372,7 +384,9 @@ void PrefsDialog::restoreDefaults()
 
 			resolution->setDpi(QApplication::screens().first()->physicalDotsPerInch());
 
+			pdfPageCacheMinSizeMiB->setValue(kDefault_PDFPageCacheMinSizeMiB);
 			pdfPageCacheSizeMiB->setValue(kDefault_PDFPageCacheSizeMiB);
+			pdfPageCacheAdaptive->setChecked(kDefault_PDFPageCacheAdaptive);
 
 			switch (TWSynchronizer::kDefault_Resolution_ToTeX) {
 				case TWSynchronizer::CharacterResolution:
@@ -640,8 +654,10 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 	double oldResolution = settings.value(QString::fromLatin1("previewResolution"), QApplication::screens().first()->physicalDotsPerInch()).toDouble();
 	dlg.resolution->setDpi(oldResolution);
 
+	dlg.pdfPageCacheMinSizeMiB->setValue(settings.value(QStringLiteral("pdfPageCacheMinSizeMiB"), kDefault_PDFPageCacheMinSizeMiB).toInt());
 	const int oldPDFPageCacheSize = settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toInt();
 	dlg.pdfPageCacheSizeMiB->setValue(oldPDFPageCacheSize);
+	dlg.pdfPageCacheAdaptive->setChecked(settings.value(QStringLiteral("pdfPageCacheAdaptive"), kDefault_PDFPageCacheAdaptive).toBool());
 
 	int oldSyncToTeX = settings.value(QString::fromLatin1("syncResolutionToTeX"), TWSynchronizer::kDefault_Resolution_ToTeX).toInt();
 	dlg.cbSyncToTeX->setCurrentIndex(oldSyncToTeX);
@@ -831,9 +847,10 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 			}
 		}
 
-		const int pdfPageCacheSize = dlg.pdfPageCacheSizeMiB->value();
-		settings.setValue(QStringLiteral("pdfPageCacheSizeMiB"), pdfPageCacheSize);
-		QtPDF::Backend::Document::pageCache().setMaxCost(pdfPageCacheSize * 1024 * 1024);
+		settings.setValue(QStringLiteral("pdfPageCacheMinSizeMiB"), dlg.pdfPageCacheMinSizeMiB->value());
+		settings.setValue(QStringLiteral("pdfPageCacheSizeMiB"), dlg.pdfPageCacheSizeMiB->value());
+		settings.setValue(QStringLiteral("pdfPageCacheAdaptive"), dlg.pdfPageCacheAdaptive->isChecked());
+		TWApp::instance()->applyPDFPageCacheSettings();
 
 		int syncToTeX = dlg.cbSyncToTeX->currentIndex();
 		if (syncToTeX != oldSyncToTeX)
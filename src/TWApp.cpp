@@ -24,6 +24,9 @@
 #include "DefaultBinaryPaths.h"
 #include "DefaultPrefs.h"
 #include "PDFDocumentWindow.h"
+#include "PDFPageCacheBudget.h"
+#include "PDFRenderProcess.h"
+#include "PDFTrace.h"
 #include "PrefsDialog.h"
 #include "ResourcesDialog.h"
 #include "Settings.h"
@@ -42,6 +45,7 @@
 
 #include <QAction>
 #include <QDesktopServices>
+#include <QDir>
 #include <QEvent>
 #include <QFileDialog>
 #include <QKeyEvent>
@@ -51,6 +55,7 @@
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QStandardPaths>
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
@@ -176,10 +181,30 @@ void TWApp::init()
 	if (!defaultCodec)
 		defaultCodec = QTextCodec::codecForName("UTF-8");
 
-	QtPDF::Backend::Document::pageCache().setMaxCost(settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toInt() * 1024 * 1024);
+	applyPDFPageCacheSettings();
+	// Hidden setting: render PDFs in separate processes so broken files cannot
+	// crash TeXworks
+	QtPDF::Backend::RenderProcessPool::instance().setProcessCount(settings.value(QStringLiteral("pdfRenderProcesses"), kDefault_PDFRenderProcesses).toInt());
+	// Hidden setting: keep PDF thumbnails on disk so they are available right
+	// away the next time a file is opened
+	if (settings.value(QStringLiteral("pdfPersistentThumbnails"), kDefault_PDFPersistentThumbnails).toBool())
+		QtPDF::Backend::Document::thumbnailCache().setCacheDirectory(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(QStringLiteral("thumbnails")));
+	// Hidden setting: trace the PDF rendering pipeline and write the trace (in
+	// Chrome's trace event format) to the given file on exit
+	const QString pdfTraceFile = settings.value(QStringLiteral("pdfTraceFile")).toString();
+	if (!pdfTraceFile.isEmpty()) {
+		QtPDF::Trace::setEnabled(true);
+		connect(this, &QCoreApplication::aboutToQuit, this, [pdfTraceFile]() { QtPDF::Trace::writeJson(pdfTraceFile); });
+	}
 
 	TWUtils::readConfig();
 
+	// Hidden setting: load the dictionaries of the recently used spell checking
+	// languages in the background so opening a file doesn't have to wait for
+	// them
+	if (settings.value(QStringLiteral("preloadDictionaries"), kDefault_PreloadDictionaries).toBool())
+		Tw::Document::SpellCheckManager::preloadDictionaries(settings.value(QStringLiteral("recentSpellcheckLanguages")).toStringList());
+
 	scriptManager = new TWScriptManager;
 
 	connect(this, &QGuiApplication::focusObjectChanged, this, [=](QObject * focusObj) {
@@ -402,7 +427,9 @@ void TWApp::maybeQuit()
 #if defined(Q_OS_DARWIN)
 	setQuitOnLastWindowClosed(true);
 #endif
+	m_quitting = true;
 	closeAllWindows();
+	m_quitting = false;
 #if defined(Q_OS_DARWIN)
 	setQuitOnLastWindowClosed(false);
 	// If maybeQuit() was called from the global menu (i.e., no windows were open),
@@ -1462,6 +1489,35 @@ QList<QVariant> TWApp::getOpenWindows() const
 	return result;
 }
 
+void TWApp::applyPDFPageCacheSettings()
+{
+	Tw::Settings settings;
+	if (!m_pdfPageCacheBudget)
+		m_pdfPageCacheBudget = new QtPDF::Backend::PDFPageCacheBudget(QtPDF::Backend::Document::pageCache(), this);
+	const qint64 MiB = 1024 * 1024;
+	// How far the cache may grow beyond its configured size if it adapts to
+	// the available memory
+	const qint64 maxGrowth = 4;
+	const qint64 size = settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toLongLong() * MiB;
+	m_pdfPageCacheBudget->setAdaptive(settings.value(QStringLiteral("pdfPageCacheAdaptive"), kDefault_PDFPageCacheAdaptive).toBool());
+	m_pdfPageCacheBudget->setLimits(settings.value(QStringLiteral("pdfPageCacheMinSizeMiB"), kDefault_PDFPageCacheMinSizeMiB).toLongLong() * MiB, maxGrowth * size);
+	m_pdfPageCacheBudget->setBaseCost(size);
+}
+
+QMap<QString, QVariant> TWApp::getPDFRenderStatistics() const
+{
+	QMap<QString, QVariant> result;
+	result[QStringLiteral("cache")] = QtPDF::Backend::Document::pageCache().statistics().toVariantMap();
+	result[QStringLiteral("rendering")] = QtPDF::Backend::PDFPageProcessingThread::totalStatistics().toVariantMap();
+	return result;
+}
+
+void TWApp::resetPDFRenderStatistics()
+{
+	QtPDF::Backend::Document::pageCache().resetStatistics();
+	QtPDF::Backend::PDFPageProcessingThread::resetTotalStatistics();
+}
+
 void TWApp::setGlobal(const QString& key, const QVariant& val)
 {
 	QVariant v = val;
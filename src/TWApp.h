@@ -44,6 +44,12 @@
 class Engine;
 class TWScriptManager;
 
+namespace QtPDF {
+namespace Backend {
+class PDFPageCacheBudget;
+} // namespace Backend
+} // namespace QtPDF
+
 #if defined(Q_OS_WIN)
 #define PATH_LIST_SEP   ";"
 #define EXE             ".exe"
@@ -113,6 +119,13 @@ public:
 
 	TWScriptManager* getScriptManager() { return scriptManager; }
 
+	// (Re-)reads the size limits of the PDF render cache from the settings
+	void applyPDFPageCacheSettings();
+
+	// Whether maybeQuit() is closing all windows at the moment (e.g., so that
+	// windows that can't close right away can retry quitting later)
+	bool isQuitting() const { return m_quitting; }
+
 	QWidget * topWindow() const;
 	QWidget * topTeXWindow() const;
 	QWidget * topPDFWindow() const;
@@ -127,6 +140,11 @@ public:
 
 	Q_INVOKABLE QList<QVariant> getOpenWindows() const;
 
+	// Statistics of the PDF page cache and the PDF rendering threads, e.g., for
+	// hook scripts that monitor performance
+	Q_INVOKABLE QMap<QString, QVariant> getPDFRenderStatistics() const;
+	Q_INVOKABLE void resetPDFRenderStatistics();
+
 	// return the version of Tw (0xMMNNPP)
 	Q_INVOKABLE
 	static int getVersion();
@@ -280,6 +298,10 @@ private:
 
 	Tw::Utils::TypesetManager m_typesetManager{this};
 
+	QtPDF::Backend::PDFPageCacheBudget * m_pdfPageCacheBudget{nullptr};
+
+	bool m_quitting{false};
+
 	static TWApp *theAppInstance;
 	Tw::InterProcessCommunicator m_IPC;
 
@@ -22,10 +22,9 @@
 #include "TeXDocks.h"
 
 #include "TeXDocumentWindow.h"
+#include "document/TagsModel.h"
 
 #include <QHeaderView>
-#include <QScrollBar>
-#include <QTreeWidget>
 
 TeXDock::TeXDock(const QString & title, TeXDocumentWindow * doc)
 	: QDockWidget(title, doc), document(doc), filled(false)
@@ -48,98 +47,84 @@ TagsDock::TagsDock(TeXDocumentWindow * doc)
 {
 	setObjectName(QString::fromLatin1("tags"));
 	setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
-	tree = new TeXDockTreeWidget(this);
+	tree = new TeXDockTreeView(this);
 	tree->header()->hide();
 	tree->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+	// All rows have the same height, which allows the view to skip measuring
+	// them (important for documents with many tags)
+	tree->setUniformRowHeights(true);
+	model = new Tw::Document::TagsModel(this);
+	tree->setModel(model);
 	setWidget(tree);
+
+	updateTimer.setSingleShot(true);
+	updateTimer.setInterval(250);
+	connect(&updateTimer, &QTimer::timeout, this, &TagsDock::fillInfo);
+
+	connect(model, &QAbstractItemModel::rowsInserted, this, &TagsDock::expandInsertedRows);
+	connect(tree->selectionModel(), &QItemSelectionModel::currentChanged, this, &TagsDock::followTagSelection);
+	connect(tree, &QTreeView::activated, this, &TagsDock::followTagSelection);
+	connect(tree, &QTreeView::clicked, this, &TagsDock::followTagSelection);
 	connect(doc->textDoc(), &Tw::Document::TeXDocument::tagsChanged, this, &TagsDock::listChanged);
-	saveScrollValue = 0;
 }
 
 void TagsDock::fillInfo()
 {
-	disconnect(tree, &QTreeWidget::itemSelectionChanged, this, &TagsDock::followTagSelection);
-	disconnect(tree, &QTreeWidget::itemActivated, this, &TagsDock::followTagSelection);
-	disconnect(tree, &QTreeWidget::itemClicked, this, &TagsDock::followTagSelection);
-	tree->clear();
-	const QList<Tw::Document::TextDocument::Tag> & tags = document->textDoc()->getTags();
-	if (!tags.empty()) {
-		QTreeWidgetItem *item = nullptr, *bmItem = nullptr;
-		QTreeWidgetItem *bookmarks = new QTreeWidgetItem(tree);
-		bookmarks->setText(0, tr("Bookmarks"));
-		bookmarks->setFlags(Qt::ItemIsEnabled);
-		bookmarks->setForeground(0, Qt::blue);
-		tree->expandItem(bookmarks);
-		QTreeWidgetItem *outline = new QTreeWidgetItem(tree, bookmarks);
-		outline->setText(0, tr("Outline"));
-		outline->setFlags(Qt::ItemIsEnabled);
-		outline->setForeground(0, Qt::blue);
-		tree->expandItem(outline);
-		for (int index = 0; index < tags.size(); ++index) {
-			const Tw::Document::TextDocument::Tag & bm = tags[index];
-			if (bm.level < 1) {
-				bmItem = new QTreeWidgetItem(bookmarks, QTreeWidgetItem::UserType);
-				bmItem->setText(0, bm.text);
-				bmItem->setText(1, QString::number(index));
-			}
-			else  {
-				while (item && item->type() >= QTreeWidgetItem::UserType + static_cast<int>(bm.level))
-					item = item->parent();
-				if (!item)
-					item = new QTreeWidgetItem(outline, QTreeWidgetItem::UserType + static_cast<int>(bm.level));
-				else
-					item = new QTreeWidgetItem(item, QTreeWidgetItem::UserType + static_cast<int>(bm.level));
-				item->setText(0, bm.text);
-				item->setText(1, QString::number(index));
-				tree->expandItem(item);
-			}
-		}
-		if (bookmarks->childCount() == 0)
-			bookmarks->setHidden(true);
-		if (outline->childCount() == 0)
-			outline->setHidden(true);
-		if (saveScrollValue > 0) {
-			tree->verticalScrollBar()->setValue(saveScrollValue);
-			saveScrollValue = 0;
-		}
-		connect(tree, &QTreeWidget::itemSelectionChanged, this, &TagsDock::followTagSelection);
-		connect(tree, &QTreeWidget::itemActivated, this, &TagsDock::followTagSelection);
-		connect(tree, &QTreeWidget::itemClicked, this, &TagsDock::followTagSelection);
-	} else {
-		QTreeWidgetItem *item = new QTreeWidgetItem();
-		item->setText(0, tr("No tags"));
-		item->setFlags(item->flags() & ~(Qt::ItemIsEnabled | Qt::ItemIsSelectable));
-		tree->addTopLevelItem(item);
-	}
+	updateTimer.stop();
+	// Rows disappearing may change the current item, which must not move the
+	// cursor in the editor
+	updating = true;
+	model->setTags(document->textDoc()->tagEntries());
+	updating = false;
 }
 
 void TagsDock::listChanged()
 {
-	saveScrollValue = tree->verticalScrollBar()->value();
-	tree->clear();
 	filled = false;
-	if (document && isVisible())
-		fillInfo();
+	if (!document || !isVisible())
+		return;
+	// Throttle rather than debounce so the tree keeps up while typing
+	if (!updateTimer.isActive())
+		updateTimer.start();
+	filled = true;
+}
+
+void TagsDock::followTagSelection(const QModelIndex & index)
+{
+	if (updating)
+		return;
+	const int tagIndex = model->tagIndex(index);
+	if (tagIndex >= 0)
+		document->goToTag(tagIndex);
 }
 
-void TagsDock::followTagSelection()
+void TagsDock::expandInsertedRows(const QModelIndex & parent, int first, int last)
 {
-	QList<QTreeWidgetItem*> items = tree->selectedItems();
-	if (items.count() > 0) {
-		QTreeWidgetItem* item = items.first();
-		QString dest = item->text(1);
-		if (!dest.isEmpty())
-			document->goToTag(dest.toInt());
+	// New items are shown expanded (but items the user collapsed stay so);
+	// this includes items that just got their first children
+	if (parent.isValid() && first == 0 && last == model->rowCount(parent) - 1)
+		tree->expand(parent);
+	QList<QModelIndex> pending;
+	for (int row = first; row <= last; ++row)
+		pending.append(model->index(row, 0, parent));
+	while (!pending.isEmpty()) {
+		const QModelIndex index = pending.takeLast();
+		const int rows = model->rowCount(index);
+		if (rows == 0)
+			continue;
+		tree->expand(index);
+		for (int row = 0; row < rows; ++row)
+			pending.append(model->index(row, 0, index));
 	}
 }
 
-TeXDockTreeWidget::TeXDockTreeWidget(QWidget* parent)
-	: QTreeWidget(parent)
+TeXDockTreeView::TeXDockTreeView(QWidget* parent)
+	: QTreeView(parent)
 {
 	setIndentation(10);
 }
 
-QSize TeXDockTreeWidget::sizeHint() const
+QSize TeXDockTreeView::sizeHint() const
 {
 	return QSize(180, 300);
 }
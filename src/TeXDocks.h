@@ -25,12 +25,18 @@
 #include <QDockWidget>
 #include <QListWidget>
 #include <QScrollArea>
-#include <QTreeWidget>
+#include <QTimer>
+#include <QTreeView>
 
 class TeXDocumentWindow;
 class QListWidget;
 class QTableWidget;
-class QTreeWidgetItem;
+
+namespace Tw {
+namespace Document {
+class TagsModel;
+} // namespace Document
+} // namespace Tw
 
 class TeXDock : public QDockWidget
 {
@@ -67,20 +73,25 @@ protected:
 	void fillInfo() override;
 
 private slots:
-	void followTagSelection();
+	void followTagSelection(const QModelIndex & index);
+	void expandInsertedRows(const QModelIndex & parent, int first, int last);
 
 private:
-	QTreeWidget *tree;
-	int saveScrollValue;
+	QTreeView *tree;
+	Tw::Document::TagsModel *model;
+	// Tags change with (almost) every keystroke; the tree is updated at most
+	// once per interval
+	QTimer updateTimer;
+	bool updating{false};
 };
 
-class TeXDockTreeWidget : public QTreeWidget
+class TeXDockTreeView : public QTreeView
 {
 	Q_OBJECT
 
 public:
-	explicit TeXDockTreeWidget(QWidget * parent);
-	~TeXDockTreeWidget() override = default;
+	explicit TeXDockTreeView(QWidget * parent);
+	~TeXDockTreeView() override = default;
 
 	QSize sizeHint() const override;
 };
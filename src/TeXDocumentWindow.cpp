@@ -36,6 +36,7 @@
 #include "scripting/ScriptAPI.h"
 #include "document/SpellChecker.h"
 #include "document/SpellCheckManager.h"
+#include "document/TextFileReader.h"
 #include "ui/ClickableLabel.h"
 #include "ui/RemoveAuxFilesDialog.h"
 #include "utils/CmdKeyFilter.h"
@@ -49,12 +50,15 @@
 #include <QCloseEvent>
 #include <QComboBox>
 #include <QDockWidget>
+#include <QEventLoop>
 #include <QFileDialog>
 #include <QFileSystemWatcher>
 #include <QFontDialog>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QPointer>
 #include <QProcess>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QScrollBar>
 #include <QSignalMapper>
@@ -62,6 +66,7 @@
 #include <QStringList>
 #include <QTextBrowser>
 #include <QTextCodec>
+#include <QTimer>
 #include <QUrl>
 
 #if defined(Q_OS_WIN)
@@ -129,6 +134,23 @@ void TeXDocumentWindow::init()
 	keepConsoleOpen = false;
 	connect(consoleTabs, &Tw::UI::ClosableTabWidget::requestClose, actionShow_Hide_Console, &QAction::trigger);
 
+	// Shown while a file is being read (unless that is done quickly)
+	statusBar()->addWidget(loadProgressBar = new QProgressBar());
+	loadProgressBar->setRange(0, 100);
+	loadProgressBar->setMaximumWidth(200);
+	loadProgressBar->setVisible(false);
+	statusBar()->addWidget(cancelLoadButton = new QPushButton(tr("Cancel")));
+	cancelLoadButton->setVisible(false);
+	connect(cancelLoadButton, &QPushButton::clicked, this, &TeXDocumentWindow::cancelLoading);
+
+	statusBar()->addPermanentWidget(largeFileLabel = new Tw::UI::ClickableLabel());
+	largeFileLabel->setFrameStyle(QFrame::StyledPanel);
+	largeFileLabel->setFont(statusBar()->font());
+	largeFileLabel->setText(tr("Large File"));
+	largeFileLabel->setToolTip(tr("Some features are turned off or restricted to the visible text to keep editing this large file responsive. Click to turn them back on."));
+	largeFileLabel->setVisible(false);
+	connect(largeFileLabel, &Tw::UI::ClickableLabel::mouseLeftClick, this, &TeXDocumentWindow::largeFileLabelClick);
+
 	statusBar()->addPermanentWidget(lineEndingLabel = new Tw::UI::ClickableLabel());
 	lineEndingLabel->setFrameStyle(QFrame::StyledPanel);
 	lineEndingLabel->setFont(statusBar()->font());
@@ -217,6 +239,17 @@ void TeXDocumentWindow::init()
 	connect(textDoc(), &Tw::Document::TeXDocument::modificationChanged, this, &TeXDocumentWindow::setWindowModified);
 	connect(textDoc(), &Tw::Document::TeXDocument::modificationChanged, this, &TeXDocumentWindow::maybeEnableSaveAndRevert);
 	connect(textDoc(), &Tw::Document::TeXDocument::modelinesChanged, this, &TeXDocumentWindow::handleModelineChange);
+	// Bookmarks (i.e., tags of level 0) are indicated next to the line numbers
+	textEdit->lineNumberWidget()->setMarkerProvider([this](const QTextBlock & block) {
+		Tw::UI::LineNumberWidget::Markers markers;
+		const int start = block.position();
+		for (const Tw::Document::TagTree::Entry & tag : textDoc()->tagEntries(start, start + block.length())) {
+			if (tag.level < 1 && tag.start >= start)
+				markers |= Tw::UI::LineNumberWidget::Marker::Bookmark;
+		}
+		return markers;
+	});
+	connect(textDoc(), &Tw::Document::TeXDocument::tagsChanged, textEdit->lineNumberWidget(), static_cast<void (Tw::UI::LineNumberWidget::*)()>(&Tw::UI::LineNumberWidget::update));
 	connect(textEdit, &CompletingEdit::cursorPositionChanged, this, &TeXDocumentWindow::showCursorPosition);
 	connect(textEdit, &CompletingEdit::selectionChanged, this, &TeXDocumentWindow::showCursorPosition);
 	connect(textEdit, &CompletingEdit::syncClick, this, &TeXDocumentWindow::syncClick);
@@ -404,6 +437,7 @@ void TeXDocumentWindow::init()
 
 	reloadSpellcheckerMenu();
 	connect(Tw::Document::SpellCheckManager::instance(), &Tw::Document::SpellCheckManager::dictionaryListChanged, this, &TeXDocumentWindow::reloadSpellcheckerMenu);
+	connect(Tw::Document::SpellCheckManager::instance(), &Tw::Document::SpellCheckManager::dictionaryLoaded, this, &TeXDocumentWindow::dictionaryLoaded);
 
 	menuShow->addAction(toolBar_run->toggleViewAction());
 	menuShow->addAction(toolBar_edit->toggleViewAction());
@@ -461,7 +495,33 @@ void TeXDocumentWindow::setLangInternal(const QString& lang)
 		return;
 	}
 
+	// Loading large dictionaries can take a while; don't block the window in
+	// the meantime but check the spelling once the dictionary is ready
+	if (!Tw::Document::SpellCheckManager::loadDictionaryAsync(lang)) {
+		pendingSpellcheckLanguage = lang;
+		highlighter->setSpellChecker(Tw::Document::SpellChecker());
+		return;
+	}
+	pendingSpellcheckLanguage.clear();
+
 	highlighter->setSpellChecker(Tw::Document::SpellChecker(lang));
+
+	if (!lang.isEmpty()) {
+		// Remember the language so its dictionary can be preloaded next time
+		Tw::Settings settings;
+		QStringList recent = settings.value(QStringLiteral("recentSpellcheckLanguages")).toStringList();
+		recent.removeAll(lang);
+		recent.prepend(lang);
+		while (recent.size() > kDefault_RecentSpellcheckLanguages)
+			recent.removeLast();
+		settings.setValue(QStringLiteral("recentSpellcheckLanguages"), recent);
+	}
+}
+
+void TeXDocumentWindow::dictionaryLoaded(const QString& lang)
+{
+	if (!pendingSpellcheckLanguage.isEmpty() && lang == pendingSpellcheckLanguage)
+		setLangInternal(lang);
 }
 
 void TeXDocumentWindow::setSpellcheckLanguage(const QString& lang)
@@ -497,6 +557,9 @@ void TeXDocumentWindow::setSpellcheckLanguage(const QString& lang)
 
 QString TeXDocumentWindow::spellcheckLanguage() const
 {
+	if (!pendingSpellcheckLanguage.isEmpty()) {
+		return pendingSpellcheckLanguage;
+	}
 	if (_texDoc == nullptr) {
 		return {};
 	}
@@ -619,7 +682,10 @@ TeXDocumentWindow* TeXDocumentWindow::open(const QString &fileName)
 	if (!fileName.isEmpty()) {
 		doc = findDocument(fileName);
 		if (!doc) {
-			if (untitled() && textEdit->document()->isEmpty() && !isWindowModified()) {
+			// While this window is loading a file (see readFile()), it is still
+			// untitled and empty, but it can't load another file; use a new
+			// window in that case
+			if (!fileReader && untitled() && textEdit->document()->isEmpty() && !isWindowModified()) {
 				loadFile(QFileInfo(fileName));
 				doc = this;
 			}
@@ -672,6 +738,20 @@ TeXDocumentWindow* TeXDocumentWindow::openDocument(const QString &fileName, bool
 
 void TeXDocumentWindow::closeEvent(QCloseEvent *event)
 {
+	if (fileReader) {
+		// loadFile() is still waiting for the file; stop reading and close the
+		// window once it has returned. If the application is quitting, this
+		// window interrupted that, so quit again (which also closes this
+		// window) instead.
+		fileReader->cancel();
+		if (TWApp::instance()->isQuitting())
+			connect(fileReader, &Tw::Document::TextFileReader::finished, TWApp::instance(), &TWApp::maybeQuit, Qt::QueuedConnection);
+		else
+			connect(fileReader, &Tw::Document::TextFileReader::finished, this, &TeXDocumentWindow::close, Qt::QueuedConnection);
+		event->ignore();
+		return;
+	}
+
 	if (process) {
 		if (QMessageBox::question(this, tr("Abort typesetting?"), tr("A typesetting process is still running and must be stopped before closing this window.\nDo you want to stop it now?"), QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::No) {
 			event->ignore();
@@ -891,62 +971,8 @@ void TeXDocumentWindow::maybeEnableSaveAndRevert(bool modified)
 	actionRevert_to_Saved->setEnabled(modified && !untitled());
 }
 
-static const char* texshopSynonyms[] = {
-	"MacOSRoman",		"Apple Roman",
-	"IsoLatin",			"ISO 8859-1",
-	"IsoLatin2",		"ISO 8859-2",
-	"IsoLatin5",		"ISO 8859-5",
-	"IsoLatin9",		"ISO 8859-9",
-//	"MacJapanese",		"",
-//	"DOSJapanese",		"",
-	"SJIS_X0213",		"Shift-JIS",
-	"EUC_JP",			"EUC-JP",
-//	"JISJapanese",		"",
-//	"MacKorean",		"",
-	"UTF-8 Unicode",	"UTF-8",
-	"Standard Unicode",	"UTF-16",
-//	"Mac Cyrillic",		"",
-//	"DOS Cyrillic",		"",
-//	"DOS Russian",		"",
-	"Windows Cyrillic",	"Windows-1251",
-	"KOI8_R",			"KOI8-R",
-//	"Mac Chinese Traditional",	"",
-//	"Mac Chinese Simplified",	"",
-//	"DOS Chinese Traditional",	"",
-//	"DOS Chinese Simplified",	"",
-//	"GBK",				"",
-//	"GB 2312",			"",
-	"GB 18030",			"GB18030-0",
-	nullptr
-};
-
-QTextCodec *TeXDocumentWindow::scanForEncoding(const QString &peekStr, bool &hasMetadata, QString &reqName)
-{
-	// peek at the file for %!TEX encoding = ....
-	QRegularExpression re(QStringLiteral(u"% *!TEX +encoding *= *([^\r\n\x2029]+)[\r\n\x2029]"), QRegularExpression::CaseInsensitiveOption);
-	QRegularExpressionMatch m = re.match(peekStr);
-	QTextCodec *reqCodec = nullptr;
-	if (m.hasMatch()) {
-		hasMetadata = true;
-		reqName = m.captured(1).trimmed();
-		reqCodec = QTextCodec::codecForName(reqName.toLatin1());
-		if (!reqCodec) {
-			static QHash<QString,QString> *synonyms = nullptr;
-			if (!synonyms) {
-				synonyms = new QHash<QString,QString>;
-				for (int i = 0; texshopSynonyms[i]; i += 2)
-					synonyms->insert(QString::fromLatin1(texshopSynonyms[i]).toLower(), QString::fromLatin1(texshopSynonyms[i+1]));
-			}
-			if (synonyms->contains(reqName.toLower()))
-				reqCodec = QTextCodec::codecForName(synonyms->value(reqName.toLower()).toLatin1());
-		}
-	}
-	else
-		hasMetadata = false;
-	return reqCodec;
-}
-
 #define PEEK_LENGTH 1024
+#define LOAD_PROGRESS_DELAY 250	// in msec
 
 QString TeXDocumentWindow::readFile(const QFileInfo & fileInfo,
 							  QTextCodec **codecUsed,
@@ -966,71 +992,127 @@ QString TeXDocumentWindow::readFile(const QFileInfo & fileInfo,
 	}
 
 	utf8BOM = false;
-	QFile file(fileInfo.absoluteFilePath());
-	// Not using QFile::Text because this prevents us reading "classic" Mac files
-	// with CR-only line endings. See issue #242.
-	if (!file.open(QFile::ReadOnly)) {
-		QMessageBox::warning(this, QCoreApplication::applicationName(),
-							 tr("Cannot read file \"%1\":\n%2")
-							 .arg(fileInfo.absoluteFilePath(), file.errorString()));
-		return QString();
-	}
 
-	QByteArray peekBytes(file.peek(PEEK_LENGTH));
+	// Only one file is read at a time (events are processed while waiting
+	// below, so, e.g., another file could be dropped onto the window; open()
+	// takes care of opening such files in a new window)
+	if (fileReader)
+		return QString();
 
-	QString reqName;
-	if (forceCodec)
-		*codecUsed = forceCodec;
-	else {
-		bool hasMetadata{false};
-		*codecUsed = scanForEncoding(QString::fromUtf8(peekBytes.constData()), hasMetadata, reqName);
-		if (!(*codecUsed)) {
-			*codecUsed = TWApp::instance()->getDefaultCodec();
-			if (hasMetadata) {
-				if (QMessageBox::warning(this, tr("Unrecognized encoding"),
-						tr("The text encoding %1 used in %2 is not supported.\n\n"
-						   "It will be interpreted as %3 instead, which may result in incorrect text.")
-							.arg(reqName, fileInfo.absoluteFilePath(), QString::fromUtf8((*codecUsed)->name().constData())),
-						QMessageBox::Ok | QMessageBox::Cancel, QMessageBox::Ok) == QMessageBox::Cancel)
-					return QString();
-			}
-		}
+	// Reading and decoding is done on a worker thread; the window stays
+	// responsive in the meantime and shows the progress if it takes a while
+	Tw::Document::TextFileReader reader;
+	fileReader = &reader;
+	const bool wasReadOnly = textEdit->isReadOnly();
+	textEdit->setReadOnly(true);
+	// As events are processed while waiting, make sure nothing can be done
+	// with the (old) text in the meantime, e.g., saving it over the file that
+	// is being reloaded; only cancelling remains possible
+	QList< QPointer<QAction> > disabledActions;
+	for (QAction * action : findChildren<QAction*>()) {
+		if (!action->isEnabled())
+			continue;
+		action->setEnabled(false);
+		disabledActions.append(action);
+	}
+	QList< QPointer<QWidget> > disabledLabels;
+	for (QWidget * label : QList<QWidget*>{lineNumberLabel, encodingLabel, lineEndingLabel, largeFileLabel}) {
+		if (!label || !label->isEnabled())
+			continue;
+		label->setEnabled(false);
+		disabledLabels.append(label);
+	}
+
+	QEventLoop loop;
+	QTimer progressDelay;
+	progressDelay.setSingleShot(true);
+	connect(&progressDelay, &QTimer::timeout, this, [this]() {
+		loadProgressBar->setValue(0);
+		loadProgressBar->setVisible(true);
+		cancelLoadButton->setVisible(true);
+		// New windows are only shown once the text is loaded otherwise
+		if (!isVisible())
+			show();
+	});
+	connect(&reader, &Tw::Document::TextFileReader::progress, loadProgressBar, &QProgressBar::setValue);
+	connect(&reader, &Tw::Document::TextFileReader::finished, &loop, &QEventLoop::quit);
+
+	reader.start(fileInfo.absoluteFilePath(), TWApp::instance()->getDefaultCodec(), forceCodec);
+	progressDelay.start(LOAD_PROGRESS_DELAY);
+	loop.exec();
+
+	progressDelay.stop();
+	loadProgressBar->setVisible(false);
+	cancelLoadButton->setVisible(false);
+	textEdit->setReadOnly(wasReadOnly);
+	for (const QPointer<QAction> & action : disabledActions) {
+		if (action)
+			action->setEnabled(true);
+	}
+	for (const QPointer<QWidget> & label : disabledLabels) {
+		if (label)
+			label->setEnabled(true);
+	}
+	maybeEnableSaveAndRevert(textEdit->document()->isModified());
+	fileReader = nullptr;
+
+	// Changes on disk that were noticed in the meantime are checked once the
+	// caller is done with this file (if it was the reloaded file, this is a
+	// no-op)
+	if (reloadAfterLoading) {
+		reloadAfterLoading = false;
+#if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
+		QTimer::singleShot(0, this, SLOT(reloadIfChangedOnDisk()));
+#else
+		QTimer::singleShot(0, this, &TeXDocumentWindow::reloadIfChangedOnDisk);
+#endif
 	}
 
-	// When using the UTF-8 codec (mib = 106), byte order marks (BOMs) are
-	// ignored during reading and not produced when writing. To keep them in
-	// files that have them, we need to check for them ourselves.
-	if ((*codecUsed)->mibEnum() == 106 && peekBytes.size() >= 3 && peekBytes[0] == '\xEF' && peekBytes[1] == '\xBB' && peekBytes[2] == '\xBF')
-		utf8BOM = true;
-
-	// If the file is empty (we're already at the end), don't try to read
-	// anything using QTextStream below as that would return a Null-String
-	// (QString()) rather than an empty string (QString("")). Instead, return
-	// an empty string right away.
-	if (file.atEnd())
-		return QStringLiteral("");
+	const Tw::Document::TextFileReader::Result result = reader.result();
+	switch (result.status) {
+		case Tw::Document::TextFileReader::Result::Status::OK:
+			break;
+		case Tw::Document::TextFileReader::Result::Status::Cancelled:
+			statusBar()->showMessage(tr("Loading \"%1\" was cancelled").arg(fileInfo.fileName()), kStatusMessageDuration);
+			return QString();
+		case Tw::Document::TextFileReader::Result::Status::Error:
+			QMessageBox::warning(this, QCoreApplication::applicationName(),
+								 tr("Cannot read file \"%1\":\n%2")
+								 .arg(fileInfo.absoluteFilePath(), result.errorString));
+			return QString();
+	}
 
-	QString text = (*codecUsed)->toUnicode(file.readAll());
+	*codecUsed = result.codec;
+	if (!result.unsupportedEncoding.isEmpty()) {
+		if (QMessageBox::warning(this, tr("Unrecognized encoding"),
+				tr("The text encoding %1 used in %2 is not supported.\n\n"
+				   "It will be interpreted as %3 instead, which may result in incorrect text.")
+					.arg(result.unsupportedEncoding, fileInfo.absoluteFilePath(), QString::fromUtf8((*codecUsed)->name().constData())),
+				QMessageBox::Ok | QMessageBox::Cancel, QMessageBox::Ok) == QMessageBox::Cancel)
+			return QString();
+	}
+	utf8BOM = result.utf8BOM;
 
 	if (lineEndings) {
-		if (text.contains(QLatin1String("\r\n"))) {
-			text.replace(QLatin1String("\r\n"), QChar::fromLatin1('\n'));
+		if (result.crlfCount > 0)
 			*lineEndings = kLineEnd_CRLF;
-		}
-		else if (text.contains(QChar::fromLatin1('\r')) && !text.contains(QChar::fromLatin1('\n'))) {
-			text.replace(QChar::fromLatin1('\r'), QChar::fromLatin1('\n'));
+		else if (result.crCount > 0 && result.lfCount == 0)
 			*lineEndings = kLineEnd_CR;
-		}
 		else
 			*lineEndings = kLineEnd_LF;
 
-		if (text.contains(QChar::fromLatin1('\r'))) {
-			text.replace(QChar::fromLatin1('\r'), QChar::fromLatin1('\n'));
+		// Lone CRs in files that otherwise use CRLF or LF
+		if (result.crCount > 0 && (*lineEndings & kLineEnd_Mask) != kLineEnd_CR)
 			*lineEndings |= kLineEnd_Mixed;
-		}
 	}
 
-	return text;
+	return result.text;
+}
+
+void TeXDocumentWindow::cancelLoading()
+{
+	if (fileReader)
+		fileReader->cancel();
 }
 
 void TeXDocumentWindow::loadFile(const QFileInfo & fileInfo, bool asTemplate, bool inBackground, bool reload, QTextCodec * forceCodec)
@@ -1043,6 +1125,10 @@ void TeXDocumentWindow::loadFile(const QFileInfo & fileInfo, bool asTemplate, bo
 		return;
 	bool identicalContent{fileContents == textEdit->text()};
 
+	// Switch features off before the text is set so they don't process it all
+	// in the first place
+	setLargeFileMode(exceedsLargeFileThresholds(fileInfo, fileContents));
+
 	// Only re-set the content if it has actually changed. Setting the content
 	// has many side effects, e.g., destroying the undo/redo stack.
 	if (!reload || !identicalContent) {
@@ -1058,7 +1144,9 @@ void TeXDocumentWindow::loadFile(const QFileInfo & fileInfo, bool asTemplate, bo
 			show();
 		QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
 
-		{
+		// Checking the layout requires laying out the whole text (possibly
+		// several times), which is prohibitive for large files
+		if (!largeFileMode) {
 			// Try to work around QTBUG-20354
 			// It seems that adding additionalFormats (as is done automatically on
 			// setPlainText() by the syntax highlighter) can disturb the layouting
@@ -1080,15 +1168,12 @@ void TeXDocumentWindow::loadFile(const QFileInfo & fileInfo, bool asTemplate, bo
 					}
 				}
 				if (isLayoutOK) break;
-				// Re-setting the document content naturally triggers a relayout
-				// (also a rehighlight). Note that layouting only works sensibly
+				// Marking the content as dirty triggers a relayout without
+				// replacing the text (which would also reset the undo stack and
+				// rehighlight everything). Note that layouting only works sensibly
 				// once show() was called, or else there is no valid widget geometry
 				// to act as bounding box.
-#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
-				doc->setPlainText(doc->toPlainText());
-#else
-				doc->setPlainText(doc->toRawText());
-#endif
+				doc->markContentsDirty(0, doc->characterCount());
 				QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
 			}
 			if (tries >= 10) {
@@ -1190,6 +1275,7 @@ void TeXDocumentWindow::delayedInit()
 
 		TeXHighlighter * highlighter = new TeXHighlighter(_texDoc);
 		connect(textEdit, &CompletingEdit::rehighlight, highlighter, &TeXHighlighter::rehighlight);
+		highlighter->addView(textEdit);
 
 		// set up syntax highlighting
 		// First, use the current file's syntaxMode property (if available)
@@ -1216,12 +1302,19 @@ void TeXDocumentWindow::delayedInit()
 			// set the default spell checking language
 			setSpellcheckLanguage(settings.value(QString::fromLatin1("language")).toString());
 		}
+		applyLargeFileFeatures();
 	}
 }
 
 #define FILE_MODIFICATION_ACCURACY	1000	// in msec
 void TeXDocumentWindow::reloadIfChangedOnDisk()
 {
+	// Don't start another load while a file is being read (see readFile());
+	// the check is repeated once that is finished
+	if (fileReader) {
+		reloadAfterLoading = true;
+		return;
+	}
 	if (untitled() || !lastModified.isValid())
 		return;
 
@@ -1679,6 +1772,70 @@ void TeXDocumentWindow::showEncodingSetting()
 	encodingLabel->setText(codec ? QString::fromUtf8(codec->name().constData()) : QString());
 }
 
+bool TeXDocumentWindow::exceedsLargeFileThresholds(const QFileInfo & fileInfo, const QString & text) const
+{
+	// Hidden settings: files larger than "largeFileSize" bytes or with more
+	// than "largeFileLines" lines are opened in large-file mode (0 disables the
+	// respective check)
+	Tw::Settings settings;
+	const qint64 maxSize = settings.value(QStringLiteral("largeFileSize"), kDefault_LargeFileSize).toLongLong();
+	const int maxLines = settings.value(QStringLiteral("largeFileLines"), kDefault_LargeFileLines).toInt();
+
+	if (maxSize > 0 && fileInfo.size() > maxSize)
+		return true;
+	return (maxLines > 0 && text.count(QChar::fromLatin1('\n')) >= maxLines);
+}
+
+void TeXDocumentWindow::setLargeFileMode(const bool enabled)
+{
+	if (enabled == largeFileMode)
+		return;
+	largeFileMode = enabled;
+	// Opt-ins only apply to the file they were made for
+	largeFileFeatures = 0;
+	largeFileLabel->setVisible(largeFileMode);
+	applyLargeFileFeatures();
+}
+
+void TeXDocumentWindow::applyLargeFileFeatures()
+{
+	textEdit->setAutocompleteAllowed(isFeatureEnabled(kLargeFile_Autocompletion));
+	textEdit->setCurrentLineHighlightAllowed(isFeatureEnabled(kLargeFile_CurrentLine));
+	textEdit->lineNumberWidget()->setMarkersVisible(isFeatureEnabled(kLargeFile_LineMarkers));
+	textEdit->updateLineNumberAreaWidth(0);
+
+	TeXHighlighter * highlighter = (_texDoc ? _texDoc->getHighlighter() : nullptr);
+	if (highlighter) {
+		highlighter->setViewportOnly(!isFeatureEnabled(kLargeFile_FullHighlighting));
+		highlighter->setSpellCheckingEnabled(isFeatureEnabled(kLargeFile_SpellChecking));
+		highlighter->setTaggingEnabled(isFeatureEnabled(kLargeFile_Tags));
+	}
+}
+
+void TeXDocumentWindow::largeFilePopup(const QPoint loc)
+{
+	QMenu menu;
+	const QList< QPair<int, QString> > features{
+		{kLargeFile_FullHighlighting, tr("Highlight Entire Document")},
+		{kLargeFile_SpellChecking, tr("Spell Checking")},
+		{kLargeFile_Tags, tr("Tags")},
+		{kLargeFile_Autocompletion, tr("Auto-Completion")},
+		{kLargeFile_CurrentLine, tr("Highlight Current Line")},
+		{kLargeFile_LineMarkers, tr("Line Markers")}
+	};
+	for (const auto & feature : features) {
+		QAction * a = menu.addAction(feature.second);
+		a->setData(feature.first);
+		a->setCheckable(true);
+		a->setChecked((largeFileFeatures & feature.first) != 0);
+	}
+	QAction * result = menu.exec(largeFileLabel->mapToGlobal(loc));
+	if (!result)
+		return;
+	largeFileFeatures ^= result->data().toInt();
+	applyLargeFileFeatures();
+}
+
 void TeXDocumentWindow::encodingPopup(const QPoint loc)
 {
 	QMenu menu;
@@ -2999,6 +3156,9 @@ void TeXDocumentWindow::executeAfterTypesetHooks()
 
 	for (int i = consoleTabs->count() - 1; i > 0; --i)
 		consoleTabs->removeTab(i);
+	// Error markers from the previous run are outdated; hook scripts (e.g., the
+	// log parser) may set new ones
+	setErrorLines(QVariantMap());
 
 	foreach (Tw::Scripting::ScriptObject *so, scriptManager->getHookScripts(QString::fromLatin1("AfterTypeset"))) {
 		QVariant result;
@@ -3139,7 +3299,7 @@ void TeXDocumentWindow::handleModelineChange(QStringList changedKeys, QStringLis
 		curs.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, PEEK_LENGTH);
 		curs.endEditBlock();
 
-		QTextCodec *newCodec = scanForEncoding(curs.selectedText(), hasMetadata, reqName);
+		QTextCodec *newCodec = Tw::Document::TextFileReader::scanForEncoding(curs.selectedText(), hasMetadata, reqName);
 		if (newCodec) {
 			codec = newCodec;
 			showEncodingSetting();
@@ -3152,8 +3312,8 @@ void TeXDocumentWindow::handleModelineChange(QStringList changedKeys, QStringLis
 
 void TeXDocumentWindow::goToTag(int index)
 {
-	if (_texDoc && index < _texDoc->getTags().count()) {
-		textEdit->setTextCursor(_texDoc->getTags()[index].cursor);
+	if (_texDoc && index >= 0 && index < _texDoc->tagCount()) {
+		textEdit->setTextCursor(_texDoc->getTag(index).cursor);
 		textEdit->setFocus(Qt::OtherFocusReason);
 	}
 }
@@ -3163,6 +3323,29 @@ bool TeXDocumentWindow::isTypesetting() const
 	return (process != nullptr || TWApp::instance()->typesetManager().getOwnerForRootFile(textDoc()->getRootFilePath()) == this);
 }
 
+void TeXDocumentWindow::setErrorLines(const QVariantMap & errors)
+{
+	const QString rootFilePath = getRootFilePath();
+	const QDir rootDir = QFileInfo(rootFilePath).absoluteDir();
+	QHash<QString, QList<int> > lines;
+	for (auto it = errors.cbegin(); it != errors.cend(); ++it) {
+		const QString path = QFileInfo(rootDir.filePath(it.key())).canonicalFilePath();
+		if (path.isEmpty())
+			continue;
+		for (const QVariant & line : it.value().toList()) {
+			if (line.toInt() > 0)
+				lines[path] << line.toInt();
+		}
+	}
+
+	foreach (TeXDocumentWindow * doc, docList) {
+		if (doc != this && doc->getRootFilePath() != rootFilePath)
+			continue;
+		const QString path = doc->textDoc()->getFileInfo().canonicalFilePath();
+		doc->textEdit->lineNumberWidget()->setLineMarkers(Tw::UI::LineNumberWidget::Marker::Error, lines.value(path));
+	}
+}
+
 void TeXDocumentWindow::removeAuxFiles()
 {
 	const QString & rootFilePath = textDoc()->getRootFilePath();
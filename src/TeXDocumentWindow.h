@@ -44,10 +44,15 @@ class QComboBox;
 class QActionGroup;
 class QTextCodec;
 class QFileSystemWatcher;
+class QProgressBar;
+class QPushButton;
 
 class PDFDocumentWindow;
 
 namespace Tw {
+namespace Document {
+class TextFileReader;
+} // namespace Document
 namespace UI {
 class ClickableLabel;
 } // namespace UI
@@ -63,6 +68,15 @@ const int kTeXWindowStateVersion = 1; // increment this if we add toolbars/docks
 #define kLineEnd_Flags_Mask  0xFF00
 #define kLineEnd_Mixed       0x0100
 
+// Features that are switched off (or restricted to the visible part of the
+// text) in large-file mode unless the user opts back in
+#define kLargeFile_FullHighlighting   0x0001
+#define kLargeFile_SpellChecking      0x0002
+#define kLargeFile_Tags               0x0004
+#define kLargeFile_Autocompletion     0x0008
+#define kLargeFile_CurrentLine        0x0010
+#define kLargeFile_LineMarkers        0x0020
+
 class TeXDocumentWindow : public TWScriptableWindow, private Ui::TeXDocumentWindow
 {
 	Q_OBJECT
@@ -114,6 +128,7 @@ public:
 	void setModified(const bool m = true) { textEdit->document()->setModified(m); }
 
 	bool isTypesetting() const;
+	bool isLargeFile() const { return largeFileMode; }
 
 	qreal lineSpacing() const { return m_lineSpacing; }
 
@@ -189,6 +204,11 @@ public slots:
 	void openAt(QAction *action);
 	void sideBySide();
 	void removeAuxFiles();
+	// Marks lines with errors (e.g., found by the log parser script) in all
+	// open windows belonging to the same root document. `errors` maps file
+	// names (relative to the root file's directory) to lists of 1-based line
+	// numbers; files that are not mentioned have their markers cleared.
+	void setErrorLines(const QVariantMap & errors);
 	void setSpellcheckLanguage(const QString& lang);
 	void reloadSpellcheckerMenu();
 	void selectRange(int start, int length = 0);
@@ -201,6 +221,7 @@ public slots:
 
 private slots:
 	void setLangInternal(const QString& lang);
+	void dictionaryLoaded(const QString& lang);
 	void maybeEnableSaveAndRevert(bool modified);
 	void clipboardChanged();
 	void doReplace(ReplaceDialog::DialogCode mode);
@@ -220,8 +241,11 @@ private slots:
 	void setupFileWatcher();
 	void lineEndingPopup(const QPoint loc);
 	void encodingPopup(const QPoint loc);
+	void largeFilePopup(const QPoint loc);
 	void lineEndingLabelClick(QMouseEvent * event) { lineEndingPopup(event->pos()); }
 	void encodingLabelClick(QMouseEvent * event) { encodingPopup(event->pos()); }
+	void largeFileLabelClick(QMouseEvent * event) { largeFilePopup(event->pos()); }
+	void cancelLoading();
 	void anchorClicked(const QUrl& url);
 	void delayedInit();
 
@@ -231,7 +255,6 @@ private:
 	void detachPdf();
 	bool saveFilesHavingRoot(const QString& aRootFile);
 	void clearFileWatcher();
-	QTextCodec *scanForEncoding(const QString &peekStr, bool &hasMetadata, QString &reqName);
 	QString readFile(const QFileInfo & fileInfo, QTextCodec **codecUsed, int *lineEndings = nullptr, QTextCodec * forceCodec = nullptr);
 	void loadFile(const QFileInfo & fileInfo, bool asTemplate = false, bool inBackground = false, bool reload = false, QTextCodec * forceCodec = nullptr);
 	bool saveFile(const QFileInfo & fileInfo);
@@ -255,6 +278,11 @@ private:
 	void presentResults(const QList<SearchResult>& results);
 	void showLineEndingSetting();
 	void showEncodingSetting();
+	bool exceedsLargeFileThresholds(const QFileInfo & fileInfo, const QString & text) const;
+	void setLargeFileMode(const bool enabled);
+	void applyLargeFileFeatures();
+	bool isFeatureEnabled(const int largeFileFeature) const
+		{ return !largeFileMode || (largeFileFeatures & largeFileFeature) != 0; }
 
 	QString selectedText() { return textCursor().selectedText().replace(QChar(QChar::ParagraphSeparator), QChar::fromLatin1('\n')); }
 	QString consoleText() { return textEdit_console->toPlainText(); }
@@ -275,11 +303,26 @@ private:
 	Tw::UI::ClickableLabel * lineNumberLabel{nullptr};
 	Tw::UI::ClickableLabel * encodingLabel{nullptr};
 	Tw::UI::ClickableLabel * lineEndingLabel{nullptr};
+	Tw::UI::ClickableLabel * largeFileLabel{nullptr};
+	QProgressBar * loadProgressBar{nullptr};
+	QPushButton * cancelLoadButton{nullptr};
+	// Reader of the file currently being loaded (if any)
+	Tw::Document::TextFileReader * fileReader{nullptr};
+	// Whether reloadIfChangedOnDisk() was called while loading
+	bool reloadAfterLoading{false};
+
+	// In large-file mode, expensive features are only used if the user
+	// explicitly opts in (see kLargeFile_*)
+	bool largeFileMode{false};
+	int largeFileFeatures{0};
 
 	QActionGroup *engineActions{nullptr};
 	QString engineName;
 
 	QSignalMapper dictSignalMapper;
+	// Language whose dictionary is being loaded in the background; spell
+	// checking is switched on once it is ready
+	QString pendingSpellcheckLanguage;
 
 	QComboBox * engine{nullptr};
 	QProcess * process{nullptr};
@@ -24,12 +24,49 @@
 #include "document/TeXDocument.h"
 #include "utils/ResourcesLibrary.h"
 
+#include <QCoreApplication>
+#include <QScrollBar>
 #include <QTextCursor>
-#include <QTime>
+#include <QThread>
 #include <climits> // for INT_MAX
 
 QList<TeXHighlighter::HighlightingSpec> *TeXHighlighter::syntaxRules = nullptr;
 QList<TeXHighlighter::TagPattern> *TeXHighlighter::tagPatterns = nullptr;
+Tw::Utils::RegularExpressionSet *TeXHighlighter::tagMatcher = nullptr;
+
+namespace {
+
+// Maximum number of blocks handed to the worker but not returned yet; keeps
+// the worker from running far ahead so that, e.g., blocks scrolled into view
+// don't have to wait behind the rest of the document
+constexpr int kMaxJobsInFlight = 256;
+// Interval (in ms) in which the worker hands back partial results
+constexpr int kResultInterval = 10;
+
+QThread * workerThread = nullptr;
+
+void stopWorkerThread()
+{
+	if (!workerThread)
+		return;
+	workerThread->quit();
+	workerThread->wait();
+	delete workerThread;
+	workerThread = nullptr;
+}
+
+QThread * getWorkerThread()
+{
+	if (!workerThread) {
+		workerThread = new QThread();
+		workerThread->setObjectName(QStringLiteral("TeXHighlighter"));
+		workerThread->start(QThread::LowPriority);
+		qAddPostRoutine(stopWorkerThread);
+	}
+	return workerThread;
+}
+
+} // anonymous namespace
 
 TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent)
 	: NonblockingSyntaxHighlighter(parent)
@@ -46,9 +83,25 @@ TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent)
 	spellFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
 #endif
 	spellFormat.setUnderlineColor(Qt::red);
+
+	qRegisterMetaType<TeXHighlighter::TokenizeBatch>();
+	qRegisterMetaType<TeXHighlighter::TokenizeResults>();
+	_worker = new TeXHighlighterWorker();
+	_worker->moveToThread(getWorkerThread());
+	connect(this, &TeXHighlighter::tokenizeRequested, _worker, &TeXHighlighterWorker::tokenize);
+	connect(_worker, &TeXHighlighterWorker::tokenized, this, &TeXHighlighter::applyTokenized);
 }
 
-void TeXHighlighter::spellCheckRange(const QString &text, QString::size_type index, QString::size_type limit, const QTextCharFormat &spellFormat)
+TeXHighlighter::~TeXHighlighter()
+{
+	// The worker may still be busy with one of our batches; skip the rest and
+	// let it delete itself in its own thread
+	_worker->setGeneration(-1);
+	_worker->deleteLater();
+}
+
+//static
+void TeXHighlighter::spellCheckRange(const Tw::Document::SpellChecker & spellChecker, const QString &text, QString::size_type index, QString::size_type limit, const int format, QVector<TokenizeResult::Span> & formats)
 {
 	while (index < limit) {
 		QString::size_type start{0}, end{0};
@@ -58,8 +111,8 @@ void TeXHighlighter::spellCheckRange(const QString &text, QString::size_type ind
 			if (end > limit)
 				end = limit;
 			if (start < end) {
-				if (!_spellChecker.isWordCorrect(text.mid(start, end - start)))
-					setFormat(start, end - start, spellFormat);
+				if (!spellChecker.isWordCorrect(text.mid(start, end - start)))
+					formats.append({start, end - start, format});
 			}
 		}
 		index = end;
@@ -68,94 +121,220 @@ void TeXHighlighter::spellCheckRange(const QString &text, QString::size_type ind
 
 void TeXHighlighter::highlightBlock(const QString &text)
 {
+	TokenizeJob job;
+	job.id = _nextJobId++;
+	_jobPositions.insert(job.id, currentBlock().position());
+	job.revision = currentBlock().revision();
+	job.text = text;
+	_pendingJobs.append(job);
+	deferCurrentBlock();
+}
+
+void TeXHighlighter::chunkProcessed()
+{
+	if (_pendingJobs.empty())
+		return;
+	TokenizeBatch batch;
+	batch.generation = _generation;
+	batch.highlightIndex = highlightIndex;
+	batch.tagging = (texDoc && isTagging);
+	if (isSpellChecking)
+		batch.spellChecker = _spellChecker;
+	batch.jobs.swap(_pendingJobs);
+	_jobsInFlight += static_cast<int>(batch.jobs.size());
+	emit tokenizeRequested(batch);
+}
+
+bool TeXHighlighter::isBusy() const
+{
+	return _jobsInFlight + _pendingJobs.size() >= kMaxJobsInFlight;
+}
+
+void TeXHighlighter::adjustToEdit(const int position, const int charsRemoved, const int charsAdded)
+{
+	for (auto it = _jobPositions.begin(); it != _jobPositions.end(); ++it) {
+		if (*it >= position + charsRemoved)
+			*it += charsAdded - charsRemoved;
+		else if (*it > position)
+			*it = -1;
+	}
+}
+
+//static
+TeXHighlighter::TokenizeResult TeXHighlighter::tokenize(const TokenizeJob & job, const TokenizeBatch & batch)
+{
+	TokenizeResult result;
+	result.id = job.id;
+	result.revision = job.revision;
+	result.text = job.text;
+
+	const QString & text = job.text;
+	const Tw::Document::SpellChecker & spellChecker = batch.spellChecker;
+
 	QString::size_type charPos = 0;
-	if (highlightIndex >= 0 && highlightIndex < syntaxRules->count()) {
-		QList<HighlightingRule>& highlightingRules = (*syntaxRules)[highlightIndex].rules;
+	if (batch.highlightIndex >= 0 && batch.highlightIndex < syntaxRules->count()) {
+		const HighlightingSpec & spec = syntaxRules->at(batch.highlightIndex);
 		// Go through the whole text...
 		while (charPos < text.length()) {
 			// ... and find the highlight pattern that matches closest to the
 			// current character index
-			QString::size_type firstIndex{std::numeric_limits<QString::size_type>::max()}, len{0};
-			const HighlightingRule* firstRule = nullptr;
-			QRegularExpressionMatch firstMatch;
-			for (int i = 0; i < highlightingRules.size(); ++i) {
-				HighlightingRule &rule = highlightingRules[i];
-				QRegularExpressionMatch m = rule.pattern.match(text, charPos);
-				if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-					firstIndex = m.capturedStart();
-					firstMatch = m;
-					firstRule = &rule;
-				}
-			}
+			const Tw::Utils::RegularExpressionSet::Match m = spec.matcher.match(text, charPos);
 			// If we found a rule, apply it and advance the character index to
 			// the end of the highlighted range
-			if (firstRule && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
-				if (_spellChecker && firstIndex > charPos)
-					spellCheckRange(text, charPos, firstIndex, spellFormat);
-				setFormat(firstIndex, len, firstRule->format);
-				charPos = firstIndex + len;
-				if (_spellChecker && firstRule->spellCheck)
-					spellCheckRange(text, firstIndex, charPos, firstRule->spellFormat);
+			if (m.hasMatch() && m.length > 0) {
+				const HighlightingRule & rule = spec.rules[m.index];
+				if (spellChecker && m.start > charPos)
+					spellCheckRange(spellChecker, text, charPos, m.start, -1, result.formats);
+				result.formats.append({m.start, m.length, 2 * m.index});
+				charPos = m.start + m.length;
+				if (spellChecker && rule.spellCheck)
+					spellCheckRange(spellChecker, text, m.start, charPos, 2 * m.index + 1, result.formats);
 			}
 			// If no rule matched, we can break out of the loop
 			else
 				break;
 		}
 	}
-	if (_spellChecker)
-		spellCheckRange(text, charPos, text.length(), spellFormat);
-
-	if (texDoc) {
-		texDoc->removeTags(currentBlock().position(), currentBlock().length());
-		if (isTagging) {
-			QString::size_type index = 0;
-			while (index < text.length()) {
-				QString::size_type firstIndex{std::numeric_limits<QString::size_type>::max()}, len{0};
-				TagPattern* firstPatt = nullptr;
-				QRegularExpressionMatch firstMatch;
-				for (int i = 0; i < tagPatterns->count(); ++i) {
-					TagPattern& patt = (*tagPatterns)[i];
-					QRegularExpressionMatch m = patt.pattern.match(text, index);
-					if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-						firstIndex = m.capturedStart();
-						firstMatch = m;
-						firstPatt = &patt;
-					}
-				}
-				if (firstPatt && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
-					QTextCursor	cursor(document());
-					using pos_type = decltype(cursor.position());
-					cursor.setPosition(currentBlock().position() + static_cast<pos_type>(firstIndex));
-					cursor.setPosition(currentBlock().position() + static_cast<pos_type>(firstIndex + len), QTextCursor::KeepAnchor);
-					QString tagText = firstMatch.captured(1);
-					if (tagText.isEmpty())
-						tagText = firstMatch.captured(0);
-					texDoc->addTag(cursor, firstPatt->level, tagText);
-					index = firstIndex + len;
-				}
-				else
-					break;
+	if (spellChecker)
+		spellCheckRange(spellChecker, text, charPos, text.length(), -1, result.formats);
+
+	if (batch.tagging) {
+		QString::size_type index = 0;
+		while (index < text.length()) {
+			const Tw::Utils::RegularExpressionSet::Match m = tagMatcher->match(text, index);
+			if (m.hasMatch() && m.length > 0) {
+				QString tagText = m.captured(1);
+				if (tagText.isEmpty())
+					tagText = m.captured(0);
+				result.tags.append({m.start, m.length, tagPatterns->at(m.index).level, tagText});
+				index = m.start + m.length;
 			}
+			else
+				break;
 		}
 	}
+	return result;
+}
+
+void TeXHighlighter::applyTokenized(const TeXHighlighter::TokenizeResults & results)
+{
+	// Results computed with outdated settings are useless; the blocks have
+	// been queued for rehighlighting already
+	if (results.generation != _generation)
+		return;
+	_jobsInFlight -= static_cast<int>(results.results.size());
+
+	// Report all tag changes of this batch at once
+	if (texDoc)
+		texDoc->beginTagUpdate();
+	for (const TokenizeResult & result : results.results) {
+		const auto it = _jobPositions.find(result.id);
+		if (it == _jobPositions.end())
+			continue;
+		const int position = *it;
+		_jobPositions.erase(it);
+		// The block was removed (or merged with the previous one) in the
+		// meantime; the edit queued whatever is there now for rehighlighting
+		if (position < 0 || !document())
+			continue;
+		const QTextBlock block = document()->findBlock(position);
+		// Discard results for blocks that were changed in the meantime. The
+		// edit should have queued them for rehighlighting, but make sure they
+		// are not left without highlighting (and tags) in any case.
+		if (!block.isValid() || block.position() != position || block.revision() != result.revision || block.text() != result.text) {
+			pushHighlightBlock(block);
+			continue;
+		}
+
+		QVector<QTextLayout::FormatRange> formats;
+		formats.reserve(result.formats.size());
+		for (const TokenizeResult::Span & span : result.formats) {
+			QTextLayout::FormatRange formatRange;
+			formatRange.start = static_cast<decltype(formatRange.start)>(span.start);
+			formatRange.length = static_cast<decltype(formatRange.length)>(span.length);
+			formatRange.format = formatForId(results.highlightIndex, span.format);
+			formats.append(formatRange);
+		}
+		applyFormats(block, formats);
+
+		if (texDoc) {
+			QList<Tw::Document::TextDocument::Tag> tags;
+			for (const TokenizeResult::Tag & tag : result.tags) {
+				QTextCursor	cursor(document());
+				using pos_type = decltype(cursor.position());
+				cursor.setPosition(block.position() + static_cast<pos_type>(tag.start));
+				cursor.setPosition(block.position() + static_cast<pos_type>(tag.start + tag.length), QTextCursor::KeepAnchor);
+				tags.append(Tw::Document::TextDocument::Tag{cursor, tag.level, tag.text});
+			}
+			texDoc->replaceTags(block.position(), block.length(), tags);
+		}
+	}
+	if (texDoc)
+		texDoc->endTagUpdate();
+	markDirtyContent();
+
+	if (hasBlocksToHighlight() && !isBusy())
+		processWhenIdle();
+}
+
+const QTextCharFormat & TeXHighlighter::formatForId(const int specIndex, const int id) const
+{
+	if (id < 0)
+		return spellFormat;
+	const HighlightingRule & rule = syntaxRules->at(specIndex).rules[id / 2];
+	return (id % 2 == 0 ? rule.format : rule.spellFormat);
+}
+
+void TeXHighlighter::invalidateResults()
+{
+	++_generation;
+	_worker->setGeneration(_generation);
+	_pendingJobs.clear();
+	_jobsInFlight = 0;
+	_jobPositions.clear();
 }
 
 void TeXHighlighter::setActiveIndex(int index)
 {
 	int oldIndex = highlightIndex;
 	highlightIndex = (index >= 0 && index < syntaxRules->count()) ? index : -1;
-	if (oldIndex != highlightIndex)
+	if (oldIndex != highlightIndex) {
+		invalidateResults();
 		rehighlight();
+	}
 }
 
 void TeXHighlighter::setSpellChecker(const Tw::Document::SpellChecker & spellChecker)
 {
 	if (_spellChecker != spellChecker) {
 		_spellChecker = spellChecker;
+		invalidateResults();
 		QTimer::singleShot(1, this, SLOT(rehighlight()));
 	}
 }
 
+void TeXHighlighter::setSpellCheckingEnabled(const bool enabled)
+{
+	if (isSpellChecking == enabled)
+		return;
+	isSpellChecking = enabled;
+	invalidateResults();
+	rehighlight();
+}
+
+void TeXHighlighter::setTaggingEnabled(const bool enabled)
+{
+	if (isTagging == enabled)
+		return;
+	isTagging = enabled;
+	// Tags found so far would otherwise only disappear block by block as the
+	// blocks are rehighlighted
+	if (!isTagging && texDoc)
+		texDoc->removeTags(0, texDoc->characterCount());
+	invalidateResults();
+	rehighlight();
+}
+
 QStringList TeXHighlighter::syntaxOptions()
 {
 	loadPatterns();
@@ -182,6 +361,15 @@ void TeXHighlighter::loadPatterns()
 	QDir configDir(Tw::Utils::ResourcesLibrary::getLibraryPath(QStringLiteral("configuration")));
 	QRegularExpression whitespace(QStringLiteral("\\s+"));
 
+	// Compiles the patterns of a list of rules into a single matcher so that
+	// highlightBlock() only needs to scan the text once per highlighted range
+	auto compile = [](const HighlightingSpec & spec) {
+		QList<QRegularExpression> patterns;
+		for (const HighlightingRule & rule : spec.rules)
+			patterns.append(rule.pattern);
+		return Tw::Utils::RegularExpressionSet(patterns);
+	};
+
 	if (!syntaxRules) {
 		syntaxRules = new QList<HighlightingSpec>;
 		QFile syntaxFile(configDir.filePath(QString::fromLatin1("syntax-patterns.txt")));
@@ -198,8 +386,10 @@ void TeXHighlighter::loadPatterns()
 				QString line = QString::fromUtf8(ba.data(), ba.size());
 				QRegularExpressionMatch sectionMatch = sectionRE.match(line);
 				if (sectionMatch.capturedStart() == 0) {
-					if (spec.rules.count() > 0)
+					if (spec.rules.count() > 0) {
+						spec.matcher = compile(spec);
 						syntaxRules->append(spec);
+					}
 					spec.rules.clear();
 					spec.name = sectionMatch.captured(1);
 					continue;
@@ -246,8 +436,10 @@ void TeXHighlighter::loadPatterns()
 				if (rule.pattern.isValid())
 					spec.rules.append(rule);
 			}
-			if (spec.rules.count() > 0)
+			if (spec.rules.count() > 0) {
+				spec.matcher = compile(spec);
 				syntaxRules->append(spec);
+			}
 		}
 	}
 
@@ -276,13 +468,56 @@ void TeXHighlighter::loadPatterns()
 				}
 			}
 		}
+		QList<QRegularExpression> patterns;
+		for (const TagPattern & patt : *tagPatterns)
+			patterns.append(patt.pattern);
+		tagMatcher = new Tw::Utils::RegularExpressionSet(patterns);
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// TeXHighlighterWorker
+///////////////////////////////////////////////////////////////////////////////
+
+void TeXHighlighterWorker::tokenize(const TeXHighlighter::TokenizeBatch & batch)
+{
+	TeXHighlighter::TokenizeResults results;
+	results.generation = batch.generation;
+	results.highlightIndex = batch.highlightIndex;
+
+	QElapsedTimer timer;
+	timer.start();
+	for (const TeXHighlighter::TokenizeJob & job : batch.jobs) {
+		// Don't waste time on results that would be discarded anyway
+		if (batch.generation != _generation.loadAcquire())
+			return;
+		results.results.append(TeXHighlighter::tokenize(job, batch));
+		// Hand back results regularly so the first blocks (which are typically
+		// the visible ones) don't have to wait for the whole batch
+		if (timer.elapsed() >= kResultInterval) {
+			emit tokenized(results);
+			results.results.clear();
+			timer.restart();
+		}
+	}
+	if (!results.results.empty())
+		emit tokenized(results);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// NonblockingSyntaxHighlighter
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Time (in ms) we aim to spend on one iteration of the event loop, including
+// the highlighting chunk; corresponds to ~60 frames per second
+constexpr int kFrameTime = 16;
+constexpr int kMinTimeSlice = 2;
+constexpr int kMaxTimeSlice = 12;
+
+} // anonymous namespace
+
 void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc)
 {
 	if (_parent)
@@ -297,6 +532,69 @@ void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc)
 	}
 }
 
+void NonblockingSyntaxHighlighter::addView(QTextEdit * view)
+{
+	if (!view || _views.contains(view))
+		return;
+	_views.removeAll(QPointer<QTextEdit>());
+	_views.append(view);
+	// Newly exposed blocks should be highlighted right away
+	auto viewportChanged = [this]() {
+		if (hasBlocksToHighlight())
+			processWhenIdle();
+	};
+	connect(view->verticalScrollBar(), &QScrollBar::valueChanged, this, viewportChanged);
+	connect(view->verticalScrollBar(), &QScrollBar::rangeChanged, this, viewportChanged);
+}
+
+void NonblockingSyntaxHighlighter::setViewportOnly(const bool viewportOnly)
+{
+	if (_viewportOnly == viewportOnly)
+		return;
+	_viewportOnly = viewportOnly;
+	if (hasBlocksToHighlight())
+		processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::removeView(QTextEdit * view)
+{
+	if (!view)
+		return;
+	_views.removeAll(view);
+	disconnect(view->verticalScrollBar(), nullptr, this, nullptr);
+}
+
+QVector<NonblockingSyntaxHighlighter::range> NonblockingSyntaxHighlighter::visibleRanges() const
+{
+	QVector<range> retVal;
+	for (const QPointer<QTextEdit> & view : _views) {
+		if (!view || !view->isVisible() || view->document() != _parent)
+			continue;
+		const QRect rect = view->viewport()->rect();
+		range r;
+		r.from = view->cursorForPosition(rect.topLeft()).position();
+		r.to = view->cursorForPosition(rect.bottomRight()).position() + 1;
+		// Include some text above and below so that it is already highlighted
+		// when scrolling a bit
+		const int margin = (r.to - r.from) / 2;
+		r.from -= margin;
+		r.to += margin;
+		retVal.append(r);
+	}
+	return retVal;
+}
+
+bool NonblockingSyntaxHighlighter::hasVisibleBlocksToHighlight(const QVector<range> & visible) const
+{
+	for (const range & pending : _highlightRanges) {
+		for (const range & r : visible) {
+			if (pending.from < r.to && pending.to > r.from)
+				return true;
+		}
+	}
+	return false;
+}
+
 void NonblockingSyntaxHighlighter::rehighlight()
 {
 	if (!_parent)
@@ -321,6 +619,8 @@ void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsR
 	if (!_parent)
 		return;
 
+	adjustToEdit(position, charsRemoved, charsAdded);
+
 	// Adjust ranges already present in _highlightRanges
 	for (int i = 0; i < _highlightRanges.size(); ++i) {
 		// Adjust front (if necessary)
@@ -384,20 +684,39 @@ void NonblockingSyntaxHighlighter::sanitizeHighlightRanges()
 
 void NonblockingSyntaxHighlighter::process()
 {
-	_processingPending = false;
 	if (!_parent)
 		return;
 
-	QTime start = QTime::currentTime();
+	// How much later than requested we are called tells us how much time the
+	// event loop needs for other work. Only use the remainder of a frame for
+	// highlighting.
+	const qint64 latency = (_scheduled.isValid() ? qMax(qint64(0), _scheduled.elapsed() - _processTimer.interval()) : 0);
+	_eventLoopLatency = 0.75 * _eventLoopLatency + 0.25 * static_cast<double>(latency);
+	_timeSlice = qBound(kMinTimeSlice, kFrameTime - static_cast<int>(_eventLoopLatency), kMaxTimeSlice);
+
+	_visibleRanges = visibleRanges();
 
-	while (start.msecsTo(QTime::currentTime()) < MAX_TIME_MSECS && hasBlocksToHighlight()) {
+	QElapsedTimer timer;
+	timer.start();
+
+	while (timer.elapsed() < _timeSlice && hasBlocksToHighlight() && !isBusy()) {
 		const QTextBlock & block = nextBlockToHighlight();
+		// Only blocks outside the viewports are left
+		if (_viewportOnly && !block.isValid())
+			break;
 		if (block.isValid()) {
 			int prevUserState = block.userState();
 			_currentBlock = block;
 			_currentFormatRanges.clear();
+			_currentBlockDeferred = false;
 			highlightBlock(block.text());
 
+			if (_currentBlockDeferred) {
+				// The formats will be passed to applyFormats() later
+				popHighlightRange(block.position(), block.position() + block.length());
+				continue;
+			}
+
 #if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
 			block.layout()->setAdditionalFormats(_currentFormatRanges.toList());
 #else
@@ -412,14 +731,29 @@ void NonblockingSyntaxHighlighter::process()
 		}
 	}
 
+	chunkProcessed();
+
 	// Notify the document of our changes
 	markDirtyContent();
 
-	// if there is more work, queue another round
-	if (hasBlocksToHighlight())
+	// if there is more work, queue another round (if we are busy, the
+	// subclass takes care of that once it is ready again)
+	if (hasBlocksToHighlight() && !isBusy() && (!_viewportOnly || hasVisibleBlocksToHighlight(visibleRanges())))
 		processWhenIdle();
 }
 
+void NonblockingSyntaxHighlighter::applyFormats(const QTextBlock & block, const QVector<QTextLayout::FormatRange> & formats)
+{
+	if (!block.isValid())
+		return;
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+	block.layout()->setAdditionalFormats(formats.toList());
+#else
+	block.layout()->setFormats(formats);
+#endif
+	pushDirtyRange(block);
+}
+
 void NonblockingSyntaxHighlighter::pushHighlightBlock(const QTextBlock & block)
 {
 	if (block.isValid())
@@ -485,7 +819,36 @@ void NonblockingSyntaxHighlighter::blockHighlighted(const QTextBlock &block)
 const QTextBlock NonblockingSyntaxHighlighter::nextBlockToHighlight() const
 {
 	if (!_parent || _highlightRanges.empty()) return QTextBlock();
-	return _parent->findBlock(_highlightRanges[0].from);
+	if (_visibleRanges.empty())
+		return (_viewportOnly ? QTextBlock() : _parent->findBlock(_highlightRanges[0].from));
+
+	// Pick the pending position closest to any of the visible ranges (top to
+	// bottom inside them); this way, processing continues outward from the
+	// viewports once they are done
+	int bestPos = _highlightRanges[0].from;
+	int bestDistance = INT_MAX;
+	for (const range & pending : _highlightRanges) {
+		for (const range & visible : _visibleRanges) {
+			int pos{0}, distance{0};
+			if (pending.to <= visible.from) {
+				pos = pending.to - 1;
+				distance = visible.from - pos;
+			}
+			else if (pending.from >= visible.to) {
+				pos = pending.from;
+				distance = pos - visible.to + 1;
+			}
+			else
+				pos = qMax(pending.from, visible.from);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				bestPos = pos;
+			}
+		}
+	}
+	if (_viewportOnly && bestDistance > 0)
+		return QTextBlock();
+	return _parent->findBlock(bestPos);
 }
 
 void NonblockingSyntaxHighlighter::pushDirtyRange(const int from, const int length)
@@ -531,8 +894,12 @@ void NonblockingSyntaxHighlighter::setFormat(const QString::size_type start, con
 
 void NonblockingSyntaxHighlighter::processWhenIdle()
 {
-	if (!_processingPending) {
-		_processingPending = true;
-		QTimer::singleShot(IDLE_DELAY_TIME, this, SLOT(process()));
-	}
+	// Blocks in the viewport are highlighted as soon as possible; everything
+	// else is done in the background, leaving the rest of each frame to the
+	// event loop
+	const int delay = (hasVisibleBlocksToHighlight(visibleRanges()) ? 0 : kFrameTime - _timeSlice);
+	if (_processTimer.isActive() && _processTimer.remainingTime() <= delay)
+		return;
+	_processTimer.start(delay);
+	_scheduled.start();
 }
@@ -23,11 +23,17 @@
 #define TEX_HIGHLIGHTER_H
 
 #include "document/SpellChecker.h"
+#include "utils/RegularExpressionSet.h"
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
 #include <QRegularExpression>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
 #include <QTextDocument>
+#include <QTextEdit>
 #include <QTextLayout>
 #include <QTimer>
 
@@ -42,20 +48,38 @@ class SpellChecker;
 
 // This class implements a non-blocking syntax highlighter that is a rewrite/
 // replacement of QSyntaxHighlighter. It queues all highlight requests and
-// processes them in small chunks that take no longer than MAX_TIME_MSECS
-// before returning control to the main event loop to keep the UI responsive.
+// processes them in small chunks before returning control to the main event
+// loop to keep the UI responsive.
+// Blocks that are visible in (or close to) the viewport of any view added with
+// addView() are processed first; from there, processing continues outward. The
+// length of each chunk adapts to how much time the event loop needs for other
+// work (painting, input handling, ...) so that highlighting doesn't make
+// scrolling or typing stutter.
 // Inspired by http://enki-editor.org/2014/08/22/Syntax_highlighting.html
 class NonblockingSyntaxHighlighter : public QObject
 {
 	Q_OBJECT
 
 public:
-	NonblockingSyntaxHighlighter(QTextDocument * parent) : QObject(parent), _processingPending(false), _parent(nullptr), MAX_TIME_MSECS(5), IDLE_DELAY_TIME(40) { setDocument(parent); }
+	NonblockingSyntaxHighlighter(QTextDocument * parent) : QObject(parent), _parent(nullptr) {
+		_processTimer.setSingleShot(true);
+		connect(&_processTimer, &QTimer::timeout, this, &NonblockingSyntaxHighlighter::process);
+		setDocument(parent);
+	}
 	~NonblockingSyntaxHighlighter() override { setDocument(nullptr); }
 
 	QTextDocument * document() const { return _parent; }
 	void setDocument(QTextDocument * doc);
 
+	// Views whose visible blocks should be highlighted first
+	void addView(QTextEdit * view);
+	void removeView(QTextEdit * view);
+
+	// If set, only blocks visible in (or close to) the viewports of the views
+	// are highlighted; the rest is done once it is scrolled into view
+	bool isViewportOnly() const { return _viewportOnly; }
+	void setViewportOnly(const bool viewportOnly);
+
 public slots:
 	void rehighlight();
 	void rehighlightBlock(const QTextBlock & block);
@@ -78,17 +102,29 @@ protected:
 	void markDirtyContent();
 	void sanitizeHighlightRanges();
 
+	// Subclasses that compute formats asynchronously call this from
+	// highlightBlock() instead of setFormat(); they later hand the formats for
+	// the block to applyFormats()
+	void deferCurrentBlock() { _currentBlockDeferred = true; }
+	void applyFormats(const QTextBlock & block, const QVector<QTextLayout::FormatRange> & formats);
+	// Called at the end of each chunk of work
+	virtual void chunkProcessed() { }
+	// Called for each edit of the document (before the affected blocks are
+	// queued for rehighlighting)
+	virtual void adjustToEdit(const int position, const int charsRemoved, const int charsAdded) { Q_UNUSED(position) Q_UNUSED(charsRemoved) Q_UNUSED(charsAdded) }
+	// While this returns true, no further blocks are passed to highlightBlock()
+	virtual bool isBusy() const { return false; }
+
+protected slots:
+	void processWhenIdle();
+
 private slots:
 	void maybeRehighlightText(int position, int charsRemoved, int charsAdded);
 	void process();
-	void processWhenIdle();
 	void unlinkFromDocument() { setDocument(nullptr); }
 
 private:
-	bool _processingPending;
 	QTextDocument * _parent;
-	int MAX_TIME_MSECS;
-	int IDLE_DELAY_TIME;
 
 	struct range {
 		int from, to; // character ranges
@@ -96,19 +132,50 @@ private:
 	QVector<range> _highlightRanges;
 	QVector<range> _dirtyRanges;
 
+	// Character ranges visible in (or close to) the viewports of _views
+	QVector<range> visibleRanges() const;
+	bool hasVisibleBlocksToHighlight(const QVector<range> & visible) const;
+	QList< QPointer<QTextEdit> > _views;
+	// Updated at the beginning of each process() call
+	QVector<range> _visibleRanges;
+	bool _viewportOnly{false};
+
+	QTimer _processTimer;
+	// Time since _processTimer was started; used to measure how much later
+	// than requested process() is invoked
+	QElapsedTimer _scheduled;
+	// Smoothed estimate of the time (in ms) the event loop spends on other
+	// work between two process() calls
+	double _eventLoopLatency{0};
+	int _timeSlice{5};
+
 	QTextBlock _currentBlock;
 	QVector<QTextLayout::FormatRange> _currentFormatRanges;
+	bool _currentBlockDeferred{false};
 };
 
+class TeXHighlighterWorker;
+
+// Regular expression matching, spell checking and finding tags is done on a
+// worker thread: highlightBlock() only takes a snapshot of the block's text,
+// and the (compact) results are applied to the document when they come back.
+// Results for blocks that have been edited in the meantime are discarded.
 class TeXHighlighter : public NonblockingSyntaxHighlighter
 {
 	Q_OBJECT
 
 public:
 	explicit TeXHighlighter(Tw::Document::TeXDocument * parent);
+	~TeXHighlighter() override;
 	void setActiveIndex(int index);
 
 	void setSpellChecker(const Tw::Document::SpellChecker & spellChecker);
+	// Spell checking and tagging can be switched off independently of the
+	// syntax mode (e.g., for very large files)
+	bool isSpellCheckingEnabled() const { return isSpellChecking; }
+	void setSpellCheckingEnabled(const bool enabled);
+	bool isTaggingEnabled() const { return isTagging; }
+	void setTaggingEnabled(const bool enabled);
 	const Tw::Document::SpellChecker & getSpellChecker() const { return _spellChecker; }
 	Tw::Document::SpellChecker & getSpellChecker() { return _spellChecker; }
 
@@ -119,10 +186,64 @@ public:
 
 	static QStringList syntaxOptions();
 
+	// Snapshot of a block to be tokenized
+	struct TokenizeJob {
+		// Identifies the block (see _jobPositions)
+		quint32 id{0};
+		int revision{0};
+		QString text;
+	};
+	// Snapshots of several blocks, along with the settings to use for them
+	struct TokenizeBatch {
+		int generation{0};
+		int highlightIndex{-1};
+		bool tagging{false};
+		Tw::Document::SpellChecker spellChecker;
+		QVector<TokenizeJob> jobs;
+	};
+	struct TokenizeResult {
+		// Formats are given as ids: -1 for misspelled words outside of any
+		// rule, 2 * i for rule i, and 2 * i + 1 for misspelled words inside
+		// rule i
+		struct Span {
+			QString::size_type start;
+			QString::size_type length;
+			int format;
+		};
+		struct Tag {
+			QString::size_type start;
+			QString::size_type length;
+			unsigned int level;
+			QString text;
+		};
+		quint32 id{0};
+		int revision{0};
+		QString text;
+		QVector<Span> formats;
+		QVector<Tag> tags;
+	};
+	struct TokenizeResults {
+		int generation{0};
+		int highlightIndex{-1};
+		QVector<TokenizeResult> results;
+	};
+
+	// Thread-safe (once the patterns are loaded)
+	static TokenizeResult tokenize(const TokenizeJob & job, const TokenizeBatch & batch);
+
+signals:
+	void tokenizeRequested(const TeXHighlighter::TokenizeBatch & batch);
+
 protected:
 	void highlightBlock(const QString &text) override;
+	void chunkProcessed() override;
+	bool isBusy() const override;
+	void adjustToEdit(const int position, const int charsRemoved, const int charsAdded) override;
 
-	void spellCheckRange(const QString &text, QString::size_type index, QString::size_type limit, const QTextCharFormat &spellFormat);
+	static void spellCheckRange(const Tw::Document::SpellChecker & spellChecker, const QString &text, QString::size_type index, QString::size_type limit, const int format, QVector<TokenizeResult::Span> & formats);
+
+private slots:
+	void applyTokenized(const TeXHighlighter::TokenizeResults & results);
 
 private:
 	static void loadPatterns();
@@ -137,6 +258,8 @@ private:
 	struct HighlightingSpec {
 		QString				name;
 		HighlightingRules	rules;
+		// All rule patterns compiled into one matcher (see loadPatterns())
+		Tw::Utils::RegularExpressionSet	matcher;
 	};
 	static QList<HighlightingSpec> *syntaxRules;
 
@@ -147,13 +270,54 @@ private:
 		unsigned int level;
 	};
 	static QList<TagPattern> *tagPatterns;
+	static Tw::Utils::RegularExpressionSet *tagMatcher;
 
 	int highlightIndex;
 	bool isTagging;
+	bool isSpellChecking{true};
 
 	Tw::Document::SpellChecker _spellChecker;
 
 	Tw::Document::TeXDocument * texDoc;
+
+	const QTextCharFormat & formatForId(const int specIndex, const int id) const;
+	// Makes sure results that are still being computed are discarded
+	void invalidateResults();
+
+	TeXHighlighterWorker * _worker{nullptr};
+	// Incremented whenever the settings change in a way that invalidates
+	// results that are currently being computed
+	int _generation{0};
+	QVector<TokenizeJob> _pendingJobs;
+	int _jobsInFlight{0};
+	// Start positions of the blocks of all jobs whose results have not been
+	// applied yet, kept up to date while the document is edited (block numbers
+	// would change when lines are inserted or removed before the block); -1
+	// if the start of the block was removed
+	QHash<quint32, int> _jobPositions;
+	quint32 _nextJobId{0};
+};
+
+Q_DECLARE_METATYPE(TeXHighlighter::TokenizeBatch)
+Q_DECLARE_METATYPE(TeXHighlighter::TokenizeResults)
+
+// Lives in a thread shared by all highlighters
+class TeXHighlighterWorker : public QObject
+{
+	Q_OBJECT
+
+public:
+	// Thread-safe; batches of older generations are skipped
+	void setGeneration(const int generation) { _generation.storeRelease(generation); }
+
+public slots:
+	void tokenize(const TeXHighlighter::TokenizeBatch & batch);
+
+signals:
+	void tokenized(const TeXHighlighter::TokenizeResults & results);
+
+private:
+	QAtomicInt _generation{0};
 };
 
 #endif
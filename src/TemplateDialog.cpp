@@ -57,6 +57,7 @@ void TemplateDialog::init()
 	Tw::Settings settings;
 	if (settings.value(QString::fromLatin1("syntaxColoring"), true).toBool()) {
 		TeXHighlighter * highlighter = new TeXHighlighter(texDoc);
+		highlighter->addView(textEdit);
 		// For now, we use "LaTeX" highlighting for all files (which is probably
 		// reasonable in most/typical cases)
 		int idx = static_cast<int>(TeXHighlighter::syntaxOptions().indexOf(QStringLiteral("LaTeX")));
@@ -25,13 +25,16 @@
 
 #include <hunspell.h>
 
+#include <QFutureWatcher>
 #include <QLocale>
+#include <QtConcurrent>
 
 namespace Tw {
 namespace Document {
 
 QMultiHash<QString, QString> * SpellCheckManager::dictionaryList = nullptr;
-QHash<const QString,std::shared_ptr<Hunhandle>> * SpellCheckManager::dictionaries = nullptr;
+QHash<const QString, QFuture<std::shared_ptr<Hunhandle>>> * SpellCheckManager::dictionaries = nullptr;
+QMutex SpellCheckManager::dictionariesMutex;
 SpellCheckManager * SpellCheckManager::_instance = new SpellCheckManager();
 
 // static
@@ -81,35 +84,121 @@ QMultiHash<QString, QString> * SpellCheckManager::getDictionaryList(const bool f
 	return dictionaryList;
 }
 
+namespace {
+
+// Watchers for the loads started by loadDictionaryAsync(); only accessed from
+// the GUI thread
+QHash<QString, QFutureWatcher<std::shared_ptr<Hunhandle>> *> & loadWatchers()
+{
+	static QHash<QString, QFutureWatcher<std::shared_ptr<Hunhandle>> *> watchers;
+	return watchers;
+}
+
+std::shared_ptr<Hunhandle> createDictionary(const QString & language, const QStringList & dirs)
+{
+	foreach (QDir dicDir, dirs) {
+		QFileInfo affFile(dicDir, language + QLatin1String(".aff"));
+		QFileInfo dicFile(dicDir, language + QLatin1String(".dic"));
+		if (affFile.isReadable() && dicFile.isReadable()) {
+			return std::shared_ptr<Hunhandle>(Hunspell_create(affFile.canonicalFilePath().toLocal8Bit().data(),
+								dicFile.canonicalFilePath().toLocal8Bit().data()), Hunspell_destroy);
+		}
+	}
+	return nullptr;
+}
+
+} // anonymous namespace
+
 // static
 std::shared_ptr<Hunhandle> SpellCheckManager::getDictionary(const QString & language)
 {
 	if (language.isEmpty())
 		return nullptr;
 
+	// If the load hasn't started yet (e.g., because all threads of the pool
+	// are busy), waiting for the result runs it in this thread
+	return startLoading(language).result();
+}
+
+// static
+QFuture<std::shared_ptr<Hunhandle>> SpellCheckManager::startLoading(const QString & language)
+{
+	QMutexLocker locker(&dictionariesMutex);
+
 	if (!dictionaries)
-		dictionaries = new QHash<const QString, std::shared_ptr<Hunhandle>>;
+		dictionaries = new QHash<const QString, QFuture<std::shared_ptr<Hunhandle>>>;
 
-	if (dictionaries->contains(language))
-		return dictionaries->value(language);
+	auto it = dictionaries->constFind(language);
+	if (it != dictionaries->constEnd())
+		return it.value();
 
+	// Look up the paths here rather than in the worker as the resource library
+	// accesses the settings
 	const QStringList dirs = Tw::Utils::ResourcesLibrary::getLibraryPaths(QStringLiteral("dictionaries"));
-	foreach (QDir dicDir, dirs) {
-		QFileInfo affFile(dicDir, language + QLatin1String(".aff"));
-		QFileInfo dicFile(dicDir, language + QLatin1String(".dic"));
-		if (affFile.isReadable() && dicFile.isReadable()) {
-			auto h = std::shared_ptr<Hunhandle>(Hunspell_create(affFile.canonicalFilePath().toLocal8Bit().data(),
-								dicFile.canonicalFilePath().toLocal8Bit().data()), Hunspell_destroy);
-			dictionaries->insert(language, h);
-			return h;
-		}
+	QFuture<std::shared_ptr<Hunhandle>> future = QtConcurrent::run([language, dirs]() {
+		return createDictionary(language, dirs);
+	});
+	dictionaries->insert(language, future);
+	return future;
+}
+
+// static
+bool SpellCheckManager::isDictionaryLoaded(const QString & language)
+{
+	if (language.isEmpty())
+		return true;
+
+	QMutexLocker locker(&dictionariesMutex);
+	if (!dictionaries)
+		return false;
+	auto it = dictionaries->constFind(language);
+	return (it != dictionaries->constEnd() && it.value().isFinished());
+}
+
+// static
+bool SpellCheckManager::loadDictionaryAsync(const QString & language)
+{
+	if (language.isEmpty())
+		return true;
+
+	QFuture<std::shared_ptr<Hunhandle>> future = startLoading(language);
+	if (future.isFinished())
+		return true;
+
+	// Concurrent requests share the load and the notification
+	if (loadWatchers().contains(language))
+		return false;
+
+	QFutureWatcher<std::shared_ptr<Hunhandle>> * watcher = new QFutureWatcher<std::shared_ptr<Hunhandle>>(instance());
+	connect(watcher, &QFutureWatcherBase::finished, instance(), [language, watcher]() {
+		if (loadWatchers().value(language) == watcher)
+			loadWatchers().remove(language);
+		watcher->deleteLater();
+		emit instance()->dictionaryLoaded(language);
+	});
+	loadWatchers().insert(language, watcher);
+	watcher->setFuture(future);
+	return false;
+}
+
+// static
+void SpellCheckManager::preloadDictionaries(const QStringList & languages)
+{
+	for (const QString & language : languages) {
+		if (!language.isEmpty())
+			startLoading(language);
 	}
-	return nullptr;
 }
 
 // static
 void SpellCheckManager::clearDictionaries()
 {
+	// Loads that are still running finish in the background and still notify
+	// their requesters (which will find that the dictionary is gone and
+	// request it again), but their results are discarded
+	loadWatchers().clear();
+
+	QMutexLocker locker(&dictionariesMutex);
 	if (!dictionaries)
 		return;
 
@@ -22,8 +22,11 @@
 #define SpellCheckManager_H
 
 #include <memory>
+#include <QFuture>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QStringList>
 #include <QTextCodec>
 
 struct Hunhandle;
@@ -45,7 +48,11 @@ class SpellCheckManager : public QObject {
 	SpellCheckManager & operator=(const SpellCheckManager &) = delete;
 	SpellCheckManager & operator=(SpellCheckManager &&) = delete;
 
+	// Returns the dictionary for `language`, loading it if necessary. If the
+	// dictionary is being loaded in the background already, this waits for
+	// that load to finish rather than starting another one.
 	static std::shared_ptr<Hunhandle> getDictionary(const QString & language);
+	static QFuture<std::shared_ptr<Hunhandle>> startLoading(const QString & language);
 
 public:
 	static SpellCheckManager * instance() { return _instance; }
@@ -54,6 +61,17 @@ public:
 	// get list of available dictionaries
 	static QMultiHash<QString, QString> * getDictionaryList(const bool forceReload = false);
 
+	// Returns true if the dictionary for `language` has finished loading (or
+	// is known not to exist), i.e., if using it won't block
+	static bool isDictionaryLoaded(const QString & language);
+	// Starts loading the dictionary for `language` in the background (unless
+	// it is loaded or being loaded already); dictionaryLoaded() is emitted
+	// once it is ready. Returns true if the dictionary is ready right away.
+	static bool loadDictionaryAsync(const QString & language);
+	// Loads the given dictionaries in the background (e.g., the recently used
+	// ones at startup)
+	static void preloadDictionaries(const QStringList & languages);
+
 	// deallocates all dictionaries
 	// WARNING: Don't call this while some window is using a dictionary as that
 	// window won't be notified; deactivate spell checking in all windows first
@@ -64,11 +82,17 @@ signals:
 	// emitted when getDictionaryList reloads the dictionary list;
 	// windows can connect to it to rebuild, e.g., a spellchecking menu
 	void dictionaryListChanged() const;
+	// emitted (in the GUI thread) when a dictionary requested by
+	// loadDictionaryAsync() has been loaded (or failed to load)
+	void dictionaryLoaded(const QString & language) const;
 
 private:
 	static SpellCheckManager * _instance;
 	static QMultiHash<QString, QString> * dictionaryList;
-	static QHash<const QString,std::shared_ptr<Hunhandle>> * dictionaries;
+	// Finished and pending loads; access is guarded by dictionariesMutex as
+	// dictionaries may be requested from the syntax highlighting thread
+	static QHash<const QString, QFuture<std::shared_ptr<Hunhandle>>> * dictionaries;
+	static QMutex dictionariesMutex;
 };
 
 } // namespace Document
@@ -2,21 +2,182 @@
 
 #include "SpellCheckManager.h"
 
+#include <QMutex>
 #include <hunspell.h>
 
 namespace Tw {
 namespace Document {
 
+namespace {
+
+// Hunspell handles are not thread-safe, but they are shared between all
+// documents using the same language and are used both by the GUI and the
+// syntax highlighting thread
+QMutex & hunspellMutex()
+{
+	static QMutex mutex;
+	return mutex;
+}
+
+QAtomicInt cacheEnabled{1};
+
+} // anonymous namespace
+
+SpellCheckCache::Statistics & SpellCheckCache::Statistics::operator+=(const Statistics & other)
+{
+	hits += other.hits;
+	misses += other.misses;
+	size += other.size;
+	return *this;
+}
+
+bool SpellCheckCache::lookup(const QString & word, bool & correct)
+{
+	{
+		QReadLocker locker(&_lock);
+		QHash<QString, bool>::const_iterator it = _current.constFind(word);
+		if (it != _current.constEnd()) {
+			correct = it.value();
+			_hits.fetchAndAddRelaxed(1);
+			return true;
+		}
+		if (!_previous.contains(word)) {
+			_misses.fetchAndAddRelaxed(1);
+			return false;
+		}
+	}
+	// Move entries that are still in use to the current generation
+	QWriteLocker locker(&_lock);
+	QHash<QString, bool>::iterator it = _previous.find(word);
+	if (it == _previous.end()) {
+		// Dropped by another thread in the meantime
+		_misses.fetchAndAddRelaxed(1);
+		return false;
+	}
+	correct = it.value();
+	_previous.erase(it);
+	_current.insert(word, correct);
+	_hits.fetchAndAddRelaxed(1);
+	return true;
+}
+
+void SpellCheckCache::insert(const QString & word, const bool correct)
+{
+	QWriteLocker locker(&_lock);
+	if (_current.size() >= qMax(1, _maxSize / 2)) {
+		_previous.swap(_current);
+		_current.clear();
+	}
+	_current.insert(word, correct);
+}
+
+void SpellCheckCache::clear()
+{
+	QWriteLocker locker(&_lock);
+	_current.clear();
+	_previous.clear();
+}
+
+int SpellCheckCache::maxSize() const
+{
+	QReadLocker locker(&_lock);
+	return _maxSize;
+}
+
+void SpellCheckCache::setMaxSize(const int maxSize)
+{
+	QWriteLocker locker(&_lock);
+	_maxSize = maxSize;
+	// Start over rather than trying to trim the generations
+	if (_current.size() + _previous.size() > _maxSize) {
+		_current.clear();
+		_previous.clear();
+	}
+}
+
+SpellCheckCache::Statistics SpellCheckCache::statistics() const
+{
+	Statistics retVal;
+	retVal.hits = _hits.loadAcquire();
+	retVal.misses = _misses.loadAcquire();
+	QReadLocker locker(&_lock);
+	retVal.size = static_cast<int>(_current.size() + _previous.size());
+	return retVal;
+}
+
+// static
+std::shared_ptr<SpellCheckCache> SpellCheckCache::forDictionary(const std::shared_ptr<Hunhandle> & dictionary)
+{
+	struct Entry {
+		std::weak_ptr<Hunhandle> dictionary;
+		std::shared_ptr<SpellCheckCache> cache;
+	};
+	static QMutex mutex;
+	static QHash<const Hunhandle *, Entry> caches;
+
+	if (!dictionary)
+		return nullptr;
+
+	QMutexLocker locker(&mutex);
+	// Forget about dictionaries that have been destroyed (a new dictionary may
+	// be allocated at the same address)
+	for (auto it = caches.begin(); it != caches.end(); ) {
+		if (it.value().dictionary.expired())
+			it = caches.erase(it);
+		else
+			++it;
+	}
+	auto it = caches.find(dictionary.get());
+	if (it != caches.end())
+		return it.value().cache;
+	Entry entry;
+	entry.dictionary = dictionary;
+	entry.cache = std::make_shared<SpellCheckCache>();
+	caches.insert(dictionary.get(), entry);
+	return entry.cache;
+}
+
+// static
+bool SpellCheckCache::isEnabled()
+{
+	return cacheEnabled.loadAcquire() != 0;
+}
+
+// static
+void SpellCheckCache::setEnabled(const bool enabled)
+{
+	cacheEnabled.storeRelease(enabled ? 1 : 0);
+}
+
 std::shared_ptr<Hunhandle> SpellChecker::DictRef::getHunhandle() const
 {
 	std::shared_ptr<Hunhandle> retVal = hunhandle.lock();
-	if (!retVal) {
-		retVal = SpellCheckManager::getDictionary(language);
-		hunhandle = retVal;
-	}
+	if (retVal)
+		return retVal;
+
+	// Don't hold hunspellMutex while getting the dictionary: that may have to
+	// wait for it to be loaded in the background, which would stall all other
+	// spell checks (including those of the GUI thread)
+	retVal = SpellCheckManager::getDictionary(language);
+
+	QMutexLocker locker(&hunspellMutex());
+	// Another thread may have done the same in the meantime
+	if (hunhandle.lock() == retVal)
+		return retVal;
+	hunhandle = retVal;
+	// The dictionary was reloaded, so its cache is gone as well
+	cache.reset();
 	return retVal;
 }
 
+std::shared_ptr<SpellCheckCache> SpellChecker::DictRef::getCache() const
+{
+	std::shared_ptr<Hunhandle> dictionary = getHunhandle();
+	if (!cache && dictionary)
+		cache = SpellCheckCache::forDictionary(dictionary);
+	return cache;
+}
+
 bool SpellChecker::DictRef::operator==(const DictRef & other) const
 {
 	return (language == other.language && getHunhandle() == other.getHunhandle() && codec == other.codec);
@@ -89,7 +250,17 @@ bool SpellChecker::isWordCorrect(const QString & word) const
 			continue;
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
-		if (Hunspell_spell(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data()) != 0) {
+		std::shared_ptr<SpellCheckCache> cache = (SpellCheckCache::isEnabled() ? dictRef.getCache() : nullptr);
+		bool correct{false};
+		if (!cache || !cache->lookup(word, correct)) {
+			// The result must be cached while holding the mutex (see ignoreWord())
+			QMutexLocker locker(&hunspellMutex());
+			correct = (Hunspell_spell(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data()) != 0);
+			if (cache) {
+				cache->insert(word, correct);
+			}
+		}
+		if (correct) {
 			return true;
 		}
 	}
@@ -106,6 +277,7 @@ QList<QString> SpellChecker::suggestionsForWord(const QString & word) const
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
 		char ** suggestionList{nullptr};
+		QMutexLocker locker(&hunspellMutex());
 
 		int numSuggestions = Hunspell_suggest(ptrHunhandle.get(), &suggestionList, dictRef.codec->fromUnicode(word).data());
 		suggestions.reserve(suggestions.size() + numSuggestions);
@@ -129,11 +301,32 @@ void SpellChecker::ignoreWord(const QString & word)
 			continue;
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
+		QMutexLocker locker(&hunspellMutex());
 		// note that this is not persistent after quitting TW
 		Hunspell_add(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data());
+		// Adding a word can also affect, e.g., differently capitalized forms,
+		// so we can't just update the entry for `word`. Clear the cache before
+		// releasing the mutex so isWordCorrect() can't insert results that were
+		// obtained before the word was added.
+		std::shared_ptr<SpellCheckCache> cache = dictRef.getCache();
+		if (cache) {
+			cache->clear();
+		}
 		return;
 	}
 }
 
+SpellCheckCache::Statistics SpellChecker::cacheStatistics() const
+{
+	SpellCheckCache::Statistics retVal;
+	for (const DictRef & dictRef : m_dicts) {
+		std::shared_ptr<SpellCheckCache> cache = dictRef.getCache();
+		if (cache) {
+			retVal += cache->statistics();
+		}
+	}
+	return retVal;
+}
+
 } // namespace Document
 } // namespace Tw
@@ -2,6 +2,9 @@
 #define SpellChecker_H
 
 #include <memory>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QReadWriteLock>
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
@@ -12,18 +15,62 @@ struct Hunhandle;
 namespace Tw {
 namespace Document {
 
+// Thread-safe cache of the spell checking results of one dictionary; shared by
+// all SpellChecker objects using that dictionary.
+// Lookups only take a read lock. Once half of maxSize() words are cached, the
+// current entries are moved to a second generation (dropping the previous
+// second generation); entries found there are moved back. This approximates
+// LRU eviction without having to update anything on most lookups.
+class SpellCheckCache {
+public:
+	struct Statistics {
+		quint64 hits{0};
+		quint64 misses{0};
+		int size{0};
+
+		double hitRate() const { return (hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.); }
+		Statistics & operator+=(const Statistics & other);
+	};
+
+	// Returns false if `word` is not in the cache
+	bool lookup(const QString & word, bool & correct);
+	void insert(const QString & word, const bool correct);
+	void clear();
+
+	int maxSize() const;
+	void setMaxSize(const int maxSize);
+	Statistics statistics() const;
+
+	static std::shared_ptr<SpellCheckCache> forDictionary(const std::shared_ptr<Hunhandle> & dictionary);
+
+	// Caching is enabled by default; disabling it is mainly useful for
+	// benchmarking
+	static bool isEnabled();
+	static void setEnabled(const bool enabled);
+
+private:
+	mutable QReadWriteLock _lock;
+	QHash<QString, bool> _current;
+	QHash<QString, bool> _previous;
+	int _maxSize{20000};
+	QAtomicInteger<quint64> _hits{0};
+	QAtomicInteger<quint64> _misses{0};
+};
+
 class SpellChecker {
 	using DictType = std::shared_ptr<Hunhandle>;
 
 	struct DictRef {
 		QString language;
 		mutable std::weak_ptr<Hunhandle> hunhandle;
+		mutable std::shared_ptr<SpellCheckCache> cache;
 		QTextCodec * codec{QTextCodec::codecForLocale()};
 
 		bool operator==(const DictRef & other) const;
 		operator bool() const { return isValid(); }
 		bool isValid() const;
 		std::shared_ptr<Hunhandle> getHunhandle() const;
+		std::shared_ptr<SpellCheckCache> getCache() const;
 	};
 
 	std::vector<DictRef> m_dicts;
@@ -45,6 +92,9 @@ public:
 	QList<QString> suggestionsForWord(const QString & word) const;
 	// note that this is not persistent after quitting TW
 	void ignoreWord(const QString & word);
+
+	// Combined statistics of the caches of all dictionaries in use
+	SpellCheckCache::Statistics cacheStatistics() const;
 };
 
 } // namespace Document
@@ -0,0 +1,285 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+
+#include "document/TagTree.h"
+
+#include <limits>
+
+namespace Tw {
+namespace Document {
+
+struct TagTree::Node {
+	explicit Node(const Entry & e, const quint32 p) : entry(e), priority(p), maxEnd(e.end) { }
+
+	Entry entry;
+	quint32 priority;
+	int size{1};
+	int maxEnd;
+	// Shift that still has to be applied to the children (but has been
+	// applied to this node already)
+	int pendingShift{0};
+	NodePtr left;
+	NodePtr right;
+};
+
+TagTree::TagTree() = default;
+
+TagTree::~TagTree()
+{
+	clear();
+}
+
+int TagTree::count() const
+{
+	return size(_root);
+}
+
+void TagTree::clear()
+{
+	_root.reset();
+}
+
+void TagTree::insert(const Entry & entry)
+{
+	NodePtr left, right;
+	split(std::move(_root), entry.start + 1, left, right);
+	_root = merge(merge(std::move(left), NodePtr(new Node(entry, nextPriority()))), std::move(right));
+}
+
+int TagTree::remove(const int from, const int to)
+{
+	if (to <= from)
+		return 0;
+	NodePtr left, middle, right;
+	split(std::move(_root), from, left, right);
+	split(std::move(right), to, middle, right);
+	const int removed = size(middle);
+	_root = merge(std::move(left), std::move(right));
+	return removed;
+}
+
+int TagTree::adjust(const int position, const int charsRemoved, const int charsAdded)
+{
+	if (!_root)
+		return 0;
+
+	NodePtr left, middle, right;
+	split(std::move(_root), position, left, right);
+	split(std::move(right), position + charsRemoved, middle, right);
+
+	int removed = 0;
+	if (charsRemoved != charsAdded) {
+		// The text these tags were attached to is gone
+		removed = size(middle);
+		middle.reset();
+	}
+	if (right)
+		shift(right.get(), charsAdded - charsRemoved);
+	// Tags are short, so typically only very few tags start before the edit
+	// but extend into it
+	adjustEnds(left.get(), position, charsRemoved, charsAdded);
+
+	_root = merge(merge(std::move(left), std::move(middle)), std::move(right));
+	return removed;
+}
+
+TagTree::Entry TagTree::at(const int index) const
+{
+	Q_ASSERT(index >= 0 && index < count());
+	Node * node = _root.get();
+	int i = index;
+	while (node) {
+		push(node);
+		const int leftSize = size(node->left);
+		if (i < leftSize)
+			node = node->left.get();
+		else if (i == leftSize)
+			return node->entry;
+		else {
+			i -= leftSize + 1;
+			node = node->right.get();
+		}
+	}
+	return Entry{-1, -1, 0, QString()};
+}
+
+int TagTree::lowerBound(const int position) const
+{
+	int retVal = 0;
+	Node * node = _root.get();
+	while (node) {
+		push(node);
+		if (node->entry.start < position) {
+			retVal += size(node->left) + 1;
+			node = node->right.get();
+		}
+		else
+			node = node->left.get();
+	}
+	return retVal;
+}
+
+QVector<TagTree::Entry> TagTree::entries() const
+{
+	QVector<Entry> retVal;
+	retVal.reserve(count());
+	collect(_root.get(), std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), retVal);
+	return retVal;
+}
+
+QVector<TagTree::Entry> TagTree::entries(const int from, const int to) const
+{
+	QVector<Entry> retVal;
+	collect(_root.get(), from, to, retVal);
+	return retVal;
+}
+
+// static
+int TagTree::size(const NodePtr & node)
+{
+	return (node ? node->size : 0);
+}
+
+// static
+void TagTree::shift(Node * node, const int delta)
+{
+	if (!node || delta == 0)
+		return;
+	node->entry.start += delta;
+	node->entry.end += delta;
+	node->maxEnd += delta;
+	node->pendingShift += delta;
+}
+
+// static
+void TagTree::push(Node * node)
+{
+	if (node->pendingShift == 0)
+		return;
+	shift(node->left.get(), node->pendingShift);
+	shift(node->right.get(), node->pendingShift);
+	node->pendingShift = 0;
+}
+
+// static
+void TagTree::update(Node * node)
+{
+	node->size = 1 + size(node->left) + size(node->right);
+	node->maxEnd = node->entry.end;
+	if (node->left)
+		node->maxEnd = qMax(node->maxEnd, node->left->maxEnd);
+	if (node->right)
+		node->maxEnd = qMax(node->maxEnd, node->right->maxEnd);
+}
+
+// static
+void TagTree::split(NodePtr node, const int key, NodePtr & left, NodePtr & right)
+{
+	// Splits into entries starting before `key` and all others
+	if (!node) {
+		left.reset();
+		right.reset();
+		return;
+	}
+	push(node.get());
+	if (node->entry.start < key) {
+		NodePtr l, r;
+		split(std::move(node->right), key, l, r);
+		node->right = std::move(l);
+		update(node.get());
+		left = std::move(node);
+		right = std::move(r);
+	}
+	else {
+		NodePtr l, r;
+		split(std::move(node->left), key, l, r);
+		node->left = std::move(r);
+		update(node.get());
+		left = std::move(l);
+		right = std::move(node);
+	}
+}
+
+// static
+TagTree::NodePtr TagTree::merge(NodePtr left, NodePtr right)
+{
+	// All entries in `left` must be ordered before those in `right`
+	if (!left)
+		return right;
+	if (!right)
+		return left;
+	if (left->priority > right->priority) {
+		push(left.get());
+		left->right = merge(std::move(left->right), std::move(right));
+		update(left.get());
+		return left;
+	}
+	push(right.get());
+	right->left = merge(std::move(left), std::move(right->left));
+	update(right.get());
+	return right;
+}
+
+// static
+void TagTree::adjustEnds(Node * node, const int position, const int charsRemoved, const int charsAdded)
+{
+	// Only visit subtrees containing entries that end at or after `position`
+	// (like QTextCursor, an end right at an insertion moves along)
+	if (!node || node->maxEnd < position)
+		return;
+	push(node);
+	int & end = node->entry.end;
+	if (end >= position + charsRemoved)
+		end += charsAdded - charsRemoved;
+	else if (end > position && charsRemoved != charsAdded)
+		end = position + charsAdded;
+	adjustEnds(node->left.get(), position, charsRemoved, charsAdded);
+	adjustEnds(node->right.get(), position, charsRemoved, charsAdded);
+	update(node);
+}
+
+// static
+void TagTree::collect(Node * node, const int from, const int to, QVector<Entry> & result)
+{
+	// No entry in this subtree can reach into [from, to)
+	if (!node || node->maxEnd < from)
+		return;
+	push(node);
+	collect(node->left.get(), from, to, result);
+	// Entries in the right subtree start even later
+	if (node->entry.start >= to)
+		return;
+	if (node->entry.start >= from || node->entry.end > from)
+		result.append(node->entry);
+	collect(node->right.get(), from, to, result);
+}
+
+quint32 TagTree::nextPriority()
+{
+	// xorshift32
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+} // namespace Document
+} // namespace Tw
@@ -0,0 +1,115 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef Document_TagTree_H
+#define Document_TagTree_H
+
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+namespace Tw {
+namespace Document {
+
+// Ordered storage for the tags (bookmarks, sectioning commands, ...) of a text
+// document.
+//
+// Entries are kept in a treap ordered by their start position (entries with
+// the same start keep the order in which they were inserted). Each node also
+// tracks the size of and the maximum end position in its subtree, which makes
+// it an interval tree that supports lookups by index and by position.
+// Positions of all entries after an edit are shifted lazily, so inserting,
+// removing a range and adjusting to an edit all take O(log n) (plus the
+// number of entries actually removed or returned).
+class TagTree
+{
+public:
+	struct Entry {
+		int start;
+		int end;
+		unsigned int level;
+		QString text;
+
+		bool operator==(const Entry & other) const {
+			return start == other.start && end == other.end && level == other.level && text == other.text;
+		}
+		bool operator!=(const Entry & other) const { return !operator==(other); }
+	};
+
+	TagTree();
+	~TagTree();
+	TagTree(const TagTree &) = delete;
+	TagTree & operator=(const TagTree &) = delete;
+
+	int count() const;
+	bool isEmpty() const { return count() == 0; }
+	void clear();
+
+	// Inserts `entry` after all entries starting at or before entry.start
+	void insert(const Entry & entry);
+	// Removes all entries that start in [from, to); returns the number of
+	// removed entries
+	int remove(const int from, const int to);
+
+	// Adjusts the positions to an edit of the text (as reported by
+	// QTextDocument::contentsChange()). Entries after the edit are shifted;
+	// entries that start in the replaced text are removed. If the same number
+	// of characters was removed and added, entries are left in place as this
+	// is what QTextDocument reports for changes of the formatting.
+	// Returns the number of removed entries.
+	int adjust(const int position, const int charsRemoved, const int charsAdded);
+
+	// Returns the entry at `index` (in the order of their start positions)
+	Entry at(const int index) const;
+	// Returns the index of the first entry starting at or after `position`
+	// (count() if there is none)
+	int lowerBound(const int position) const;
+	// Returns all entries (in order)
+	QVector<Entry> entries() const;
+	// Returns the entries that overlap [from, to), i.e., that start in the
+	// range or start before it and extend into it
+	QVector<Entry> entries(const int from, const int to) const;
+
+private:
+	struct Node;
+	using NodePtr = std::unique_ptr<Node>;
+
+	static int size(const NodePtr & node);
+	static void shift(Node * node, const int delta);
+	static void push(Node * node);
+	static void update(Node * node);
+	static void split(NodePtr node, const int key, NodePtr & left, NodePtr & right);
+	static NodePtr merge(NodePtr left, NodePtr right);
+	static void adjustEnds(Node * node, const int position, const int charsRemoved, const int charsAdded);
+	static void collect(Node * node, const int from, const int to, QVector<Entry> & result);
+
+	quint32 nextPriority();
+
+	// Nodes are only restructured in const methods to apply pending shifts,
+	// which doesn't change the observable state
+	mutable NodePtr _root;
+	quint32 _seed{0x9E3779B9u};
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_TagTree_H)
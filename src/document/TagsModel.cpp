@@ -0,0 +1,267 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+
+#include "document/TagsModel.h"
+
+#include <QBrush>
+#include <QCoreApplication>
+
+#include <iterator>
+
+namespace Tw {
+namespace Document {
+
+struct TagsModel::Node
+{
+	enum Kind { Root, Group, Tag, Placeholder };
+
+	Node * parent{nullptr};
+	int row{0};
+	Kind kind{Root};
+	unsigned int level{0};
+	QString text;
+	int tagIndex{-1};
+	std::vector<NodePtr> children;
+
+	Node * addChild(const Kind childKind, const QString & childText, const unsigned int childLevel = 0, const int childTagIndex = -1) {
+		NodePtr child{new Node};
+		child->parent = this;
+		child->row = static_cast<int>(children.size());
+		child->kind = childKind;
+		child->text = childText;
+		child->level = childLevel;
+		child->tagIndex = childTagIndex;
+		children.push_back(std::move(child));
+		return children.back().get();
+	}
+};
+
+TagsModel::TagsModel(QObject * parent /* = nullptr */)
+	: QAbstractItemModel(parent)
+	, _root(buildTree({}))
+{
+}
+
+TagsModel::~TagsModel() = default;
+
+// static
+TagsModel::NodePtr TagsModel::buildTree(const QVector<TagTree::Entry> & tags)
+{
+	// The labels used to be part of the tags dock, so keep using its context
+	// for the translations
+	NodePtr root{new Node};
+	if (tags.isEmpty()) {
+		root->addChild(Node::Placeholder, QCoreApplication::translate("TagsDock", "No tags"));
+		return root;
+	}
+
+	NodePtr bookmarks{new Node};
+	bookmarks->kind = Node::Group;
+	bookmarks->text = QCoreApplication::translate("TagsDock", "Bookmarks");
+	NodePtr outline{new Node};
+	outline->kind = Node::Group;
+	outline->text = QCoreApplication::translate("TagsDock", "Outline");
+
+	// Chain of the outline items the next item may be nested in
+	std::vector<Node *> open;
+	for (int i = 0; i < tags.size(); ++i) {
+		const TagTree::Entry & tag = tags[i];
+		if (tag.level < 1) {
+			bookmarks->addChild(Node::Tag, tag.text, tag.level, i);
+			continue;
+		}
+		while (!open.empty() && open.back()->level >= tag.level)
+			open.pop_back();
+		Node * parent = (open.empty() ? outline.get() : open.back());
+		open.push_back(parent->addChild(Node::Tag, tag.text, tag.level, i));
+	}
+
+	for (NodePtr * group : {&bookmarks, &outline}) {
+		if ((*group)->children.empty())
+			continue;
+		(*group)->parent = root.get();
+		(*group)->row = static_cast<int>(root->children.size());
+		root->children.push_back(std::move(*group));
+	}
+	return root;
+}
+
+// static
+bool TagsModel::sameItem(const Node & a, const Node & b)
+{
+	return (a.kind == b.kind && a.level == b.level && a.text == b.text);
+}
+
+// static
+void TagsModel::renumber(Node & node, const std::size_t from)
+{
+	for (std::size_t i = from; i < node.children.size(); ++i) {
+		node.children[i]->parent = &node;
+		node.children[i]->row = static_cast<int>(i);
+	}
+}
+
+void TagsModel::setTags(const QVector<TagTree::Entry> & tags)
+{
+	NodePtr updated = buildTree(tags);
+	sync(*_root, *updated, QModelIndex());
+}
+
+void TagsModel::sync(Node & current, Node & updated, const QModelIndex & parentIndex)
+{
+	std::vector<NodePtr> & oldChildren = current.children;
+	std::vector<NodePtr> & newChildren = updated.children;
+	const std::size_t oldCount = oldChildren.size();
+	const std::size_t newCount = newChildren.size();
+
+	// Edits typically affect only a few tags in one place, so skip the common
+	// beginning and end
+	std::size_t prefix = 0;
+	while (prefix < oldCount && prefix < newCount && sameItem(*oldChildren[prefix], *newChildren[prefix]))
+		++prefix;
+	std::size_t suffix = 0;
+	while (suffix < oldCount - prefix && suffix < newCount - prefix && sameItem(*oldChildren[oldCount - 1 - suffix], *newChildren[newCount - 1 - suffix]))
+		++suffix;
+
+	// Items in between are updated in place (e.g., when typing in a section
+	// title, which keeps the subsections and their state in the view); only
+	// the surplus is removed or inserted
+	const std::size_t oldMiddle = oldCount - prefix - suffix;
+	const std::size_t newMiddle = newCount - prefix - suffix;
+	const std::size_t paired = qMin(oldMiddle, newMiddle);
+	for (std::size_t i = prefix; i < prefix + paired; ++i) {
+		Node & node = *oldChildren[i];
+		node.kind = newChildren[i]->kind;
+		node.level = newChildren[i]->level;
+		node.text = newChildren[i]->text;
+		const QModelIndex idx = index(static_cast<int>(i), 0, parentIndex);
+		emit dataChanged(idx, idx);
+	}
+
+	const std::size_t first = prefix + paired;
+	if (oldMiddle > newMiddle) {
+		beginRemoveRows(parentIndex, static_cast<int>(first), static_cast<int>(prefix + oldMiddle - 1));
+		oldChildren.erase(oldChildren.begin() + static_cast<std::ptrdiff_t>(first), oldChildren.begin() + static_cast<std::ptrdiff_t>(prefix + oldMiddle));
+		renumber(current, first);
+		endRemoveRows();
+	}
+	else if (newMiddle > oldMiddle) {
+		beginInsertRows(parentIndex, static_cast<int>(first), static_cast<int>(prefix + newMiddle - 1));
+		// Inserted subtrees are taken over as they are
+		oldChildren.insert(oldChildren.begin() + static_cast<std::ptrdiff_t>(first),
+						   std::make_move_iterator(newChildren.begin() + static_cast<std::ptrdiff_t>(first)),
+						   std::make_move_iterator(newChildren.begin() + static_cast<std::ptrdiff_t>(prefix + newMiddle)));
+		renumber(current, first);
+		endInsertRows();
+	}
+
+	for (std::size_t i = 0; i < newCount; ++i) {
+		if (!newChildren[i])
+			continue;
+		// The index of a tag changes whenever tags are added or removed before
+		// it; as it isn't displayed, this is not reported as a change
+		oldChildren[i]->tagIndex = newChildren[i]->tagIndex;
+		sync(*oldChildren[i], *newChildren[i], index(static_cast<int>(i), 0, parentIndex));
+	}
+}
+
+int TagsModel::tagIndex(const QModelIndex & index) const
+{
+	if (!index.isValid())
+		return -1;
+	return nodeFromIndex(index)->tagIndex;
+}
+
+TagsModel::Node * TagsModel::nodeFromIndex(const QModelIndex & index) const
+{
+	if (!index.isValid())
+		return _root.get();
+	return static_cast<Node*>(index.internalPointer());
+}
+
+QModelIndex TagsModel::index(int row, int column, const QModelIndex & parent /* = {} */) const
+{
+	const Node * parentNode = nodeFromIndex(parent);
+	if (!parentNode || column != 0 || row < 0 || static_cast<std::size_t>(row) >= parentNode->children.size())
+		return {};
+	return createIndex(row, column, parentNode->children[static_cast<std::size_t>(row)].get());
+}
+
+QModelIndex TagsModel::parent(const QModelIndex & child) const
+{
+	const Node * node = nodeFromIndex(child);
+	if (!node || !node->parent || node->parent == _root.get())
+		return {};
+	return createIndex(node->parent->row, 0, node->parent);
+}
+
+int TagsModel::rowCount(const QModelIndex & parent /* = {} */) const
+{
+	if (parent.column() > 0)
+		return 0;
+	const Node * node = nodeFromIndex(parent);
+	return (node ? static_cast<int>(node->children.size()) : 0);
+}
+
+int TagsModel::columnCount(const QModelIndex & parent /* = {} */) const
+{
+	Q_UNUSED(parent)
+	return 1;
+}
+
+QVariant TagsModel::data(const QModelIndex & index, int role /* = Qt::DisplayRole */) const
+{
+	if (!index.isValid())
+		return {};
+	const Node * node = nodeFromIndex(index);
+	Q_ASSERT(node != nullptr);
+
+	switch (role) {
+		case Qt::DisplayRole:
+		case Qt::ToolTipRole:
+			return node->text;
+		case Qt::ForegroundRole:
+			if (node->kind == Node::Group)
+				return QBrush(Qt::blue);
+			return {};
+		case TagIndexRole:
+			return node->tagIndex;
+		default:
+			return {};
+	}
+}
+
+Qt::ItemFlags TagsModel::flags(const QModelIndex & index) const
+{
+	if (!index.isValid())
+		return Qt::NoItemFlags;
+	switch (nodeFromIndex(index)->kind) {
+		case Node::Tag:
+			return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+		case Node::Group:
+			return Qt::ItemIsEnabled;
+		default:
+			return Qt::NoItemFlags;
+	}
+}
+
+} // namespace Document
+} // namespace Tw
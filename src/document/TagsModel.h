@@ -0,0 +1,79 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef Document_TagsModel_H
+#define Document_TagsModel_H
+
+#include "document/TagTree.h"
+
+#include <QAbstractItemModel>
+
+#include <memory>
+#include <vector>
+
+namespace Tw {
+namespace Document {
+
+// Item model presenting the tags of a document as a tree: bookmarks (tags of
+// level 0) are listed in one group, the outline (tags of level >= 1, nested by
+// their level) in another.
+//
+// setTags() doesn't reset the model. Instead, the new tree is compared to the
+// current one and only the rows that actually changed are removed, inserted
+// or updated, so views keep their selection, scroll position and expanded
+// items.
+class TagsModel : public QAbstractItemModel
+{
+	Q_OBJECT
+public:
+	enum Role { TagIndexRole = Qt::UserRole + 1 };
+
+	explicit TagsModel(QObject * parent = nullptr);
+	~TagsModel() override;
+
+	void setTags(const QVector<TagTree::Entry> & tags);
+	// Returns the index of the tag (in the document) `index` refers to, or -1
+	// for group headers and placeholders
+	int tagIndex(const QModelIndex & index) const;
+
+	QModelIndex index(int row, int column, const QModelIndex & parent = {}) const override;
+	QModelIndex parent(const QModelIndex & child) const override;
+	int rowCount(const QModelIndex & parent = {}) const override;
+	int columnCount(const QModelIndex & parent = {}) const override;
+	QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+	Qt::ItemFlags flags(const QModelIndex & index) const override;
+
+private:
+	struct Node;
+	using NodePtr = std::unique_ptr<Node>;
+
+	static NodePtr buildTree(const QVector<TagTree::Entry> & tags);
+	static bool sameItem(const Node & a, const Node & b);
+	static void renumber(Node & node, const std::size_t from);
+	void sync(Node & current, Node & updated, const QModelIndex & parentIndex);
+	Node * nodeFromIndex(const QModelIndex & index) const;
+
+	NodePtr _root;
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_TagsModel_H)
@@ -21,45 +21,114 @@
 
 #include "document/TextDocument.h"
 
+#include <algorithm>
+
 namespace Tw {
 namespace Document {
 
-TextDocument::TextDocument(QObject * parent) : QTextDocument(parent) { }
+TextDocument::TextDocument(QObject * parent) : QTextDocument(parent)
+{
+	connect(this, &QTextDocument::contentsChange, this, &TextDocument::adjustTags);
+}
 
-TextDocument::TextDocument(const QString & text, QObject * parent) : QTextDocument(text, parent) { }
+TextDocument::TextDocument(const QString & text, QObject * parent) : QTextDocument(text, parent)
+{
+	connect(this, &QTextDocument::contentsChange, this, &TextDocument::adjustTags);
+}
 
-void TextDocument::addTag(const QTextCursor & cursor, const unsigned int level, const QString & text)
+TextDocument::Tag TextDocument::tagFromEntry(const TagTree::Entry & entry) const
 {
-	QList<Tag>::iterator it;
+	QTextCursor cursor(const_cast<TextDocument *>(this));
+	cursor.setPosition(entry.start);
+	cursor.setPosition(entry.end, QTextCursor::KeepAnchor);
+	return {cursor, entry.level, entry.text};
+}
 
-	for (it = _tags.begin(); it != _tags.end(); ++it) {
-		if (it->cursor.selectionStart() > cursor.selectionStart())
-			break;
-	}
-	_tags.insert(it, {cursor, level, text});
-	emit tagsChanged();
+QList<TextDocument::Tag> TextDocument::getTags() const
+{
+	QList<Tag> retVal;
+	const QVector<TagTree::Entry> entries = _tags.entries();
+	retVal.reserve(entries.size());
+	for (const TagTree::Entry & entry : entries)
+		retVal.append(tagFromEntry(entry));
+	return retVal;
+}
+
+QList<TextDocument::Tag> TextDocument::getTags(const int from, const int to) const
+{
+	QList<Tag> retVal;
+	for (const TagTree::Entry & entry : _tags.entries(from, to))
+		retVal.append(tagFromEntry(entry));
+	return retVal;
+}
+
+TextDocument::Tag TextDocument::getTag(const int index) const
+{
+	Q_ASSERT(index >= 0 && index < tagCount());
+	return tagFromEntry(_tags.at(index));
+}
+
+void TextDocument::addTag(const QTextCursor & cursor, const unsigned int level, const QString & text)
+{
+	_tags.insert({cursor.selectionStart(), cursor.selectionEnd(), level, text});
+	notifyTagsChanged();
 }
 
 unsigned int TextDocument::removeTags(int offset, int len)
 {
-	unsigned int removed = 0;
-	QList<Tag>::iterator start, end;
+	const int removed = _tags.remove(offset, offset + len);
+	if (removed > 0)
+		notifyTagsChanged();
+	return static_cast<unsigned int>(removed);
+}
 
-	for (start = _tags.begin(); start != _tags.end(); ++start) {
-		if (start->cursor.selectionStart() >= offset)
-			break;
-	}
-	for (end = start; end != _tags.end(); ++end) {
-		if (end->cursor.selectionStart() < offset + len)
-			++removed;
-		else
-			break;
-	}
-	if (removed > 0) {
-		_tags.erase(start, end);
+void TextDocument::replaceTags(int offset, int len, const QList<Tag> & tags)
+{
+	QVector<TagTree::Entry> newEntries;
+	newEntries.reserve(tags.size());
+	for (const Tag & tag : tags)
+		newEntries.append(TagTree::Entry{tag.cursor.selectionStart(), tag.cursor.selectionEnd(), tag.level, tag.text});
+	std::stable_sort(newEntries.begin(), newEntries.end(), [](const TagTree::Entry & a, const TagTree::Entry & b) { return a.start < b.start; });
+
+	// Rehighlighting a block usually yields the same tags again
+	QVector<TagTree::Entry> oldEntries;
+	const int first = _tags.lowerBound(offset);
+	const int last = _tags.lowerBound(offset + len);
+	oldEntries.reserve(last - first);
+	for (int i = first; i < last; ++i)
+		oldEntries.append(_tags.at(i));
+	if (oldEntries == newEntries)
+		return;
+
+	_tags.remove(offset, offset + len);
+	for (const TagTree::Entry & entry : newEntries)
+		_tags.insert(entry);
+	notifyTagsChanged();
+}
+
+void TextDocument::endTagUpdate()
+{
+	Q_ASSERT(_tagUpdateDepth > 0);
+	if (--_tagUpdateDepth == 0 && _tagsModified) {
+		_tagsModified = false;
 		emit tagsChanged();
 	}
-	return removed;
+}
+
+void TextDocument::notifyTagsChanged()
+{
+	if (_tagUpdateDepth > 0)
+		_tagsModified = true;
+	else
+		emit tagsChanged();
+}
+
+void TextDocument::adjustTags(int position, int charsRemoved, int charsAdded)
+{
+	// Positions of tags after the edit are shifted implicitly; only removing
+	// tags (because their text was removed) is a change worth reporting
+	if (_tags.adjust(position, charsRemoved, charsAdded) > 0)
+		notifyTagsChanged();
 }
 
 } // namespace Document
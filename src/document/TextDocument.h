@@ -22,6 +22,7 @@
 #define Document_TextDocument_H
 
 #include "document/Document.h"
+#include "document/TagTree.h"
 
 #include <QTextCursor>
 #include <QTextDocument>
@@ -42,15 +43,46 @@ public:
 	explicit TextDocument(QObject * parent = nullptr);
 	explicit TextDocument(const QString & text, QObject * parent = nullptr);
 
-	const QList<Tag> & getTags() const { return _tags; }
+	// Tags are ordered by their position in the document; the cursors of the
+	// returned Tag objects are created on demand (selecting the tagged text)
+	QList<Tag> getTags() const;
+	// Returns the tags that overlap [from, to)
+	QList<Tag> getTags(const int from, const int to) const;
+	// Returns all tags without creating cursors for them
+	QVector<TagTree::Entry> tagEntries() const { return _tags.entries(); }
+	QVector<TagTree::Entry> tagEntries(const int from, const int to) const { return _tags.entries(from, to); }
+	int tagCount() const { return _tags.count(); }
+	Tag getTag(const int index) const;
+	// Returns the index of the first tag at or after `position`
+	int tagIndexForPosition(const int position) const { return _tags.lowerBound(position); }
 	void addTag(const QTextCursor & cursor, const unsigned int level, const QString & text);
+	// Removes the tags starting in [offset, offset + len)
 	unsigned int removeTags(int offset, int len);
+	// Replaces the tags starting in [offset, offset + len) by `tags`; does
+	// nothing (and in particular doesn't emit tagsChanged()) if they are the
+	// same already
+	void replaceTags(int offset, int len, const QList<Tag> & tags);
+
+	// Changes made between beginTagUpdate() and the matching endTagUpdate()
+	// result in (at most) one tagsChanged() signal; calls can be nested
+	void beginTagUpdate() { ++_tagUpdateDepth; }
+	void endTagUpdate();
 
 signals:
 	void tagsChanged() const;
 
 protected:
-	QList<Tag> _tags;
+	Tag tagFromEntry(const TagTree::Entry & entry) const;
+	void notifyTagsChanged();
+
+	TagTree _tags;
+
+private slots:
+	void adjustTags(int position, int charsRemoved, int charsAdded);
+
+private:
+	int _tagUpdateDepth{0};
+	bool _tagsModified{false};
 };
 
 } // namespace Document
@@ -0,0 +1,245 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+
+#include "document/TextFileReader.h"
+
+#include <QFile>
+#include <QHash>
+#include <QRegularExpression>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace Tw {
+namespace Document {
+
+namespace {
+
+// Number of bytes at the beginning of the file that are searched for a
+// "%!TEX encoding" line
+constexpr qint64 kPeekLength = 1024;
+constexpr qint64 kChunkSize = 1024 * 1024;
+
+const char * const texshopSynonyms[] = {
+	"MacOSRoman",		"Apple Roman",
+	"IsoLatin",			"ISO 8859-1",
+	"IsoLatin2",		"ISO 8859-2",
+	"IsoLatin5",		"ISO 8859-5",
+	"IsoLatin9",		"ISO 8859-9",
+//	"MacJapanese",		"",
+//	"DOSJapanese",		"",
+	"SJIS_X0213",		"Shift-JIS",
+	"EUC_JP",			"EUC-JP",
+//	"JISJapanese",		"",
+//	"MacKorean",		"",
+	"UTF-8 Unicode",	"UTF-8",
+	"Standard Unicode",	"UTF-16",
+//	"Mac Cyrillic",		"",
+//	"DOS Cyrillic",		"",
+//	"DOS Russian",		"",
+	"Windows Cyrillic",	"Windows-1251",
+	"KOI8_R",			"KOI8-R",
+//	"Mac Chinese Traditional",	"",
+//	"Mac Chinese Simplified",	"",
+//	"DOS Chinese Traditional",	"",
+//	"DOS Chinese Simplified",	"",
+//	"GBK",				"",
+//	"GB 2312",			"",
+	"GB 18030",			"GB18030-0",
+	nullptr
+};
+
+// Appends `chunk` to `text`, replacing "\r\n" and "\r" by "\n". A "\r" at the
+// end of the chunk is held back in `pendingCR` as it may be followed by "\n"
+// at the beginning of the next chunk.
+void appendNormalized(const QString & chunk, QString & text, bool & pendingCR, TextFileReader::Result & result)
+{
+	const QChar cr = QChar::fromLatin1('\r');
+	const QChar lf = QChar::fromLatin1('\n');
+	const QChar * data = chunk.constData();
+	const QString::size_type length = chunk.size();
+	QString::size_type i = 0;
+
+	if (pendingCR && length > 0) {
+		text += lf;
+		if (data[0] == lf) {
+			++result.crlfCount;
+			i = 1;
+		}
+		else
+			++result.crCount;
+		pendingCR = false;
+	}
+
+	while (i < length) {
+		const QString::size_type next = chunk.indexOf(cr, i);
+		const QString::size_type end = (next < 0 ? length : next);
+		result.lfCount += std::count(data + i, data + end, lf);
+		text.append(data + i, end - i);
+		if (next < 0)
+			break;
+		if (next + 1 == length) {
+			pendingCR = true;
+			break;
+		}
+		text += lf;
+		if (data[next + 1] == lf) {
+			++result.crlfCount;
+			i = next + 2;
+		}
+		else {
+			++result.crCount;
+			i = next + 1;
+		}
+	}
+}
+
+} // anonymous namespace
+
+TextFileReader::TextFileReader(QObject * parent /* = nullptr */)
+	: QObject(parent)
+{
+	connect(&_watcher, &QFutureWatcherBase::finished, this, &TextFileReader::finished);
+}
+
+TextFileReader::~TextFileReader()
+{
+	cancel();
+	_watcher.waitForFinished();
+}
+
+void TextFileReader::start(const QString & filePath, QTextCodec * defaultCodec, QTextCodec * forceCodec /* = nullptr */)
+{
+	_cancelled.storeRelease(0);
+	_percent.storeRelease(-1);
+	_watcher.setFuture(QtConcurrent::run([this, filePath, defaultCodec, forceCodec]() {
+		return read(filePath, defaultCodec, forceCodec, [this](qint64 bytesRead, qint64 bytesTotal) {
+			const int percent = (bytesTotal > 0 ? static_cast<int>(100 * bytesRead / bytesTotal) : 0);
+			if (_percent.fetchAndStoreRelaxed(percent) != percent)
+				emit progress(percent);
+			return _cancelled.loadAcquire() == 0;
+		});
+	}));
+}
+
+// static
+TextFileReader::Result TextFileReader::read(const QString & filePath, QTextCodec * defaultCodec, QTextCodec * forceCodec /* = nullptr */, const ProgressCallback & progress /* = {} */)
+{
+	Result result;
+
+	QFile file(filePath);
+	// Not using QFile::Text because this prevents us reading "classic" Mac files
+	// with CR-only line endings. See issue #242.
+	if (!file.open(QFile::ReadOnly)) {
+		result.errorString = file.errorString();
+		return result;
+	}
+
+	const QByteArray peekBytes(file.peek(kPeekLength));
+
+	if (forceCodec)
+		result.codec = forceCodec;
+	else {
+		bool hasMetadata{false};
+		QString reqName;
+		result.codec = scanForEncoding(QString::fromUtf8(peekBytes.constData()), hasMetadata, reqName);
+		if (!result.codec) {
+			result.codec = defaultCodec;
+			if (hasMetadata)
+				result.unsupportedEncoding = reqName;
+		}
+	}
+	if (!result.codec) {
+		result.errorString = tr("No text codec available");
+		return result;
+	}
+
+	// When using the UTF-8 codec (mib = 106), byte order marks (BOMs) are
+	// ignored during reading and not produced when writing. To keep them in
+	// files that have them, we need to check for them ourselves.
+	if (result.codec->mibEnum() == 106 && peekBytes.size() >= 3 && peekBytes[0] == '\xEF' && peekBytes[1] == '\xBB' && peekBytes[2] == '\xBF')
+		result.utf8BOM = true;
+
+	// Empty files yield an empty (rather than a null) string
+	result.text = QStringLiteral("");
+	const qint64 bytesTotal = file.size();
+	// The number of bytes is an upper bound for the number of characters for
+	// all but the UTF-16/32 encodings
+	result.text.reserve(static_cast<int>(qMin(bytesTotal, static_cast<qint64>(std::numeric_limits<int>::max()))));
+
+	std::unique_ptr<QTextDecoder> decoder(result.codec->makeDecoder());
+	bool pendingCR{false};
+	while (!file.atEnd()) {
+		if (progress && !progress(file.pos(), bytesTotal)) {
+			result.status = Result::Status::Cancelled;
+			result.text = QString();
+			return result;
+		}
+		const QByteArray chunk = file.read(kChunkSize);
+		if (chunk.isEmpty() && file.error() != QFileDevice::NoError) {
+			result.errorString = file.errorString();
+			result.text = QString();
+			return result;
+		}
+		appendNormalized(decoder->toUnicode(chunk), result.text, pendingCR, result);
+	}
+	if (pendingCR) {
+		result.text += QChar::fromLatin1('\n');
+		++result.crCount;
+	}
+	if (progress)
+		progress(bytesTotal, bytesTotal);
+
+	result.status = Result::Status::OK;
+	return result;
+}
+
+// static
+QTextCodec * TextFileReader::scanForEncoding(const QString & peekStr, bool & hasMetadata, QString & reqName)
+{
+	// peek at the file for %!TEX encoding = ....
+	static const QRegularExpression re(QStringLiteral(u"% *!TEX +encoding *= *([^\r\n\x2029]+)[\r\n\x2029]"), QRegularExpression::CaseInsensitiveOption);
+	// Initialized once in a thread-safe way
+	static const QHash<QString, QString> synonyms = []() {
+		QHash<QString, QString> retVal;
+		for (int i = 0; texshopSynonyms[i]; i += 2)
+			retVal.insert(QString::fromLatin1(texshopSynonyms[i]).toLower(), QString::fromLatin1(texshopSynonyms[i + 1]));
+		return retVal;
+	}();
+
+	QRegularExpressionMatch m = re.match(peekStr);
+	QTextCodec * reqCodec = nullptr;
+	if (m.hasMatch()) {
+		hasMetadata = true;
+		reqName = m.captured(1).trimmed();
+		reqCodec = QTextCodec::codecForName(reqName.toLatin1());
+		if (!reqCodec && synonyms.contains(reqName.toLower()))
+			reqCodec = QTextCodec::codecForName(synonyms.value(reqName.toLower()).toLatin1());
+	}
+	else
+		hasMetadata = false;
+	return reqCodec;
+}
+
+} // namespace Document
+} // namespace Tw
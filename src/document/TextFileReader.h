@@ -0,0 +1,101 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef Document_TextFileReader_H
+#define Document_TextFileReader_H
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QTextCodec>
+
+#include <functional>
+
+namespace Tw {
+namespace Document {
+
+// Reads text files for editing.
+//
+// The file is processed in a single pass over chunks of its data: the
+// encoding is taken from a "%!TEX encoding" line at the beginning of the file
+// (unless a codec is forced), the data is decoded and all line endings are
+// normalized to "\n" on the fly. read() doesn't touch any GUI objects, so
+// start() can run it on a worker thread while the window shows the progress
+// and lets the user cancel.
+class TextFileReader : public QObject
+{
+	Q_OBJECT
+public:
+	struct Result {
+		enum class Status { OK, Cancelled, Error };
+
+		Status status{Status::Error};
+		QString errorString;
+		// Null if the file couldn't be read; empty (but not null) for empty
+		// files
+		QString text;
+		QTextCodec * codec{nullptr};
+		// Name of the encoding requested by a "%!TEX encoding" line that is not
+		// supported (in which case `codec` is the default codec)
+		QString unsupportedEncoding;
+		bool utf8BOM{false};
+		// Number of line endings of each kind found in the file
+		qint64 crlfCount{0};
+		qint64 crCount{0};
+		qint64 lfCount{0};
+	};
+	// Called with the number of bytes read so far and the size of the file;
+	// reading is cancelled if it returns false
+	using ProgressCallback = std::function<bool(qint64 bytesRead, qint64 bytesTotal)>;
+
+	explicit TextFileReader(QObject * parent = nullptr);
+	~TextFileReader() override;
+
+	// Starts reading `filePath` in the background; finished() is emitted once
+	// the result is available
+	void start(const QString & filePath, QTextCodec * defaultCodec, QTextCodec * forceCodec = nullptr);
+	void cancel() { _cancelled.storeRelease(1); }
+	bool isRunning() const { return _watcher.isRunning(); }
+	Result result() const { return _watcher.result(); }
+
+	// Thread-safe
+	static Result read(const QString & filePath, QTextCodec * defaultCodec, QTextCodec * forceCodec = nullptr, const ProgressCallback & progress = {});
+	// Looks for a "%!TEX encoding = ..." line in `peekStr`; returns the
+	// corresponding codec (or nullptr if there is no such line or the
+	// encoding is not supported)
+	static QTextCodec * scanForEncoding(const QString & peekStr, bool & hasMetadata, QString & reqName);
+
+signals:
+	// Progress in percent; emitted (from the worker thread) whenever it
+	// changes
+	void progress(int percent);
+	void finished();
+
+private:
+	QFutureWatcher<Result> _watcher;
+	QAtomicInt _cancelled{0};
+	QAtomicInt _percent{-1};
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_TextFileReader_H)
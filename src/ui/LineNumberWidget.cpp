@@ -35,6 +35,107 @@ LineNumberWidget::LineNumberWidget(QTextEdit * parent)
 	, _bgColor(palette().color(QPalette::Mid))
 {
 	setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Ignored);
+	if (_editor)
+		setDocument(_editor->document());
+}
+
+void LineNumberWidget::setDocument(const QTextDocument * doc)
+{
+	if (doc == _revisionDocument)
+		return;
+	disconnect(_modificationConnection);
+	// Line markers are anchored to the text of the old document
+	_lineMarkers.clear();
+	_revisionDocument = doc;
+	_savedRevision = (doc ? doc->revision() : 0);
+	if (!doc)
+		return;
+	_modificationConnection = connect(doc, &QTextDocument::modificationChanged, this, [this](bool modified) {
+		if (modified || !_revisionDocument)
+			return;
+		_savedRevision = _revisionDocument->revision();
+		update();
+	});
+	update();
+}
+
+void LineNumberWidget::setMarkersVisible(const bool visible)
+{
+	if (_markersVisible == visible)
+		return;
+	_markersVisible = visible;
+	updateGeometry();
+	update();
+}
+
+void LineNumberWidget::setMarkerProvider(const MarkerProvider & provider)
+{
+	_markerProvider = provider;
+	update();
+}
+
+LineNumberWidget::Markers LineNumberWidget::lineMarkers(const int line) const
+{
+	Markers markers;
+	for (const LineMarker & lm : _lineMarkers) {
+		if (lm.anchor.blockNumber() + 1 == line)
+			markers |= lm.marker;
+	}
+	return markers;
+}
+
+QHash<int, LineNumberWidget::Markers> LineNumberWidget::lineMarkersByLine() const
+{
+	QHash<int, Markers> retVal;
+	for (const LineMarker & lm : _lineMarkers)
+		retVal[lm.anchor.blockNumber() + 1] |= lm.marker;
+	return retVal;
+}
+
+void LineNumberWidget::setLineMarkers(const Marker marker, const QList<int> & lines)
+{
+	clearLineMarkers(marker);
+	if (_editor) {
+		QTextDocument * doc = _editor->document();
+		for (const int line : lines) {
+			const QTextBlock block = doc->findBlockByNumber(line - 1);
+			if (!block.isValid())
+				continue;
+			// The cursor moves along with the text; in particular, if a line
+			// break is inserted at the start of the line, it moves to the new
+			// line together with the text
+			_lineMarkers.append({QTextCursor(block), marker});
+		}
+	}
+	update();
+}
+
+void LineNumberWidget::clearLineMarkers(const Marker marker)
+{
+	for (auto it = _lineMarkers.begin(); it != _lineMarkers.end(); ) {
+		if (it->marker == marker)
+			it = _lineMarkers.erase(it);
+		else
+			++it;
+	}
+	update();
+}
+
+int LineNumberWidget::digitWidth() const
+{
+	if (_digitWidth < 0) {
+#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
+		_digitWidth = fontMetrics().width(QChar::fromLatin1('9'));
+#else
+		_digitWidth = fontMetrics().horizontalAdvance(QChar::fromLatin1('9'));
+#endif
+	}
+	return _digitWidth;
+}
+
+int LineNumberWidget::markerLaneWidth() const
+{
+	return (_markersVisible ? digitWidth() + 4 : 0);
 }
 
 QSize LineNumberWidget::sizeHint() const
@@ -49,14 +150,28 @@ QSize LineNumberWidget::sizeHint() const
 		}
 	}
 
-#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
-	int space = 3 + fontMetrics().width(QChar::fromLatin1('9')) * digits;
-#else
-	int space = 3 + fontMetrics().horizontalAdvance(QChar::fromLatin1('9')) * digits;
-#endif
+	int space = 3 + digitWidth() * digits + markerLaneWidth();
 	return QSize(space, 0);
 }
 
+QTextBlock LineNumberWidget::firstVisibleBlock(const int y) const
+{
+	// Look up the block at the top of the visible area directly (which takes
+	// O(log n)) instead of walking all blocks above it
+	QTextDocument * doc = _editor->document();
+	const int scroll = _editor->verticalScrollBar()->value();
+	const int pos = doc->documentLayout()->hitTest(QPointF(0, y + scroll), Qt::FuzzyHit);
+	QTextBlock block = (pos < 0 ? doc->begin() : doc->findBlock(pos));
+	if (!block.isValid())
+		return doc->begin();
+	// The hit may lie in the spacing between two blocks, in which case the
+	// previous block can still be partially visible
+	const QTextBlock prev = block.previous();
+	if (prev.isValid() && doc->documentLayout()->blockBoundingRect(prev).bottom() - scroll >= y)
+		return prev;
+	return block;
+}
+
 void LineNumberWidget::paintEvent(QPaintEvent * event)
 {
 	QPainter painter(this);
@@ -65,36 +180,85 @@ void LineNumberWidget::paintEvent(QPaintEvent * event)
 	if (!_editor)
 		return;
 
-	QTextBlock block = _editor->document()->begin();
-	int blockNumber = 1;
+	QTextDocument * doc = _editor->document();
+	const bool modified = (doc == _revisionDocument && doc->isModified());
+
+	// Only a few lines have markers, so this is cheap
+	const QHash<int, Markers> markersByLine = (_markersVisible ? lineMarkersByLine() : QHash<int, Markers>());
 
-	QAbstractTextDocumentLayout *layout = _editor->document()->documentLayout();
-	int top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-	int bottom = static_cast<int>(top + layout->blockBoundingRect(block).height());
+	QTextBlock block = firstVisibleBlock(event->rect().top());
+	int blockNumber = block.blockNumber() + 1;
+
+	QAbstractTextDocumentLayout *layout = doc->documentLayout();
+	const int scroll = _editor->verticalScrollBar()->value();
+	const int lineHeight = fontMetrics().height();
+	const int laneWidth = markerLaneWidth();
+
+	while (block.isValid()) {
+		// NB: The top of this block may not coincide with the bottom of the
+		// previous block in case the line spacing is not 100%
+		const QRectF rect = layout->blockBoundingRect(block);
+		const int top = static_cast<int>(rect.top()) - scroll;
+		const int bottom = top + static_cast<int>(rect.height());
+		if (top > event->rect().bottom())
+			break;
 
-	while (block.isValid() && top <= event->rect().bottom()) {
 		if (bottom >= event->rect().top()) {
 			QString number = QString::number(blockNumber);
-			painter.drawText(0, top, width() - 1, fontMetrics().height(),
+			painter.drawText(laneWidth, top, width() - laneWidth - 1, lineHeight,
 							 Qt::AlignRight, number);
+
+			if (_markersVisible) {
+				Markers markers = markersByLine.value(blockNumber);
+				if (_markerProvider)
+					markers |= _markerProvider(block);
+				if (modified && block.revision() > _savedRevision)
+					markers |= Marker::Modified;
+				if (markers != Markers())
+					paintMarkers(painter, QRect(0, top, laneWidth, qMax(lineHeight, bottom - top)), markers);
+			}
 		}
 
 		block = block.next();
-		if (block == _editor->document()->end())
-			break;
-		// NB: The top of this block may not coincide with the bottom of the
-		// previous block in case the line spacing is not 100%
-		top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-		bottom = top + static_cast<int>(layout->blockBoundingRect(block).height());
 		++blockNumber;
 	}
 }
 
+void LineNumberWidget::paintMarkers(QPainter & painter, const QRect & rect, const Markers markers) const
+{
+	const int size = qMin(rect.width() - 4, fontMetrics().height()) - 2;
+	const QRect symbol(rect.left() + 1, rect.top() + (fontMetrics().height() - size) / 2, size, size);
+
+	painter.save();
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setPen(Qt::NoPen);
+	if (markers.testFlag(Marker::Modified))
+		painter.fillRect(QRect(rect.right() - 2, rect.top(), 2, rect.height()), QColor(255, 165, 0));
+	if (markers.testFlag(Marker::Error)) {
+		painter.setBrush(QColor(220, 40, 40));
+		painter.drawEllipse(symbol);
+	}
+	else if (markers.testFlag(Marker::Bookmark)) {
+		// A small flag pointing towards the text
+		const QPoint points[] = {
+			symbol.topLeft(),
+			QPoint(symbol.right(), symbol.center().y()),
+			symbol.bottomLeft()
+		};
+		painter.setBrush(palette().color(QPalette::Highlight));
+		painter.drawPolygon(points, 3);
+	}
+	painter.restore();
+}
+
 void LineNumberWidget::changeEvent(QEvent * event)
 {
 	if (event->type() == QEvent::ParentChange) {
 		_editor = qobject_cast<QTextEdit*>(parentWidget());
+		setDocument(_editor ? _editor->document() : nullptr);
 	}
+	else if (event->type() == QEvent::FontChange)
+		_digitWidth = -1;
 	QWidget::changeEvent(event);
 }
 
@@ -21,32 +21,99 @@
 #ifndef LineNumberWidget_H
 #define LineNumberWidget_H
 
+#include <QHash>
 #include <QPaintEvent>
+#include <QTextBlock>
+#include <QTextCursor>
 #include <QTextEdit>
+#include <QVector>
+
+#include <functional>
+
+class QPainter;
 
 namespace Tw {
 namespace UI {
 
+// Gutter displaying the line numbers of a QTextEdit.
+//
+// Optionally, a marker lane is shown to the left of the numbers, indicating
+// bookmarks, errors and lines modified since the document was last saved.
+// Only the visible blocks are visited when painting, so the cost of a repaint
+// doesn't depend on the size of the document.
 class LineNumberWidget : public QWidget
 {
 public:
+	enum class Marker {
+		None = 0x0,
+		Bookmark = 0x1,
+		Error = 0x2,
+		Modified = 0x4
+	};
+	Q_DECLARE_FLAGS(Markers, Marker)
+
+	// Returns the markers to display for `block`; only called for visible
+	// blocks while painting
+	using MarkerProvider = std::function<Markers(const QTextBlock & block)>;
+
 	explicit LineNumberWidget(QTextEdit * parent);
 	~LineNumberWidget() override = default;
 
+	// Starts tracking the modifications of `doc`; must be called whenever the
+	// editor's document is replaced
+	void setDocument(const QTextDocument * doc);
+
 	QColor bgColor() const { return _bgColor; }
 	void setBgColor(const QColor color) { _bgColor = color; }
 
+	bool markersVisible() const { return _markersVisible; }
+	void setMarkersVisible(const bool visible);
+	void setMarkerProvider(const MarkerProvider & provider);
+
+	// Markers attached to (1-based) line numbers, e.g. for errors reported by
+	// the typesetting tool. They are anchored to the text of the lines, i.e.,
+	// they move along when lines are inserted or removed above them. Lines
+	// that don't exist (yet) are ignored.
+	Markers lineMarkers(const int line) const;
+	void setLineMarkers(const Marker marker, const QList<int> & lines);
+	void clearLineMarkers(const Marker marker);
+
 	QSize sizeHint() const override;
 
 protected:
 	void paintEvent(QPaintEvent * event) override;
 	void changeEvent(QEvent * event) override;
 
+	QTextBlock firstVisibleBlock(const int y) const;
+	int digitWidth() const;
+	int markerLaneWidth() const;
+	void paintMarkers(QPainter & painter, const QRect & rect, const Markers markers) const;
+	// Maps (1-based) line numbers to their markers set with setLineMarkers()
+	QHash<int, Markers> lineMarkersByLine() const;
+
 private:
 	QTextEdit * _editor;
 	QColor _bgColor;
+	bool _markersVisible{false};
+	MarkerProvider _markerProvider;
+	struct LineMarker {
+		QTextCursor anchor;
+		Marker marker;
+	};
+	QVector<LineMarker> _lineMarkers;
+
+	// Revision of the document when it was last marked unmodified (e.g., when
+	// saving); blocks with a later revision are marked as modified
+	const QTextDocument * _revisionDocument{nullptr};
+	QMetaObject::Connection _modificationConnection;
+	int _savedRevision{0};
+
+	// Cache of the font metrics (invalidated when the font changes)
+	mutable int _digitWidth{-1};
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(LineNumberWidget::Markers)
+
 } // namespace UI
 } // namespace Tw
 
@@ -0,0 +1,140 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+
+#include "utils/RegularExpressionSet.h"
+
+namespace Tw {
+namespace Utils {
+
+QString RegularExpressionSet::Match::captured(const int n /* = 0 */) const
+{
+	if (!hasMatch())
+		return QString();
+	return match.captured(groupOffset + n);
+}
+
+RegularExpressionSet::RegularExpressionSet(const QList<QRegularExpression> & patterns)
+	: _patterns(patterns)
+{
+	QString combined;
+	QRegularExpression::PatternOptions options{QRegularExpression::NoPatternOption};
+	int group = 1;
+
+	for (int i = 0; i < _patterns.size(); ++i) {
+		const QRegularExpression & pattern = _patterns[i];
+		if (_combinedIndices.empty())
+			options = pattern.patternOptions();
+		if (!canCombine(pattern, options)) {
+			_separateIndices.append(i);
+			continue;
+		}
+		if (!combined.isEmpty())
+			combined += QChar::fromLatin1('|');
+		combined += QChar::fromLatin1('(') + pattern.pattern() + QChar::fromLatin1(')');
+		_combinedIndices.append(i);
+		_groupOffsets.append(group);
+		group += 1 + pattern.captureCount();
+	}
+
+	if (_combinedIndices.empty())
+		return;
+
+	_combined = QRegularExpression(combined, options);
+	// If anything went wrong (which canCombine() should have prevented), the
+	// group offsets are off; fall back to running all patterns separately
+	if (!_combined.isValid() || _combined.captureCount() != group - 1) {
+		_combined = QRegularExpression();
+		_separateIndices.clear();
+		for (int i = 0; i < _patterns.size(); ++i)
+			_separateIndices.append(i);
+		_combinedIndices.clear();
+		_groupOffsets.clear();
+		return;
+	}
+	_combined.optimize();
+}
+
+// static
+bool RegularExpressionSet::canCombine(const QRegularExpression & pattern, const QRegularExpression::PatternOptions options)
+{
+	// Constructs that behave differently when the pattern is embedded in a
+	// larger one:
+	// - numbered, relative or named backreferences and subroutine calls (the
+	//   group numbers shift; group names could clash)
+	// - recursion (would recurse into the combined pattern)
+	// - conditionals (may refer to groups)
+	// - extended mode (a trailing comment would swallow the closing
+	//   parenthesis)
+	// - \Q without \E (likewise)
+	// - verbs like (*UTF) that are only valid at the start of the pattern
+	// Some of these checks are overly cautious, but a false positive merely
+	// means the pattern is run separately.
+	static const QRegularExpression unsafe(QStringLiteral(
+		"\\\\[1-9gkQ]|\\(\\?(?:P[<=>]|&|R|[+-]?\\d|\\(|<[A-Za-z_]|'|[\\^A-Za-z-]*x)|\\(\\*"
+	));
+
+	if (!pattern.isValid() || pattern.patternOptions() != options)
+		return false;
+	if (options.testFlag(QRegularExpression::ExtendedPatternSyntaxOption))
+		return false;
+	return !unsafe.match(pattern.pattern()).hasMatch();
+}
+
+RegularExpressionSet::Match RegularExpressionSet::match(const QString & text, const QString::size_type offset /* = 0 */) const
+{
+	Match retVal;
+
+	if (!_combinedIndices.empty()) {
+		QRegularExpressionMatch m = _combined.match(text, offset);
+		if (m.hasMatch()) {
+			// Exactly one of the alternatives took part in the match; the
+			// groups of all others are unset
+			for (int i = 0; i < _combinedIndices.size(); ++i) {
+				if (m.capturedStart(_groupOffsets[i]) < 0)
+					continue;
+				retVal.index = _combinedIndices[i];
+				retVal.start = m.capturedStart();
+				retVal.length = m.capturedLength();
+				retVal.match = m;
+				retVal.groupOffset = _groupOffsets[i];
+				break;
+			}
+		}
+	}
+
+	for (const int i : _separateIndices) {
+		QRegularExpressionMatch m = _patterns[i].match(text, offset);
+		if (!m.hasMatch())
+			continue;
+		if (retVal.hasMatch() && (m.capturedStart() > retVal.start || (m.capturedStart() == retVal.start && i > retVal.index)))
+			continue;
+		retVal.index = i;
+		retVal.start = m.capturedStart();
+		retVal.length = m.capturedLength();
+		retVal.match = m;
+		retVal.groupOffset = 0;
+	}
+
+	return retVal;
+}
+
+} // namespace Utils
+} // namespace Tw
@@ -0,0 +1,87 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef TW_REGULAREXPRESSIONSET_H
+#define TW_REGULAREXPRESSIONSET_H
+
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+namespace Tw {
+namespace Utils {
+
+// Finds the match of a list of regular expressions that starts closest to a
+// given offset. If several patterns match at the same position, the one that
+// comes first in the list wins.
+//
+// Instead of running every pattern separately, the patterns are compiled into
+// a single alternation "(p0)|(p1)|..." up front. PCRE tries the alternatives
+// in order at each position, so a single scan yields the same result as
+// running all patterns and picking the nearest match. Patterns that can't be
+// combined without changing their meaning (e.g., because they contain
+// backreferences, which would be renumbered) are run separately and merged
+// with the result of the combined pattern.
+class RegularExpressionSet
+{
+public:
+	struct Match {
+		// Index of the pattern that matched, or -1 if none did
+		int index{-1};
+		QString::size_type start{-1};
+		QString::size_type length{0};
+
+		bool hasMatch() const { return index >= 0; }
+		// Returns the text captured by group `n` of the pattern that matched
+		QString captured(const int n = 0) const;
+
+		QRegularExpressionMatch match;
+		int groupOffset{0};
+	};
+
+	RegularExpressionSet() = default;
+	explicit RegularExpressionSet(const QList<QRegularExpression> & patterns);
+
+	int count() const { return static_cast<int>(_patterns.size()); }
+	const QList<QRegularExpression> & patterns() const { return _patterns; }
+	// Returns true if the pattern at `index` is part of the combined pattern
+	// (as opposed to being run separately)
+	bool isCombined(const int index) const { return _combinedIndices.contains(index); }
+
+	Match match(const QString & text, const QString::size_type offset = 0) const;
+
+private:
+	static bool canCombine(const QRegularExpression & pattern, const QRegularExpression::PatternOptions options);
+
+	QList<QRegularExpression> _patterns;
+	QRegularExpression _combined;
+	// Indices (into _patterns) of the alternatives in _combined and the
+	// capture group that wraps each of them
+	QVector<int> _combinedIndices;
+	QVector<int> _groupOffsets;
+	// Indices (into _patterns) of the patterns that are run separately
+	QVector<int> _separateIndices;
+};
+
+} // namespace Utils
+} // namespace Tw
+
+#endif // !defined(TW_REGULAREXPRESSIONSET_H)
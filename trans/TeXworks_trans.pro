@@ -30,8 +30,11 @@ SOURCES = \
   "../src/document/Document.cpp" \
   "../src/document/SpellCheckManager.cpp" \
   "../src/document/SpellChecker.cpp" \
+  "../src/document/TagsModel.cpp" \
+  "../src/document/TagTree.cpp" \
   "../src/document/TeXDocument.cpp" \
   "../src/document/TextDocument.cpp" \
+  "../src/document/TextFileReader.cpp" \
   "../src/main.cpp" \
   "../src/scripting/ECMAScript.cpp" \
   "../src/scripting/ECMAScriptInterface.cpp" \
@@ -52,6 +55,7 @@ SOURCES = \
   "../src/utils/CommandlineParser.cpp" \
   "../src/utils/FileVersionDatabase.cpp" \
   "../src/utils/FullscreenManager.cpp" \
+  "../src/utils/RegularExpressionSet.cpp" \
   "../src/utils/ResourcesLibrary.cpp" \
   "../src/utils/SystemCommand.cpp" \
   "../src/utils/TextCodecs.cpp" \
@@ -88,8 +92,11 @@ HEADERS = \
   "../src/document/Document.h" \
   "../src/document/SpellCheckManager.h" \
   "../src/document/SpellChecker.h" \
+  "../src/document/TagsModel.h" \
+  "../src/document/TagTree.h" \
   "../src/document/TeXDocument.h" \
   "../src/document/TextDocument.h" \
+  "../src/document/TextFileReader.h" \
   "../src/scripting/JSScript.h" \
   "../src/scripting/JSScriptInterface.h" \
   "../src/scripting/Script.h" \
@@ -109,6 +116,7 @@ HEADERS = \
   "../src/utils/FileVersionDatabase.h" \
   "../src/utils/FullscreenManager.h" \
   "../src/utils/IniConfig.h" \
+  "../src/utils/RegularExpressionSet.h" \
   "../src/utils/ResourcesLibrary.h" \
   "../src/utils/SystemCommand.h" \
   "../src/utils/TextCodecs.h" \
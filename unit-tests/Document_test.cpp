@@ -27,11 +27,16 @@
 #include "document/Document.h"
 #include "document/SpellChecker.h"
 #include "document/SpellCheckManager.h"
+#include "document/TagsModel.h"
 #include "document/TeXDocument.h"
 #include "document/TextDocument.h"
+#include "document/TextFileReader.h"
 #include "utils/ResourcesLibrary.h"
 
 #include <QSignalSpy>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+#include <QAbstractItemModelTester>
+#endif
 #include <limits>
 
 #if WITH_POPPLERQT
@@ -47,15 +52,6 @@ Q_DECLARE_METATYPE(TWSynchronizer::TeXSyncPoint)
 Q_DECLARE_METATYPE(TWSynchronizer::PDFSyncPoint)
 Q_DECLARE_METATYPE(TWSynchronizer::Resolution)
 
-void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc) { Q_UNUSED(doc) }
-void NonblockingSyntaxHighlighter::rehighlight() { }
-void NonblockingSyntaxHighlighter::rehighlightBlock(const QTextBlock & block) { Q_UNUSED(block) }
-void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsRemoved, int charsAdded) { Q_UNUSED(position) Q_UNUSED(charsRemoved) Q_UNUSED(charsAdded) }
-void NonblockingSyntaxHighlighter::process() { }
-void NonblockingSyntaxHighlighter::processWhenIdle() {}
-TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent) : NonblockingSyntaxHighlighter(parent) { }
-void TeXHighlighter::highlightBlock(const QString &text) { Q_UNUSED(text) }
-
 char * toString(const TWSyncTeXSynchronizer::TeXSyncPoint & p) {
 	return QTest::toString(QStringLiteral("TeXSyncPoint(%0 @ %1, %2 - %3)").arg(p.filename).arg(p.line).arg(p.col).arg(p.col + p.len));
 }
@@ -126,6 +122,8 @@ namespace Tw {
 namespace Utils {
 // Referenced in Tw::Document::SpellCheckManager
 const QStringList ResourcesLibrary::getLibraryPaths(const QString & subdir, const bool updateOnDisk) { Q_UNUSED(subdir) Q_UNUSED(updateOnDisk) return QStringList(QDir::currentPath()); }
+// Referenced in TeXHighlighter (to load the default patterns)
+const QString ResourcesLibrary::getLibraryPath(const QString & subdir, const bool updateOnDisk) { Q_UNUSED(updateOnDisk) return QDir::current().absoluteFilePath(QStringLiteral("../res/resfiles/") + subdir); }
 } // namespace Utils
 } // namespace Tw
 
@@ -255,6 +253,262 @@ void TestDocument::tags()
 	QCOMPARE(spy.count(), 1);
 }
 
+namespace {
+
+QTextCursor selection(QTextDocument * doc, const int start, const int end)
+{
+	QTextCursor cursor(doc);
+	cursor.setPosition(start);
+	cursor.setPosition(end, QTextCursor::KeepAnchor);
+	return cursor;
+}
+
+} // anonymous namespace
+
+void TestDocument::tags_edit()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("Hello World\nSecond line"));
+	QSignalSpy spy(&doc, &Tw::Document::TextDocument::tagsChanged);
+	QVERIFY(spy.isValid());
+
+	doc.addTag(selection(&doc, 0, 5), 1, QStringLiteral("Hello"));
+	doc.addTag(selection(&doc, 6, 11), 2, QStringLiteral("World"));
+	doc.addTag(selection(&doc, 12, 18), 1, QStringLiteral("Second"));
+	QCOMPARE(doc.tagCount(), 3);
+	spy.clear();
+
+	// Inserting text shifts all later tags
+	QTextCursor(&doc).insertText(QStringLiteral("XX"));
+	QCOMPARE(spy.count(), 0);
+	QCOMPARE(doc.tagCount(), 3);
+	QCOMPARE(doc.getTag(0).cursor.selectedText(), QStringLiteral("Hello"));
+	QCOMPARE(doc.getTag(1).cursor.selectedText(), QStringLiteral("World"));
+	QCOMPARE(doc.getTag(2).cursor.selectedText(), QStringLiteral("Second"));
+
+	// Removing the tagged text removes the tag
+	selection(&doc, 8, 13).removeSelectedText();
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(doc.tagCount(), 2);
+	QCOMPARE(doc.getTag(0).text, QStringLiteral("Hello"));
+	QCOMPARE(doc.getTag(1).text, QStringLiteral("Second"));
+	QCOMPARE(doc.getTag(1).cursor.selectedText(), QStringLiteral("Second"));
+
+	// Changes of the formatting are reported as replacing the text by itself,
+	// but don't affect the tags
+	spy.clear();
+	QTextCharFormat format;
+	format.setFontWeight(QFont::Bold);
+	selection(&doc, 0, doc.characterCount() - 1).mergeCharFormat(format);
+	QCOMPARE(spy.count(), 0);
+	QCOMPARE(doc.tagCount(), 2);
+	QCOMPARE(doc.getTag(0).cursor.selectedText(), QStringLiteral("Hello"));
+	QCOMPARE(doc.getTag(1).cursor.selectedText(), QStringLiteral("Second"));
+
+	// Replacing the whole text removes all tags at once
+	doc.setPlainText(QStringLiteral("Something else"));
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(doc.tagCount(), 0);
+}
+
+void TestDocument::tags_range()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("x").repeated(1000));
+
+	// Insert in reverse order to make sure the tags are sorted
+	for (int i = 99; i >= 0; --i)
+		doc.addTag(selection(&doc, 10 * i, 10 * i + 5), 1, QString::number(i));
+	QCOMPARE(doc.tagCount(), 100);
+	for (int i = 0; i < doc.tagCount(); ++i)
+		QCOMPARE(doc.getTag(i).text, QString::number(i));
+
+	QCOMPARE(doc.tagIndexForPosition(0), 0);
+	QCOMPARE(doc.tagIndexForPosition(1), 1);
+	QCOMPARE(doc.tagIndexForPosition(500), 50);
+	QCOMPARE(doc.tagIndexForPosition(1000), 100);
+
+	// Tags overlapping the range (the one at 500 ends at 505)
+	QList<Tw::Document::TextDocument::Tag> tags = doc.getTags(503, 521);
+	QCOMPARE(tags.size(), 3);
+	QCOMPARE(tags[0].text, QStringLiteral("50"));
+	QCOMPARE(tags[1].text, QStringLiteral("51"));
+	QCOMPARE(tags[2].text, QStringLiteral("52"));
+	QCOMPARE(doc.getTags(505, 510).size(), 0);
+	QCOMPARE(doc.getTags().size(), 100);
+
+	QCOMPARE(doc.removeTags(200, 300), 30u);
+	QCOMPARE(doc.tagCount(), 70);
+	QCOMPARE(doc.getTag(20).text, QStringLiteral("50"));
+}
+
+void TestDocument::tags_update()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("Hello World"));
+	QSignalSpy spy(&doc, &Tw::Document::TextDocument::tagsChanged);
+	QVERIFY(spy.isValid());
+
+	// Changes are reported once the (outermost) update ends
+	doc.beginTagUpdate();
+	doc.addTag(selection(&doc, 0, 5), 1, QStringLiteral("Hello"));
+	doc.beginTagUpdate();
+	doc.addTag(selection(&doc, 6, 11), 1, QStringLiteral("World"));
+	doc.endTagUpdate();
+	doc.removeTags(6, 1);
+	QCOMPARE(spy.count(), 0);
+	doc.endTagUpdate();
+	QCOMPARE(spy.count(), 1);
+
+	// Updates without changes are not reported
+	doc.beginTagUpdate();
+	doc.endTagUpdate();
+	QCOMPARE(spy.count(), 1);
+
+	// Replacing tags by the same ones is not a change
+	const QList<Tw::Document::TextDocument::Tag> tags{{selection(&doc, 0, 5), 1, QStringLiteral("Hello")}};
+	doc.replaceTags(0, doc.characterCount(), tags);
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(doc.getTags(), tags);
+
+	const QList<Tw::Document::TextDocument::Tag> newTags{{selection(&doc, 6, 11), 2, QStringLiteral("World")}, {selection(&doc, 0, 5), 1, QStringLiteral("Hello")}};
+	doc.replaceTags(0, doc.characterCount(), newTags);
+	QCOMPARE(spy.count(), 2);
+	QCOMPARE(doc.tagCount(), 2);
+	QCOMPARE(doc.getTag(0).text, QStringLiteral("Hello"));
+	QCOMPARE(doc.getTag(1).text, QStringLiteral("World"));
+}
+
+namespace {
+
+Tw::Document::TagTree::Entry tagEntry(const unsigned int level, const QString & text)
+{
+	return Tw::Document::TagTree::Entry{0, 0, level, text};
+}
+
+// Flattens the model into "text(tagIndex)" lines indented by depth
+QStringList dumpModel(const QAbstractItemModel & model, const QModelIndex & parent = {}, const QString & indent = {})
+{
+	QStringList retVal;
+	for (int row = 0; row < model.rowCount(parent); ++row) {
+		const QModelIndex index = model.index(row, 0, parent);
+		retVal << QStringLiteral("%1%2(%3)").arg(indent, index.data().toString(), index.data(Tw::Document::TagsModel::TagIndexRole).toString());
+		retVal << dumpModel(model, index, indent + QStringLiteral("  "));
+	}
+	return retVal;
+}
+
+} // anonymous namespace
+
+void TestDocument::TagsModel_setTags()
+{
+	Tw::Document::TagsModel model;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+	QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+#endif
+	QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+	QSignalSpy insertSpy(&model, &QAbstractItemModel::rowsInserted);
+	QSignalSpy removeSpy(&model, &QAbstractItemModel::rowsRemoved);
+	QSignalSpy changeSpy(&model, &QAbstractItemModel::dataChanged);
+
+	QCOMPARE(dumpModel(model), QStringList{QStringLiteral("No tags(-1)")});
+
+	QVector<Tw::Document::TagTree::Entry> tags{
+		tagEntry(1, QStringLiteral("Intro")),
+		tagEntry(0, QStringLiteral("mark")),
+		tagEntry(2, QStringLiteral("Background")),
+		tagEntry(1, QStringLiteral("Method")),
+		tagEntry(3, QStringLiteral("Detail"))
+	};
+	model.setTags(tags);
+	QCOMPARE(dumpModel(model), QStringList({
+		QStringLiteral("Bookmarks(-1)"),
+		QStringLiteral("  mark(1)"),
+		QStringLiteral("Outline(-1)"),
+		QStringLiteral("  Intro(0)"),
+		QStringLiteral("    Background(2)"),
+		QStringLiteral("  Method(3)"),
+		QStringLiteral("    Detail(4)")
+	}));
+	QCOMPARE(model.flags(model.index(0, 0)), Qt::ItemFlags(Qt::ItemIsEnabled));
+	QCOMPARE(model.flags(model.index(0, 0, model.index(0, 0))), Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+
+	// Setting the same tags again doesn't change anything
+	resetSpy.clear();
+	insertSpy.clear();
+	removeSpy.clear();
+	changeSpy.clear();
+	model.setTags(tags);
+	QCOMPARE(insertSpy.count(), 0);
+	QCOMPARE(removeSpy.count(), 0);
+	QCOMPARE(changeSpy.count(), 0);
+
+	// Editing a title updates the row in place (keeping its children)
+	tags[3].text = QStringLiteral("Methods");
+	model.setTags(tags);
+	QCOMPARE(insertSpy.count(), 0);
+	QCOMPARE(removeSpy.count(), 0);
+	QCOMPARE(changeSpy.count(), 1);
+	QCOMPARE(model.index(1, 0, model.index(1, 0)).data().toString(), QStringLiteral("Methods"));
+	QCOMPARE(model.rowCount(model.index(1, 0, model.index(1, 0))), 1);
+
+	// Adding a tag inserts exactly one row (and updates the indices of later
+	// tags)
+	changeSpy.clear();
+	tags.insert(3, tagEntry(2, QStringLiteral("Related work")));
+	model.setTags(tags);
+	QCOMPARE(insertSpy.count(), 1);
+	QCOMPARE(removeSpy.count(), 0);
+	QCOMPARE(changeSpy.count(), 0);
+	QCOMPARE(dumpModel(model), QStringList({
+		QStringLiteral("Bookmarks(-1)"),
+		QStringLiteral("  mark(1)"),
+		QStringLiteral("Outline(-1)"),
+		QStringLiteral("  Intro(0)"),
+		QStringLiteral("    Background(2)"),
+		QStringLiteral("    Related work(3)"),
+		QStringLiteral("  Methods(4)"),
+		QStringLiteral("    Detail(5)")
+	}));
+
+	// Removing the only bookmark removes its group
+	insertSpy.clear();
+	tags.remove(1);
+	model.setTags(tags);
+	QCOMPARE(insertSpy.count(), 0);
+	QCOMPARE(removeSpy.count(), 1);
+	QCOMPARE(model.rowCount(), 1);
+	QCOMPARE(model.index(0, 0).data().toString(), QStringLiteral("Outline"));
+	QCOMPARE(model.tagIndex(model.index(0, 0, model.index(0, 0))), 0);
+	QCOMPARE(model.tagIndex(model.index(1, 0, model.index(0, 0))), 3);
+
+	model.setTags({});
+	QCOMPARE(dumpModel(model), QStringList{QStringLiteral("No tags(-1)")});
+	QCOMPARE(resetSpy.count(), 0);
+}
+
+void TestDocument::TagsModel_largeDocument()
+{
+	Tw::Document::TagsModel model;
+	QSignalSpy insertSpy(&model, &QAbstractItemModel::rowsInserted);
+	QSignalSpy removeSpy(&model, &QAbstractItemModel::rowsRemoved);
+
+	QVector<Tw::Document::TagTree::Entry> tags;
+	for (int i = 0; i < 10000; ++i)
+		tags.append(tagEntry(static_cast<unsigned int>(1 + i % 3), QStringLiteral("Section %1").arg(i)));
+	model.setTags(tags);
+
+	// Typing a new section somewhere in the middle only inserts that row
+	insertSpy.clear();
+	tags.insert(5001, tagEntry(3, QStringLiteral("New")));
+	model.setTags(tags);
+	QCOMPARE(insertSpy.count(), 1);
+	QCOMPARE(removeSpy.count(), 0);
+
+	// Cost of an update that doesn't change anything (i.e., the diff itself)
+	QBENCHMARK {
+		model.setTags(tags);
+	}
+	QCOMPARE(insertSpy.count(), 1);
+}
+
 void TestDocument::getHighlighter()
 {
 	Tw::Document::TeXDocument doc;
@@ -264,6 +518,111 @@ void TestDocument::getHighlighter()
 	QCOMPARE(doc.getHighlighter(), &highlighter);
 }
 
+void TestDocument::TeXHighlighter_tokenize()
+{
+	struct ExpectedSpan {
+		int start;
+		int length;
+		int format;
+	};
+	const auto compareSpans = [](const QVector<TeXHighlighter::TokenizeResult::Span> & actual, const QVector<ExpectedSpan> & expected) {
+		if (actual.size() != expected.size())
+			return false;
+		for (int i = 0; i < expected.size(); ++i) {
+			if (actual[i].start != expected[i].start || actual[i].length != expected[i].length || actual[i].format != expected[i].format)
+				return false;
+		}
+		return true;
+	};
+
+	Tw::Document::TeXDocument doc;
+	// Loads the default patterns
+	TeXHighlighter highlighter(&doc);
+	const int latex = TeXHighlighter::syntaxOptions().indexOf(QStringLiteral("LaTeX"));
+	QVERIFY(latex >= 0);
+
+	TeXHighlighter::TokenizeJob job;
+	job.id = 42;
+	job.revision = 7;
+	job.text = QStringLiteral("\\section{Wrld} World % Wrld");
+
+	TeXHighlighter::TokenizeBatch batch;
+	batch.highlightIndex = latex;
+	batch.tagging = true;
+
+	// LaTeX rules: 0 = special characters, 3 = control sequences, 4 = comments
+	// (spell checked)
+	{
+		const TeXHighlighter::TokenizeResult result = TeXHighlighter::tokenize(job, batch);
+		QCOMPARE(result.id, job.id);
+		QCOMPARE(result.revision, job.revision);
+		QCOMPARE(result.text, job.text);
+		QVERIFY(compareSpans(result.formats, {{0, 8, 6}, {8, 1, 0}, {13, 1, 0}, {21, 6, 8}}));
+		QCOMPARE(result.tags.size(), 1);
+		QCOMPARE(result.tags[0].start, QString::size_type(0));
+		QCOMPARE(result.tags[0].length, QString::size_type(14));
+		QCOMPARE(result.tags[0].level, 3u);
+		QCOMPARE(result.tags[0].text, QStringLiteral("Wrld"));
+	}
+
+	// Misspelled words outside of rules are marked with -1, those inside rules
+	// with 2 * rule + 1
+	batch.spellChecker = Tw::Document::SpellChecker(QStringLiteral("dictionary"));
+	batch.tagging = false;
+	{
+		const TeXHighlighter::TokenizeResult result = TeXHighlighter::tokenize(job, batch);
+		QVERIFY(compareSpans(result.formats, {{0, 8, 6}, {8, 1, 0}, {9, 4, -1}, {13, 1, 0}, {21, 6, 8}, {23, 4, 9}}));
+		QVERIFY(result.tags.isEmpty());
+	}
+
+	// Without a syntax mode, only spell checking is done
+	batch.highlightIndex = -1;
+	{
+		const TeXHighlighter::TokenizeResult result = TeXHighlighter::tokenize(job, batch);
+		QVERIFY(compareSpans(result.formats, {{9, 4, -1}, {23, 4, -1}}));
+	}
+}
+
+void TestDocument::TeXHighlighter_editWhileTokenizing()
+{
+	const auto formatCount = [](const QTextBlock & block) {
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+		return block.layout()->additionalFormats().size();
+#else
+		return block.layout()->formats().size();
+#endif
+	};
+
+	Tw::Document::TeXDocument doc(QStringLiteral("\\section{A}\nfoo\n\\section{B}\nbar"));
+	TeXHighlighter highlighter(&doc);
+	highlighter.setActiveIndex(TeXHighlighter::syntaxOptions().indexOf(QStringLiteral("LaTeX")));
+
+	// Insert a line at the top while the worker tokenizes the blocks; all
+	// following blocks are renumbered, but not changed, so their results must
+	// still be applied
+	bool edited{false};
+	connect(&highlighter, &TeXHighlighter::tokenizeRequested, &doc, [&doc, &edited]() {
+		if (edited)
+			return;
+		edited = true;
+		QTextCursor cursor(&doc);
+		cursor.insertText(QStringLiteral("\n"));
+	});
+
+	QTRY_COMPARE(doc.getTags().size(), 2);
+	QVERIFY(edited);
+	QCOMPARE(doc.toPlainText(), QStringLiteral("\n\\section{A}\nfoo\n\\section{B}\nbar"));
+
+	const QList<Tw::Document::TextDocument::Tag> tags = doc.getTags();
+	QCOMPARE(tags[0].text, QStringLiteral("A"));
+	QCOMPARE(tags[0].cursor.selectionStart(), doc.findBlockByNumber(1).position());
+	QCOMPARE(tags[1].text, QStringLiteral("B"));
+	QCOMPARE(tags[1].cursor.selectionStart(), doc.findBlockByNumber(3).position());
+
+	QTRY_VERIFY(formatCount(doc.findBlockByNumber(1)) > 0);
+	QTRY_VERIFY(formatCount(doc.findBlockByNumber(3)) > 0);
+}
+
 void TestDocument::modelines()
 {
 	Tw::Document::TeXDocument doc(QStringLiteral("Lorem ipsum\n").repeated(200));
@@ -441,6 +800,57 @@ void TestDocument::SpellCheckManager_getDictionaryList()
 	QCOMPARE(spy.count(), 2);
 }
 
+void TestDocument::SpellCheckManager_loadDictionaryAsync()
+{
+	using Tw::Document::SpellCheckManager;
+	const QString lang{QStringLiteral("dictionary")};
+	const QString missingLang{QStringLiteral("does-not-exist")};
+
+	QSignalSpy spy(SpellCheckManager::instance(), &SpellCheckManager::dictionaryLoaded);
+	QVERIFY(spy.isValid());
+
+	SpellCheckManager::clearDictionaries();
+	QCOMPARE(SpellCheckManager::isDictionaryLoaded(lang), false);
+	QCOMPARE(SpellCheckManager::isDictionaryLoaded(QString()), true);
+	QCOMPARE(SpellCheckManager::loadDictionaryAsync(QString()), true);
+
+	// The test dictionary is small, so it may be ready right away; otherwise,
+	// concurrent requests share one load and one notification
+	const bool ready = SpellCheckManager::loadDictionaryAsync(lang);
+	SpellCheckManager::loadDictionaryAsync(lang);
+	if (!ready) {
+		QVERIFY(spy.wait());
+		QCOMPARE(spy.count(), 1);
+		QCOMPARE(spy.at(0).at(0).toString(), lang);
+	}
+	QCOMPARE(SpellCheckManager::isDictionaryLoaded(lang), true);
+	QCOMPARE(SpellCheckManager::loadDictionaryAsync(lang), true);
+	QCoreApplication::processEvents();
+	QCOMPARE(spy.count(), (ready ? 0 : 1));
+
+	// Synchronous users get the dictionary loaded in the background
+	Tw::Document::SpellChecker spellChecker(lang);
+	QCOMPARE(spellChecker.isValid(), true);
+	QCOMPARE(spellChecker.isWordCorrect(QStringLiteral("World")), true);
+
+	// Requesting a dictionary that doesn't exist finishes as well
+	spy.clear();
+	if (!SpellCheckManager::loadDictionaryAsync(missingLang)) {
+		QVERIFY(spy.wait());
+		QCOMPARE(spy.at(0).at(0).toString(), missingLang);
+	}
+	QCOMPARE(SpellCheckManager::isDictionaryLoaded(missingLang), true);
+	QCOMPARE(Tw::Document::SpellChecker(missingLang).isValid(), false);
+
+	// Preloading doesn't notify anyone
+	SpellCheckManager::clearDictionaries();
+	spy.clear();
+	SpellCheckManager::preloadDictionaries(QStringList{lang});
+	QTRY_VERIFY(SpellCheckManager::isDictionaryLoaded(lang));
+	QCoreApplication::processEvents();
+	QCOMPARE(spy.count(), 0);
+}
+
 void TestDocument::SpellChecker()
 {
 	const QString lang{QStringLiteral("dictionary")};
@@ -509,6 +919,269 @@ void TestDocument::SpellChecker_ignoreWord()
 	}
 }
 
+void TestDocument::SpellChecker_cache()
+{
+	const QString lang{QStringLiteral("dictionary")};
+	const QString correctWord{QStringLiteral("World")};
+	const QString wrongWord{QStringLiteral("Wrld")};
+
+	Tw::Document::SpellCheckManager::clearDictionaries();
+	Tw::Document::SpellChecker spellChecker(lang);
+	Tw::Document::SpellChecker otherSpellChecker(lang);
+
+	QCOMPARE(spellChecker.cacheStatistics().hits, quint64(0));
+	QCOMPARE(spellChecker.cacheStatistics().misses, quint64(0));
+
+	QCOMPARE(spellChecker.isWordCorrect(correctWord), true);
+	QCOMPARE(spellChecker.isWordCorrect(correctWord), true);
+	QCOMPARE(spellChecker.isWordCorrect(wrongWord), false);
+	QCOMPARE(spellChecker.isWordCorrect(wrongWord), false);
+	Tw::Document::SpellCheckCache::Statistics stats = spellChecker.cacheStatistics();
+	QCOMPARE(stats.hits, quint64(2));
+	QCOMPARE(stats.misses, quint64(2));
+	QCOMPARE(stats.size, 2);
+	QCOMPARE(stats.hitRate(), 0.5);
+
+	// Spell checkers using the same dictionary share the cache
+	QCOMPARE(otherSpellChecker.isWordCorrect(correctWord), true);
+	QCOMPARE(otherSpellChecker.cacheStatistics().hits, quint64(3));
+
+	// Ignoring a word must invalidate the cached result for all spell checkers
+	spellChecker.ignoreWord(wrongWord);
+	QCOMPARE(spellChecker.cacheStatistics().size, 0);
+	QCOMPARE(spellChecker.isWordCorrect(wrongWord), true);
+	QCOMPARE(otherSpellChecker.isWordCorrect(wrongWord), true);
+
+	// The cache is bounded
+	Tw::Document::SpellCheckCache cache;
+	bool correct{false};
+	cache.setMaxSize(4);
+	for (int i = 0; i < 10; ++i)
+		cache.insert(QStringLiteral("word%1").arg(i), (i % 2 == 0));
+	QVERIFY(cache.statistics().size <= 4);
+	QCOMPARE(cache.lookup(QStringLiteral("word0"), correct), false);
+	// Recently used words are kept
+	QCOMPARE(cache.lookup(QStringLiteral("word8"), correct), true);
+	QCOMPARE(correct, true);
+	QCOMPARE(cache.lookup(QStringLiteral("word9"), correct), true);
+	QCOMPARE(correct, false);
+	cache.clear();
+	QCOMPARE(cache.statistics().size, 0);
+	QCOMPARE(cache.lookup(QStringLiteral("word9"), correct), false);
+	QCOMPARE(cache.statistics().hits, quint64(2));
+	QCOMPARE(cache.statistics().misses, quint64(2));
+
+	// A reloaded dictionary starts with an empty cache (the ignored word is
+	// gone as well)
+	Tw::Document::SpellCheckManager::clearDictionaries();
+	QCOMPARE(spellChecker.isWordCorrect(wrongWord), false);
+	QCOMPARE(spellChecker.cacheStatistics().hits, quint64(0));
+}
+
+void TestDocument::SpellChecker_benchmark_data()
+{
+	QTest::addColumn<bool>("cached");
+	QTest::newRow("uncached") << false;
+	QTest::newRow("cached") << true;
+}
+
+void TestDocument::SpellChecker_benchmark()
+{
+	QFETCH(bool, cached);
+
+	QFile file(QStringLiteral("sync.tex"));
+	QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+	const QStringList lines = QString::fromUtf8(file.readAll()).repeated(50).split(QChar::fromLatin1('\n'));
+
+	const bool wasEnabled = Tw::Document::SpellCheckCache::isEnabled();
+	Tw::Document::SpellCheckCache::setEnabled(cached);
+	Tw::Document::SpellCheckManager::clearDictionaries();
+	Tw::Document::SpellChecker spellChecker(QStringLiteral("dictionary"));
+
+	// Check every word of every line like TeXHighlighter does when
+	// rehighlighting the whole document
+	int misspelled{0};
+	QBENCHMARK {
+		misspelled = 0;
+		for (const QString & line : lines) {
+			QString::size_type index{0};
+			while (index < line.length()) {
+				QString::size_type start{0}, end{0};
+				if (Tw::Document::TeXDocument::findNextWord(line, index, start, end) && start < end) {
+					if (!spellChecker.isWordCorrect(line.mid(start, end - start)))
+						++misspelled;
+				}
+				index = qMax(end, index + 1);
+			}
+		}
+	}
+	Tw::Document::SpellCheckCache::setEnabled(wasEnabled);
+
+	QVERIFY(misspelled > 0);
+	if (cached)
+		QVERIFY(spellChecker.cacheStatistics().hitRate() > 0.9);
+}
+
+static QString writeTestFile(const QTemporaryDir & dir, const QString & name, const QByteArray & data)
+{
+	const QString filePath = QDir(dir.path()).absoluteFilePath(name);
+	QFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+		return QString();
+	return filePath;
+}
+
+void TestDocument::TextFileReader_read_data()
+{
+	QTest::addColumn<QByteArray>("data");
+	QTest::addColumn<QString>("text");
+	QTest::addColumn<qint64>("crlf");
+	QTest::addColumn<qint64>("cr");
+	QTest::addColumn<qint64>("lf");
+
+	QTest::newRow("empty") << QByteArray() << QString() << qint64(0) << qint64(0) << qint64(0);
+	QTest::newRow("LF") << QByteArray("a\nb\n") << QStringLiteral("a\nb\n") << qint64(0) << qint64(0) << qint64(2);
+	QTest::newRow("CRLF") << QByteArray("a\r\nb\r\n") << QStringLiteral("a\nb\n") << qint64(2) << qint64(0) << qint64(0);
+	QTest::newRow("CR") << QByteArray("a\rb\r") << QStringLiteral("a\nb\n") << qint64(0) << qint64(2) << qint64(0);
+	QTest::newRow("mixed") << QByteArray("a\r\nb\rc\nd") << QStringLiteral("a\nb\nc\nd") << qint64(1) << qint64(1) << qint64(1);
+	QTest::newRow("empty lines") << QByteArray("\r\r\n\n\r") << QStringLiteral("\n\n\n\n") << qint64(1) << qint64(2) << qint64(1);
+}
+
+void TestDocument::TextFileReader_read()
+{
+	QFETCH(QByteArray, data);
+	QFETCH(QString, text);
+	QFETCH(qint64, crlf);
+	QFETCH(qint64, cr);
+	QFETCH(qint64, lf);
+
+	QTextCodec * utf8 = QTextCodec::codecForName("UTF-8");
+	const QString filePath = writeTestFile(m_tempDir, QStringLiteral("read.tex"), data);
+	QVERIFY(!filePath.isEmpty());
+
+	const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8);
+	QVERIFY(result.status == Tw::Document::TextFileReader::Result::Status::OK);
+	QCOMPARE(result.text, text);
+	// Empty files yield empty (but not null) strings
+	QVERIFY(!result.text.isNull());
+	QCOMPARE(result.codec, utf8);
+	QCOMPARE(result.crlfCount, crlf);
+	QCOMPARE(result.crCount, cr);
+	QCOMPARE(result.lfCount, lf);
+}
+
+void TestDocument::TextFileReader_chunks()
+{
+	// Line endings and multi-byte characters that straddle the boundaries of
+	// the chunks the file is read in
+	constexpr int ChunkSize = 1024 * 1024;
+	QByteArray data(ChunkSize - 1, 'x');
+	data += "\r\n";
+	data += QByteArray(ChunkSize - 2, 'y');
+	data += "\xC3\xA4";
+	data += QByteArray(ChunkSize - 1, 'z');
+	data += "\r";
+
+	const QString filePath = writeTestFile(m_tempDir, QStringLiteral("chunks.tex"), data);
+	QVERIFY(!filePath.isEmpty());
+
+	QVector<qint64> progress;
+	const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, QTextCodec::codecForName("UTF-8"), nullptr, [&progress](qint64 bytesRead, qint64 bytesTotal) {
+		Q_UNUSED(bytesTotal)
+		progress.append(bytesRead);
+		return true;
+	});
+	QVERIFY(result.status == Tw::Document::TextFileReader::Result::Status::OK);
+	QCOMPARE(result.text, QString(ChunkSize - 1, QChar::fromLatin1('x')) + QStringLiteral("\n") + QString(ChunkSize - 2, QChar::fromLatin1('y')) + QString::fromUtf8("\xC3\xA4") + QString(ChunkSize - 1, QChar::fromLatin1('z')) + QStringLiteral("\n"));
+	QCOMPARE(result.crlfCount, qint64(1));
+	QCOMPARE(result.crCount, qint64(1));
+	QCOMPARE(result.lfCount, qint64(0));
+
+	QVERIFY(progress.size() > 1);
+	QCOMPARE(progress.first(), qint64(0));
+	QCOMPARE(progress.last(), static_cast<qint64>(data.size()));
+}
+
+void TestDocument::TextFileReader_encoding()
+{
+	QTextCodec * utf8 = QTextCodec::codecForName("UTF-8");
+	QTextCodec * latin1 = QTextCodec::codecForName("ISO-8859-1");
+	using Status = Tw::Document::TextFileReader::Result::Status;
+
+	{
+		const QString filePath = writeTestFile(m_tempDir, QStringLiteral("latin1.tex"), QByteArray("% !TEX encoding = ISO-8859-1\n\xE4\n"));
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8);
+		QVERIFY(result.status == Status::OK);
+		QCOMPARE(result.codec, latin1);
+		QVERIFY(result.unsupportedEncoding.isEmpty());
+		QCOMPARE(result.text, QStringLiteral("% !TEX encoding = ISO-8859-1\n") + QString::fromUtf8("\xC3\xA4") + QStringLiteral("\n"));
+
+		// Forced codecs take precedence
+		const Tw::Document::TextFileReader::Result forced = Tw::Document::TextFileReader::read(filePath, latin1, utf8);
+		QCOMPARE(forced.codec, utf8);
+	}
+	{
+		// TeXShop names
+		const QString filePath = writeTestFile(m_tempDir, QStringLiteral("texshop.tex"), QByteArray("% !TEX encoding = IsoLatin\n"));
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8);
+		QCOMPARE(result.codec, latin1);
+	}
+	{
+		const QString filePath = writeTestFile(m_tempDir, QStringLiteral("unsupported.tex"), QByteArray("% !TEX encoding = NoSuchEncoding\n"));
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8);
+		QVERIFY(result.status == Status::OK);
+		QCOMPARE(result.codec, utf8);
+		QCOMPARE(result.unsupportedEncoding, QStringLiteral("NoSuchEncoding"));
+	}
+	{
+		const QString filePath = writeTestFile(m_tempDir, QStringLiteral("bom.tex"), QByteArray("\xEF\xBB\xBF" "abc"));
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8);
+		QVERIFY(result.status == Status::OK);
+		QVERIFY(result.utf8BOM);
+		QCOMPARE(result.text, QStringLiteral("abc"));
+	}
+}
+
+void TestDocument::TextFileReader_errors()
+{
+	using Status = Tw::Document::TextFileReader::Result::Status;
+	QTextCodec * utf8 = QTextCodec::codecForName("UTF-8");
+
+	{
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(QDir(m_tempDir.path()).absoluteFilePath(QStringLiteral("does-not-exist.tex")), utf8);
+		QVERIFY(result.status == Status::Error);
+		QVERIFY(!result.errorString.isEmpty());
+		QVERIFY(result.text.isNull());
+	}
+	{
+		const QString filePath = writeTestFile(m_tempDir, QStringLiteral("cancel.tex"), QByteArray("abc\n"));
+		const Tw::Document::TextFileReader::Result result = Tw::Document::TextFileReader::read(filePath, utf8, nullptr, [](qint64, qint64) { return false; });
+		QVERIFY(result.status == Status::Cancelled);
+		QVERIFY(result.text.isNull());
+	}
+}
+
+void TestDocument::TextFileReader_async()
+{
+	const QString filePath = writeTestFile(m_tempDir, QStringLiteral("async.tex"), QByteArray("a\r\nb\r\n"));
+	QVERIFY(!filePath.isEmpty());
+
+	Tw::Document::TextFileReader reader;
+#if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
+	QSignalSpy spy(&reader, SIGNAL(finished()));
+#else
+	QSignalSpy spy(&reader, &Tw::Document::TextFileReader::finished);
+#endif
+	QVERIFY(spy.isValid());
+
+	reader.start(filePath, QTextCodec::codecForName("UTF-8"));
+	QVERIFY(spy.wait());
+	QVERIFY(!reader.isRunning());
+	QVERIFY(reader.result().status == Tw::Document::TextFileReader::Result::Status::OK);
+	QCOMPARE(reader.result().text, QStringLiteral("a\nb\n"));
+	QCOMPARE(reader.result().crlfCount, qint64(2));
+}
+
 void TestDocument::Synchronizer_isValid()
 {
 	TWSyncTeXSynchronizer valid(QStringLiteral("sync.pdf"), nullptr, nullptr);
@@ -43,15 +43,33 @@ private slots:
 	void absoluteFilePath();
 
 	void tags();
+	void tags_edit();
+	void tags_range();
+	void tags_update();
+	void TagsModel_setTags();
+	void TagsModel_largeDocument();
 
 	void getHighlighter();
+	void TeXHighlighter_tokenize();
+	void TeXHighlighter_editWhileTokenizing();
 	void modelines();
 	void findNextWord_data();
 	void findNextWord();
 
 	void SpellCheckManager_getDictionaryList();
+	void SpellCheckManager_loadDictionaryAsync();
 	void SpellChecker();
 	void SpellChecker_ignoreWord();
+	void SpellChecker_cache();
+	void SpellChecker_benchmark_data();
+	void SpellChecker_benchmark();
+
+	void TextFileReader_read_data();
+	void TextFileReader_read();
+	void TextFileReader_chunks();
+	void TextFileReader_encoding();
+	void TextFileReader_errors();
+	void TextFileReader_async();
 
 	void Synchronizer_isValid();
 	void Synchronizer_syncTeXFilename();
@@ -28,7 +28,9 @@
 #include "ui/ScreenCalibrationWidget.h"
 
 #include <QDoubleSpinBox>
+#include <QAbstractTextDocumentLayout>
 #include <QMouseEvent>
+#include <QScrollBar>
 #include <QTabBar>
 
 namespace UnitTest {
@@ -130,6 +132,99 @@ void TestUI::LineNumberWidget_setParent()
 #endif
 }
 
+void TestUI::LineNumberWidget_markers()
+{
+	using Marker = Tw::UI::LineNumberWidget::Marker;
+	QTextEdit e;
+	Tw::UI::LineNumberWidget w(&e);
+	const int width = w.sizeHint().width();
+
+	QVERIFY(!w.markersVisible());
+	w.setMarkersVisible(true);
+	QVERIFY(w.markersVisible());
+	QVERIFY(w.sizeHint().width() > width);
+
+	e.insertPlainText(QStringLiteral("1\n2\n3\n4\n5\n"));
+	w.setLineMarkers(Marker::Error, {2, 5});
+	w.setLineMarkers(Marker::Bookmark, {5});
+	QVERIFY(!w.lineMarkers(1));
+	QVERIFY(w.lineMarkers(2).testFlag(Marker::Error));
+	QVERIFY(!w.lineMarkers(2).testFlag(Marker::Bookmark));
+	QVERIFY(w.lineMarkers(5).testFlag(Marker::Error));
+	QVERIFY(w.lineMarkers(5).testFlag(Marker::Bookmark));
+
+	// Setting markers of one kind replaces the previous ones of that kind
+	w.setLineMarkers(Marker::Error, {3});
+	QVERIFY(!w.lineMarkers(2));
+	QVERIFY(w.lineMarkers(3).testFlag(Marker::Error));
+	QVERIFY(!w.lineMarkers(5).testFlag(Marker::Error));
+	QVERIFY(w.lineMarkers(5).testFlag(Marker::Bookmark));
+
+	w.clearLineMarkers(Marker::Bookmark);
+	QVERIFY(!w.lineMarkers(5));
+	QVERIFY(w.lineMarkers(3).testFlag(Marker::Error));
+
+	// Markers stay with their lines when lines are inserted or removed above
+	QTextCursor cursor(e.document());
+	cursor.insertText(QStringLiteral("0\n"));
+	QVERIFY(!w.lineMarkers(3));
+	QVERIFY(w.lineMarkers(4).testFlag(Marker::Error));
+	cursor.movePosition(QTextCursor::Start);
+	cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 2);
+	cursor.removeSelectedText();
+	QVERIFY(w.lineMarkers(2).testFlag(Marker::Error));
+
+	// Lines that don't exist are ignored
+	w.setLineMarkers(Marker::Error, {100});
+	QVERIFY(!w.lineMarkers(100));
+
+	w.setGeometry(0, 0, w.sizeHint().width(), 100);
+	w.grab();
+
+	w.setMarkersVisible(false);
+	QCOMPARE(w.sizeHint().width(), width);
+}
+
+void TestUI::LineNumberWidget_visibleRange()
+{
+	using Markers = Tw::UI::LineNumberWidget::Markers;
+	constexpr int NumLines = 1000;
+
+	QTextEdit e;
+	QStringList lines;
+	for (int i = 0; i < NumLines; ++i)
+		lines << QString::number(i);
+	e.setPlainText(lines.join(QChar::fromLatin1('\n')));
+	e.resize(200, 200);
+
+	Tw::UI::LineNumberWidget w(&e);
+	w.setMarkersVisible(true);
+	w.setGeometry(0, 0, w.sizeHint().width(), e.viewport()->height());
+
+	QList<int> visited;
+	w.setMarkerProvider([&visited](const QTextBlock & block) {
+		visited.append(block.blockNumber());
+		return Markers(Tw::UI::LineNumberWidget::Marker::Bookmark);
+	});
+
+	// Only the blocks at the top are painted
+	w.grab();
+	QVERIFY(!visited.isEmpty());
+	QVERIFY(visited.size() < NumLines / 10);
+	QCOMPARE(visited.first(), 0);
+
+	// Only the blocks at the bottom are painted (without visiting the ones
+	// before them)
+	e.document()->documentLayout()->documentSize();
+	QVERIFY(e.verticalScrollBar()->maximum() > 0);
+	e.verticalScrollBar()->setValue(e.verticalScrollBar()->maximum());
+	visited.clear();
+	w.grab();
+	QVERIFY(!visited.isEmpty());
+	QVERIFY(visited.size() < NumLines / 10);
+	QCOMPARE(visited.last(), NumLines - 1);
+}
+
 void TestUI::ScreenCalibrationWidget_dpi()
 {
 	Tw::UI::ScreenCalibrationWidget w;
@@ -31,6 +31,8 @@ private slots:
 	void LineNumberWidget_sizeHint();
 	void LineNumberWidget_paint();
 	void LineNumberWidget_setParent();
+	void LineNumberWidget_markers();
+	void LineNumberWidget_visibleRange();
 
 	void ScreenCalibrationWidget_dpi();
 	void ScreenCalibrationWidget_drag();
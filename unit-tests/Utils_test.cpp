@@ -24,11 +24,13 @@
 #include "utils/CommandlineParser.h"
 #include "utils/FileVersionDatabase.h"
 #include "utils/FullscreenManager.h"
+#include "utils/RegularExpressionSet.h"
 #include "utils/ResourcesLibrary.h"
 #include "utils/SystemCommand.h"
 #include "utils/TextCodecs.h"
 #include "utils/TypesetManager.h"
 
+#include <QDirIterator>
 #include <QMenuBar>
 #include <QMouseEvent>
 #include <QStatusBar>
@@ -802,6 +804,188 @@ void TestUtils::TypesetManager()
 	QCOMPARE(tm.isFileBeingTypeset(fileB), false);
 }
 
+// Reference implementation: run every pattern separately and keep the one that
+// matches closest to offset (the first one in case of ties)
+static Tw::Utils::RegularExpressionSet::Match matchSeparately(const QList<QRegularExpression> & patterns, const QString & text, const QString::size_type offset)
+{
+	Tw::Utils::RegularExpressionSet::Match retVal;
+	for (int i = 0; i < patterns.size(); ++i) {
+		QRegularExpressionMatch m = patterns[i].match(text, offset);
+		if (m.hasMatch() && (!retVal.hasMatch() || m.capturedStart() < retVal.start)) {
+			retVal.index = i;
+			retVal.start = m.capturedStart();
+			retVal.length = m.capturedLength();
+			retVal.match = m;
+		}
+	}
+	return retVal;
+}
+
+static QList<QRegularExpression> toRegularExpressions(const QStringList & patterns)
+{
+	QList<QRegularExpression> retVal;
+	for (const QString & pattern : patterns)
+		retVal.append(QRegularExpression(pattern));
+	return retVal;
+}
+
+void TestUtils::RegularExpressionSet_match()
+{
+	using Tw::Utils::RegularExpressionSet;
+	using ST = QString::size_type;
+
+	{
+		RegularExpressionSet set;
+		QCOMPARE(set.count(), 0);
+		QCOMPARE(set.match(QStringLiteral("abc")).hasMatch(), false);
+	}
+
+	QList<QRegularExpression> patterns = toRegularExpressions({
+		QStringLiteral("\\\\(?:begin|end)\\s*\\{[^\\}]*\\}"),
+		QStringLiteral("\\\\(?:[\\p{L}@]+|.)"),
+		QStringLiteral("%.*"),
+		QStringLiteral("(['\"])[^'\"]*\\1"),
+		QStringLiteral("(?x) y # comment"),
+		QStringLiteral("\\{(\\d+)\\}")
+	});
+	RegularExpressionSet set(patterns);
+	QCOMPARE(set.count(), 6);
+	QCOMPARE(set.isCombined(0), true);
+	QCOMPARE(set.isCombined(1), true);
+	QCOMPARE(set.isCombined(2), true);
+	// Backreferences and extended syntax can't be combined
+	QCOMPARE(set.isCombined(3), false);
+	QCOMPARE(set.isCombined(4), false);
+	// Captures without backreferences can
+	QCOMPARE(set.isCombined(5), true);
+
+	// Earlier patterns win ties
+	RegularExpressionSet::Match m = set.match(QStringLiteral("a \\begin{document}"), 1);
+	QCOMPARE(m.index, 0);
+	QCOMPARE(m.start, ST(2));
+	QCOMPARE(m.length, ST(16));
+	m = set.match(QStringLiteral("a \\section{x}"), 1);
+	QCOMPARE(m.index, 1);
+	QCOMPARE(m.start, ST(2));
+	QCOMPARE(m.captured(), QStringLiteral("\\section"));
+
+	// Separately run patterns are merged by position and index
+	m = set.match(QStringLiteral("a 'b' %c"), 1);
+	QCOMPARE(m.index, 3);
+	QCOMPARE(m.start, ST(2));
+	QCOMPARE(m.captured(1), QStringLiteral("'"));
+	m = set.match(QStringLiteral("a 'b' %c"), 5);
+	QCOMPARE(m.index, 2);
+	QCOMPARE(m.start, ST(6));
+	m = set.match(QStringLiteral("ay"), 0);
+	QCOMPARE(m.index, 4);
+	QCOMPARE(m.start, ST(1));
+
+	// Capture groups are relative to the pattern that matched
+	m = set.match(QStringLiteral("a{42}"), 0);
+	QCOMPARE(m.index, 5);
+	QCOMPARE(m.captured(0), QStringLiteral("{42}"));
+	QCOMPARE(m.captured(1), QStringLiteral("42"));
+	QCOMPARE(m.captured(2), QString());
+
+	// Empty matches are reported like any other
+	RegularExpressionSet emptySet(toRegularExpressions({QStringLiteral("b"), QStringLiteral("x*")}));
+	m = emptySet.match(QStringLiteral("abc"), 0);
+	QCOMPARE(m.index, 1);
+	QCOMPARE(m.start, ST(0));
+	QCOMPARE(m.length, ST(0));
+	m = emptySet.match(QStringLiteral("abc"), 1);
+	QCOMPARE(m.index, 0);
+	QCOMPARE(m.start, ST(1));
+	QCOMPARE(m.length, ST(1));
+}
+
+void TestUtils::RegularExpressionSet_corpus_data()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+	constexpr auto SkipEmptyParts = QString::SkipEmptyParts;
+#else
+	constexpr auto SkipEmptyParts = Qt::SkipEmptyParts;
+#endif
+	QTest::addColumn<QStringList>("patterns");
+
+	const QRegularExpression whitespace(QStringLiteral("\\s+"));
+	const QRegularExpression sectionRE(QStringLiteral("^\\[([^\\]]+)\\]"));
+	const QString configDir = QStringLiteral("../res/resfiles/configuration/");
+
+	// Same format as read by TeXHighlighter::loadPatterns()
+	QFile syntaxFile(configDir + QStringLiteral("syntax-patterns.txt"));
+	QVERIFY(syntaxFile.open(QIODevice::ReadOnly | QIODevice::Text));
+	QString section;
+	QStringList patterns;
+	while (!syntaxFile.atEnd()) {
+		const QString line = QString::fromUtf8(syntaxFile.readLine());
+		if (line.startsWith(QChar::fromLatin1('#')) || line.trimmed().isEmpty())
+			continue;
+		QRegularExpressionMatch sectionMatch = sectionRE.match(line);
+		if (sectionMatch.hasMatch()) {
+			if (!patterns.isEmpty())
+				QTest::newRow(qPrintable(section)) << patterns;
+			section = sectionMatch.captured(1);
+			patterns.clear();
+			continue;
+		}
+		const QStringList parts = line.split(whitespace, SkipEmptyParts);
+		if (parts.size() == 3)
+			patterns << parts[2];
+	}
+	if (!patterns.isEmpty())
+		QTest::newRow(qPrintable(section)) << patterns;
+
+	QFile tagPatternFile(configDir + QStringLiteral("tag-patterns.txt"));
+	QVERIFY(tagPatternFile.open(QIODevice::ReadOnly | QIODevice::Text));
+	patterns.clear();
+	while (!tagPatternFile.atEnd()) {
+		const QString line = QString::fromUtf8(tagPatternFile.readLine());
+		if (line.startsWith(QChar::fromLatin1('#')) || line.trimmed().isEmpty())
+			continue;
+		const QStringList parts = line.split(whitespace, SkipEmptyParts);
+		if (parts.size() == 2)
+			patterns << parts[1];
+	}
+	QTest::newRow("tags") << patterns;
+}
+
+void TestUtils::RegularExpressionSet_corpus()
+{
+	QFETCH(QStringList, patterns);
+
+	const QList<QRegularExpression> regexps = toRegularExpressions(patterns);
+	const Tw::Utils::RegularExpressionSet set(regexps);
+
+	QStringList lines;
+	QDirIterator it(QDir::currentPath(), {QStringLiteral("*.tex"), QStringLiteral("*.bib"), QStringLiteral("*.lua"), QStringLiteral("*.js"), QStringLiteral("*.ps"), QStringLiteral("*.dic"), QStringLiteral("*.aff"), QStringLiteral("README")}, QDir::Files, QDirIterator::Subdirectories);
+	while (it.hasNext()) {
+		QFile f(it.next());
+		QVERIFY(f.open(QIODevice::ReadOnly | QIODevice::Text));
+		lines << QString::fromUtf8(f.readAll()).split(QChar::fromLatin1('\n'));
+	}
+	QVERIFY(!lines.isEmpty());
+
+	// Walk through each line the way TeXHighlighter::highlightBlock() does and
+	// compare each step to the reference
+	for (const QString & line : lines) {
+		QString::size_type pos = 0;
+		while (pos < line.length()) {
+			const Tw::Utils::RegularExpressionSet::Match expected = matchSeparately(regexps, line, pos);
+			const Tw::Utils::RegularExpressionSet::Match actual = set.match(line, pos);
+			const QString context = QStringLiteral("%1 @ %2").arg(line).arg(pos);
+			QVERIFY2(actual.index == expected.index, qPrintable(context));
+			QVERIFY2(actual.start == expected.start, qPrintable(context));
+			QVERIFY2(actual.length == expected.length, qPrintable(context));
+			QVERIFY2(actual.captured(1) == expected.captured(1), qPrintable(context));
+			if (!expected.hasMatch() || expected.length == 0)
+				break;
+			pos = expected.start + expected.length;
+		}
+	}
+}
+
 #ifdef Q_OS_DARWIN
 void TestUtils::OSVersionString()
 {
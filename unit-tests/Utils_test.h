@@ -52,6 +52,10 @@ private slots:
 
 	void TypesetManager();
 
+	void RegularExpressionSet_match();
+	void RegularExpressionSet_corpus_data();
+	void RegularExpressionSet_corpus();
+
 #ifdef Q_OS_DARWIN
 	void OSVersionString();
 #endif // defined(Q_OS_DARWIN)